@@ -0,0 +1,719 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * Discrete-event simulation of a fleet of hosts sourcing credentials, for comparing refresh policies before
+ * rolling them out.  Every simulated host runs the real cached and chain providers, on top of two mock sources:
+ * an instance metadata service (local to the host, and missing on some hosts) and STS (shared by the whole fleet,
+ * and throttled above a fixed rate).  The sources answer after a simulated latency, in virtual time, so hours of
+ * fleet activity run in seconds.
+ *
+ *   refresh_sim [--hosts <count>] [--hours <count>] [--requests-per-minute <count>] [--imds-percent <percent>]
+ *               [--sts-limit <requests per second>] [--seed <seed>]
+ *
+ * For each policy, reports the peak requests per second seen by each source, how long callers waited for
+ * credentials, how many callers got no credentials at all and how many were handed credentials that had already
+ * expired.
+ */
+
+#include <aws/auth/auth.h>
+#include <aws/auth/credentials.h>
+#include <aws/auth/private/credentials_utils.h>
+#include <aws/common/priority_queue.h>
+#include <aws/common/string.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#    pragma warning(disable : 4204)
+#endif /* _MSC_VER */
+
+#define NS_PER_MS 1000000ULL
+#define NS_PER_SEC 1000000000ULL
+#define SECS_PER_MINUTE 60ULL
+
+#define DEFAULT_HOST_COUNT 1000
+#define DEFAULT_HOURS 4
+#define DEFAULT_REQUESTS_PER_MINUTE 12
+#define DEFAULT_IMDS_PERCENT 50
+#define DEFAULT_STS_LIMIT 100
+#define DEFAULT_SEED 0x5eed
+
+/* wait buckets: bucket 0 is "didn't wait", bucket i > 0 holds waits in [2^(i-1), 2^i) microseconds */
+#define WAIT_BUCKET_COUNT 40
+
+/*
+ * Simulated credentials carry their expiration in the access key id, so callers can tell when they've been handed
+ * stale ones; the cached provider itself knows nothing about expiration.
+ */
+static const char *s_access_key_prefix = "SIM";
+
+/* the virtual clock every provider in the simulation reads */
+static uint64_t s_now = 0;
+
+static int s_virtual_clock_fn(uint64_t *timestamp) {
+    *timestamp = s_now;
+    return AWS_OP_SUCCESS;
+}
+
+struct sim_source_model {
+    const char *name;
+    uint64_t latency_ns;
+    uint64_t latency_jitter_ns;
+    /* how long a caller waits for an unreachable source before giving up */
+    uint64_t unavailable_timeout_ns;
+    uint64_t credential_lifetime_ns;
+    /* requests per second above which the source throttles; 0 for no limit */
+    uint64_t throttle_limit;
+};
+
+static struct sim_source_model s_imds_model = {
+    .name = "imds",
+    .latency_ns = 1 * NS_PER_MS,
+    .latency_jitter_ns = 1 * NS_PER_MS,
+    .unavailable_timeout_ns = 1 * NS_PER_SEC,
+    .credential_lifetime_ns = 6 * 3600 * NS_PER_SEC,
+    .throttle_limit = 0,
+};
+
+static struct sim_source_model s_sts_model = {
+    .name = "sts",
+    .latency_ns = 30 * NS_PER_MS,
+    .latency_jitter_ns = 20 * NS_PER_MS,
+    .unavailable_timeout_ns = 0,
+    .credential_lifetime_ns = 3600 * NS_PER_SEC,
+    .throttle_limit = DEFAULT_STS_LIMIT,
+};
+
+struct sim_source_stats {
+    uint64_t calls;
+    uint64_t failures;
+    uint64_t current_second;
+    uint64_t current_second_calls;
+    uint64_t peak_calls_per_second;
+};
+
+/*
+ * A policy is what can be configured on the cached provider: its refresh interval.  Each host's interval is drawn
+ * from [interval - jitter, interval], and hosts boot at uniformly random points of the boot window.
+ */
+struct sim_policy {
+    const char *name;
+    uint64_t refresh_interval_ms;
+    uint64_t refresh_jitter_ms;
+    uint64_t boot_window_secs;
+};
+
+static struct sim_policy s_policies[] = {
+    {.name = "5m, staggered boot", .refresh_interval_ms = 5 * 60 * 1000, .boot_window_secs = 3600},
+    {.name = "50m, fleet-wide deploy", .refresh_interval_ms = 50 * 60 * 1000, .boot_window_secs = 60},
+    {.name = "50m, staggered boot", .refresh_interval_ms = 50 * 60 * 1000, .boot_window_secs = 3600},
+    {
+        .name = "50m-10m jitter, fleet-wide deploy",
+        .refresh_interval_ms = 50 * 60 * 1000,
+        .refresh_jitter_ms = 10 * 60 * 1000,
+        .boot_window_secs = 60,
+    },
+    {.name = "70m, staggered boot", .refresh_interval_ms = 70 * 60 * 1000, .boot_window_secs = 3600},
+    {.name = "never, staggered boot", .refresh_interval_ms = 0, .boot_window_secs = 3600},
+};
+
+struct sim_options {
+    size_t host_count;
+    uint64_t hours;
+    uint64_t requests_per_minute;
+    uint64_t imds_percent;
+    uint64_t seed;
+};
+
+struct sim_results {
+    struct sim_source_stats imds_stats;
+    struct sim_source_stats sts_stats;
+    uint64_t caller_requests;
+    uint64_t caller_failures;
+    uint64_t expired_credentials;
+    uint64_t wait_buckets[WAIT_BUCKET_COUNT];
+    uint64_t max_wait_ns;
+};
+
+struct sim_host {
+    struct aws_credentials_provider *cached;
+    uint64_t request_interval_ns;
+};
+
+struct simulation {
+    struct aws_allocator *allocator;
+    const struct sim_options *options;
+    struct aws_priority_queue events;
+    uint64_t event_sequence;
+    uint64_t end_time;
+    uint64_t random_state;
+    struct sim_host *hosts;
+    struct sim_results results;
+};
+
+enum sim_event_type {
+    SIM_EVENT_CALLER_REQUEST,
+    SIM_EVENT_SOURCE_RESPONSE,
+};
+
+struct sim_source_fetch;
+
+struct sim_event {
+    uint64_t time;
+    /* orders events scheduled for the same time by when they were scheduled */
+    uint64_t sequence;
+    enum sim_event_type type;
+    struct sim_host *host;
+    struct sim_source_fetch *fetch;
+};
+
+struct sim_source_impl {
+    struct simulation *sim;
+    const struct sim_source_model *model;
+    struct sim_source_stats *stats;
+    bool available;
+};
+
+struct sim_source_fetch {
+    struct aws_credentials_provider *source;
+    aws_on_get_credentials_callback_fn *callback;
+    void *user_data;
+    bool succeeded;
+};
+
+struct sim_caller_request {
+    struct simulation *sim;
+    uint64_t start_time;
+};
+
+/* xorshift64*: runs are reproducible for a given seed */
+static uint64_t s_random(struct simulation *sim) {
+    sim->random_state ^= sim->random_state >> 12;
+    sim->random_state ^= sim->random_state << 25;
+    sim->random_state ^= sim->random_state >> 27;
+    return sim->random_state * 2685821657736338717ULL;
+}
+
+static uint64_t s_random_below(struct simulation *sim, uint64_t bound) {
+    return bound > 0 ? s_random(sim) % bound : 0;
+}
+
+static int s_compare_events(const void *a, const void *b) {
+    const struct sim_event *event_a = a;
+    const struct sim_event *event_b = b;
+
+    if (event_a->time != event_b->time) {
+        return event_a->time < event_b->time ? -1 : 1;
+    }
+
+    if (event_a->sequence != event_b->sequence) {
+        return event_a->sequence < event_b->sequence ? -1 : 1;
+    }
+
+    return 0;
+}
+
+static int s_schedule(
+    struct simulation *sim,
+    uint64_t time,
+    enum sim_event_type type,
+    struct sim_host *host,
+    struct sim_source_fetch *fetch) {
+
+    struct sim_event event = {
+        .time = time,
+        .sequence = sim->event_sequence++,
+        .type = type,
+        .host = host,
+        .fetch = fetch,
+    };
+
+    return aws_priority_queue_push(&sim->events, &event);
+}
+
+/*
+ * Mock sources
+ */
+static void s_count_source_call(struct sim_source_stats *stats) {
+    uint64_t second = s_now / NS_PER_SEC;
+    if (second != stats->current_second) {
+        stats->current_second = second;
+        stats->current_second_calls = 0;
+    }
+
+    ++stats->calls;
+    ++stats->current_second_calls;
+    if (stats->current_second_calls > stats->peak_calls_per_second) {
+        stats->peak_calls_per_second = stats->current_second_calls;
+    }
+}
+
+static int s_sim_source_get_credentials(
+    struct aws_credentials_provider *provider,
+    aws_on_get_credentials_callback_fn callback,
+    void *user_data) {
+
+    struct sim_source_impl *impl = provider->impl;
+    struct simulation *sim = impl->sim;
+    const struct sim_source_model *model = impl->model;
+
+    struct sim_source_fetch *fetch = aws_mem_calloc(provider->allocator, 1, sizeof(struct sim_source_fetch));
+    if (fetch == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    fetch->source = provider;
+    fetch->callback = callback;
+    fetch->user_data = user_data;
+
+    uint64_t response_delay = model->unavailable_timeout_ns;
+    if (impl->available) {
+        s_count_source_call(impl->stats);
+
+        response_delay = model->latency_ns + s_random_below(sim, model->latency_jitter_ns);
+        fetch->succeeded = model->throttle_limit == 0 || impl->stats->current_second_calls <= model->throttle_limit;
+    }
+
+    if (!fetch->succeeded) {
+        ++impl->stats->failures;
+    }
+
+    if (s_schedule(sim, s_now + response_delay, SIM_EVENT_SOURCE_RESPONSE, NULL, fetch)) {
+        aws_mem_release(provider->allocator, fetch);
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static void s_sim_source_destroy(struct aws_credentials_provider *provider) {
+    aws_credentials_provider_invoke_shutdown_callback(provider);
+
+    aws_mem_release(provider->allocator, provider);
+}
+
+static struct aws_credentials_provider_vtable s_sim_source_vtable = {
+    .get_credentials = s_sim_source_get_credentials,
+    .destroy = s_sim_source_destroy,
+};
+
+static struct aws_credentials_provider *s_sim_source_new(
+    struct simulation *sim,
+    const struct sim_source_model *model,
+    struct sim_source_stats *stats,
+    bool available) {
+
+    struct aws_credentials_provider *provider = NULL;
+    struct sim_source_impl *impl = NULL;
+
+    aws_mem_acquire_many(
+        sim->allocator,
+        2,
+        &provider,
+        sizeof(struct aws_credentials_provider),
+        &impl,
+        sizeof(struct sim_source_impl));
+
+    if (!provider) {
+        return NULL;
+    }
+
+    AWS_ZERO_STRUCT(*provider);
+    AWS_ZERO_STRUCT(*impl);
+
+    aws_credentials_provider_init_base(provider, sim->allocator, &s_sim_source_vtable, impl);
+
+    impl->sim = sim;
+    impl->model = model;
+    impl->stats = stats;
+    impl->available = available;
+
+    return provider;
+}
+
+static void s_complete_source_fetch(struct sim_source_fetch *fetch) {
+    struct aws_credentials_provider *source = fetch->source;
+    struct sim_source_impl *impl = source->impl;
+
+    struct aws_credentials *credentials = NULL;
+    if (fetch->succeeded) {
+        char access_key_id[64];
+        snprintf(
+            access_key_id,
+            sizeof(access_key_id),
+            "%s%" PRIu64,
+            s_access_key_prefix,
+            s_now + impl->model->credential_lifetime_ns);
+
+        struct aws_byte_cursor access_key_id_cursor = aws_byte_cursor_from_c_str(access_key_id);
+        struct aws_byte_cursor secret_access_key_cursor = aws_byte_cursor_from_c_str("SimulatedSecretAccessKey");
+
+        credentials =
+            aws_credentials_new_from_cursors(source->allocator, &access_key_id_cursor, &secret_access_key_cursor, NULL);
+    }
+
+    fetch->callback(credentials, fetch->user_data);
+
+    aws_credentials_destroy(credentials);
+    aws_mem_release(source->allocator, fetch);
+}
+
+/*
+ * Callers
+ */
+static void s_record_wait(struct sim_results *results, uint64_t wait_ns) {
+    if (wait_ns > results->max_wait_ns) {
+        results->max_wait_ns = wait_ns;
+    }
+
+    size_t bucket = 0;
+    for (uint64_t wait_us = wait_ns / 1000; wait_us > 0 && bucket + 1 < WAIT_BUCKET_COUNT; wait_us >>= 1) {
+        ++bucket;
+    }
+
+    ++results->wait_buckets[bucket];
+}
+
+static void s_on_caller_credentials(struct aws_credentials *credentials, void *user_data) {
+    struct sim_caller_request *request = user_data;
+    struct sim_results *results = &request->sim->results;
+
+    s_record_wait(results, s_now - request->start_time);
+
+    if (credentials == NULL) {
+        ++results->caller_failures;
+    } else {
+        const char *access_key_id = aws_string_c_str(credentials->access_key_id);
+        uint64_t expiration = strtoull(access_key_id + strlen(s_access_key_prefix), NULL, 10);
+        if (expiration <= s_now) {
+            ++results->expired_credentials;
+        }
+    }
+
+    aws_mem_release(request->sim->allocator, request);
+}
+
+static int s_run_caller_request(struct simulation *sim, struct sim_host *host) {
+    struct sim_caller_request *request = aws_mem_calloc(sim->allocator, 1, sizeof(struct sim_caller_request));
+    if (request == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    request->sim = sim;
+    request->start_time = s_now;
+
+    ++sim->results.caller_requests;
+
+    if (aws_credentials_provider_get_credentials(host->cached, s_on_caller_credentials, request)) {
+        aws_mem_release(sim->allocator, request);
+        return AWS_OP_ERR;
+    }
+
+    /* uniform inter-arrival times with the configured mean */
+    uint64_t next_request_time = s_now + 1 + s_random_below(sim, 2 * host->request_interval_ns);
+    if (next_request_time >= sim->end_time) {
+        return AWS_OP_SUCCESS;
+    }
+
+    return s_schedule(sim, next_request_time, SIM_EVENT_CALLER_REQUEST, host, NULL);
+}
+
+/*
+ * Simulation
+ */
+static int s_create_hosts(struct simulation *sim, const struct sim_policy *policy) {
+    const struct sim_options *options = sim->options;
+
+    sim->hosts = aws_mem_calloc(sim->allocator, options->host_count, sizeof(struct sim_host));
+    if (sim->hosts == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    for (size_t i = 0; i < options->host_count; ++i) {
+        struct sim_host *host = &sim->hosts[i];
+        host->request_interval_ns = SECS_PER_MINUTE * NS_PER_SEC / options->requests_per_minute;
+
+        bool has_imds = s_random_below(sim, 100) < options->imds_percent;
+
+        struct aws_credentials_provider *sources[2] = {
+            s_sim_source_new(sim, &s_imds_model, &sim->results.imds_stats, has_imds),
+            s_sim_source_new(sim, &s_sts_model, &sim->results.sts_stats, true),
+        };
+
+        struct aws_credentials_provider *chain = NULL;
+        if (sources[0] != NULL && sources[1] != NULL) {
+            struct aws_credentials_provider_chain_options chain_options = {
+                .providers = sources,
+                .provider_count = AWS_ARRAY_SIZE(sources),
+            };
+
+            chain = aws_credentials_provider_new_chain(sim->allocator, &chain_options);
+        }
+
+        if (chain != NULL) {
+            uint64_t refresh_interval_ms = policy->refresh_interval_ms;
+            if (refresh_interval_ms > 0) {
+                refresh_interval_ms -= s_random_below(sim, policy->refresh_jitter_ms);
+            }
+
+            struct aws_credentials_provider_cached_options cached_options = {
+                .source = chain,
+                .refresh_time_in_milliseconds = refresh_interval_ms,
+                .clock_fn = s_virtual_clock_fn,
+            };
+
+            host->cached = aws_credentials_provider_new_cached(sim->allocator, &cached_options);
+        }
+
+        /* the chain holds the sources and the cached provider holds the chain */
+        aws_credentials_provider_release(chain);
+        aws_credentials_provider_release(sources[1]);
+        aws_credentials_provider_release(sources[0]);
+
+        if (host->cached == NULL) {
+            return AWS_OP_ERR;
+        }
+
+        uint64_t boot_time = s_random_below(sim, policy->boot_window_secs * NS_PER_SEC);
+        if (s_schedule(sim, boot_time, SIM_EVENT_CALLER_REQUEST, host, NULL)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_run_events(struct simulation *sim) {
+    struct sim_event event;
+    while (aws_priority_queue_size(&sim->events) > 0) {
+        if (aws_priority_queue_pop(&sim->events, &event)) {
+            return AWS_OP_ERR;
+        }
+
+        s_now = event.time;
+
+        switch (event.type) {
+            case SIM_EVENT_CALLER_REQUEST:
+                if (s_run_caller_request(sim, event.host)) {
+                    return AWS_OP_ERR;
+                }
+                break;
+
+            case SIM_EVENT_SOURCE_RESPONSE:
+                s_complete_source_fetch(event.fetch);
+                break;
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static void s_clean_up_simulation(struct simulation *sim) {
+    /* a failed run can leave fetches behind; answer them so every provider can shut down */
+    struct sim_event event;
+    while (aws_priority_queue_size(&sim->events) > 0) {
+        aws_priority_queue_pop(&sim->events, &event);
+        if (event.type == SIM_EVENT_SOURCE_RESPONSE) {
+            event.fetch->succeeded = false;
+            s_complete_source_fetch(event.fetch);
+        }
+    }
+
+    if (sim->hosts != NULL) {
+        for (size_t i = 0; i < sim->options->host_count; ++i) {
+            aws_credentials_provider_release(sim->hosts[i].cached);
+        }
+
+        aws_mem_release(sim->allocator, sim->hosts);
+        sim->hosts = NULL;
+    }
+
+    aws_priority_queue_clean_up(&sim->events);
+}
+
+static int s_simulate_policy(
+    struct aws_allocator *allocator,
+    const struct sim_options *options,
+    const struct sim_policy *policy,
+    struct sim_results *results) {
+
+    struct simulation sim;
+    AWS_ZERO_STRUCT(sim);
+    sim.allocator = allocator;
+    sim.options = options;
+    sim.end_time = options->hours * 3600 * NS_PER_SEC;
+    /* every policy sees the same fleet */
+    sim.random_state = options->seed != 0 ? options->seed : DEFAULT_SEED;
+
+    s_now = 0;
+
+    if (aws_priority_queue_init_dynamic(
+            &sim.events, allocator, options->host_count * 2, sizeof(struct sim_event), s_compare_events)) {
+        return AWS_OP_ERR;
+    }
+
+    int result = AWS_OP_ERR;
+
+    if (s_create_hosts(&sim, policy)) {
+        goto done;
+    }
+
+    if (s_run_events(&sim)) {
+        goto done;
+    }
+
+    *results = sim.results;
+    result = AWS_OP_SUCCESS;
+
+done:
+
+    s_clean_up_simulation(&sim);
+
+    return result;
+}
+
+/* upper bound of the bucket holding the given fraction of waits, in milliseconds */
+static double s_wait_percentile_ms(const struct sim_results *results, double fraction) {
+    uint64_t target = (uint64_t)(fraction * (double)results->caller_requests);
+    uint64_t seen = 0;
+
+    for (size_t bucket = 0; bucket < WAIT_BUCKET_COUNT; ++bucket) {
+        seen += results->wait_buckets[bucket];
+        if (seen > target) {
+            return bucket == 0 ? 0.0 : (double)(1ULL << bucket) / 1000.0;
+        }
+    }
+
+    return (double)results->max_wait_ns / NS_PER_MS;
+}
+
+static void s_print_results(const struct sim_policy *policy, const struct sim_results *results) {
+    uint64_t waited = results->caller_requests - results->wait_buckets[0];
+
+    printf(
+        "%-34s %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %9" PRIu64 " %7.3f%% %8.1f %8.1f %8.1f %9" PRIu64
+        " %9" PRIu64 "\n",
+        policy->name,
+        results->imds_stats.peak_calls_per_second,
+        results->sts_stats.peak_calls_per_second,
+        results->sts_stats.calls,
+        results->sts_stats.failures,
+        results->caller_requests > 0 ? 100.0 * (double)waited / (double)results->caller_requests : 0.0,
+        s_wait_percentile_ms(results, 0.99),
+        s_wait_percentile_ms(results, 0.9999),
+        (double)results->max_wait_ns / NS_PER_MS,
+        results->caller_failures,
+        results->expired_credentials);
+}
+
+static void s_usage(const char *program) {
+    fprintf(
+        stderr,
+        "usage: %s [--hosts <count>] [--hours <count>] [--requests-per-minute <count>] [--imds-percent <percent>]\n"
+        "       [--sts-limit <requests per second>] [--seed <seed>]\n",
+        program);
+}
+
+int main(int argc, char **argv) {
+    struct sim_options options = {
+        .host_count = DEFAULT_HOST_COUNT,
+        .hours = DEFAULT_HOURS,
+        .requests_per_minute = DEFAULT_REQUESTS_PER_MINUTE,
+        .imds_percent = DEFAULT_IMDS_PERCENT,
+        .seed = DEFAULT_SEED,
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (value == NULL) {
+            s_usage(argv[0]);
+            return 1;
+        }
+
+        if (strcmp(argv[i], "--hosts") == 0) {
+            options.host_count = (size_t)strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--hours") == 0) {
+            options.hours = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--requests-per-minute") == 0) {
+            options.requests_per_minute = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--imds-percent") == 0) {
+            options.imds_percent = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--sts-limit") == 0) {
+            s_sts_model.throttle_limit = strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--seed") == 0) {
+            options.seed = strtoull(value, NULL, 10);
+        } else {
+            s_usage(argv[0]);
+            return 1;
+        }
+
+        ++i;
+    }
+
+    if (options.host_count == 0 || options.hours == 0 || options.requests_per_minute == 0 ||
+        options.imds_percent > 100) {
+        s_usage(argv[0]);
+        return 1;
+    }
+
+    struct aws_allocator *allocator = aws_default_allocator();
+    aws_auth_library_init(allocator);
+
+    printf(
+        "%zu hosts, %" PRIu64 " hours, %" PRIu64 " requests/minute/host, %" PRIu64 "%% with imds, sts limit %" PRIu64
+        "/s\n\n",
+        options.host_count,
+        options.hours,
+        options.requests_per_minute,
+        options.imds_percent,
+        s_sts_model.throttle_limit);
+
+    printf(
+        "%-34s %9s %9s %9s %9s %8s %8s %8s %8s %9s %9s\n",
+        "refresh policy",
+        "imds pk/s",
+        "sts pk/s",
+        "sts calls",
+        "sts fails",
+        "waited",
+        "p99 ms",
+        "p9999 ms",
+        "max ms",
+        "no creds",
+        "expired");
+
+    int exit_code = 0;
+
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(s_policies); ++i) {
+        struct sim_results results;
+        AWS_ZERO_STRUCT(results);
+
+        if (s_simulate_policy(allocator, &options, &s_policies[i], &results)) {
+            fprintf(stderr, "%s: simulation failed: %s\n", s_policies[i].name, aws_error_str(aws_last_error()));
+            exit_code = 1;
+            continue;
+        }
+
+        s_print_results(&s_policies[i], &results);
+    }
+
+    aws_auth_library_clean_up();
+
+    return exit_code;
+}
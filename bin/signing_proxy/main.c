@@ -0,0 +1,938 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * A local sigv4 signing service for programs that can't link this library.  Each http request sent to the proxy is
+ * signed as if it were going to the host named in its Host header, and the proxy responds with the headers to add
+ * to it, one "name: value" line each, in the response body:
+ *
+ *   curl -s -H "Host: sqs.us-east-1.amazonaws.com" "http://127.0.0.1:8119/?Action=ListQueues"
+ *
+ * The request's method, path, query string, headers and body are all signed.  Requests are signed for the region and
+ * service given on the command line, unless they carry X-Signing-Region or X-Signing-Service headers, which are
+ * removed before signing.  Credentials come from the default provider chain, which caches them, and derived signing
+ * keys are cached per day, so a signing request costs about as much as signing in-process.
+ *
+ *   signing_proxy [--port <port> | --unix-socket <path>] [--region <region>] [--service <service>]
+ *   signing_proxy --bench [--connections <count>] [--requests <count>]
+ *
+ * --bench starts the proxy on a local port with fixed credentials, sends it requests from several connections at
+ * once and reports signed requests per second.
+ */
+
+#include <aws/auth/credentials.h>
+#include <aws/auth/signable.h>
+#include <aws/auth/signing.h>
+#include <aws/auth/signing_key_cache.h>
+#include <aws/auth/signing_result.h>
+#include <aws/common/clock.h>
+#include <aws/common/condition_variable.h>
+#include <aws/common/mutex.h>
+#include <aws/common/string.h>
+#include <aws/http/connection.h>
+#include <aws/http/request_response.h>
+#include <aws/http/server.h>
+#include <aws/io/channel_bootstrap.h>
+#include <aws/io/event_loop.h>
+#include <aws/io/host_resolver.h>
+#include <aws/io/socket.h>
+#include <aws/io/stream.h>
+
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#    pragma warning(disable : 4204)
+#endif /* _MSC_VER */
+
+#define DEFAULT_PORT 8119
+#define DEFAULT_BENCH_PORT 8120
+#define DEFAULT_BENCH_CONNECTIONS 8
+#define DEFAULT_BENCH_REQUESTS 100000
+
+/* larger bodies are rejected rather than buffered */
+#define MAX_REQUEST_BODY_SIZE (16 * 1024 * 1024)
+
+AWS_STATIC_STRING_FROM_LITERAL(s_bench_access_key_id, "AKIDEXAMPLE");
+AWS_STATIC_STRING_FROM_LITERAL(s_bench_secret_access_key, "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY");
+
+static struct aws_byte_cursor s_region_header_name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("x-signing-region");
+static struct aws_byte_cursor s_service_header_name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("x-signing-service");
+static struct aws_byte_cursor s_s3_service_name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("s3");
+
+static volatile sig_atomic_t s_shutdown_requested = 0;
+
+static void s_on_sigint(int signal_number) {
+    (void)signal_number;
+    s_shutdown_requested = 1;
+}
+
+struct proxy_context {
+    struct aws_allocator *allocator;
+
+    struct aws_event_loop_group el_group;
+    struct aws_host_resolver resolver;
+    struct aws_client_bootstrap *client_bootstrap;
+    struct aws_server_bootstrap *server_bootstrap;
+    struct aws_http_server *server;
+
+    struct aws_credentials_provider *credentials_provider;
+    struct aws_signing_key_cache *signing_key_cache;
+    struct aws_byte_cursor region;
+    struct aws_byte_cursor service;
+
+    struct aws_mutex lock;
+    struct aws_condition_variable signal;
+    bool server_destroyed;
+};
+
+/*
+ * Lives from the start of an incoming request until its response has been sent
+ */
+struct proxy_request {
+    struct proxy_context *proxy;
+    struct aws_http_stream *stream;
+
+    struct aws_http_message *request;
+    struct aws_byte_buf body;
+    struct aws_input_stream *body_stream;
+    struct aws_byte_buf region;
+    struct aws_byte_buf service;
+    struct aws_signable *signable;
+    struct aws_signing_config_aws config;
+
+    struct aws_http_message *response;
+    struct aws_byte_buf response_body;
+    struct aws_input_stream *response_body_stream;
+};
+
+static void s_proxy_request_destroy(struct proxy_request *request) {
+    struct aws_allocator *allocator = request->proxy->allocator;
+
+    aws_signable_destroy(request->signable);
+    if (request->request != NULL) {
+        aws_http_message_release(request->request);
+    }
+    if (request->body_stream != NULL) {
+        aws_input_stream_destroy(request->body_stream);
+    }
+    if (request->response != NULL) {
+        aws_http_message_release(request->response);
+    }
+    if (request->response_body_stream != NULL) {
+        aws_input_stream_destroy(request->response_body_stream);
+    }
+
+    aws_byte_buf_clean_up(&request->body);
+    aws_byte_buf_clean_up(&request->region);
+    aws_byte_buf_clean_up(&request->service);
+    aws_byte_buf_clean_up(&request->response_body);
+
+    aws_mem_release(allocator, request);
+}
+
+/* the response body stream reads from request->response_body, so both live until the stream completes */
+static void s_send_response(struct proxy_request *request, int status, struct aws_byte_cursor body) {
+    struct aws_allocator *allocator = request->proxy->allocator;
+
+    if (aws_byte_buf_init(&request->response_body, allocator, body.len) ||
+        aws_byte_buf_append(&request->response_body, &body)) {
+        goto on_error;
+    }
+
+    request->response = aws_http_message_new_response(allocator);
+    if (request->response == NULL) {
+        goto on_error;
+    }
+
+    char content_length[21];
+    snprintf(content_length, sizeof(content_length), "%zu", request->response_body.len);
+
+    struct aws_http_header headers[] = {
+        {
+            .name = aws_byte_cursor_from_c_str("content-type"),
+            .value = aws_byte_cursor_from_c_str("text/plain"),
+        },
+        {
+            .name = aws_byte_cursor_from_c_str("content-length"),
+            .value = aws_byte_cursor_from_c_str(content_length),
+        },
+    };
+
+    if (aws_http_message_set_response_status(request->response, status) ||
+        aws_http_message_add_header_array(request->response, headers, AWS_ARRAY_SIZE(headers))) {
+        goto on_error;
+    }
+
+    struct aws_byte_cursor response_body_cursor = aws_byte_cursor_from_buf(&request->response_body);
+    request->response_body_stream = aws_input_stream_new_from_cursor(allocator, &response_body_cursor);
+    if (request->response_body_stream == NULL) {
+        goto on_error;
+    }
+
+    aws_http_message_set_body_stream(request->response, request->response_body_stream);
+
+    if (aws_http_stream_send_response(request->stream, request->response)) {
+        goto on_error;
+    }
+
+    return;
+
+on_error:
+
+    /* the stream completes (and cleans up) once the connection closes */
+    fprintf(stderr, "unable to send response: %s\n", aws_error_str(aws_last_error()));
+    aws_http_connection_close(aws_http_stream_get_connection(request->stream));
+}
+
+static void s_send_error_response(struct proxy_request *request, int status, int error_code) {
+    char message[256];
+    snprintf(message, sizeof(message), "unable to sign request: %s\n", aws_error_str(error_code));
+
+    s_send_response(request, status, aws_byte_cursor_from_c_str(message));
+}
+
+static int s_append_signed_header(struct aws_byte_buf *dest, const struct aws_signing_result_property *header) {
+    struct aws_byte_cursor name = aws_byte_cursor_from_string(header->name);
+    struct aws_byte_cursor value = aws_byte_cursor_from_string(header->value);
+    struct aws_byte_cursor separator = aws_byte_cursor_from_c_str(": ");
+    struct aws_byte_cursor line_end = aws_byte_cursor_from_c_str("\n");
+
+    if (aws_byte_buf_append_dynamic(dest, &name) || aws_byte_buf_append_dynamic(dest, &separator) ||
+        aws_byte_buf_append_dynamic(dest, &value) || aws_byte_buf_append_dynamic(dest, &line_end)) {
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static void s_on_signing_complete(struct aws_signing_result *result, int error_code, void *userdata) {
+    struct proxy_request *request = userdata;
+
+    if (error_code != AWS_ERROR_SUCCESS || result == NULL) {
+        s_send_error_response(request, 500, error_code != AWS_ERROR_SUCCESS ? error_code : AWS_ERROR_UNKNOWN);
+        return;
+    }
+
+    struct aws_array_list *headers = NULL;
+    if (aws_signing_result_get_property_list(result, g_aws_http_headers_property_list_name, &headers)) {
+        s_send_error_response(request, 500, aws_last_error());
+        return;
+    }
+
+    struct aws_byte_buf signed_headers;
+    if (aws_byte_buf_init(&signed_headers, request->proxy->allocator, 512)) {
+        s_send_error_response(request, 500, aws_last_error());
+        return;
+    }
+
+    for (size_t i = 0; i < aws_array_list_length(headers); ++i) {
+        struct aws_signing_result_property header;
+        aws_array_list_get_at(headers, &header, i);
+
+        if (s_append_signed_header(&signed_headers, &header)) {
+            aws_byte_buf_clean_up(&signed_headers);
+            s_send_error_response(request, 500, aws_last_error());
+            return;
+        }
+    }
+
+    s_send_response(request, 200, aws_byte_cursor_from_buf(&signed_headers));
+
+    aws_byte_buf_clean_up(&signed_headers);
+}
+
+static int s_on_request_headers(
+    struct aws_http_stream *stream,
+    enum aws_http_header_block header_block,
+    const struct aws_http_header *header_array,
+    size_t num_headers,
+    void *user_data) {
+
+    (void)stream;
+
+    struct proxy_request *request = user_data;
+
+    if (header_block != AWS_HTTP_HEADER_BLOCK_MAIN) {
+        return AWS_OP_SUCCESS;
+    }
+
+    for (size_t i = 0; i < num_headers; ++i) {
+        const struct aws_http_header *header = &header_array[i];
+
+        if (aws_byte_cursor_eq_ignore_case(&header->name, &s_region_header_name)) {
+            request->region.len = 0;
+            if (aws_byte_buf_append_dynamic(&request->region, &header->value)) {
+                return AWS_OP_ERR;
+            }
+        } else if (aws_byte_cursor_eq_ignore_case(&header->name, &s_service_header_name)) {
+            request->service.len = 0;
+            if (aws_byte_buf_append_dynamic(&request->service, &header->value)) {
+                return AWS_OP_ERR;
+            }
+        } else if (aws_http_message_add_header(request->request, *header)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_on_request_body(struct aws_http_stream *stream, const struct aws_byte_cursor *data, void *user_data) {
+    (void)stream;
+
+    struct proxy_request *request = user_data;
+
+    if (request->body.len + data->len > MAX_REQUEST_BODY_SIZE) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    return aws_byte_buf_append_dynamic(&request->body, data);
+}
+
+static int s_on_request_done(struct aws_http_stream *stream, void *user_data) {
+    struct proxy_request *request = user_data;
+    struct proxy_context *proxy = request->proxy;
+
+    struct aws_byte_cursor method;
+    struct aws_byte_cursor uri;
+    AWS_ZERO_STRUCT(method);
+    AWS_ZERO_STRUCT(uri);
+
+    if (aws_http_stream_get_incoming_request_method(stream, &method) ||
+        aws_http_stream_get_incoming_request_uri(stream, &uri) ||
+        aws_http_message_set_request_method(request->request, method) ||
+        aws_http_message_set_request_path(request->request, uri)) {
+        goto on_error;
+    }
+
+    if (request->body.len > 0) {
+        struct aws_byte_cursor body_cursor = aws_byte_cursor_from_buf(&request->body);
+        request->body_stream = aws_input_stream_new_from_cursor(proxy->allocator, &body_cursor);
+        if (request->body_stream == NULL) {
+            goto on_error;
+        }
+
+        aws_http_message_set_body_stream(request->request, request->body_stream);
+    }
+
+    request->signable = aws_signable_new_http_request(proxy->allocator, request->request);
+    if (request->signable == NULL) {
+        goto on_error;
+    }
+
+    struct aws_signing_config_aws *config = &request->config;
+    config->config_type = AWS_SIGNING_CONFIG_AWS;
+    config->algorithm = AWS_SIGNING_ALGORITHM_SIG_V4_HEADER;
+    config->credentials_provider = proxy->credentials_provider;
+    config->signing_key_cache = proxy->signing_key_cache;
+    config->region = request->region.len > 0 ? aws_byte_cursor_from_buf(&request->region) : proxy->region;
+    config->service = request->service.len > 0 ? aws_byte_cursor_from_buf(&request->service) : proxy->service;
+    aws_date_time_init_now(&config->date);
+
+    /* S3 signs paths as sent and requires a payload hash; every other service wants the usual canonicalization */
+    bool is_s3 = aws_byte_cursor_eq_ignore_case(&config->service, &s_s3_service_name);
+    config->use_double_uri_encode = !is_s3;
+    config->should_normalize_uri_path = !is_s3;
+    config->body_signing_type = is_s3 ? AWS_BODY_SIGNING_ON : AWS_BODY_SIGNING_OFF;
+
+    if (aws_sign_request_aws(
+            proxy->allocator,
+            request->signable,
+            (struct aws_signing_config_base *)config,
+            s_on_signing_complete,
+            request)) {
+        goto on_error;
+    }
+
+    return AWS_OP_SUCCESS;
+
+on_error:
+
+    s_send_error_response(request, 400, aws_last_error());
+
+    return AWS_OP_SUCCESS;
+}
+
+static void s_on_request_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    (void)error_code;
+
+    struct proxy_request *request = user_data;
+
+    aws_http_stream_release(stream);
+    s_proxy_request_destroy(request);
+}
+
+static struct aws_http_stream *s_on_incoming_request(struct aws_http_connection *connection, void *user_data) {
+    struct proxy_context *proxy = user_data;
+
+    struct proxy_request *request = aws_mem_calloc(proxy->allocator, 1, sizeof(struct proxy_request));
+    if (request == NULL) {
+        return NULL;
+    }
+
+    request->proxy = proxy;
+
+    request->request = aws_http_message_new_request(proxy->allocator);
+    if (request->request == NULL || aws_byte_buf_init(&request->body, proxy->allocator, 0) ||
+        aws_byte_buf_init(&request->region, proxy->allocator, 0) ||
+        aws_byte_buf_init(&request->service, proxy->allocator, 0)) {
+        goto on_error;
+    }
+
+    struct aws_http_request_handler_options options = {
+        .self_size = sizeof(struct aws_http_request_handler_options),
+        .server_connection = connection,
+        .user_data = request,
+        .on_request_headers = s_on_request_headers,
+        .on_request_body = s_on_request_body,
+        .on_request_done = s_on_request_done,
+        .on_complete = s_on_request_complete,
+    };
+
+    request->stream = aws_http_stream_new_server_request_handler(&options);
+    if (request->stream == NULL) {
+        goto on_error;
+    }
+
+    return request->stream;
+
+on_error:
+
+    s_proxy_request_destroy(request);
+
+    return NULL;
+}
+
+static void s_on_server_connection_shutdown(struct aws_http_connection *connection, int error_code, void *user_data) {
+    (void)error_code;
+    (void)user_data;
+
+    aws_http_connection_release(connection);
+}
+
+static void s_on_incoming_connection(
+    struct aws_http_server *server,
+    struct aws_http_connection *connection,
+    int error_code,
+    void *user_data) {
+
+    (void)server;
+
+    if (error_code != AWS_ERROR_SUCCESS) {
+        fprintf(stderr, "incoming connection failed: %s\n", aws_error_str(error_code));
+        return;
+    }
+
+    struct aws_http_server_connection_options options = {
+        .self_size = sizeof(struct aws_http_server_connection_options),
+        .connection_user_data = user_data,
+        .on_incoming_request = s_on_incoming_request,
+        .on_shutdown = s_on_server_connection_shutdown,
+    };
+
+    if (aws_http_connection_configure_server(connection, &options)) {
+        fprintf(stderr, "unable to configure connection: %s\n", aws_error_str(aws_last_error()));
+        aws_http_connection_release(connection);
+    }
+}
+
+static void s_on_server_destroy_complete(void *user_data) {
+    struct proxy_context *proxy = user_data;
+
+    aws_mutex_lock(&proxy->lock);
+    proxy->server_destroyed = true;
+    aws_condition_variable_notify_all(&proxy->signal);
+    aws_mutex_unlock(&proxy->lock);
+}
+
+static bool s_is_server_destroyed(void *user_data) {
+    struct proxy_context *proxy = user_data;
+    return proxy->server_destroyed;
+}
+
+static int s_proxy_init(struct proxy_context *proxy, struct aws_allocator *allocator) {
+    AWS_ZERO_STRUCT(*proxy);
+    proxy->allocator = allocator;
+
+    if (aws_mutex_init(&proxy->lock)) {
+        return AWS_OP_ERR;
+    }
+
+    if (aws_condition_variable_init(&proxy->signal)) {
+        goto on_signal_error;
+    }
+
+    if (aws_event_loop_group_default_init(&proxy->el_group, allocator, 0)) {
+        goto on_el_group_error;
+    }
+
+    if (aws_host_resolver_init_default(&proxy->resolver, allocator, 8, &proxy->el_group)) {
+        goto on_resolver_error;
+    }
+
+    struct aws_client_bootstrap_options bootstrap_options = {
+        .event_loop_group = &proxy->el_group,
+        .host_resolver = &proxy->resolver,
+    };
+    proxy->client_bootstrap = aws_client_bootstrap_new(allocator, &bootstrap_options);
+    if (proxy->client_bootstrap == NULL) {
+        goto on_client_bootstrap_error;
+    }
+
+    proxy->server_bootstrap = aws_server_bootstrap_new(allocator, &proxy->el_group);
+    if (proxy->server_bootstrap == NULL) {
+        goto on_server_bootstrap_error;
+    }
+
+    proxy->signing_key_cache = aws_signing_key_cache_new(allocator, NULL);
+    if (proxy->signing_key_cache == NULL) {
+        goto on_key_cache_error;
+    }
+
+    return AWS_OP_SUCCESS;
+
+on_key_cache_error:
+    aws_server_bootstrap_release(proxy->server_bootstrap);
+
+on_server_bootstrap_error:
+    aws_client_bootstrap_release(proxy->client_bootstrap);
+
+on_client_bootstrap_error:
+    aws_host_resolver_clean_up(&proxy->resolver);
+
+on_resolver_error:
+    aws_event_loop_group_clean_up(&proxy->el_group);
+
+on_el_group_error:
+    aws_condition_variable_clean_up(&proxy->signal);
+
+on_signal_error:
+    aws_mutex_clean_up(&proxy->lock);
+
+    return AWS_OP_ERR;
+}
+
+static int s_proxy_listen(struct proxy_context *proxy, const char *unix_socket_path, uint16_t port) {
+    struct aws_socket_endpoint endpoint;
+    AWS_ZERO_STRUCT(endpoint);
+
+    struct aws_socket_options socket_options = {
+        .type = AWS_SOCKET_STREAM,
+        .connect_timeout_ms = 3000,
+    };
+
+    if (unix_socket_path != NULL) {
+        if (strlen(unix_socket_path) >= sizeof(endpoint.address)) {
+            fprintf(stderr, "unix socket path is too long\n");
+            return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        }
+
+        socket_options.domain = AWS_SOCKET_LOCAL;
+        snprintf(endpoint.address, sizeof(endpoint.address), "%s", unix_socket_path);
+    } else {
+        socket_options.domain = AWS_SOCKET_IPV4;
+        snprintf(endpoint.address, sizeof(endpoint.address), "127.0.0.1");
+        endpoint.port = port;
+    }
+
+    struct aws_http_server_options server_options = {
+        .self_size = sizeof(struct aws_http_server_options),
+        .allocator = proxy->allocator,
+        .bootstrap = proxy->server_bootstrap,
+        .endpoint = &endpoint,
+        .socket_options = &socket_options,
+        .initial_window_size = SIZE_MAX,
+        .server_user_data = proxy,
+        .on_incoming_connection = s_on_incoming_connection,
+        .on_destroy_complete = s_on_server_destroy_complete,
+    };
+
+    proxy->server = aws_http_server_new(&server_options);
+    if (proxy->server == NULL) {
+        fprintf(stderr, "unable to listen on %s: %s\n", endpoint.address, aws_error_str(aws_last_error()));
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static void s_proxy_clean_up(struct proxy_context *proxy) {
+    if (proxy->server != NULL) {
+        aws_http_server_release(proxy->server);
+
+        aws_mutex_lock(&proxy->lock);
+        aws_condition_variable_wait_pred(&proxy->signal, &proxy->lock, s_is_server_destroyed, proxy);
+        aws_mutex_unlock(&proxy->lock);
+    }
+
+    aws_credentials_provider_release(proxy->credentials_provider);
+    aws_signing_key_cache_destroy(proxy->signing_key_cache);
+    aws_server_bootstrap_release(proxy->server_bootstrap);
+    aws_client_bootstrap_release(proxy->client_bootstrap);
+
+    aws_host_resolver_clean_up(&proxy->resolver);
+    aws_event_loop_group_clean_up(&proxy->el_group);
+
+    aws_condition_variable_clean_up(&proxy->signal);
+    aws_mutex_clean_up(&proxy->lock);
+}
+
+/*
+ * Benchmark: each connection sends GET requests one after another until the shared budget is spent
+ */
+
+struct bench_context {
+    struct proxy_context *proxy;
+    struct aws_http_message *request;
+    size_t request_budget;
+
+    /* protected by the proxy's lock */
+    size_t requests_started;
+    size_t requests_succeeded;
+    size_t requests_failed;
+    size_t open_connections;
+};
+
+static void s_bench_send_next_request(struct bench_context *bench, struct aws_http_connection *connection);
+
+static int s_bench_on_response_body(
+    struct aws_http_stream *stream,
+    const struct aws_byte_cursor *data,
+    void *user_data) {
+    (void)stream;
+    (void)data;
+    (void)user_data;
+
+    return AWS_OP_SUCCESS;
+}
+
+static void s_bench_on_response_complete(struct aws_http_stream *stream, int error_code, void *user_data) {
+    struct bench_context *bench = user_data;
+    struct proxy_context *proxy = bench->proxy;
+
+    int status = 0;
+    bool succeeded = error_code == AWS_ERROR_SUCCESS &&
+                     aws_http_stream_get_incoming_response_status(stream, &status) == AWS_OP_SUCCESS && status == 200;
+
+    struct aws_http_connection *connection = aws_http_stream_get_connection(stream);
+    aws_http_stream_release(stream);
+
+    aws_mutex_lock(&proxy->lock);
+    if (succeeded) {
+        ++bench->requests_succeeded;
+    } else {
+        ++bench->requests_failed;
+    }
+    aws_mutex_unlock(&proxy->lock);
+
+    s_bench_send_next_request(bench, connection);
+}
+
+static void s_bench_connection_done(struct bench_context *bench, struct aws_http_connection *connection) {
+    struct proxy_context *proxy = bench->proxy;
+
+    if (connection != NULL) {
+        aws_http_connection_release(connection);
+    }
+
+    aws_mutex_lock(&proxy->lock);
+    --bench->open_connections;
+    aws_condition_variable_notify_all(&proxy->signal);
+    aws_mutex_unlock(&proxy->lock);
+}
+
+static void s_bench_send_next_request(struct bench_context *bench, struct aws_http_connection *connection) {
+    struct proxy_context *proxy = bench->proxy;
+
+    aws_mutex_lock(&proxy->lock);
+    bool has_budget = bench->requests_started < bench->request_budget;
+    if (has_budget) {
+        ++bench->requests_started;
+    }
+    aws_mutex_unlock(&proxy->lock);
+
+    if (!has_budget) {
+        s_bench_connection_done(bench, connection);
+        return;
+    }
+
+    struct aws_http_make_request_options options = {
+        .self_size = sizeof(struct aws_http_make_request_options),
+        .request = bench->request,
+        .user_data = bench,
+        .on_response_body = s_bench_on_response_body,
+        .on_complete = s_bench_on_response_complete,
+    };
+
+    if (aws_http_connection_make_request(connection, &options) == NULL) {
+        aws_mutex_lock(&proxy->lock);
+        ++bench->requests_failed;
+        aws_mutex_unlock(&proxy->lock);
+
+        s_bench_connection_done(bench, connection);
+    }
+}
+
+static void s_bench_on_connection_setup(struct aws_http_connection *connection, int error_code, void *user_data) {
+    struct bench_context *bench = user_data;
+
+    if (error_code != AWS_ERROR_SUCCESS) {
+        fprintf(stderr, "unable to connect to the proxy: %s\n", aws_error_str(error_code));
+        s_bench_connection_done(bench, NULL);
+        return;
+    }
+
+    s_bench_send_next_request(bench, connection);
+}
+
+static void s_bench_on_connection_shutdown(struct aws_http_connection *connection, int error_code, void *user_data) {
+    (void)connection;
+    (void)error_code;
+    (void)user_data;
+}
+
+static bool s_are_bench_connections_done(void *user_data) {
+    struct bench_context *bench = user_data;
+    return bench->open_connections == 0;
+}
+
+static struct aws_http_message *s_new_bench_request(struct aws_allocator *allocator) {
+    struct aws_http_message *request = aws_http_message_new_request(allocator);
+    if (request == NULL) {
+        return NULL;
+    }
+
+    struct aws_http_header headers[] = {
+        {
+            .name = aws_byte_cursor_from_c_str("Host"),
+            .value = aws_byte_cursor_from_c_str("examplebucket.s3.amazonaws.com"),
+        },
+        {
+            .name = aws_byte_cursor_from_c_str("Range"),
+            .value = aws_byte_cursor_from_c_str("bytes=0-9"),
+        },
+    };
+
+    if (aws_http_message_set_request_method(request, aws_http_method_get) ||
+        aws_http_message_set_request_path(request, aws_byte_cursor_from_c_str("/bench/object.txt")) ||
+        aws_http_message_add_header_array(request, headers, AWS_ARRAY_SIZE(headers))) {
+        aws_http_message_release(request);
+        return NULL;
+    }
+
+    return request;
+}
+
+static int s_run_bench(struct proxy_context *proxy, size_t connection_count, size_t request_budget) {
+    struct bench_context bench;
+    AWS_ZERO_STRUCT(bench);
+    bench.proxy = proxy;
+    bench.request_budget = request_budget;
+
+    bench.request = s_new_bench_request(proxy->allocator);
+    if (bench.request == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_socket_options socket_options = {
+        .type = AWS_SOCKET_STREAM,
+        .domain = AWS_SOCKET_IPV4,
+        .connect_timeout_ms = 3000,
+    };
+
+    struct aws_http_client_connection_options options = {
+        .self_size = sizeof(struct aws_http_client_connection_options),
+        .allocator = proxy->allocator,
+        .bootstrap = proxy->client_bootstrap,
+        .host_name = aws_byte_cursor_from_c_str("127.0.0.1"),
+        .port = DEFAULT_BENCH_PORT,
+        .socket_options = &socket_options,
+        .initial_window_size = SIZE_MAX,
+        .user_data = &bench,
+        .on_setup = s_bench_on_connection_setup,
+        .on_shutdown = s_bench_on_connection_shutdown,
+    };
+
+    uint64_t start_ns = 0;
+    aws_high_res_clock_get_ticks(&start_ns);
+
+    bench.open_connections = connection_count;
+    for (size_t i = 0; i < connection_count; ++i) {
+        if (aws_http_client_connect(&options)) {
+            fprintf(stderr, "unable to connect to the proxy: %s\n", aws_error_str(aws_last_error()));
+            s_bench_connection_done(&bench, NULL);
+        }
+    }
+
+    aws_mutex_lock(&proxy->lock);
+    aws_condition_variable_wait_pred(&proxy->signal, &proxy->lock, s_are_bench_connections_done, &bench);
+    aws_mutex_unlock(&proxy->lock);
+
+    uint64_t end_ns = 0;
+    aws_high_res_clock_get_ticks(&end_ns);
+
+    aws_http_message_release(bench.request);
+
+    double elapsed_secs = (double)(end_ns - start_ns) / (double)AWS_TIMESTAMP_NANOS;
+    size_t completed = bench.requests_succeeded + bench.requests_failed;
+
+    printf("connections: %zu\n", connection_count);
+    printf("requests:    %zu\n", completed);
+    printf("failures:    %zu\n", bench.requests_failed);
+    printf("elapsed:     %.3f s\n", elapsed_secs);
+    printf(
+        "throughput:  %.1f signed requests/s\n",
+        elapsed_secs > 0 ? (double)bench.requests_succeeded / elapsed_secs : 0.0);
+
+    /* every connection has one request outstanding at a time */
+    printf(
+        "latency:     %.1f us/request\n",
+        completed > 0 ? elapsed_secs * 1e6 * (double)connection_count / (double)completed : 0.0);
+
+    return bench.requests_failed == 0 && completed > 0 ? AWS_OP_SUCCESS : AWS_OP_ERR;
+}
+
+static void s_usage(const char *program) {
+    fprintf(
+        stderr,
+        "usage: %s [--port <port> | --unix-socket <path>] [--region <region>] [--service <service>]\n"
+        "       %s --bench [--connections <count>] [--requests <count>]\n",
+        program,
+        program);
+}
+
+int main(int argc, char **argv) {
+    const char *unix_socket_path = NULL;
+    uint16_t port = DEFAULT_PORT;
+    const char *region = "us-east-1";
+    const char *service = "s3";
+    bool bench = false;
+    size_t connection_count = DEFAULT_BENCH_CONNECTIONS;
+    size_t request_budget = DEFAULT_BENCH_REQUESTS;
+
+    for (int i = 1; i < argc; ++i) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "--bench") == 0) {
+            bench = true;
+            continue;
+        }
+
+        if (value == NULL) {
+            s_usage(argv[0]);
+            return 1;
+        }
+
+        if (strcmp(argv[i], "--port") == 0) {
+            port = (uint16_t)strtoul(value, NULL, 10);
+        } else if (strcmp(argv[i], "--unix-socket") == 0) {
+            unix_socket_path = value;
+        } else if (strcmp(argv[i], "--region") == 0) {
+            region = value;
+        } else if (strcmp(argv[i], "--service") == 0) {
+            service = value;
+        } else if (strcmp(argv[i], "--connections") == 0) {
+            connection_count = (size_t)strtoull(value, NULL, 10);
+        } else if (strcmp(argv[i], "--requests") == 0) {
+            request_budget = (size_t)strtoull(value, NULL, 10);
+        } else {
+            s_usage(argv[0]);
+            return 1;
+        }
+
+        ++i;
+    }
+
+    if (bench && (connection_count == 0 || request_budget == 0)) {
+        s_usage(argv[0]);
+        return 1;
+    }
+
+    struct aws_allocator *allocator = aws_default_allocator();
+    aws_auth_library_init(allocator);
+
+    int exit_code = 1;
+
+    struct proxy_context proxy;
+    if (s_proxy_init(&proxy, allocator)) {
+        fprintf(stderr, "unable to initialize: %s\n", aws_error_str(aws_last_error()));
+        aws_auth_library_clean_up();
+        return exit_code;
+    }
+
+    proxy.region = aws_byte_cursor_from_c_str(region);
+    proxy.service = aws_byte_cursor_from_c_str(service);
+
+    if (bench) {
+        struct aws_credentials_provider_static_options static_options = {
+            .access_key_id = aws_byte_cursor_from_string(s_bench_access_key_id),
+            .secret_access_key = aws_byte_cursor_from_string(s_bench_secret_access_key),
+        };
+        proxy.credentials_provider = aws_credentials_provider_new_static(allocator, &static_options);
+    } else {
+        struct aws_credentials_provider_chain_default_options chain_options = {
+            .bootstrap = proxy.client_bootstrap,
+        };
+        proxy.credentials_provider = aws_credentials_provider_new_chain_default(allocator, &chain_options);
+    }
+
+    if (proxy.credentials_provider == NULL) {
+        fprintf(stderr, "unable to create a credentials provider: %s\n", aws_error_str(aws_last_error()));
+        goto done;
+    }
+
+    if (s_proxy_listen(&proxy, bench ? NULL : unix_socket_path, bench ? DEFAULT_BENCH_PORT : port)) {
+        goto done;
+    }
+
+    if (bench) {
+        if (s_run_bench(&proxy, connection_count, request_budget) == AWS_OP_SUCCESS) {
+            exit_code = 0;
+        }
+        goto done;
+    }
+
+    if (unix_socket_path != NULL) {
+        printf("signing requests on %s\n", unix_socket_path);
+    } else {
+        printf("signing requests on 127.0.0.1:%" PRIu16 "\n", port);
+    }
+    fflush(stdout);
+
+    signal(SIGINT, s_on_sigint);
+
+    aws_mutex_lock(&proxy.lock);
+    while (!s_shutdown_requested) {
+        aws_condition_variable_wait_for(
+            &proxy.signal,
+            &proxy.lock,
+            (int64_t)aws_timestamp_convert(1, AWS_TIMESTAMP_SECS, AWS_TIMESTAMP_NANOS, NULL));
+    }
+    aws_mutex_unlock(&proxy.lock);
+
+    exit_code = 0;
+
+done:
+
+    s_proxy_clean_up(&proxy);
+
+    aws_auth_library_clean_up();
+
+    return exit_code;
+}
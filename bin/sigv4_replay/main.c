@@ -0,0 +1,402 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+/*
+ * Replays a signing trace (see aws/auth/signing_trace.h) against the sigv4 signer.  Every record is turned into a
+ * synthetic http request of the same shape, then the whole set is signed repeatedly and per-call latency is
+ * reported.
+ *
+ *   sigv4_replay <trace file> [iterations]
+ */
+
+#include <aws/auth/credentials.h>
+#include <aws/auth/signable.h>
+#include <aws/auth/signing.h>
+#include <aws/auth/signing_trace.h>
+#include <aws/common/clock.h>
+#include <aws/common/string.h>
+#include <aws/http/request_response.h>
+#include <aws/io/file_utils.h>
+#include <aws/io/stream.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#    pragma warning(disable : 4204)
+#endif /* _MSC_VER */
+
+#define DEFAULT_ITERATIONS 100
+#define QUERY_PARAM_SIZE 8
+
+AWS_STATIC_STRING_FROM_LITERAL(s_access_key_id, "AKIDEXAMPLE");
+AWS_STATIC_STRING_FROM_LITERAL(s_secret_access_key, "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY");
+
+struct replay_request {
+    struct aws_signing_config_aws config;
+    struct aws_byte_buf path;
+    struct aws_input_stream *body;
+    struct aws_http_message *message;
+    struct aws_signable *signable;
+};
+
+struct replay_context {
+    struct aws_allocator *allocator;
+    struct aws_byte_buf trace;
+    struct aws_byte_buf filler;
+    struct aws_array_list requests;
+    struct aws_credentials_provider *credentials_provider;
+    size_t failures;
+};
+
+static void s_on_signing_complete(struct aws_signing_result *result, int error_code, void *userdata) {
+    (void)result;
+
+    struct replay_context *context = userdata;
+    if (error_code != AWS_ERROR_SUCCESS) {
+        ++context->failures;
+    }
+}
+
+static int s_uint64_compare(const void *a, const void *b) {
+    uint64_t lhs = *(const uint64_t *)a;
+    uint64_t rhs = *(const uint64_t *)b;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+static size_t s_max_size(size_t lhs, size_t rhs) {
+    return lhs > rhs ? lhs : rhs;
+}
+
+/*
+ * Filler bytes stand in for every value (path segments, header values, payloads), so size it to the largest one
+ */
+static int s_init_filler(struct replay_context *context) {
+    struct aws_signing_trace_record record;
+    if (aws_signing_trace_record_init(&record, context->allocator)) {
+        return AWS_OP_ERR;
+    }
+
+    size_t filler_size = 1;
+    struct aws_byte_cursor cursor = aws_byte_cursor_from_buf(&context->trace);
+    if (aws_signing_trace_decode_header(&cursor)) {
+        goto on_error;
+    }
+
+    while (cursor.len > 0) {
+        if (aws_signing_trace_record_decode(&record, &cursor)) {
+            goto on_error;
+        }
+
+        filler_size = s_max_size(filler_size, (size_t)record.payload_size);
+        for (size_t i = 0; i < aws_array_list_length(&record.headers); ++i) {
+            struct aws_signing_trace_header_shape shape;
+            aws_array_list_get_at(&record.headers, &shape, i);
+            filler_size = s_max_size(filler_size, shape.value_length);
+        }
+    }
+
+    aws_signing_trace_record_clean_up(&record);
+
+    if (aws_byte_buf_init(&context->filler, context->allocator, filler_size)) {
+        return AWS_OP_ERR;
+    }
+
+    memset(context->filler.buffer, 'a', filler_size);
+    context->filler.len = filler_size;
+
+    return AWS_OP_SUCCESS;
+
+on_error:
+
+    aws_signing_trace_record_clean_up(&record);
+
+    return AWS_OP_ERR;
+}
+
+static int s_build_path(struct replay_request *request, const struct aws_signing_trace_record *record) {
+    struct aws_byte_cursor slash = aws_byte_cursor_from_c_str("/");
+    if (aws_byte_buf_append_dynamic(&request->path, &slash)) {
+        return AWS_OP_ERR;
+    }
+
+    for (uint32_t i = 1; i < record->path_length; ++i) {
+        struct aws_byte_cursor segment_char = aws_byte_cursor_from_c_str((i % 16 == 0) ? "/" : "p");
+        if (aws_byte_buf_append_dynamic(&request->path, &segment_char)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    for (uint32_t i = 0; i < record->query_param_count; ++i) {
+        char param[QUERY_PARAM_SIZE * 2];
+        snprintf(param, sizeof(param), "%cq%" PRIu32 "=v", i == 0 ? '?' : '&', i);
+
+        struct aws_byte_cursor param_cursor = aws_byte_cursor_from_c_str(param);
+        if (aws_byte_buf_append_dynamic(&request->path, &param_cursor)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_build_request(
+    struct replay_context *context,
+    const struct aws_signing_trace_record *record,
+    struct replay_request *request) {
+
+    struct aws_allocator *allocator = context->allocator;
+
+    request->config.config_type = AWS_SIGNING_CONFIG_AWS;
+    request->config.algorithm = record->algorithm;
+    request->config.body_signing_type = record->body_signing_type;
+    request->config.use_double_uri_encode = record->use_double_uri_encode;
+    request->config.should_normalize_uri_path = record->should_normalize_uri_path;
+    request->config.credentials_provider = context->credentials_provider;
+    request->config.region = aws_byte_cursor_from_c_str("us-east-1");
+    request->config.service = aws_byte_cursor_from_c_str("service");
+
+    if (aws_byte_buf_init(&request->path, allocator, record->path_length + 1) || s_build_path(request, record)) {
+        return AWS_OP_ERR;
+    }
+
+    request->message = aws_http_message_new_request(allocator);
+    if (request->message == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_byte_cursor method = record->payload_size > 0 ? aws_http_method_put : aws_http_method_get;
+    if (aws_http_message_set_request_method(request->message, method) ||
+        aws_http_message_set_request_path(request->message, aws_byte_cursor_from_buf(&request->path))) {
+        return AWS_OP_ERR;
+    }
+
+    for (size_t i = 0; i < aws_array_list_length(&record->headers); ++i) {
+        struct aws_signing_trace_header_shape shape;
+        aws_array_list_get_at(&record->headers, &shape, i);
+
+        struct aws_http_header header = {
+            .name = shape.name,
+            .value = aws_byte_cursor_from_array(context->filler.buffer, shape.value_length),
+        };
+
+        if (aws_http_message_add_header(request->message, header)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    if (record->payload_size > 0) {
+        struct aws_byte_cursor body = aws_byte_cursor_from_array(context->filler.buffer, (size_t)record->payload_size);
+        request->body = aws_input_stream_new_from_cursor(allocator, &body);
+        if (request->body == NULL) {
+            return AWS_OP_ERR;
+        }
+
+        aws_http_message_set_body_stream(request->message, request->body);
+    }
+
+    request->signable = aws_signable_new_http_request(allocator, request->message);
+    if (request->signable == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static void s_clean_up_request(struct replay_request *request) {
+    if (request->signable != NULL) {
+        aws_signable_destroy(request->signable);
+    }
+
+    if (request->message != NULL) {
+        aws_http_message_release(request->message);
+    }
+
+    if (request->body != NULL) {
+        aws_input_stream_destroy(request->body);
+    }
+
+    aws_byte_buf_clean_up(&request->path);
+}
+
+static int s_build_requests(struct replay_context *context) {
+    struct aws_signing_trace_record record;
+    if (aws_signing_trace_record_init(&record, context->allocator)) {
+        return AWS_OP_ERR;
+    }
+
+    int result = AWS_OP_ERR;
+
+    struct aws_byte_cursor cursor = aws_byte_cursor_from_buf(&context->trace);
+    if (aws_signing_trace_decode_header(&cursor)) {
+        goto done;
+    }
+
+    while (cursor.len > 0) {
+        if (aws_signing_trace_record_decode(&record, &cursor)) {
+            goto done;
+        }
+
+        struct replay_request request;
+        AWS_ZERO_STRUCT(request);
+
+        if (s_build_request(context, &record, &request) || aws_array_list_push_back(&context->requests, &request)) {
+            s_clean_up_request(&request);
+            goto done;
+        }
+    }
+
+    result = AWS_OP_SUCCESS;
+
+done:
+
+    aws_signing_trace_record_clean_up(&record);
+
+    return result;
+}
+
+static int s_replay(struct replay_context *context, size_t iterations) {
+    const size_t request_count = aws_array_list_length(&context->requests);
+    const size_t sample_count = request_count * iterations;
+    if (sample_count == 0) {
+        fprintf(stderr, "trace contains no records\n");
+        return AWS_OP_ERR;
+    }
+
+    uint64_t *latencies = aws_mem_acquire(context->allocator, sample_count * sizeof(uint64_t));
+    if (latencies == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    uint64_t start_ns = 0;
+    aws_high_res_clock_get_ticks(&start_ns);
+
+    size_t sample = 0;
+    for (size_t iteration = 0; iteration < iterations; ++iteration) {
+        for (size_t i = 0; i < request_count; ++i) {
+            struct replay_request *request = NULL;
+            aws_array_list_get_at_ptr(&context->requests, (void **)&request, i);
+
+            aws_date_time_init_now(&request->config.date);
+
+            uint64_t before_ns = 0;
+            uint64_t after_ns = 0;
+
+            /* the static provider completes synchronously, so the request is fully signed on return */
+            aws_high_res_clock_get_ticks(&before_ns);
+            if (aws_sign_request_aws(
+                    context->allocator,
+                    request->signable,
+                    (struct aws_signing_config_base *)&request->config,
+                    s_on_signing_complete,
+                    context)) {
+                ++context->failures;
+            }
+            aws_high_res_clock_get_ticks(&after_ns);
+
+            latencies[sample++] = after_ns - before_ns;
+        }
+    }
+
+    uint64_t end_ns = 0;
+    aws_high_res_clock_get_ticks(&end_ns);
+
+    qsort(latencies, sample_count, sizeof(uint64_t), s_uint64_compare);
+
+    double elapsed_secs = (double)(end_ns - start_ns) / (double)AWS_TIMESTAMP_NANOS;
+
+    printf("requests:    %zu (%zu iterations of %zu records)\n", sample_count, iterations, request_count);
+    printf("failures:    %zu\n", context->failures);
+    printf("elapsed:     %.3f s\n", elapsed_secs);
+    printf("throughput:  %.1f signs/s\n", elapsed_secs > 0 ? (double)sample_count / elapsed_secs : 0.0);
+    printf("latency p50: %" PRIu64 " ns\n", latencies[sample_count / 2]);
+    printf("latency p90: %" PRIu64 " ns\n", latencies[(sample_count * 90) / 100]);
+    printf("latency p99: %" PRIu64 " ns\n", latencies[(sample_count * 99) / 100]);
+    printf("latency max: %" PRIu64 " ns\n", latencies[sample_count - 1]);
+
+    aws_mem_release(context->allocator, latencies);
+
+    return AWS_OP_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <trace file> [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    size_t iterations = DEFAULT_ITERATIONS;
+    if (argc > 2) {
+        iterations = (size_t)strtoull(argv[2], NULL, 10);
+    }
+
+    struct aws_allocator *allocator = aws_default_allocator();
+    aws_auth_library_init(allocator);
+
+    int exit_code = 1;
+
+    struct replay_context context;
+    AWS_ZERO_STRUCT(context);
+    context.allocator = allocator;
+
+    if (aws_array_list_init_dynamic(&context.requests, allocator, 16, sizeof(struct replay_request))) {
+        goto done;
+    }
+
+    struct aws_credentials_provider_static_options static_options = {
+        .access_key_id = aws_byte_cursor_from_string(s_access_key_id),
+        .secret_access_key = aws_byte_cursor_from_string(s_secret_access_key),
+    };
+    context.credentials_provider = aws_credentials_provider_new_static(allocator, &static_options);
+    if (context.credentials_provider == NULL) {
+        goto done;
+    }
+
+    if (aws_byte_buf_init_from_file(&context.trace, allocator, argv[1])) {
+        fprintf(stderr, "unable to read trace file %s\n", argv[1]);
+        goto done;
+    }
+
+    if (s_init_filler(&context) || s_build_requests(&context)) {
+        fprintf(stderr, "unable to load trace: %s\n", aws_error_str(aws_last_error()));
+        goto done;
+    }
+
+    if (s_replay(&context, iterations) == AWS_OP_SUCCESS) {
+        exit_code = 0;
+    }
+
+done:
+
+    for (size_t i = 0; i < aws_array_list_length(&context.requests); ++i) {
+        struct replay_request *request = NULL;
+        aws_array_list_get_at_ptr(&context.requests, (void **)&request, i);
+        s_clean_up_request(request);
+    }
+    aws_array_list_clean_up(&context.requests);
+
+    if (context.credentials_provider != NULL) {
+        aws_credentials_provider_release(context.credentials_provider);
+    }
+    aws_byte_buf_clean_up(&context.filler);
+    aws_byte_buf_clean_up(&context.trace);
+
+    aws_auth_library_clean_up();
+
+    return exit_code;
+}
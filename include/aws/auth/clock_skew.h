@@ -0,0 +1,102 @@
+#ifndef AWS_AUTH_CLOCK_SKEW_H
+#define AWS_AUTH_CLOCK_SKEW_H
+
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/auth.h>
+
+#include <aws/common/byte_buf.h>
+#include <aws/common/date_time.h>
+#include <aws/io/io.h>
+
+struct aws_clock_skew_tracker;
+
+/* Number of recent Date header observations per endpoint that the applied offset is estimated from */
+#define AWS_CLOCK_SKEW_SAMPLE_COUNT 4
+
+/*
+ * A clock skew tracker learns how far the local clock is from each endpoint's clock, based on the Date headers of
+ * the endpoint's responses, and dates signatures with the corrected time.  Hosts with a drifted clock then stop
+ * getting RequestTimeTooSkewed errors (and paying for a retry) on every request.
+ *
+ * Endpoints are arbitrary keys chosen by the caller: a host name, a service name, or anything else that shares a
+ * clock.  Keys are compared case-insensitively.
+ */
+struct aws_clock_skew_tracker_options {
+    /*
+     * Wall clock, in nanoseconds since the unix epoch.  Defaults to aws_sys_clock_get_ticks.  Useful for testing.
+     */
+    aws_io_clock_fn *clock_fn;
+
+    /*
+     * Estimated offsets smaller than this aren't applied.  Date headers only have one second resolution, and a slow
+     * response makes its Date look late, so tiny offsets are noise.  Defaults to three seconds if zero.
+     */
+    uint64_t min_skew_ms;
+};
+
+AWS_EXTERN_C_BEGIN
+
+AWS_AUTH_API
+struct aws_clock_skew_tracker *aws_clock_skew_tracker_new(
+    struct aws_allocator *allocator,
+    const struct aws_clock_skew_tracker_options *options);
+
+/**
+ * The tracker must outlive any signing call whose config references it.
+ */
+AWS_AUTH_API
+void aws_clock_skew_tracker_destroy(struct aws_clock_skew_tracker *tracker);
+
+/**
+ * Feeds back a server's time for an endpoint.  The applied offset is the largest of the endpoint's last
+ * AWS_CLOCK_SKEW_SAMPLE_COUNT observed offsets, since delays only ever make an observation fall behind, so a single
+ * slow or proxied response doesn't move it.  It is zero while that estimate is below the minimum skew.
+ */
+AWS_AUTH_API
+int aws_clock_skew_tracker_record_server_time(
+    struct aws_clock_skew_tracker *tracker,
+    struct aws_byte_cursor endpoint,
+    const struct aws_date_time *server_time);
+
+/**
+ * Feeds back the value of an http Date response header (RFC 822 format) for an endpoint.
+ */
+AWS_AUTH_API
+int aws_clock_skew_tracker_record_date_header(
+    struct aws_clock_skew_tracker *tracker,
+    struct aws_byte_cursor endpoint,
+    struct aws_byte_cursor date_header_value);
+
+/**
+ * Returns the applied offset of an endpoint's clock from the local clock, in milliseconds (positive if the
+ * endpoint is ahead), or 0 for endpoints with no observations or no significant skew.
+ */
+AWS_AUTH_API
+int64_t aws_clock_skew_tracker_get_offset_ms(struct aws_clock_skew_tracker *tracker, struct aws_byte_cursor endpoint);
+
+/**
+ * Initializes a date to the current time as the endpoint's clock would report it.
+ */
+AWS_AUTH_API
+int aws_clock_skew_tracker_now(
+    struct aws_clock_skew_tracker *tracker,
+    struct aws_byte_cursor endpoint,
+    struct aws_date_time *out_date);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_AUTH_CLOCK_SKEW_H */
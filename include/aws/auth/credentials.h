@@ -24,7 +24,9 @@
 #include <aws/io/io.h>
 
 struct aws_client_bootstrap;
+struct aws_clock_skew_tracker;
 struct aws_credentials_provider_system_vtable;
+struct aws_imds_client;
 struct aws_string;
 
 extern const uint16_t aws_sts_assume_role_default_duration_secs;
@@ -37,6 +39,13 @@ struct aws_credentials {
     struct aws_string *access_key_id;
     struct aws_string *secret_access_key;
     struct aws_string *session_token;
+
+    /*
+     * The session token, uri-encoded as it appears in query param signing.  Set by the constructors (and carried
+     * over by copies) so that it is encoded once per set of credentials rather than on every presigned request.
+     * NULL if there is no session token.
+     */
+    struct aws_string *uri_encoded_session_token;
 };
 
 struct aws_credentials_provider;
@@ -119,14 +128,76 @@ struct aws_credentials_provider_chain_options {
     size_t provider_count;
 };
 
+/*
+ * Creates the provider a lazy provider wraps.  Returns NULL (with an error raised) on failure.
+ */
+typedef struct aws_credentials_provider *(aws_credentials_provider_factory_fn)(
+    struct aws_allocator *allocator,
+    void *factory_user_data);
+
+struct aws_credentials_provider_lazy_options {
+    struct aws_credentials_provider_shutdown_options shutdown_options;
+    aws_credentials_provider_factory_fn *factory;
+
+    /* Must outlive the lazy provider */
+    void *factory_user_data;
+};
+
+/*
+ * Request hedging for providers that fetch credentials over http.  When a fetch is still outstanding after the
+ * configured percentile of recently observed fetch latencies, a duplicate fetch is started on another pooled
+ * connection.  The first successful result wins and the other fetch is cancelled.
+ */
+struct aws_credentials_provider_hedging_options {
+    /*
+     * Latency percentile (1-99) after which the duplicate fetch is started.  0 disables hedging.
+     */
+    uint32_t latency_percentile;
+
+    /*
+     * Lower bound on the hedging delay.  Until enough latencies have been observed, a conservative one second delay
+     * is used instead of the percentile.
+     */
+    uint32_t min_delay_ms;
+
+    /*
+     * Duplicate fetches allowed per 100 fetches, at most (and by default) 100, so hedging never more than doubles
+     * the load on the credentials source.
+     */
+    uint32_t max_hedges_per_100_requests;
+};
+
 struct aws_credentials_provider_imds_options {
     struct aws_credentials_provider_shutdown_options shutdown_options;
     struct aws_client_bootstrap *bootstrap;
 
-    /* For mocking the http layer in tests, leave NULL otherwise */
+    /* Optional, hedging is off by default */
+    struct aws_credentials_provider_hedging_options hedging;
+
+    /*
+     * Optional instance metadata client to query through; the provider takes its own reference.  By default, every
+     * imds provider shares one process-wide client (and so one connection pool) built from the bootstrap.
+     */
+    struct aws_imds_client *client;
+
+    /*
+     * For mocking the http layer in tests, leave NULL otherwise.  Ignored if client is set; otherwise a mocked
+     * provider gets a client of its own rather than the shared one.
+     */
     struct aws_credentials_provider_system_vtable *function_table;
 };
 
+/*
+ * An STS endpoint the AssumeRole provider may send requests to.  Requests are signed for the endpoint's region.
+ */
+struct aws_credentials_provider_sts_endpoint {
+    /* Region to sign for, e.g. "eu-west-1" */
+    struct aws_byte_cursor region;
+
+    /* Optional.  Defaults to sts.<region>.amazonaws.com (or .amazonaws.com.cn for the China regions) */
+    struct aws_byte_cursor host;
+};
+
 struct aws_credentials_provider_sts_options {
     struct aws_client_bootstrap *bootstrap;
     struct aws_tls_ctx *tls_ctx;
@@ -136,6 +207,31 @@ struct aws_credentials_provider_sts_options {
     uint16_t duration_seconds;
     struct aws_credentials_provider_shutdown_options shutdown_options;
 
+    /*
+     * Optional.  If set, STS response Date headers are fed back to this tracker and AssumeRole requests are dated
+     * with its skew-corrected clock.  Must outlive the provider.
+     */
+    struct aws_clock_skew_tracker *clock_skew_tracker;
+
+    /*
+     * Optional.  Endpoints to send AssumeRole requests to, in order of preference.  If none are given, the global
+     * endpoint (sts.amazonaws.com, signed for us-east-1) is used.
+     *
+     * When a request fails with a connection error or a 5xx response, it is retried against the next endpoint that
+     * hasn't been tried yet, and the failing endpoint is avoided for a while.  At most 32 endpoints are supported.
+     */
+    const struct aws_credentials_provider_sts_endpoint *endpoints;
+    size_t endpoint_count;
+
+    /*
+     * If true, requests go to the healthy endpoint with the lowest observed latency rather than the first healthy
+     * endpoint in the list.  Endpoints that haven't completed a request yet are tried first.
+     */
+    bool enable_latency_routing;
+
+    /* Optional, hedging is off by default.  Duplicate requests go through the same endpoint selection. */
+    struct aws_credentials_provider_hedging_options hedging;
+
     /* For mocking the http layer in tests, leave NULL otherwise */
     struct aws_credentials_provider_system_vtable *function_table;
 };
@@ -273,6 +369,17 @@ struct aws_credentials_provider *aws_credentials_provider_new_chain(
     struct aws_allocator *allocator,
     const struct aws_credentials_provider_chain_options *options);
 
+/*
+ * A provider that defers creating another provider until credentials are first requested from it.  Useful for
+ * chain members that are expensive to set up and often never reached.
+ *
+ * If creation fails, the query completes with NULL credentials and creation is retried by the next query.
+ */
+AWS_AUTH_API
+struct aws_credentials_provider *aws_credentials_provider_new_lazy(
+    struct aws_allocator *allocator,
+    const struct aws_credentials_provider_lazy_options *options);
+
 /*
  * A provider that sources credentials from the ec2 instance metadata service
  */
@@ -291,6 +398,8 @@ struct aws_credentials_provider *aws_credentials_provider_new_imds(
  * (3) (conditional, off by default) ECS
  * (4) (conditional, on by default) EC2 Instance Metadata
  *
+ * Instance metadata is only set up once a query falls through to it.  The bootstrap must outlive the provider.
+ *
  * Support for environmental control of the default provider chain is not yet
  * implemented.
  */
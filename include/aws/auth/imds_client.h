@@ -0,0 +1,176 @@
+#ifndef AWS_AUTH_IMDS_CLIENT_H
+#define AWS_AUTH_IMDS_CLIENT_H
+
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/auth.h>
+
+#include <aws/common/byte_buf.h>
+
+struct aws_client_bootstrap;
+struct aws_credentials_provider_system_vtable;
+struct aws_imds_client;
+struct aws_string;
+
+/*
+ * A client for the ec2 instance metadata service.  The client owns one connection pool, and concurrent gets of the
+ * same resource share a single http request.
+ *
+ * Instance metadata providers created with the same bootstrap share a process-wide client (see
+ * aws_imds_client_acquire_shared) unless they are given one explicitly.
+ */
+struct aws_imds_client_options {
+    struct aws_client_bootstrap *bootstrap;
+
+    /* Size of the connection pool, defaults to 2 */
+    size_t max_connections;
+
+    /* For mocking the http layer in tests, leave NULL otherwise */
+    struct aws_credentials_provider_system_vtable *function_table;
+};
+
+/*
+ * Invoked exactly once per get.  On success, error_code is AWS_ERROR_SUCCESS and resource holds the response body,
+ * which is only valid for the duration of the callback.
+ */
+typedef void(aws_imds_client_on_get_resource_fn)(const struct aws_byte_buf *resource, int error_code, void *user_data);
+
+/*
+ * Invoked once a released reference no longer keeps anything alive: right away if the client is still referenced
+ * elsewhere, otherwise once its connection pool has shut down.
+ */
+typedef void(aws_imds_client_on_released_fn)(void *user_data);
+
+/*
+ * Fields of the instance identity document (/latest/dynamic/instance-identity/document).  Owned by the client and
+ * valid for as long as the caller holds a reference to it.
+ */
+struct aws_imds_instance_identity {
+    struct aws_string *region;
+    struct aws_string *availability_zone;
+    struct aws_string *account_id;
+    struct aws_string *instance_id;
+};
+
+/*
+ * Invoked exactly once per identity query; identity is NULL on failure.
+ */
+typedef void(aws_imds_client_on_get_instance_identity_fn)(
+    const struct aws_imds_instance_identity *identity,
+    int error_code,
+    void *user_data);
+
+/*
+ * Invoked exactly once per identity field query.  On failure, value is empty.  On success, value points into the
+ * client's cached identity, so it can be used as, e.g., the signing config region while the client is referenced.
+ */
+typedef void(aws_imds_client_on_get_identity_field_fn)(struct aws_byte_cursor value, int error_code, void *user_data);
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Creates a client with its own connection pool.  The caller holds the only reference.
+ */
+AWS_AUTH_API
+struct aws_imds_client *aws_imds_client_new(
+    struct aws_allocator *allocator,
+    const struct aws_imds_client_options *options);
+
+/**
+ * Returns a new reference to the process-wide client for these options, creating it if there currently is none.
+ * Shared clients are keyed by bootstrap, pool size and function table, so callers only ever share a client (and its
+ * connection pool) with callers that passed the same bootstrap.  The bootstrap must outlive every reference.
+ */
+AWS_AUTH_API
+struct aws_imds_client *aws_imds_client_acquire_shared(
+    struct aws_allocator *allocator,
+    const struct aws_imds_client_options *options);
+
+AWS_AUTH_API
+void aws_imds_client_acquire(struct aws_imds_client *client);
+
+/**
+ * Releases a reference.  on_released is optional.
+ */
+AWS_AUTH_API
+void aws_imds_client_release(
+    struct aws_imds_client *client,
+    aws_imds_client_on_released_fn *on_released,
+    void *user_data);
+
+/**
+ * Gets a metadata resource by path, e.g. "/latest/meta-data/iam/security-credentials/".  Joins an outstanding get
+ * of the same path if there is one.
+ */
+AWS_AUTH_API
+int aws_imds_client_get_resource(
+    struct aws_imds_client *client,
+    struct aws_byte_cursor resource_path,
+    aws_imds_client_on_get_resource_fn *callback,
+    void *user_data);
+
+/**
+ * Like aws_imds_client_get_resource, but always sends a request of its own.  For hedged duplicates of a get that
+ * may be stalled.
+ */
+AWS_AUTH_API
+int aws_imds_client_get_resource_uncoalesced(
+    struct aws_imds_client *client,
+    struct aws_byte_cursor resource_path,
+    aws_imds_client_on_get_resource_fn *callback,
+    void *user_data);
+
+/**
+ * Gets the instance identity.  The document is fetched once per client and cached; later queries (and with the
+ * shared client, queries from anywhere in the process) complete immediately, on the calling thread.  A failed fetch
+ * is not cached.
+ */
+AWS_AUTH_API
+int aws_imds_client_get_instance_identity(
+    struct aws_imds_client *client,
+    aws_imds_client_on_get_instance_identity_fn *callback,
+    void *user_data);
+
+/**
+ * Single field getters over the cached instance identity, see aws_imds_client_get_instance_identity.
+ */
+AWS_AUTH_API
+int aws_imds_client_get_region(
+    struct aws_imds_client *client,
+    aws_imds_client_on_get_identity_field_fn *callback,
+    void *user_data);
+
+AWS_AUTH_API
+int aws_imds_client_get_availability_zone(
+    struct aws_imds_client *client,
+    aws_imds_client_on_get_identity_field_fn *callback,
+    void *user_data);
+
+AWS_AUTH_API
+int aws_imds_client_get_account_id(
+    struct aws_imds_client *client,
+    aws_imds_client_on_get_identity_field_fn *callback,
+    void *user_data);
+
+AWS_AUTH_API
+int aws_imds_client_get_instance_id(
+    struct aws_imds_client *client,
+    aws_imds_client_on_get_identity_field_fn *callback,
+    void *user_data);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_AUTH_IMDS_CLIENT_H */
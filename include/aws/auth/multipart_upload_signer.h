@@ -0,0 +1,127 @@
+#ifndef AWS_AUTH_MULTIPART_UPLOAD_SIGNER_H
+#define AWS_AUTH_MULTIPART_UPLOAD_SIGNER_H
+
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/auth.h>
+
+#include <aws/common/byte_buf.h>
+#include <aws/io/io.h>
+
+struct aws_credentials;
+struct aws_input_stream;
+struct aws_multipart_upload_signer;
+struct aws_signing_result;
+
+/* S3 part numbers run from 1 to 10000 */
+#define AWS_MULTIPART_UPLOAD_MAX_PART_NUMBER 10000
+
+/*
+ * Invoked on a hashing thread once a part has been signed.  On success, result holds the headers to add to the
+ * UploadPart request (x-amz-content-sha256, X-Amz-Date, Authorization and, with session credentials,
+ * X-Amz-Security-Token); it is only valid for the duration of the callback.  On failure, result is NULL and
+ * error_code is set.
+ */
+typedef void(aws_multipart_upload_part_signed_fn)(
+    uint32_t part_number,
+    struct aws_signing_result *result,
+    int error_code,
+    void *user_data);
+
+struct aws_multipart_upload_signer_options {
+    /*
+     * Credentials to sign every part with.  Copied.
+     */
+    const struct aws_credentials *credentials;
+
+    /*
+     * Region and service to sign for.  The service defaults to "s3" if empty.
+     */
+    struct aws_byte_cursor region;
+    struct aws_byte_cursor service;
+
+    /*
+     * Host header value of the UploadPart requests (the bucket's endpoint)
+     */
+    struct aws_byte_cursor host;
+
+    /*
+     * Request path of the object, uri-encoded exactly as it will be sent.  S3 paths are neither normalized nor
+     * double-encoded before signing, so neither is this.
+     */
+    struct aws_byte_cursor path;
+
+    /*
+     * Upload id returned by CreateMultipartUpload, not uri-encoded
+     */
+    struct aws_byte_cursor upload_id;
+
+    /*
+     * Number of threads that hash part payloads.  Defaults to the processor count if zero.
+     */
+    size_t thread_count;
+
+    /*
+     * Wall clock (nanoseconds since the unix epoch) used for the signing date of each part.
+     * For testing; leave NULL to use the system clock.
+     */
+    aws_io_clock_fn *clock_fn;
+};
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Creates a signer bound to one multipart upload.  Everything about an UploadPart request except its part number,
+ * date and payload hash is fixed for the whole upload, so the canonical request, scope and authorization value are
+ * built once here as templates and each part only fills in what changes.  The signing key is derived once per day.
+ */
+AWS_AUTH_API
+struct aws_multipart_upload_signer *aws_multipart_upload_signer_new(
+    struct aws_allocator *allocator,
+    const struct aws_multipart_upload_signer_options *options);
+
+/**
+ * Waits for every submitted part to be signed (and its callback to return), then destroys the signer.
+ */
+AWS_AUTH_API
+void aws_multipart_upload_signer_destroy(struct aws_multipart_upload_signer *signer);
+
+/**
+ * Queues a part for signing.  Its body is hashed on one of the signer's threads, and callback is invoked there with
+ * the signed headers.  The body is read from the beginning and rewound afterwards; it must stay valid, and must not
+ * be read by anyone else, until the callback has been invoked.  A NULL body is an empty part.
+ */
+AWS_AUTH_API
+int aws_multipart_upload_signer_sign_part(
+    struct aws_multipart_upload_signer *signer,
+    uint32_t part_number,
+    struct aws_input_stream *body,
+    aws_multipart_upload_part_signed_fn *callback,
+    void *user_data);
+
+/**
+ * Appends the request path (and query string) of a part's UploadPart request, matching what the signature covers:
+ * <path>?partNumber=<part number>&uploadId=<uri-encoded upload id>
+ */
+AWS_AUTH_API
+int aws_multipart_upload_signer_append_part_path(
+    const struct aws_multipart_upload_signer *signer,
+    uint32_t part_number,
+    struct aws_byte_buf *dest);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_AUTH_MULTIPART_UPLOAD_SIGNER_H */
@@ -0,0 +1,125 @@
+#ifndef AWS_AUTH_PRESIGNED_URL_CACHE_H
+#define AWS_AUTH_PRESIGNED_URL_CACHE_H
+
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/auth.h>
+
+#include <aws/common/byte_buf.h>
+#include <aws/io/io.h>
+
+struct aws_credentials_provider;
+struct aws_presigned_url_cache;
+struct aws_signing_key_cache;
+
+/*
+ * Invoked with the presigned path (path + query string, including all X-Amz-* auth params); callers prepend the
+ * scheme and host to form the url.  The cursor is only valid for the duration of the callback.  On failure,
+ * presigned_path is NULL and error_code is set.
+ */
+typedef void(aws_presigned_url_complete_fn)(
+    const struct aws_byte_cursor *presigned_path,
+    int error_code,
+    void *user_data);
+
+struct aws_presigned_url_cache_options {
+    /*
+     * Credentials used to presign.  The access key id of the credentials a lookup is served with is part of the
+     * cache key, so rotated credentials never get a url signed with their predecessors.  Once a lookup is served
+     * with a new access key id, every url cached under the old one is dropped.
+     */
+    struct aws_credentials_provider *credentials_provider;
+
+    /*
+     * Value of X-Amz-Expires.  Defaults to one hour if zero.
+     */
+    uint64_t expiration_in_seconds;
+
+    /*
+     * A cached url is only handed out if it stays valid for at least this long; otherwise the lookup re-signs.
+     * Defaults to five minutes if zero.  Clamped to half the expiration window.
+     */
+    uint64_t min_remaining_validity_in_seconds;
+
+    /*
+     * Maximum number of cached urls.  The least recently used one is evicted to make room for a new one.
+     * Defaults to 1024 if zero.
+     */
+    size_t max_entries;
+
+    /*
+     * Optional.  If set, re-signs take their signing keys from this cache.  It must outlive the url cache.
+     */
+    struct aws_signing_key_cache *signing_key_cache;
+
+    /*
+     * Wall clock (nanoseconds since the unix epoch) used for both the signing date and the validity checks.
+     * For testing; leave NULL to use the system clock.
+     */
+    aws_io_clock_fn *clock_fn;
+};
+
+/*
+ * What to presign.  Together with the credentials' access key id, these fields are the cache key; the path and
+ * query are compared as given, so callers should build them the same way each time.
+ */
+struct aws_presigned_url_cache_request {
+    struct aws_byte_cursor method;
+    struct aws_byte_cursor host;
+    struct aws_byte_cursor path;
+    struct aws_byte_cursor region;
+    struct aws_byte_cursor service;
+};
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Creates a bounded cache of sigv4 query param presigned urls.  Repeated presigns of the same request are served
+ * from the cache while the cached url has enough validity left, skipping the signing pass and the rebuild of the
+ * request path.
+ */
+AWS_AUTH_API
+struct aws_presigned_url_cache *aws_presigned_url_cache_new(
+    struct aws_allocator *allocator,
+    const struct aws_presigned_url_cache_options *options);
+
+/**
+ * Add a reference to a presigned url cache
+ */
+AWS_AUTH_API
+void aws_presigned_url_cache_acquire(struct aws_presigned_url_cache *url_cache);
+
+/**
+ * Release a reference to a presigned url cache.  In-progress lookups keep the cache alive until they complete.
+ */
+AWS_AUTH_API
+void aws_presigned_url_cache_release(struct aws_presigned_url_cache *url_cache);
+
+/**
+ * Retrieves a presigned path for a request.  Once credentials have been sourced, the callback is invoked with the
+ * cached path if it is still valid for long enough, or else with a freshly signed one that replaces it.
+ * Concurrent misses on the same request each sign; the last one to finish is the one that stays cached.
+ */
+AWS_AUTH_API
+int aws_presigned_url_cache_get(
+    struct aws_presigned_url_cache *url_cache,
+    const struct aws_presigned_url_cache_request *request,
+    aws_presigned_url_complete_fn *callback,
+    void *user_data);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_AUTH_PRESIGNED_URL_CACHE_H */
@@ -0,0 +1,77 @@
+#ifndef AWS_AUTH_PROBES_H
+#define AWS_AUTH_PROBES_H
+
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/auth.h>
+
+/*
+ * USDT (statically defined tracing) probes, for bpftrace, perf, systemtap and friends.  Compiled in only when the
+ * library is configured with AWS_AUTH_ENABLE_USDT_PROBES on a platform with <sys/sdt.h>; otherwise every probe
+ * expands to nothing and its arguments are never evaluated.  A compiled-in probe is a single nop until a tracer
+ * attaches to it.
+ *
+ * All probes live under the "aws_auth" provider:
+ *
+ *   sign__start(signable, algorithm)
+ *   sign__credentials(signable, has_credentials)
+ *   sign__canonical__request(signable, canonical request length, payload bytes hashed)
+ *   sign__string__to__sign(signable, string to sign length)
+ *   sign__done(signable, error code)
+ *
+ *   provider__fetch__start(provider, query, kind)
+ *   provider__fetch__done(provider, query, kind, error code)
+ *
+ * signable, provider and query are addresses that identify one signing call, provider and fetch respectively;
+ * kind is a string ("cached", "chain", "imds", "sts", "profile").  Example:
+ *
+ *   bpftrace -e 'usdt:libaws-c-auth.so:aws_auth:provider__fetch__start { @start[arg1] = nsecs; }
+ *                usdt:libaws-c-auth.so:aws_auth:provider__fetch__done /@start[arg1]/ {
+ *                    @ms[str(arg2)] = hist((nsecs - @start[arg1]) / 1000000); delete(@start[arg1]); }'
+ */
+
+#if defined(AWS_AUTH_USE_USDT_PROBES)
+
+#    include <sys/sdt.h>
+
+#    define AWS_AUTH_PROBE2(name, arg1, arg2) DTRACE_PROBE2(aws_auth, name, arg1, arg2)
+#    define AWS_AUTH_PROBE3(name, arg1, arg2, arg3) DTRACE_PROBE3(aws_auth, name, arg1, arg2, arg3)
+#    define AWS_AUTH_PROBE4(name, arg1, arg2, arg3, arg4) DTRACE_PROBE4(aws_auth, name, arg1, arg2, arg3, arg4)
+
+#else
+
+#    define AWS_AUTH_PROBE2(name, arg1, arg2)
+#    define AWS_AUTH_PROBE3(name, arg1, arg2, arg3)
+#    define AWS_AUTH_PROBE4(name, arg1, arg2, arg3, arg4)
+
+#endif /* AWS_AUTH_USE_USDT_PROBES */
+
+#define AWS_AUTH_PROBE_FETCH_START(provider, query, kind)                                                             \
+    AWS_AUTH_PROBE3(provider__fetch__start, (void *)(provider), (void *)(query), (const char *)(kind))
+
+/*
+ * A fetch that sourced no credentials reports the last error raised on the completing thread, which is normally the
+ * failure that ended it.
+ */
+#define AWS_AUTH_PROBE_FETCH_DONE(provider, query, kind, credentials)                                                 \
+    AWS_AUTH_PROBE4(                                                                                                   \
+        provider__fetch__done,                                                                                         \
+        (void *)(provider),                                                                                            \
+        (void *)(query),                                                                                               \
+        (const char *)(kind),                                                                                          \
+        (credentials) != NULL ? AWS_ERROR_SUCCESS : aws_last_error())
+
+#endif /* AWS_AUTH_PROBES_H */
@@ -22,6 +22,7 @@
 #include <aws/common/byte_buf.h>
 #include <aws/common/hash_table.h>
 
+struct aws_date_time;
 struct aws_signable;
 struct aws_signing_config_aws;
 struct aws_signing_result;
@@ -59,9 +60,15 @@ struct aws_signing_state_aws {
     struct aws_byte_buf signed_headers;
     struct aws_byte_buf canonical_header_block;
     struct aws_byte_buf payload_hash;
+    struct aws_byte_buf tree_hash;
+    struct aws_byte_buf content_md5;
+    struct aws_byte_buf checksum_crc32c;
     struct aws_byte_buf credential_scope;
     struct aws_byte_buf access_credential_scope;
     struct aws_byte_buf date;
+
+    /* how much of the payload was hashed while building the canonical request */
+    uint64_t payload_bytes_hashed;
 };
 
 AWS_EXTERN_C_BEGIN
@@ -97,11 +104,39 @@ int aws_signing_build_string_to_sign(struct aws_signing_state_aws *state);
 AWS_AUTH_API
 int aws_signing_build_authorization_value(struct aws_signing_state_aws *state);
 
+/**
+ * Derives the sigv4 signing key for a credential scope (date, region, service) from a secret access key and
+ * writes the raw (binary) key into an empty dest buffer.
+ */
+AWS_AUTH_API
+int aws_signing_derive_sigv4_signing_key(
+    struct aws_allocator *allocator,
+    const struct aws_string *secret_access_key,
+    const struct aws_date_time *date,
+    const struct aws_byte_cursor *region,
+    const struct aws_byte_cursor *service,
+    struct aws_byte_buf *dest);
+
+/**
+ * Appends the sigv4 credential scope, <short date>/<region>/<service>/aws4_request, to dest.  Shared by every
+ * signer in the library so that the scope is only spelled out in one place.
+ */
+AWS_AUTH_API
+int aws_signing_append_sigv4_credential_scope(
+    const struct aws_date_time *date,
+    const struct aws_byte_cursor *region,
+    const struct aws_byte_cursor *service,
+    struct aws_byte_buf *dest);
+
 /*
  * Named constants particular to the sigv4 signing algorithm.  Can be moved to a public header
  * as needed.
  */
+AWS_AUTH_API extern const struct aws_string *g_aws_signing_sigv4_algorithm;
 AWS_AUTH_API extern const struct aws_string *g_aws_signing_content_header_name;
+AWS_AUTH_API extern const struct aws_string *g_aws_signing_tree_hash_header_name;
+AWS_AUTH_API extern const struct aws_string *g_aws_signing_content_md5_header_name;
+AWS_AUTH_API extern const struct aws_string *g_aws_signing_checksum_crc32c_header_name;
 AWS_AUTH_API extern const struct aws_string *g_aws_signing_algorithm_query_param_name;
 AWS_AUTH_API extern const struct aws_string *g_aws_signing_credential_query_param_name;
 AWS_AUTH_API extern const struct aws_string *g_aws_signing_date_name;
@@ -109,6 +144,7 @@ AWS_AUTH_API extern const struct aws_string *g_aws_signing_signed_headers_query_
 AWS_AUTH_API extern const struct aws_string *g_aws_signing_authorization_header_name;
 AWS_AUTH_API extern const struct aws_string *g_aws_signing_authorization_query_param_name;
 AWS_AUTH_API extern const struct aws_string *g_aws_signing_security_token_name;
+AWS_AUTH_API extern const struct aws_string *g_aws_signing_expires_query_param_name;
 
 /**
  * Initializes the internal table of headers that should not be signed
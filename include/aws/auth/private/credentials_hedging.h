@@ -0,0 +1,144 @@
+#ifndef AWS_AUTH_CREDENTIALS_HEDGING_H
+#define AWS_AUTH_CREDENTIALS_HEDGING_H
+
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/auth.h>
+
+#include <aws/auth/credentials.h>
+#include <aws/common/mutex.h>
+
+struct aws_credentials_hedged_attempt;
+struct aws_credentials_provider_system_vtable;
+struct aws_event_loop_group;
+struct aws_http_connection;
+
+/* Number of recent fetch latencies the hedging delay percentile is computed from */
+#define AWS_CREDENTIALS_HEDGING_SAMPLE_COUNT 32
+
+/*
+ * Starts one fetch for a hedged request.  The fetch must eventually call aws_credentials_hedged_attempt_complete
+ * exactly once, even if it fails before doing any work.
+ */
+typedef void(aws_credentials_hedged_attempt_start_fn)(
+    struct aws_credentials_provider *provider,
+    struct aws_credentials_hedged_attempt *attempt);
+
+/*
+ * Per-provider hedging state: the configuration, recent fetch latencies and the hedge budget.  Embedded in the
+ * provider's impl.
+ */
+struct aws_credentials_hedging {
+    struct aws_allocator *allocator;
+    struct aws_event_loop_group *event_loop_group;
+    struct aws_credentials_provider_system_vtable *function_table;
+    aws_credentials_hedged_attempt_start_fn *start_attempt;
+
+    uint32_t latency_percentile;
+    uint64_t min_delay_ns;
+    uint32_t max_hedges_per_100_requests;
+
+    struct aws_mutex lock;
+
+    /* protected by lock */
+    uint64_t latency_samples_ns[AWS_CREDENTIALS_HEDGING_SAMPLE_COUNT];
+    size_t latency_sample_count;
+    size_t next_latency_sample;
+
+    /* in hundredths of a hedge; earned by every request and spent by every hedge, protected by lock */
+    uint32_t budget;
+};
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Initializes hedging state.  Hedging stays disabled (and nothing needs cleaning up) if the options don't enable it.
+ * function_table is only used to close losing connections, and may be NULL if no attempt ever registers one.
+ */
+AWS_AUTH_API
+int aws_credentials_hedging_init(
+    struct aws_credentials_hedging *hedging,
+    struct aws_allocator *allocator,
+    const struct aws_credentials_provider_hedging_options *options,
+    struct aws_event_loop_group *event_loop_group,
+    struct aws_credentials_provider_system_vtable *function_table,
+    aws_credentials_hedged_attempt_start_fn *start_attempt);
+
+AWS_AUTH_API
+void aws_credentials_hedging_clean_up(struct aws_credentials_hedging *hedging);
+
+AWS_AUTH_API
+bool aws_credentials_hedging_is_enabled(const struct aws_credentials_hedging *hedging);
+
+/**
+ * How long a fetch may be outstanding before it's hedged.
+ */
+AWS_AUTH_API
+uint64_t aws_credentials_hedging_get_delay_ns(struct aws_credentials_hedging *hedging);
+
+AWS_AUTH_API
+void aws_credentials_hedging_record_latency(struct aws_credentials_hedging *hedging, uint64_t latency_ns);
+
+/**
+ * Credits the budget for one request.
+ */
+AWS_AUTH_API
+void aws_credentials_hedging_on_request(struct aws_credentials_hedging *hedging);
+
+/**
+ * Spends the budget for one hedge.  Returns false if the budget is exhausted.
+ */
+AWS_AUTH_API
+bool aws_credentials_hedging_try_acquire_hedge(struct aws_credentials_hedging *hedging);
+
+/**
+ * Fetches credentials with hedging.  The callback is invoked exactly once, with the first successful result or with
+ * NULL once every fetch has failed.
+ */
+AWS_AUTH_API
+int aws_credentials_hedged_request_start(
+    struct aws_credentials_hedging *hedging,
+    struct aws_credentials_provider *provider,
+    aws_on_get_credentials_callback_fn callback,
+    void *user_data);
+
+/**
+ * Registers the connection a fetch is using, so that it can be closed if another fetch wins (pass NULL before
+ * handing the connection back to its pool).  Returns false if the request has already completed, in which case the
+ * fetch should give up.
+ */
+AWS_AUTH_API
+bool aws_credentials_hedged_attempt_set_connection(
+    struct aws_credentials_hedged_attempt *attempt,
+    struct aws_http_connection *connection);
+
+/**
+ * True once another fetch of the same request has won (or every fetch has failed).
+ */
+AWS_AUTH_API
+bool aws_credentials_hedged_attempt_is_cancelled(struct aws_credentials_hedged_attempt *attempt);
+
+/**
+ * Reports the result of a fetch.  The credentials are not retained.  The attempt must not be used afterwards.
+ */
+AWS_AUTH_API
+void aws_credentials_hedged_attempt_complete(
+    struct aws_credentials_hedged_attempt *attempt,
+    struct aws_credentials *credentials);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_AUTH_CREDENTIALS_HEDGING_H */
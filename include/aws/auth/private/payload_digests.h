@@ -0,0 +1,70 @@
+#ifndef AWS_AUTH_PAYLOAD_DIGESTS_H
+#define AWS_AUTH_PAYLOAD_DIGESTS_H
+
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/auth.h>
+
+#include <aws/common/byte_buf.h>
+
+struct aws_hash;
+
+/*
+ * The set of digests computed over a payload in one pass: always SHA-256, plus whichever of the
+ * aws_signing_payload_digest flags were requested.
+ */
+struct aws_payload_digests {
+    struct aws_hash *sha256;
+
+    /* NULL unless AWS_SIGNING_PAYLOAD_DIGEST_MD5 was requested */
+    struct aws_hash *md5;
+
+    bool has_crc32c;
+    uint32_t crc32c;
+
+    /* total payload bytes fed to the set */
+    uint64_t bytes_hashed;
+};
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Initializes a digest set.  extra_digests is a bitwise-or of aws_signing_payload_digest values.
+ */
+AWS_AUTH_API
+int aws_payload_digests_init(
+    struct aws_payload_digests *digests,
+    struct aws_allocator *allocator,
+    uint32_t extra_digests);
+
+AWS_AUTH_API
+void aws_payload_digests_clean_up(struct aws_payload_digests *digests);
+
+/**
+ * Feeds the next range of the payload to every digest in the set.
+ */
+AWS_AUTH_API
+int aws_payload_digests_update(struct aws_payload_digests *digests, const struct aws_byte_cursor *data);
+
+/**
+ * Continues a CRC32C (Castagnoli) checksum; pass 0 as previous_crc32c to start a new one.
+ */
+AWS_AUTH_API
+uint32_t aws_crc32c_compute(const struct aws_byte_cursor *data, uint32_t previous_crc32c);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_AUTH_PAYLOAD_DIGESTS_H */
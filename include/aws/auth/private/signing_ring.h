@@ -0,0 +1,57 @@
+#ifndef AWS_AUTH_SIGNING_RING_H
+#define AWS_AUTH_SIGNING_RING_H
+
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/auth.h>
+
+#include <aws/common/byte_buf.h>
+
+/*
+ * Per-thread rings of recently signed requests (see aws_signing_visit_recent_requests).  Recording never takes a
+ * lock: each thread writes only to its own ring, and readers detect torn slots with a per-slot sequence number.
+ */
+
+/* Slots per thread */
+#define AWS_SIGNING_RING_SLOT_COUNT 8
+
+/* Most rings that exist at once; threads that sign while every ring is claimed by a live thread don't record */
+#define AWS_SIGNING_RING_MAX_COUNT 64
+
+/* Bytes of string-to-sign plus canonical request retained per slot; longer canonical requests are truncated */
+#define AWS_SIGNING_RING_SLOT_DATA_SIZE 4096
+
+AWS_EXTERN_C_BEGIN
+
+AWS_AUTH_API
+void aws_signing_ring_init(struct aws_allocator *allocator);
+
+AWS_AUTH_API
+void aws_signing_ring_clean_up(void);
+
+/**
+ * Copies a successfully computed signature and its inputs into the calling thread's ring, overwriting the oldest
+ * entry.  Best effort: does nothing if the thread can't get a ring.
+ */
+AWS_AUTH_API
+void aws_signing_ring_record(
+    const struct aws_byte_cursor *canonical_request,
+    const struct aws_byte_cursor *string_to_sign,
+    const struct aws_byte_cursor *signature);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_AUTH_SIGNING_RING_H */
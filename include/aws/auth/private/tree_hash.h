@@ -0,0 +1,77 @@
+#ifndef AWS_AUTH_TREE_HASH_H
+#define AWS_AUTH_TREE_HASH_H
+
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/auth.h>
+
+#include <aws/common/byte_buf.h>
+
+struct aws_input_stream;
+
+/*
+ * SHA-256 tree hashes (as used by Glacier): the payload is split into 1 MiB chunks, each chunk is hashed, and then
+ * adjacent digests are hashed together pairwise, level by level, until one digest remains.  An odd digest at the end
+ * of a level is carried up unchanged.
+ */
+#define AWS_TREE_HASH_CHUNK_SIZE (1024 * 1024)
+
+/* Upper bound on the process-wide hashing pool, which is otherwise sized to the processor count */
+#define AWS_TREE_HASH_MAX_POOL_THREAD_COUNT 64
+
+/* Payloads of fewer chunks than this are hashed on the calling thread */
+#define AWS_TREE_HASH_PARALLEL_MIN_CHUNK_COUNT 8
+
+/* Invoked on the reading thread with each chunk of the payload, in order */
+typedef int(aws_tree_hash_on_chunk_fn)(const struct aws_byte_cursor *chunk, void *user_data);
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Sets up the hashing pool.  Its threads are started as computations need them and kept for reuse.
+ */
+AWS_AUTH_API
+void aws_tree_hash_pool_init(struct aws_allocator *allocator);
+
+/**
+ * Joins the hashing pool's threads.  No computation may be running.
+ */
+AWS_AUTH_API
+void aws_tree_hash_pool_clean_up(void);
+
+/**
+ * Computes the tree hash of a stream, read once from its current position to the end, and appends the raw digest
+ * to output.
+ *
+ * If on_chunk is non-NULL, it sees the whole payload in order, so that other digests of the payload (the ordinary
+ * payload hash, for one) come out of the same read pass.  Chunk digests are computed on up to thread_count threads
+ * of the hashing pool (the processor count if 0).  Pool threads are only used once the payload reaches
+ * AWS_TREE_HASH_PARALLEL_MIN_CHUNK_COUNT chunks, and only as many as other computations have left idle, since the
+ * pool is the process-wide budget; otherwise chunks are hashed on the calling thread, as they are before the pool is
+ * initialized.  A NULL stream is an empty payload.
+ */
+AWS_AUTH_API
+int aws_sha256_tree_hash_compute(
+    struct aws_allocator *allocator,
+    struct aws_input_stream *stream,
+    size_t thread_count,
+    aws_tree_hash_on_chunk_fn *on_chunk,
+    void *on_chunk_user_data,
+    struct aws_byte_buf *output);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_AUTH_TREE_HASH_H */
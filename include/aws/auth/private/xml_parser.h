@@ -56,12 +56,14 @@ struct aws_xml_parser {
     /* splits on attributes and node name, so (10 attributes + 1 name) */
     struct aws_byte_cursor split_scratch[11];
     size_t max_depth;
+    /* bytes read while skipping nodes the callbacks left unprocessed, a measure of parse work for tests */
+    size_t skipped_len;
     int error;
     bool stop_parsing;
 };
 
 /**
- * Initialize the parser with xml document: doc.
+ * Initialize the parser with xml document: doc.  max_depth bounds how deeply nodes can be traversed (20 if 0).
  */
 AWS_AUTH_API
 int aws_xml_parser_init(
@@ -92,6 +94,10 @@ int aws_xml_node_as_body(struct aws_xml_parser *parser, struct aws_xml_node *nod
 
 /**
  * Traverse node and invoke on_node_encountered when a nested node is encountered.
+ *
+ * Callbacks descend by calling this again, so traversal recurses once per nesting level.  The recursion is bounded by
+ * the parser's max_depth: traversing deeper fails with AWS_ERROR_MALFORMED_INPUT_STRING.  Skipping a node that the
+ * callback leaves unprocessed does not recurse, however deeply it nests.
  */
 AWS_AUTH_API
 int aws_xml_node_traverse(
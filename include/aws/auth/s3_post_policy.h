@@ -0,0 +1,153 @@
+#ifndef AWS_AUTH_S3_POST_POLICY_H
+#define AWS_AUTH_S3_POST_POLICY_H
+
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/auth.h>
+
+#include <aws/common/byte_buf.h>
+#include <aws/common/date_time.h>
+
+struct aws_credentials;
+
+/*
+ * Everything needed to sign a browser-based S3 POST upload policy with sigv4.
+ */
+struct aws_s3_post_policy_signing_options {
+    /*
+     * Credentials to sign with.  If a session token is present, it is returned as the x-amz-security-token field.
+     */
+    const struct aws_credentials *credentials;
+
+    /*
+     * The region of the target bucket
+     */
+    struct aws_byte_cursor region;
+
+    /*
+     * Service to sign for.  Defaults to "s3" if empty.
+     */
+    struct aws_byte_cursor service;
+
+    /*
+     * Signing date.  Becomes the x-amz-date field and the date component of the credential scope.
+     */
+    struct aws_date_time date;
+};
+
+/*
+ * A builder for the most common POST policy conditions.  Empty cursors are left out of the generated policy.
+ * The x-amz-algorithm, x-amz-credential, x-amz-date (and x-amz-security-token) conditions are always added,
+ * since they are only known at signing time.
+ */
+struct aws_s3_post_policy_conditions {
+    /*
+     * When the policy stops being accepted.  Required.
+     */
+    struct aws_date_time expiration;
+
+    /* {"bucket": <bucket>} */
+    struct aws_byte_cursor bucket;
+
+    /* {"key": <key>} */
+    struct aws_byte_cursor key;
+
+    /* ["starts-with", "$key", <key_prefix>] */
+    struct aws_byte_cursor key_prefix;
+
+    /* {"acl": <acl>} */
+    struct aws_byte_cursor acl;
+
+    /* ["starts-with", "$Content-Type", <content_type_prefix>] */
+    struct aws_byte_cursor content_type_prefix;
+
+    /* {"success_action_status": <success_action_status>} */
+    struct aws_byte_cursor success_action_status;
+
+    /* ["content-length-range", <min>, <max>], only if has_content_length_range is set */
+    bool has_content_length_range;
+    uint64_t content_length_min;
+    uint64_t content_length_max;
+};
+
+/*
+ * The form fields a browser must post along with the file.  All cursors point into the caller's output buffer
+ * and are only valid as long as that buffer is neither modified nor cleaned up.
+ */
+struct aws_s3_post_policy_form_fields {
+    /* "policy": base64-encoded policy document */
+    struct aws_byte_cursor policy;
+
+    /* "x-amz-algorithm" */
+    struct aws_byte_cursor algorithm;
+
+    /* "x-amz-credential" */
+    struct aws_byte_cursor credential;
+
+    /* "x-amz-date" */
+    struct aws_byte_cursor date;
+
+    /* "x-amz-signature" */
+    struct aws_byte_cursor signature;
+
+    /* "x-amz-security-token"; empty if the credentials have no session token */
+    struct aws_byte_cursor security_token;
+};
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Signs a caller-supplied POST policy document (raw JSON, not yet base64-encoded).  The document must already
+ * contain any conditions the caller wants enforced, including the x-amz-* signing conditions.
+ *
+ * Field values are appended to output, which must be initialized (it is grown as needed).
+ */
+AWS_AUTH_API
+int aws_s3_post_policy_sign(
+    struct aws_allocator *allocator,
+    const struct aws_s3_post_policy_signing_options *options,
+    const struct aws_byte_cursor *policy_document,
+    struct aws_byte_buf *output,
+    struct aws_s3_post_policy_form_fields *out_fields);
+
+/**
+ * Builds a policy document from a set of common conditions and signs it.  See aws_s3_post_policy_sign.
+ */
+AWS_AUTH_API
+int aws_s3_post_policy_sign_conditions(
+    struct aws_allocator *allocator,
+    const struct aws_s3_post_policy_signing_options *options,
+    const struct aws_s3_post_policy_conditions *conditions,
+    struct aws_byte_buf *output,
+    struct aws_s3_post_policy_form_fields *out_fields);
+
+/**
+ * Bulk variant of aws_s3_post_policy_sign_conditions.  Generates one set of form fields per entry in
+ * conditions_array, all sharing the same signing options.  The signing key and credential scope are derived once
+ * for the whole batch.  out_fields_array must have room for condition_count entries.
+ */
+AWS_AUTH_API
+int aws_s3_post_policy_sign_conditions_bulk(
+    struct aws_allocator *allocator,
+    const struct aws_s3_post_policy_signing_options *options,
+    const struct aws_s3_post_policy_conditions *conditions_array,
+    size_t condition_count,
+    struct aws_byte_buf *output,
+    struct aws_s3_post_policy_form_fields *out_fields_array);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_AUTH_S3_POST_POLICY_H */
@@ -0,0 +1,147 @@
+#ifndef AWS_AUTH_S3_SESSION_CACHE_H
+#define AWS_AUTH_S3_SESSION_CACHE_H
+
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/auth.h>
+
+#include <aws/auth/credentials.h>
+#include <aws/common/byte_buf.h>
+#include <aws/io/io.h>
+
+struct aws_client_bootstrap;
+struct aws_credentials_provider_system_vtable;
+struct aws_s3_session_cache;
+struct aws_tls_ctx;
+
+struct aws_s3_session_cache_options {
+    /*
+     * Connection bootstrap to use for the CreateSession calls
+     */
+    struct aws_client_bootstrap *bootstrap;
+
+    /*
+     * (Optional) tls context to use for the CreateSession calls.  A default client context is created if NULL.
+     */
+    struct aws_tls_ctx *tls_ctx;
+
+    /*
+     * Credentials used to sign the CreateSession calls
+     */
+    struct aws_credentials_provider *creds_provider;
+
+    /*
+     * Region the buckets live in
+     */
+    struct aws_byte_cursor region;
+
+    /*
+     * (Optional) host suffix of the bucket endpoints; CreateSession for bucket "b" is sent to "b.<suffix>".
+     * If empty, the suffix is derived from the bucket name, which must then be of the form
+     * "<name>--<zone id>--x-s3": "s3express-<zone id>.<region>.amazonaws.com".
+     */
+    struct aws_byte_cursor endpoint_host_suffix;
+
+    /*
+     * Maximum number of buckets with cached sessions.  The least recently used bucket is evicted to make room
+     * for a new one.  Defaults to 64 if zero.
+     */
+    size_t max_sessions;
+
+    /*
+     * How long before a session expires the cache starts creating its replacement in the background, while
+     * continuing to hand out the still-valid session.  Defaults to one minute if zero.  Clamped to half of each
+     * session's lifetime.
+     */
+    uint64_t refresh_ahead_in_seconds;
+
+    /*
+     * Wall clock (nanoseconds since the unix epoch) that session expirations are compared against.
+     * For testing; leave NULL to use the system clock.
+     */
+    aws_io_clock_fn *clock_fn;
+
+    /* For mocking the http layer in tests, leave NULL otherwise */
+    struct aws_credentials_provider_system_vtable *function_table;
+};
+
+struct aws_credentials_provider_s3_session_options {
+    struct aws_credentials_provider_shutdown_options shutdown_options;
+
+    /*
+     * Cache to fetch sessions from.  The provider holds a reference to it.
+     */
+    struct aws_s3_session_cache *session_cache;
+
+    /*
+     * Bucket whose session credentials the provider returns
+     */
+    struct aws_byte_cursor bucket;
+};
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Creates a cache of per-bucket session credentials for directory-bucket style services, where every bucket
+ * requires its own short-lived credentials, obtained by a CreateSession call signed with the caller's base
+ * credentials.  Sessions are cached per bucket until shortly before they expire, so only the first request to a
+ * bucket (and one request per session lifetime after that) pays for the extra round trip.
+ */
+AWS_AUTH_API
+struct aws_s3_session_cache *aws_s3_session_cache_new(
+    struct aws_allocator *allocator,
+    const struct aws_s3_session_cache_options *options);
+
+/**
+ * Add a reference to a session cache
+ */
+AWS_AUTH_API
+void aws_s3_session_cache_acquire(struct aws_s3_session_cache *session_cache);
+
+/**
+ * Release a reference to a session cache.  In-progress CreateSession calls keep the cache alive until they
+ * complete.
+ */
+AWS_AUTH_API
+void aws_s3_session_cache_release(struct aws_s3_session_cache *session_cache);
+
+/**
+ * Retrieves session credentials for a bucket.  If the bucket has a valid cached session, the callback is invoked
+ * immediately with it (kicking off a background CreateSession if the refresh-ahead window has been entered).
+ * Otherwise the query is queued behind a single CreateSession call shared by all concurrent callers for that bucket.
+ * On failure the callback is invoked with NULL credentials.
+ */
+AWS_AUTH_API
+int aws_s3_session_cache_get_credentials(
+    struct aws_s3_session_cache *session_cache,
+    struct aws_byte_cursor bucket,
+    aws_on_get_credentials_callback_fn callback,
+    void *user_data);
+
+/**
+ * Creates a provider that sources the session credentials of a single bucket from a session cache, for use as the
+ * credentials_provider of the signing config of that bucket's requests.  If the provider holds the cache's last
+ * reference when it is released, its shutdown callback is invoked once the cache's connection managers have shut
+ * down.
+ */
+AWS_AUTH_API
+struct aws_credentials_provider *aws_credentials_provider_new_s3_session(
+    struct aws_allocator *allocator,
+    const struct aws_credentials_provider_s3_session_options *options);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_AUTH_S3_SESSION_CACHE_H */
@@ -21,6 +21,7 @@
 #include <aws/auth/signing_config.h>
 #include <aws/auth/signing_result.h>
 
+struct aws_credentials;
 struct aws_signable;
 
 /**
@@ -31,6 +32,43 @@ struct aws_signable;
  */
 typedef void(aws_signing_complete_fn)(struct aws_signing_result *result, int error_code, void *userdata);
 
+/**
+ * Optional hook invoked at the start of every aws_sign_request_aws call, before credentials are sourced.  Used to
+ * record signing workloads (see signing_trace.h).  The signable and config are only valid for the duration of the
+ * call.
+ */
+typedef void(aws_signing_capture_fn)(
+    const struct aws_signable *signable,
+    const struct aws_signing_config_aws *config,
+    void *user_data);
+
+/*
+ * Credential scope and key material for the raw sigv4 signing functions.  Unlike aws_signing_config_aws, credentials
+ * are supplied directly since raw signing is synchronous.
+ */
+struct aws_sigv4_raw_signing_options {
+    const struct aws_credentials *credentials;
+    struct aws_byte_cursor region;
+    struct aws_byte_cursor service;
+    struct aws_date_time date;
+};
+
+/*
+ * A recently computed signature along with the canonical request and string-to-sign it was derived from.  Each
+ * signing thread retains a small ring of these so that SignatureDoesNotMatch failures can be diagnosed without
+ * logging every request.
+ */
+struct aws_signing_recent_request {
+    struct aws_byte_cursor signature;
+    struct aws_byte_cursor canonical_request;
+    struct aws_byte_cursor string_to_sign;
+
+    /* true if the canonical request was too long to be retained in full */
+    bool canonical_request_truncated;
+};
+
+typedef void(aws_signing_recent_request_fn)(const struct aws_signing_recent_request *request, void *user_data);
+
 AWS_EXTERN_C_BEGIN
 
 /*
@@ -66,6 +104,68 @@ int aws_sign_request_aws(
     aws_signing_complete_fn *on_complete,
     void *userdata);
 
+/*
+ * Installs (or, with a NULL capture_fn, removes) the process-wide signing capture hook.  Not synchronized with
+ * signing itself: install the hook before signing starts and remove it only once all signing calls have returned.
+ */
+AWS_AUTH_API
+void aws_signing_set_capture_fn(aws_signing_capture_fn *capture_fn, void *user_data);
+
+/*
+ * Invokes visit_fn on every entry still held in the recent-request rings of all signing threads, oldest first
+ * within each thread.  Entries being overwritten concurrently are skipped.  The cursors in each entry are only valid
+ * during the callback, and the callback must not sign anything itself.
+ */
+AWS_AUTH_API
+void aws_signing_visit_recent_requests(aws_signing_recent_request_fn *visit_fn, void *user_data);
+
+/*
+ * Reports that a service rejected a request signed with the given (hex) signature.  If the signing inputs for that
+ * signature are still retained, they are logged at ERROR level and true is returned.
+ */
+AWS_AUTH_API
+bool aws_signing_report_signature_failure(const struct aws_byte_cursor *signature);
+
+/*
+ * Raw sigv4 primitives, for protocols that define their own canonical form (MQTT connect tokens, custom message
+ * formats) and so have no use for http canonicalization.  Each appends the hex-encoded signature to out_signature.
+ *
+ * The caller is responsible for putting whatever the receiver needs to verify the signature (date, credential scope,
+ * access key) into its own message.
+ */
+
+/**
+ * Signs a caller-built canonical request: hashes it, builds the string-to-sign from the options' date and scope,
+ * and signs that.
+ */
+AWS_AUTH_API
+int aws_sigv4_sign_canonical_request(
+    struct aws_allocator *allocator,
+    const struct aws_sigv4_raw_signing_options *options,
+    const struct aws_byte_cursor *canonical_request,
+    struct aws_byte_buf *out_signature);
+
+/**
+ * Like aws_sigv4_sign_canonical_request, but takes the lowercase hex-encoded sha256 of the canonical request, for
+ * callers that hash incrementally or hash elsewhere.
+ */
+AWS_AUTH_API
+int aws_sigv4_sign_canonical_request_hash(
+    struct aws_allocator *allocator,
+    const struct aws_sigv4_raw_signing_options *options,
+    const struct aws_byte_cursor *canonical_request_hash,
+    struct aws_byte_buf *out_signature);
+
+/**
+ * Signs a complete, caller-built string-to-sign with the key derived from the options' credentials and scope.
+ */
+AWS_AUTH_API
+int aws_sigv4_sign_string_to_sign(
+    struct aws_allocator *allocator,
+    const struct aws_sigv4_raw_signing_options *options,
+    const struct aws_byte_cursor *string_to_sign,
+    struct aws_byte_buf *out_signature);
+
 AWS_EXTERN_C_END
 
 #endif /* AWS_AUTH_SIGNER_H */
@@ -21,7 +21,12 @@
 #include <aws/common/byte_buf.h>
 #include <aws/common/date_time.h>
 
+/* longest validity sigv4 allows for a presigned request */
+#define AWS_SIGV4_MAX_EXPIRATION_IN_SECONDS 604800
+
+struct aws_clock_skew_tracker;
 struct aws_credentials;
+struct aws_signing_key_cache;
 
 typedef bool(aws_should_sign_param_fn)(const struct aws_byte_cursor *name, void *userdata);
 
@@ -57,6 +62,14 @@ enum aws_body_signing_config_type {
     AWS_BODY_SIGNING_UNSIGNED_PAYLOAD,
 };
 
+/*
+ * Digests, beyond the SHA-256 payload hash, that can be computed while the payload is read for signing
+ */
+enum aws_signing_payload_digest {
+    AWS_SIGNING_PAYLOAD_DIGEST_MD5 = 0x01,
+    AWS_SIGNING_PAYLOAD_DIGEST_CRC32C = 0x02,
+};
+
 /*
  * A configuration structure for use in AWS-related signing.  Currently covers sigv4 only, but is not required to.
  */
@@ -122,6 +135,45 @@ struct aws_signing_config_aws {
      * otherwise no paylod signing will take place.
      */
     enum aws_body_signing_config_type body_signing_type;
+
+    /*
+     * If true and body_signing_type is AWS_BODY_SIGNING_ON, the payload's SHA-256 tree hash (1 MiB leaves) is signed
+     * as the x-amz-sha256-tree-hash header.  It is computed in the same read pass as x-amz-content-sha256, with leaves
+     * hashed on up to tree_hash_thread_count threads (the processor count if 0) of a pool that is shared by every
+     * signing call and sized to the processor count.  Payloads under 8 MiB, or signed while the pool is busy, are
+     * hashed on the signing thread.
+     */
+    bool add_tree_hash_header;
+    size_t tree_hash_thread_count;
+
+    /*
+     * Bitwise-or of aws_signing_payload_digest values.  If body_signing_type is AWS_BODY_SIGNING_ON, each requested
+     * digest is computed in the same read of the payload as the payload hash and added to the signing result's
+     * headers, base64-encoded: Content-MD5 and x-amz-checksum-crc32c.  These headers are signed, so the request
+     * must not already carry them.
+     */
+    uint32_t extra_payload_digests;
+
+    /*
+     * If non-zero and the algorithm is query param based, adds the X-Amz-Expires query param with this value.
+     * Presigned urls are only valid for this many seconds after the signing date.  Ignored by header-based signing.
+     * Must not exceed AWS_SIGV4_MAX_EXPIRATION_IN_SECONDS (seven days).  When set, the request itself must not
+     * carry an X-Amz-Expires param.
+     */
+    uint64_t expiration_in_seconds;
+
+    /*
+     * Optional.  If set, the date field is ignored and the request is dated with this tracker's skew-corrected
+     * clock for clock_skew_endpoint (the service name if empty).  The tracker must outlive the signing call.
+     */
+    struct aws_clock_skew_tracker *clock_skew_tracker;
+    struct aws_byte_cursor clock_skew_endpoint;
+
+    /*
+     * Optional.  If set, signing keys come from (and are kept in) this cache rather than being derived for every
+     * request.  The cache must outlive the signing call.
+     */
+    struct aws_signing_key_cache *signing_key_cache;
 };
 
 AWS_EXTERN_C_BEGIN
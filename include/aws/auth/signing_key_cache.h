@@ -0,0 +1,111 @@
+#ifndef AWS_AUTH_SIGNING_KEY_CACHE_H
+#define AWS_AUTH_SIGNING_KEY_CACHE_H
+
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/auth.h>
+
+#include <aws/common/byte_buf.h>
+#include <aws/io/io.h>
+
+struct aws_date_time;
+struct aws_signing_key_cache;
+struct aws_string;
+
+/*
+ * A signing key cache keeps derived sigv4 signing keys per (access key, region, service) scope, so that signers
+ * skip the four-HMAC derivation on every request.
+ *
+ * Keys are only valid for one UTC day, so every cached key expires at midnight at once.  To keep that from turning
+ * into a latency spike, the cache re-derives the next day's key for every scope that has been used in the last day,
+ * shortly before midnight, on a background thread.  Each scope holds two days' keys, so requests dated either side
+ * of midnight find theirs without waiting.
+ */
+struct aws_signing_key_cache_options {
+    /*
+     * Wall clock, in nanoseconds since the unix epoch.  Defaults to aws_sys_clock_get_ticks.  Useful for testing.
+     */
+    aws_io_clock_fn *clock_fn;
+
+    /*
+     * How long before midnight UTC to derive the next day's keys.  Defaults to 5 minutes.
+     */
+    uint32_t prederive_lead_time_secs;
+
+    /*
+     * If true, no background thread is started and the next day's keys are only derived by
+     * aws_signing_key_cache_prederive.  For callers with their own scheduling, and for tests.
+     */
+    bool manual_prederive;
+};
+
+/*
+ * Counters for keys handed out by aws_signing_key_cache_get_sigv4_key.  Pre-derivations are not counted; see
+ * aws_signing_key_cache_prederive.
+ */
+struct aws_signing_key_cache_stats {
+    /* requests answered from the cache */
+    uint64_t hit_count;
+
+    /* requests that had to derive their key */
+    uint64_t derive_count;
+};
+
+AWS_EXTERN_C_BEGIN
+
+AWS_AUTH_API
+struct aws_signing_key_cache *aws_signing_key_cache_new(
+    struct aws_allocator *allocator,
+    const struct aws_signing_key_cache_options *options);
+
+/**
+ * The cache must outlive any signing call whose config references it.
+ */
+AWS_AUTH_API
+void aws_signing_key_cache_destroy(struct aws_signing_key_cache *cache);
+
+/**
+ * Appends the sigv4 signing key for a scope and date to dest, deriving (and caching) it if necessary.
+ */
+AWS_AUTH_API
+int aws_signing_key_cache_get_sigv4_key(
+    struct aws_signing_key_cache *cache,
+    const struct aws_string *access_key_id,
+    const struct aws_string *secret_access_key,
+    const struct aws_date_time *date,
+    const struct aws_byte_cursor *region,
+    const struct aws_byte_cursor *service,
+    struct aws_byte_buf *dest);
+
+/**
+ * Derives tomorrow's (by the cache's clock) key for every scope used since the start of yesterday, and drops scopes
+ * that haven't been used since.  The background thread calls this shortly before midnight.  If out_derived_count
+ * is non-NULL, it is set to the number of keys derived.
+ */
+AWS_AUTH_API
+int aws_signing_key_cache_prederive(struct aws_signing_key_cache *cache, size_t *out_derived_count);
+
+/**
+ * Copies the cache's counters into out_stats.
+ */
+AWS_AUTH_API
+void aws_signing_key_cache_get_stats(
+    struct aws_signing_key_cache *cache,
+    struct aws_signing_key_cache_stats *out_stats);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_AUTH_SIGNING_KEY_CACHE_H */
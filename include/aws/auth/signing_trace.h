@@ -0,0 +1,135 @@
+#ifndef AWS_AUTH_SIGNING_TRACE_H
+#define AWS_AUTH_SIGNING_TRACE_H
+
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/auth.h>
+
+#include <aws/auth/signing_config.h>
+#include <aws/common/array_list.h>
+#include <aws/common/byte_buf.h>
+
+struct aws_signable;
+struct aws_signing_trace_file_capture;
+
+/*
+ * Signing traces record the shape of signing workloads without any of the sensitive content: header names are
+ * kept, but every value (header values, path, query params, payload) is reduced to a length or a count.  A trace
+ * can be replayed against the signer with synthetic requests of the same shape to benchmark realistic mixes.
+ *
+ * Trace layout (all integers big-endian):
+ *
+ *   header: "AWSSIGTR" <u8 version>
+ *   record: <u8 algorithm> <u8 body signing type> <u8 flags> <u32 path length> <u16 query param count>
+ *           <u64 payload size> <u16 header count> (<u16 name length> <name> <u32 value length>)*
+ */
+
+/*
+ * A single header in a trace record.  The name points either into the recorded signable (when captured) or into the
+ * trace data (when decoded).
+ */
+struct aws_signing_trace_header_shape {
+    struct aws_byte_cursor name;
+    uint32_t value_length;
+};
+
+struct aws_signing_trace_record {
+    enum aws_signing_algorithm algorithm;
+    enum aws_body_signing_config_type body_signing_type;
+    bool use_double_uri_encode;
+    bool should_normalize_uri_path;
+
+    uint32_t path_length;
+    uint32_t query_param_count;
+    uint64_t payload_size;
+
+    /* list of struct aws_signing_trace_header_shape */
+    struct aws_array_list headers;
+};
+
+AWS_EXTERN_C_BEGIN
+
+AWS_AUTH_API
+int aws_signing_trace_record_init(struct aws_signing_trace_record *record, struct aws_allocator *allocator);
+
+AWS_AUTH_API
+void aws_signing_trace_record_clean_up(struct aws_signing_trace_record *record);
+
+/**
+ * Fills in a (previously initialized) record with the shape of a signing call.  Header names in the record point
+ * into the signable and are only valid as long as it is.
+ */
+AWS_AUTH_API
+int aws_signing_trace_record_capture(
+    struct aws_signing_trace_record *record,
+    const struct aws_signable *signable,
+    const struct aws_signing_config_aws *config);
+
+/**
+ * Appends the trace file header to a buffer.
+ */
+AWS_AUTH_API
+int aws_signing_trace_encode_header(struct aws_byte_buf *output);
+
+/**
+ * Consumes and validates the trace file header at the front of a cursor.
+ */
+AWS_AUTH_API
+int aws_signing_trace_decode_header(struct aws_byte_cursor *input);
+
+/**
+ * Appends the binary encoding of a record to a buffer.
+ */
+AWS_AUTH_API
+int aws_signing_trace_record_encode(const struct aws_signing_trace_record *record, struct aws_byte_buf *output);
+
+/**
+ * Decodes the next record from the front of a cursor, advancing it.  Header names in the record point into the
+ * cursor's memory.  Raises AWS_ERROR_INVALID_ARGUMENT on a truncated or malformed record.
+ */
+AWS_AUTH_API
+int aws_signing_trace_record_decode(struct aws_signing_trace_record *record, struct aws_byte_cursor *input);
+
+/**
+ * A capture target that appends trace records to a file.  Install it with:
+ *
+ *   aws_signing_set_capture_fn(aws_signing_trace_file_capture_fn, capture);
+ *
+ * The capture is internally synchronized, so signing may happen on any number of threads.
+ */
+AWS_AUTH_API
+struct aws_signing_trace_file_capture *aws_signing_trace_file_capture_new(
+    struct aws_allocator *allocator,
+    const char *file_path);
+
+/**
+ * Flushes and closes the trace file.  Uninstall the capture function before calling this.
+ */
+AWS_AUTH_API
+void aws_signing_trace_file_capture_destroy(struct aws_signing_trace_file_capture *capture);
+
+/**
+ * aws_signing_capture_fn implementation for a file capture; user_data must be the aws_signing_trace_file_capture.
+ */
+AWS_AUTH_API
+void aws_signing_trace_file_capture_fn(
+    const struct aws_signable *signable,
+    const struct aws_signing_config_aws *config,
+    void *user_data);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_AUTH_SIGNING_TRACE_H */
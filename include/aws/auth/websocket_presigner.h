@@ -0,0 +1,111 @@
+#ifndef AWS_AUTH_WEBSOCKET_PRESIGNER_H
+#define AWS_AUTH_WEBSOCKET_PRESIGNER_H
+
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/auth.h>
+
+#include <aws/common/byte_buf.h>
+#include <aws/io/io.h>
+
+struct aws_credentials_provider;
+struct aws_websocket_presigner;
+
+/*
+ * Invoked with the presigned websocket handshake path (path + query string, including all X-Amz-* auth params).
+ * The cursor is only valid for the duration of the callback.  On failure, signed_path is NULL and error_code is set.
+ */
+typedef void(aws_websocket_presign_complete_fn)(
+    const struct aws_byte_cursor *signed_path,
+    int error_code,
+    void *user_data);
+
+struct aws_websocket_presigner_options {
+    /*
+     * Credentials used to sign the handshake
+     */
+    struct aws_credentials_provider *credentials_provider;
+
+    /*
+     * Region and service to sign for ("iotdevicegateway" for IoT Core, for example)
+     */
+    struct aws_byte_cursor region;
+    struct aws_byte_cursor service;
+
+    /*
+     * Host header value and request path (optionally with a query string) of the websocket handshake
+     */
+    struct aws_byte_cursor host;
+    struct aws_byte_cursor path;
+
+    /*
+     * Value of X-Amz-Expires.  The cached signed path is handed out for this long after signing.  Defaults to
+     * 15 minutes if zero.
+     */
+    uint64_t expiration_in_seconds;
+
+    /*
+     * How long before expiration the presigner starts re-signing in the background, while continuing to hand
+     * out the still-valid cached path.  Defaults to one minute if zero.  Clamped to half the expiration window.
+     */
+    uint64_t refresh_ahead_in_seconds;
+
+    /*
+     * Wall clock (nanoseconds since the unix epoch) used for both the signing date and the cache window.
+     * For testing; leave NULL to use the system clock.
+     */
+    aws_io_clock_fn *clock_fn;
+};
+
+AWS_EXTERN_C_BEGIN
+
+/**
+ * Creates a presigner that signs a websocket handshake request via sigv4 query params and caches the resulting
+ * path for its X-Amz-Expires validity window.  Reconnects that happen within the window reuse the cached path
+ * rather than paying for a full signing pass each.
+ */
+AWS_AUTH_API
+struct aws_websocket_presigner *aws_websocket_presigner_new(
+    struct aws_allocator *allocator,
+    const struct aws_websocket_presigner_options *options);
+
+/**
+ * Add a reference to a websocket presigner
+ */
+AWS_AUTH_API
+void aws_websocket_presigner_acquire(struct aws_websocket_presigner *presigner);
+
+/**
+ * Release a reference to a websocket presigner.  An in-progress refresh keeps the presigner alive until it
+ * completes.
+ */
+AWS_AUTH_API
+void aws_websocket_presigner_release(struct aws_websocket_presigner *presigner);
+
+/**
+ * Retrieves a presigned handshake path.  If a valid cached path exists, the callback is invoked immediately with it
+ * (kicking off a background re-sign if the refresh-ahead window has been entered).  Otherwise the request is queued
+ * behind a single signing pass shared by all concurrent callers.
+ */
+AWS_AUTH_API
+int aws_websocket_presigner_get_signed_path(
+    struct aws_websocket_presigner *presigner,
+    aws_websocket_presign_complete_fn *callback,
+    void *user_data);
+
+AWS_EXTERN_C_END
+
+#endif /* AWS_AUTH_WEBSOCKET_PRESIGNER_H */
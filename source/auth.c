@@ -16,6 +16,8 @@
 
 #include <aws/auth/external/cJSON.h>
 #include <aws/auth/private/aws_signing.h>
+#include <aws/auth/private/signing_ring.h>
+#include <aws/auth/private/tree_hash.h>
 
 #include <aws/http/http.h>
 
@@ -104,6 +106,8 @@ void aws_auth_library_init(struct aws_allocator *allocator) {
     aws_register_log_subject_info_list(&s_auth_log_subject_list);
 
     AWS_FATAL_ASSERT(aws_signing_init_signing_tables(allocator) == AWS_OP_SUCCESS);
+    aws_signing_ring_init(s_library_allocator);
+    aws_tree_hash_pool_init(s_library_allocator);
 
     struct cJSON_Hooks allocation_hooks = {.malloc_fn = s_cJSONAlloc, .free_fn = s_cJSONFree};
 
@@ -117,6 +121,8 @@ void aws_auth_library_clean_up(void) {
 
     s_library_initialized = false;
 
+    aws_tree_hash_pool_clean_up();
+    aws_signing_ring_clean_up();
     aws_signing_clean_up_signing_tables();
 
     aws_http_library_clean_up();
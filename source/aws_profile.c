@@ -24,6 +24,7 @@
 
 #define PROPERTIES_TABLE_DEFAULT_SIZE 4
 #define PROFILE_TABLE_DEFAULT_SIZE 5
+#define CONTINUATION_VALUE_STARTING_SIZE 256
 
 /*
  * Character-based profile parse helper functions
@@ -186,6 +187,14 @@ struct profile_file_parse_context {
     struct aws_profile_collection *profile_collection;
     struct aws_profile *current_profile;
     struct aws_profile_property *current_property;
+
+    /*
+     * The value of a property with continuation lines is built up here and only copied into the property once the
+     * property is complete, so that long multi-line values take linear time to parse
+     */
+    struct aws_profile_property *continued_property;
+    struct aws_byte_buf continuation_value;
+
     struct aws_byte_cursor current_line;
     enum aws_auth_errors parse_error;
     int current_line_number;
@@ -273,44 +282,55 @@ AWS_STATIC_STRING_FROM_LITERAL(s_newline, "\n");
  * Continuations are applied to the property value by concatenating the old value and the new value, with a '\n'
  * in between.
  */
-static int s_profile_property_add_continuation(
-    struct aws_profile_property *property,
-    const struct aws_byte_cursor *continuation_value) {
-
-    int result = AWS_OP_ERR;
-    struct aws_byte_buf concatenation;
-    if (aws_byte_buf_init(&concatenation, property->allocator, property->value->len + continuation_value->len + 1)) {
-        return result;
-    }
-
-    struct aws_byte_cursor old_value = aws_byte_cursor_from_string(property->value);
-    if (aws_byte_buf_append(&concatenation, &old_value)) {
-        goto on_generic_failure;
-    }
-
-    struct aws_byte_cursor newline = aws_byte_cursor_from_string(s_newline);
-    if (aws_byte_buf_append(&concatenation, &newline)) {
-        goto on_generic_failure;
+/*
+ * Copies the accumulated continuation value, if any, into its property
+ */
+static int s_apply_property_continuations(struct profile_file_parse_context *context) {
+    struct aws_profile_property *property = context->continued_property;
+    if (property == NULL) {
+        return AWS_OP_SUCCESS;
     }
 
-    if (aws_byte_buf_append(&concatenation, continuation_value)) {
-        goto on_generic_failure;
-    }
+    context->continued_property = NULL;
 
-    struct aws_string *new_value =
-        aws_string_new_from_array(property->allocator, concatenation.buffer, concatenation.len);
+    struct aws_string *new_value = aws_string_new_from_array(
+        property->allocator, context->continuation_value.buffer, context->continuation_value.len);
     if (new_value == NULL) {
-        goto on_generic_failure;
+        return AWS_OP_ERR;
     }
 
-    result = AWS_OP_SUCCESS;
     aws_string_destroy(property->value);
     property->value = new_value;
 
-on_generic_failure:
-    aws_byte_buf_clean_up(&concatenation);
+    return AWS_OP_SUCCESS;
+}
+
+static int s_profile_property_add_continuation(
+    struct profile_file_parse_context *context,
+    const struct aws_byte_cursor *continuation_value) {
 
-    return result;
+    struct aws_byte_buf *value = &context->continuation_value;
+
+    if (context->continued_property != context->current_property) {
+        if (s_apply_property_continuations(context)) {
+            return AWS_OP_ERR;
+        }
+
+        value->len = 0;
+        struct aws_byte_cursor old_value = aws_byte_cursor_from_string(context->current_property->value);
+        if (aws_byte_buf_append_dynamic(value, &old_value)) {
+            return AWS_OP_ERR;
+        }
+
+        context->continued_property = context->current_property;
+    }
+
+    struct aws_byte_cursor newline = aws_byte_cursor_from_string(s_newline);
+    if (aws_byte_buf_append_dynamic(value, &newline) || aws_byte_buf_append_dynamic(value, continuation_value)) {
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
 }
 
 static int s_profile_property_add_sub_property(
@@ -853,6 +873,11 @@ static bool s_parse_profile_declaration(
         return false;
     }
 
+    if (s_apply_property_continuations(context)) {
+        context->parse_error = AWS_AUTH_PROFILE_PARSE_FATAL_ERROR;
+        return true;
+    }
+
     context->has_seen_profile = true;
     context->current_profile = NULL;
     context->current_property = NULL;
@@ -993,7 +1018,7 @@ static bool s_parse_property_continuation(
         return true;
     }
 
-    if (s_profile_property_add_continuation(context->current_property, &continuation_cursor)) {
+    if (s_profile_property_add_continuation(context, &continuation_cursor)) {
         AWS_LOGF_WARN(AWS_LS_AUTH_PROFILE, "Property continuation could not be applied to the current property");
         s_log_parse_context(AWS_LL_WARN, context);
 
@@ -1064,6 +1089,11 @@ static bool s_parse_property(const struct aws_byte_cursor *line_cursor, struct p
     struct aws_byte_cursor property_line_cursor = s_trim_trailing_whitespace_comment(line_cursor);
     struct aws_byte_cursor property_cursor = aws_byte_cursor_right_trim_pred(&property_line_cursor, s_is_whitespace);
 
+    if (s_apply_property_continuations(context)) {
+        context->parse_error = AWS_AUTH_PROFILE_PARSE_FATAL_ERROR;
+        return true;
+    }
+
     context->current_property = NULL;
 
     struct aws_byte_cursor key_cursor;
@@ -1184,6 +1214,9 @@ static struct aws_profile_collection *s_aws_profile_collection_new_internal(
     profile_collection->profile_source = source;
     profile_collection->allocator = allocator;
 
+    struct profile_file_parse_context context;
+    AWS_ZERO_STRUCT(context);
+
     if (aws_hash_table_init(
             &profile_collection->profiles,
             allocator,
@@ -1201,12 +1234,14 @@ static struct aws_profile_collection *s_aws_profile_collection_new_internal(
         struct aws_byte_cursor line_cursor;
         AWS_ZERO_STRUCT(line_cursor);
 
-        struct profile_file_parse_context context;
-        AWS_ZERO_STRUCT(context);
         context.current_line_number = 1;
         context.profile_collection = profile_collection;
         context.source_file_path = path;
 
+        if (aws_byte_buf_init(&context.continuation_value, allocator, CONTINUATION_VALUE_STARTING_SIZE)) {
+            goto cleanup;
+        }
+
         while (aws_byte_cursor_next_split(&current_position, '\n', &line_cursor)) {
             context.current_line = line_cursor;
 
@@ -1219,11 +1254,18 @@ static struct aws_profile_collection *s_aws_profile_collection_new_internal(
             aws_byte_cursor_advance(&current_position, line_cursor.len + 1);
             ++context.current_line_number;
         }
+
+        if (s_apply_property_continuations(&context)) {
+            goto cleanup;
+        }
+
+        aws_byte_buf_clean_up(&context.continuation_value);
     }
 
     return profile_collection;
 
 cleanup:
+    aws_byte_buf_clean_up(&context.continuation_value);
     aws_profile_collection_destroy(profile_collection);
 
     return NULL;
@@ -15,9 +15,14 @@
 
 #include <aws/auth/private/aws_signing.h>
 
+#include <aws/auth/clock_skew.h>
 #include <aws/auth/credentials.h>
+#include <aws/auth/private/payload_digests.h>
+#include <aws/auth/private/signing_ring.h>
+#include <aws/auth/private/tree_hash.h>
 #include <aws/auth/signable.h>
 #include <aws/auth/signing.h>
+#include <aws/auth/signing_key_cache.h>
 #include <aws/cal/hash.h>
 #include <aws/cal/hmac.h>
 #include <aws/common/date_time.h>
@@ -27,6 +32,8 @@
 #include <aws/io/uri.h>
 
 #include <ctype.h>
+#include <inttypes.h>
+#include <stdio.h>
 
 #if defined(_MSC_VER)
 #    pragma warning(disable : 4204)
@@ -51,8 +58,12 @@
 #define ENCODED_SIGNING_QUERY_PARAM_STARTING_SIZE 256
 #define INITIAL_QUERY_FRAGMENT_COUNT 5
 #define DEFAULT_PATH_COMPONENT_COUNT 10
+#define MAX_EXPIRES_VALUE_LENGTH 21
 
 AWS_STRING_FROM_LITERAL(g_aws_signing_content_header_name, "x-amz-content-sha256");
+AWS_STRING_FROM_LITERAL(g_aws_signing_tree_hash_header_name, "x-amz-sha256-tree-hash");
+AWS_STRING_FROM_LITERAL(g_aws_signing_content_md5_header_name, "Content-MD5");
+AWS_STRING_FROM_LITERAL(g_aws_signing_checksum_crc32c_header_name, "x-amz-checksum-crc32c");
 AWS_STRING_FROM_LITERAL(g_aws_signing_authorization_header_name, "Authorization");
 AWS_STRING_FROM_LITERAL(g_aws_signing_authorization_query_param_name, "X-Amz-Signature");
 AWS_STRING_FROM_LITERAL(g_aws_signing_algorithm_query_param_name, "X-Amz-Algorithm");
@@ -60,6 +71,7 @@ AWS_STRING_FROM_LITERAL(g_aws_signing_credential_query_param_name, "X-Amz-Creden
 AWS_STRING_FROM_LITERAL(g_aws_signing_date_name, "X-Amz-Date");
 AWS_STRING_FROM_LITERAL(g_aws_signing_signed_headers_query_param_name, "X-Amz-SignedHeaders");
 AWS_STRING_FROM_LITERAL(g_aws_signing_security_token_name, "X-Amz-Security-Token");
+AWS_STRING_FROM_LITERAL(g_aws_signing_expires_query_param_name, "X-Amz-Expires");
 
 /* aws-related query param and header tables */
 static struct aws_hash_table s_forbidden_headers;
@@ -211,7 +223,7 @@ void aws_signing_clean_up_signing_tables(void) {
 /*
  * Signing algorithm helper functions
  */
-AWS_STATIC_STRING_FROM_LITERAL(s_sigv4_algorithm, "AWS4-HMAC-SHA256");
+AWS_STRING_FROM_LITERAL(g_aws_signing_sigv4_algorithm, "AWS4-HMAC-SHA256");
 
 static bool s_is_header_auth(enum aws_signing_algorithm algorithm) {
     return algorithm == AWS_SIGNING_ALGORITHM_SIG_V4_HEADER;
@@ -225,7 +237,7 @@ static int s_get_signing_algorithm_cursor(enum aws_signing_algorithm algorithm,
     switch (algorithm) {
         case AWS_SIGNING_ALGORITHM_SIG_V4_HEADER:
         case AWS_SIGNING_ALGORITHM_SIG_V4_QUERY_PARAM:
-            *cursor = aws_byte_cursor_from_string(s_sigv4_algorithm);
+            *cursor = aws_byte_cursor_from_string(g_aws_signing_sigv4_algorithm);
             break;
 
         default:
@@ -267,6 +279,19 @@ struct aws_signing_state_aws *aws_signing_state_new(
 
     /* Make our own copy of the signing config */
     state->config = *config;
+
+    if (config->clock_skew_tracker != NULL) {
+        struct aws_byte_cursor endpoint = config->clock_skew_endpoint;
+        if (endpoint.len == 0) {
+            endpoint = config->service;
+        }
+
+        if (aws_clock_skew_tracker_now(config->clock_skew_tracker, endpoint, &state->config.date)) {
+            aws_mem_release(allocator, state);
+            return NULL;
+        }
+    }
+
     aws_credentials_provider_acquire(state->config.credentials_provider);
 
     if (aws_byte_buf_init(&state->region_service_buffer, allocator, config->region.len + config->service.len)) {
@@ -294,6 +319,7 @@ struct aws_signing_state_aws *aws_signing_state_new(
         aws_byte_buf_init(&state->signed_headers, allocator, SIGNED_HEADERS_STARTING_SIZE) ||
         aws_byte_buf_init(&state->canonical_header_block, allocator, CANONICAL_HEADER_BLOCK_STARTING_SIZE) ||
         aws_byte_buf_init(&state->payload_hash, allocator, PAYLOAD_HASH_STARTING_SIZE) ||
+        aws_byte_buf_init(&state->tree_hash, allocator, PAYLOAD_HASH_STARTING_SIZE) ||
         aws_byte_buf_init(&state->credential_scope, allocator, CREDENTIAL_SCOPE_STARTING_SIZE) ||
         aws_byte_buf_init(&state->access_credential_scope, allocator, ACCESS_CREDENTIAL_SCOPE_STARTING_SIZE) ||
         aws_byte_buf_init(&state->date, allocator, AWS_DATE_TIME_STR_MAX_LEN)) {
@@ -320,6 +346,9 @@ void aws_signing_state_destroy(struct aws_signing_state_aws *state) {
     aws_byte_buf_clean_up(&state->signed_headers);
     aws_byte_buf_clean_up(&state->canonical_header_block);
     aws_byte_buf_clean_up(&state->payload_hash);
+    aws_byte_buf_clean_up(&state->tree_hash);
+    aws_byte_buf_clean_up(&state->content_md5);
+    aws_byte_buf_clean_up(&state->checksum_crc32c);
     aws_byte_buf_clean_up(&state->credential_scope);
     aws_byte_buf_clean_up(&state->access_credential_scope);
     aws_byte_buf_clean_up(&state->date);
@@ -599,7 +628,22 @@ int s_canonical_header_comparator(const void *lhs, const void *rhs) {
     return 1;
 }
 
-static int s_append_canonical_query_param(struct aws_uri_param *param, struct aws_byte_buf *buffer) {
+/*
+ * Is this the session token param s_add_authorization_query_params added?  Its value points at the credentials' own
+ * token, so a token param that was already on the request never matches.
+ */
+static bool s_is_credentials_session_token_param(struct aws_signing_state_aws *state, struct aws_uri_param *param) {
+    const struct aws_string *session_token = state->credentials->session_token;
+
+    return session_token != NULL && param->value.ptr == aws_string_bytes(session_token) &&
+           param->value.len == session_token->len;
+}
+
+static int s_append_canonical_query_param(
+    struct aws_signing_state_aws *state,
+    struct aws_uri_param *param,
+    struct aws_byte_buf *buffer) {
+
     if (aws_byte_buf_append_encoding_uri_param(buffer, &param->key)) {
         return AWS_OP_ERR;
     }
@@ -608,6 +652,12 @@ static int s_append_canonical_query_param(struct aws_uri_param *param, struct aw
         return AWS_OP_ERR;
     }
 
+    const struct aws_string *encoded_token = state->credentials->uri_encoded_session_token;
+    if (encoded_token != NULL && s_is_credentials_session_token_param(state, param)) {
+        struct aws_byte_cursor encoded_value = aws_byte_cursor_from_string(encoded_token);
+        return aws_byte_buf_append_dynamic(buffer, &encoded_value);
+    }
+
     if (aws_byte_buf_append_encoding_uri_param(buffer, &param->value)) {
         return AWS_OP_ERR;
     }
@@ -615,6 +665,51 @@ static int s_append_canonical_query_param(struct aws_uri_param *param, struct aw
     return AWS_OP_SUCCESS;
 }
 
+/*
+ * Gets the uri-encoded session token.  Credentials created by the library carry it already; only credentials
+ * assembled by hand need it encoded here, into scratch (which is initialized if it hasn't been).
+ */
+static int s_get_uri_encoded_session_token(
+    struct aws_signing_state_aws *state,
+    struct aws_byte_buf *scratch,
+    struct aws_byte_cursor *out_encoded_token) {
+
+    if (state->credentials->uri_encoded_session_token != NULL) {
+        *out_encoded_token = aws_byte_cursor_from_string(state->credentials->uri_encoded_session_token);
+        return AWS_OP_SUCCESS;
+    }
+
+    struct aws_byte_cursor session_token = aws_byte_cursor_from_string(state->credentials->session_token);
+
+    if (scratch->buffer == NULL && aws_byte_buf_init(scratch, state->allocator, session_token.len)) {
+        return AWS_OP_ERR;
+    }
+
+    scratch->len = 0;
+    if (aws_byte_buf_append_encoding_uri_param(scratch, &session_token)) {
+        return AWS_OP_ERR;
+    }
+
+    *out_encoded_token = aws_byte_cursor_from_buf(scratch);
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_add_authorization_query_param_pre_encoded(
+    struct aws_signing_state_aws *state,
+    struct aws_array_list *query_params,
+    struct aws_uri_param *uri_param,
+    struct aws_byte_cursor *encoded_value) {
+
+    if (aws_signing_result_append_property_list(
+            &state->result, g_aws_http_query_params_property_list_name, &uri_param->key, encoded_value) ||
+        aws_array_list_push_back(query_params, uri_param)) {
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
 static int s_add_authorization_query_param_with_encoding(
     struct aws_signing_state_aws *state,
     struct aws_array_list *query_params,
@@ -626,14 +721,9 @@ static int s_add_authorization_query_param_with_encoding(
         return AWS_OP_ERR;
     }
 
-    struct aws_byte_cursor encoded_algorithm_value = aws_byte_cursor_from_buf(uri_encoded_buffer);
-    if (aws_signing_result_append_property_list(
-            &state->result, g_aws_http_query_params_property_list_name, &uri_param->key, &encoded_algorithm_value) ||
-        aws_array_list_push_back(query_params, uri_param)) {
-        return AWS_OP_ERR;
-    }
+    struct aws_byte_cursor encoded_value = aws_byte_cursor_from_buf(uri_encoded_buffer);
 
-    return AWS_OP_SUCCESS;
+    return s_add_authorization_query_param_pre_encoded(state, query_params, uri_param, &encoded_value);
 }
 
 /*
@@ -710,6 +800,20 @@ static int s_add_authorization_query_params(struct aws_signing_state_aws *state,
         goto done;
     }
 
+    /* X-Amz-Expires */
+    char expires_value[MAX_EXPIRES_VALUE_LENGTH];
+    if (state->config.expiration_in_seconds > 0) {
+        snprintf(expires_value, sizeof(expires_value), "%" PRIu64, state->config.expiration_in_seconds);
+
+        struct aws_uri_param expires_param = {
+            .key = aws_byte_cursor_from_string(g_aws_signing_expires_query_param_name),
+            .value = aws_byte_cursor_from_c_str(expires_value)};
+
+        if (s_add_authorization_query_param_with_encoding(state, query_params, &expires_param, &uri_encoded_value)) {
+            goto done;
+        }
+    }
+
     /* X-Amz-Security-token */
     struct aws_byte_cursor security_token_name_cur = aws_byte_cursor_from_string(g_aws_signing_security_token_name);
 
@@ -717,8 +821,10 @@ static int s_add_authorization_query_params(struct aws_signing_state_aws *state,
         struct aws_uri_param security_token_param = {
             .key = security_token_name_cur, .value = aws_byte_cursor_from_string(state->credentials->session_token)};
 
-        if (s_add_authorization_query_param_with_encoding(
-                state, query_params, &security_token_param, &uri_encoded_value)) {
+        struct aws_byte_cursor encoded_session_token;
+        if (s_get_uri_encoded_session_token(state, &uri_encoded_value, &encoded_session_token) ||
+            s_add_authorization_query_param_pre_encoded(
+                state, query_params, &security_token_param, &encoded_session_token)) {
             goto done;
         }
     }
@@ -732,7 +838,10 @@ done:
     return result;
 }
 
-static int s_validate_query_params(struct aws_array_list *params) {
+static int s_validate_query_params(struct aws_signing_state_aws *state, struct aws_array_list *params) {
+    /* X-Amz-Expires may come with the request unless the signer is adding its own */
+    bool is_expires_forbidden = state->config.expiration_in_seconds > 0;
+
     const size_t param_count = aws_array_list_length(params);
     for (size_t i = 0; i < param_count; ++i) {
         struct aws_uri_param param;
@@ -742,7 +851,8 @@ static int s_validate_query_params(struct aws_array_list *params) {
         struct aws_hash_element *forbidden_element = NULL;
         aws_hash_table_find(&s_forbidden_params, &param.key, &forbidden_element);
 
-        if (forbidden_element != NULL) {
+        if (forbidden_element != NULL ||
+            (is_expires_forbidden && aws_string_eq_byte_cursor(g_aws_signing_expires_query_param_name, &param.key))) {
             AWS_LOGF_ERROR(
                 AWS_LS_AUTH_SIGNING,
                 "AWS authorization query param \"" PRInSTR "\" found in request while signing",
@@ -773,7 +883,7 @@ static int s_append_canonical_query_string(struct aws_uri *uri, struct aws_signi
         goto cleanup;
     }
 
-    if (s_validate_query_params(&query_params)) {
+    if (s_validate_query_params(state, &query_params)) {
         goto cleanup;
     }
 
@@ -791,7 +901,7 @@ static int s_append_canonical_query_string(struct aws_uri *uri, struct aws_signi
             goto cleanup;
         }
 
-        if (s_append_canonical_query_param(&param, canonical_request_buffer)) {
+        if (s_append_canonical_query_param(state, &param, canonical_request_buffer)) {
             goto cleanup;
         }
 
@@ -1036,12 +1146,66 @@ static int s_build_canonical_stable_header_list(
         *out_required_capacity += g_aws_signing_content_header_name->len + state->payload_hash.len;
     }
 
+    /*
+     * x-amz-sha256-tree-hash (optional)
+     */
+    if (state->tree_hash.len > 0) {
+        struct stable_header tree_hash_header = {
+            .original_index = additional_header_index++,
+            .header = {.name = aws_byte_cursor_from_string(g_aws_signing_tree_hash_header_name),
+                       .value = aws_byte_cursor_from_buf(&state->tree_hash)}};
+
+        if (aws_array_list_push_back(stable_header_list, &tree_hash_header)) {
+            return AWS_OP_ERR;
+        }
+
+        *out_required_capacity += g_aws_signing_tree_hash_header_name->len + state->tree_hash.len;
+    }
+
+    /*
+     * Content-MD5, x-amz-checksum-crc32c (optional)
+     */
+    struct {
+        const struct aws_string *name;
+        const struct aws_byte_buf *value;
+    } extra_digest_headers[] = {
+        {.name = g_aws_signing_content_md5_header_name, .value = &state->content_md5},
+        {.name = g_aws_signing_checksum_crc32c_header_name, .value = &state->checksum_crc32c},
+    };
+
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(extra_digest_headers); ++i) {
+        if (extra_digest_headers[i].value->len == 0) {
+            continue;
+        }
+
+        struct stable_header digest_header = {
+            .original_index = additional_header_index++,
+            .header = {.name = aws_byte_cursor_from_string(extra_digest_headers[i].name),
+                       .value = aws_byte_cursor_from_buf(extra_digest_headers[i].value)}};
+
+        if (aws_array_list_push_back(stable_header_list, &digest_header)) {
+            return AWS_OP_ERR;
+        }
+
+        *out_required_capacity += extra_digest_headers[i].name->len + extra_digest_headers[i].value->len;
+    }
+
     *out_required_capacity += aws_array_list_length(stable_header_list) * 2; /*  ':' + '\n' per header */
 
     return AWS_OP_SUCCESS;
 }
 
-static int s_validate_signable_header_list(struct aws_array_list *header_list) {
+static int s_validate_signable_header_list(struct aws_signing_state_aws *state, struct aws_array_list *header_list) {
+    /* the signer adds its own digest headers, a second one from the caller would be signed alongside each */
+    bool is_payload_read = state->config.body_signing_type == AWS_BODY_SIGNING_ON;
+    bool is_tree_hash_forbidden = state->config.add_tree_hash_header && is_payload_read;
+    bool is_md5_forbidden = is_payload_read && (state->config.extra_payload_digests & AWS_SIGNING_PAYLOAD_DIGEST_MD5);
+    bool is_crc32c_forbidden =
+        is_payload_read && (state->config.extra_payload_digests & AWS_SIGNING_PAYLOAD_DIGEST_CRC32C);
+    struct aws_byte_cursor tree_hash_header_name = aws_byte_cursor_from_string(g_aws_signing_tree_hash_header_name);
+    struct aws_byte_cursor md5_header_name = aws_byte_cursor_from_string(g_aws_signing_content_md5_header_name);
+    struct aws_byte_cursor crc32c_header_name = aws_byte_cursor_from_string(g_aws_signing_checksum_crc32c_header_name);
+
     const size_t header_count = aws_array_list_length(header_list);
     for (size_t i = 0; i < header_count; ++i) {
         struct aws_signable_property_list_pair header;
@@ -1052,7 +1216,10 @@ static int s_validate_signable_header_list(struct aws_array_list *header_list) {
         struct aws_hash_element *forbidden_element = NULL;
         aws_hash_table_find(&s_forbidden_headers, &header.name, &forbidden_element);
 
-        if (forbidden_element != NULL) {
+        if (forbidden_element != NULL ||
+            (is_tree_hash_forbidden && aws_byte_cursor_eq_ignore_case(&header.name, &tree_hash_header_name)) ||
+            (is_md5_forbidden && aws_byte_cursor_eq_ignore_case(&header.name, &md5_header_name)) ||
+            (is_crc32c_forbidden && aws_byte_cursor_eq_ignore_case(&header.name, &crc32c_header_name))) {
             AWS_LOGF_ERROR(
                 AWS_LS_AUTH_SIGNING,
                 "AWS authorization header \"" PRInSTR "\" found in request while signing",
@@ -1085,7 +1252,7 @@ static int s_build_canonical_headers(struct aws_signing_state_aws *state) {
         return AWS_OP_ERR;
     }
 
-    if (s_validate_signable_header_list(signable_header_list)) {
+    if (s_validate_signable_header_list(state, signable_header_list)) {
         return AWS_OP_ERR;
     }
 
@@ -1096,6 +1263,18 @@ static int s_build_canonical_headers(struct aws_signing_state_aws *state) {
         total_sign_headers_count += 1;
     }
 
+    if (state->tree_hash.len > 0) {
+        total_sign_headers_count += 1; /* for x-amz-sha256-tree-hash */
+    }
+
+    if (state->content_md5.len > 0) {
+        total_sign_headers_count += 1; /* for Content-MD5 */
+    }
+
+    if (state->checksum_crc32c.len > 0) {
+        total_sign_headers_count += 1; /* for x-amz-checksum-crc32c */
+    }
+
     if (state->credentials->session_token) {
         total_sign_headers_count += 1; /* for X-Amz-Security-Token */
     }
@@ -1165,10 +1344,71 @@ on_cleanup:
     return result;
 }
 
+static int s_update_payload_digests(const struct aws_byte_cursor *chunk, void *user_data) {
+    return aws_payload_digests_update(user_data, chunk);
+}
+
 /*
- * Computes the payload hash as hex digits.  We currently don't have a way
- * to rewind the stream, so the caller of the signing process will need to do
- * that manually.
+ * Base64-encodes a finished extra digest into its state buffer
+ */
+static int s_encode_extra_digest(
+    struct aws_allocator *allocator,
+    struct aws_byte_cursor digest,
+    struct aws_byte_buf *encoded_digest) {
+
+    size_t encoded_length = 0;
+    if (aws_base64_compute_encoded_len(digest.len, &encoded_length)) {
+        return AWS_OP_ERR;
+    }
+
+    if (aws_byte_buf_init(encoded_digest, allocator, encoded_length)) {
+        return AWS_OP_ERR;
+    }
+
+    if (aws_base64_encode(&digest, encoded_digest)) {
+        return AWS_OP_ERR;
+    }
+
+    /* the encoder null-terminates its output; that is not part of the header value */
+    while (encoded_digest->len > 0 && encoded_digest->buffer[encoded_digest->len - 1] == 0) {
+        --encoded_digest->len;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_finalize_extra_digests(struct aws_signing_state_aws *state, struct aws_payload_digests *digests) {
+    if (digests->md5 != NULL) {
+        uint8_t md5[AWS_MD5_LEN];
+        struct aws_byte_buf md5_buffer = aws_byte_buf_from_empty_array(md5, sizeof(md5));
+        if (aws_hash_finalize(digests->md5, &md5_buffer, 0)) {
+            return AWS_OP_ERR;
+        }
+
+        if (s_encode_extra_digest(state->allocator, aws_byte_cursor_from_buf(&md5_buffer), &state->content_md5)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    if (digests->has_crc32c) {
+        /* checksums go over the wire big-endian */
+        uint8_t crc32c[sizeof(uint32_t)];
+        struct aws_byte_buf crc32c_buffer = aws_byte_buf_from_empty_array(crc32c, sizeof(crc32c));
+        aws_byte_buf_write_be32(&crc32c_buffer, digests->crc32c);
+
+        if (s_encode_extra_digest(
+                state->allocator, aws_byte_cursor_from_buf(&crc32c_buffer), &state->checksum_crc32c)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+/*
+ * Computes the payload hash as hex digits, along with the tree hash and any extra digests that were asked for, all
+ * from one read of the payload.  We currently don't have a way to rewind the stream, so the caller of the signing
+ * process will need to do that manually.
  */
 static int s_build_canonical_payload_hash(struct aws_signing_state_aws *state) {
     const struct aws_signable *signable = state->signable;
@@ -1180,14 +1420,18 @@ static int s_build_canonical_payload_hash(struct aws_signing_state_aws *state) {
     struct aws_byte_buf digest_buffer = aws_byte_buf_from_c_str("UNSIGNED-PAYLOAD");
     struct aws_byte_buf body_buffer;
     AWS_ZERO_STRUCT(body_buffer);
-    struct aws_hash *hash = NULL;
+    struct aws_payload_digests digests;
+    AWS_ZERO_STRUCT(digests);
+    struct aws_byte_buf tree_digest_buffer;
+    AWS_ZERO_STRUCT(tree_digest_buffer);
 
     int result = AWS_OP_ERR;
     if (state->config.body_signing_type != AWS_BODY_SIGNING_UNSIGNED_PAYLOAD) {
-        hash = aws_sha256_new(allocator);
         AWS_ZERO_STRUCT(digest_buffer);
 
-        if (hash == NULL) {
+        bool is_payload_read = state->config.body_signing_type == AWS_BODY_SIGNING_ON;
+        uint32_t extra_digests = is_payload_read ? state->config.extra_payload_digests : 0;
+        if (aws_payload_digests_init(&digests, allocator, extra_digests)) {
             return AWS_OP_ERR;
         }
 
@@ -1201,35 +1445,66 @@ static int s_build_canonical_payload_hash(struct aws_signing_state_aws *state) {
             goto on_cleanup;
         }
 
-        if (payload_stream != NULL && state->config.body_signing_type == AWS_BODY_SIGNING_ON) {
+        bool add_tree_hash = state->config.add_tree_hash_header && is_payload_read;
+        if (add_tree_hash && aws_byte_buf_init(&tree_digest_buffer, allocator, AWS_SHA256_LEN)) {
+            goto on_cleanup;
+        }
+
+        if (payload_stream != NULL && is_payload_read) {
             if (aws_input_stream_seek(payload_stream, 0, AWS_SSB_BEGIN)) {
                 goto on_cleanup;
             }
 
-            struct aws_stream_status payload_status;
-            AWS_ZERO_STRUCT(payload_status);
-
-            while (!payload_status.is_end_of_stream) {
-                /* reset the temporary body buffer; we can calculate the hash in window chunks */
-                body_buffer.len = 0;
-                aws_input_stream_read(payload_stream, &body_buffer);
-                if (body_buffer.len > 0) {
-                    struct aws_byte_cursor body_cursor = aws_byte_cursor_from_buf(&body_buffer);
-                    aws_hash_update(hash, &body_cursor);
-                }
-
-                if (aws_input_stream_get_status(payload_stream, &payload_status)) {
+            if (add_tree_hash) {
+                /* the tree hash hands every chunk it reads to the other digests too, so the stream is read once */
+                if (aws_sha256_tree_hash_compute(
+                        allocator,
+                        payload_stream,
+                        state->config.tree_hash_thread_count,
+                        s_update_payload_digests,
+                        &digests,
+                        &tree_digest_buffer)) {
                     goto on_cleanup;
                 }
+            } else {
+                struct aws_stream_status payload_status;
+                AWS_ZERO_STRUCT(payload_status);
+
+                while (!payload_status.is_end_of_stream) {
+                    /* reset the temporary body buffer; we can calculate the hashes in window chunks */
+                    body_buffer.len = 0;
+                    aws_input_stream_read(payload_stream, &body_buffer);
+                    if (body_buffer.len > 0) {
+                        struct aws_byte_cursor body_cursor = aws_byte_cursor_from_buf(&body_buffer);
+                        if (aws_payload_digests_update(&digests, &body_cursor)) {
+                            goto on_cleanup;
+                        }
+                    }
+
+                    if (aws_input_stream_get_status(payload_stream, &payload_status)) {
+                        goto on_cleanup;
+                    }
+                }
             }
 
             /* reset the input stream for sending */
             if (aws_input_stream_seek(payload_stream, 0, AWS_SSB_BEGIN)) {
                 goto on_cleanup;
             }
+        } else if (add_tree_hash) {
+            /* no body: the tree hash of an empty payload */
+            if (aws_sha256_tree_hash_compute(allocator, NULL, 1, NULL, NULL, &tree_digest_buffer)) {
+                goto on_cleanup;
+            }
+        }
+
+        state->payload_bytes_hashed = digests.bytes_hashed;
+
+        if (aws_hash_finalize(digests.sha256, &digest_buffer, 0)) {
+            goto on_cleanup;
         }
 
-        if (aws_hash_finalize(hash, &digest_buffer, 0)) {
+        if (s_finalize_extra_digests(state, &digests)) {
             goto on_cleanup;
         }
     }
@@ -1248,16 +1523,22 @@ static int s_build_canonical_payload_hash(struct aws_signing_state_aws *state) {
         }
     }
 
+    if (tree_digest_buffer.len > 0) {
+        struct aws_byte_cursor tree_digest_cursor = aws_byte_cursor_from_buf(&tree_digest_buffer);
+        if (aws_hex_encode_append_dynamic(&tree_digest_cursor, &state->tree_hash)) {
+            goto on_cleanup;
+        }
+    }
+
     result = AWS_OP_SUCCESS;
 
 on_cleanup:
 
+    aws_byte_buf_clean_up(&tree_digest_buffer);
     aws_byte_buf_clean_up(&digest_buffer);
     aws_byte_buf_clean_up(&body_buffer);
 
-    if (hash) {
-        aws_hash_destroy(hash);
-    }
+    aws_payload_digests_clean_up(&digests);
 
     return result;
 }
@@ -1291,38 +1572,51 @@ static int s_append_canonical_payload_hash(struct aws_signing_state_aws *state)
         }
     }
 
-    /* Sigv4 spec claims a newline should be included after the payload, but the implementation doesn't do this */
-
-    return AWS_OP_SUCCESS;
-}
-
-AWS_STATIC_STRING_FROM_LITERAL(s_credential_scope_sigv4_terminator, "aws4_request");
-
-static int s_append_credential_scope_terminator(enum aws_signing_algorithm algorithm, struct aws_byte_buf *dest) {
-    struct aws_byte_cursor terminator_cursor;
+    if (s_is_header_auth(state->config.algorithm) && state->tree_hash.len > 0) {
+        struct aws_byte_cursor tree_hash_header_name = aws_byte_cursor_from_string(g_aws_signing_tree_hash_header_name);
+        struct aws_byte_cursor tree_hash_cursor = aws_byte_cursor_from_buf(&state->tree_hash);
+        if (aws_signing_result_append_property_list(
+                &state->result, g_aws_http_headers_property_list_name, &tree_hash_header_name, &tree_hash_cursor)) {
+            return AWS_OP_ERR;
+        }
+    }
 
-    switch (algorithm) {
-        case AWS_SIGNING_ALGORITHM_SIG_V4_HEADER:
-        case AWS_SIGNING_ALGORITHM_SIG_V4_QUERY_PARAM:
-            terminator_cursor = aws_byte_cursor_from_string(s_credential_scope_sigv4_terminator);
-            break;
+    /*
+     * Extra payload digests are signed and go on the request whatever the algorithm
+     */
+    struct {
+        const struct aws_string *name;
+        const struct aws_byte_buf *value;
+    } extra_digest_headers[] = {
+        {.name = g_aws_signing_content_md5_header_name, .value = &state->content_md5},
+        {.name = g_aws_signing_checksum_crc32c_header_name, .value = &state->checksum_crc32c},
+    };
+
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(extra_digest_headers); ++i) {
+        if (extra_digest_headers[i].value->len == 0) {
+            continue;
+        }
 
-        default:
-            return aws_raise_error(AWS_AUTH_SIGNING_UNSUPPORTED_ALGORITHM);
+        struct aws_byte_cursor header_name = aws_byte_cursor_from_string(extra_digest_headers[i].name);
+        struct aws_byte_cursor header_value = aws_byte_cursor_from_buf(extra_digest_headers[i].value);
+        if (aws_signing_result_append_property_list(
+                &state->result, g_aws_http_headers_property_list_name, &header_name, &header_value)) {
+            return AWS_OP_ERR;
+        }
     }
 
-    return aws_byte_buf_append_dynamic(dest, &terminator_cursor);
+    /* Sigv4 spec claims a newline should be included after the payload, but the implementation doesn't do this */
+
+    return AWS_OP_SUCCESS;
 }
 
-/*
- * Builds the credential scope string by appending a bunch of things together:
- *   Date, region, service, algorithm terminator
- */
-static int s_build_credential_scope(struct aws_signing_state_aws *state) {
-    AWS_ASSERT(state->credential_scope.len == 0);
+AWS_STATIC_STRING_FROM_LITERAL(s_credential_scope_sigv4_terminator, "aws4_request");
 
-    const struct aws_signing_config_aws *config = &state->config;
-    struct aws_byte_buf *dest = &state->credential_scope;
+int aws_signing_append_sigv4_credential_scope(
+    const struct aws_date_time *date,
+    const struct aws_byte_cursor *region,
+    const struct aws_byte_cursor *service,
+    struct aws_byte_buf *dest) {
 
     /*
      * date output uses the non-dynamic append, so make sure there's enough room first
@@ -1331,7 +1625,7 @@ static int s_build_credential_scope(struct aws_signing_state_aws *state) {
         return AWS_OP_ERR;
     }
 
-    if (aws_date_time_to_utc_time_short_str(&config->date, AWS_DATE_FORMAT_ISO_8601_BASIC, dest)) {
+    if (aws_date_time_to_utc_time_short_str(date, AWS_DATE_FORMAT_ISO_8601_BASIC, dest)) {
         return AWS_OP_ERR;
     }
 
@@ -1339,7 +1633,7 @@ static int s_build_credential_scope(struct aws_signing_state_aws *state) {
         return AWS_OP_ERR;
     }
 
-    if (aws_byte_buf_append_dynamic(dest, &config->region)) {
+    if (aws_byte_buf_append_dynamic(dest, region)) {
         return AWS_OP_ERR;
     }
 
@@ -1347,7 +1641,7 @@ static int s_build_credential_scope(struct aws_signing_state_aws *state) {
         return AWS_OP_ERR;
     }
 
-    if (aws_byte_buf_append_dynamic(dest, &config->service)) {
+    if (aws_byte_buf_append_dynamic(dest, service)) {
         return AWS_OP_ERR;
     }
 
@@ -1355,7 +1649,25 @@ static int s_build_credential_scope(struct aws_signing_state_aws *state) {
         return AWS_OP_ERR;
     }
 
-    if (s_append_credential_scope_terminator(state->config.algorithm, dest)) {
+    struct aws_byte_cursor terminator_cursor = aws_byte_cursor_from_string(s_credential_scope_sigv4_terminator);
+    return aws_byte_buf_append_dynamic(dest, &terminator_cursor);
+}
+
+/*
+ * Builds the credential scope string by appending a bunch of things together:
+ *   Date, region, service, algorithm terminator
+ */
+static int s_build_credential_scope(struct aws_signing_state_aws *state) {
+    AWS_ASSERT(state->credential_scope.len == 0);
+
+    const struct aws_signing_config_aws *config = &state->config;
+
+    if (!s_is_header_auth(config->algorithm) && !s_is_query_param_auth(config->algorithm)) {
+        return aws_raise_error(AWS_AUTH_SIGNING_UNSUPPORTED_ALGORITHM);
+    }
+
+    if (aws_signing_append_sigv4_credential_scope(
+            &config->date, &config->region, &config->service, &state->credential_scope)) {
         return AWS_OP_ERR;
     }
 
@@ -1566,16 +1878,20 @@ int aws_signing_build_string_to_sign(struct aws_signing_state_aws *state) {
 AWS_STATIC_STRING_FROM_LITERAL(s_secret_key_prefix, "AWS4");
 
 /*
- * Computes the key to sign with as a function of the secret access key in the credentials and
+ * Computes the key to sign with as a function of the secret access key and
  *  the components of the credential scope: date, region, service, algorithm terminator
  */
-static int s_compute_sigv4_signing_key(struct aws_signing_state_aws *state, struct aws_byte_buf *dest) {
+int aws_signing_derive_sigv4_signing_key(
+    struct aws_allocator *allocator,
+    const struct aws_string *secret_access_key,
+    const struct aws_date_time *date,
+    const struct aws_byte_cursor *region,
+    const struct aws_byte_cursor *service,
+    struct aws_byte_buf *dest) {
+
     /* dest should be empty */
     AWS_ASSERT(dest->len == 0);
 
-    const struct aws_signing_config_aws *config = &state->config;
-    struct aws_allocator *allocator = state->allocator;
-
     int result = AWS_OP_ERR;
 
     struct aws_byte_buf secret_key;
@@ -1587,8 +1903,7 @@ static int s_compute_sigv4_signing_key(struct aws_signing_state_aws *state, stru
     struct aws_byte_buf date_buf;
     AWS_ZERO_STRUCT(date_buf);
 
-    if (aws_byte_buf_init(
-            &secret_key, allocator, s_secret_key_prefix->len + state->credentials->secret_access_key->len) ||
+    if (aws_byte_buf_init(&secret_key, allocator, s_secret_key_prefix->len + secret_access_key->len) ||
         aws_byte_buf_init(&output, allocator, AWS_SHA256_LEN) ||
         aws_byte_buf_init(&date_buf, allocator, AWS_DATE_TIME_STR_MAX_LEN)) {
         goto cleanup;
@@ -1598,7 +1913,7 @@ static int s_compute_sigv4_signing_key(struct aws_signing_state_aws *state, stru
      * Prep Key
      */
     struct aws_byte_cursor prefix_cursor = aws_byte_cursor_from_string(s_secret_key_prefix);
-    struct aws_byte_cursor key_cursor = aws_byte_cursor_from_string(state->credentials->secret_access_key);
+    struct aws_byte_cursor key_cursor = aws_byte_cursor_from_string(secret_access_key);
     if (aws_byte_buf_append_dynamic(&secret_key, &prefix_cursor) ||
         aws_byte_buf_append_dynamic(&secret_key, &key_cursor)) {
         goto cleanup;
@@ -1607,7 +1922,7 @@ static int s_compute_sigv4_signing_key(struct aws_signing_state_aws *state, stru
     /*
      * Prep date
      */
-    if (aws_date_time_to_utc_time_short_str(&config->date, AWS_DATE_FORMAT_ISO_8601_BASIC, &date_buf)) {
+    if (aws_date_time_to_utc_time_short_str(date, AWS_DATE_FORMAT_ISO_8601_BASIC, &date_buf)) {
         goto cleanup;
     }
 
@@ -1619,13 +1934,13 @@ static int s_compute_sigv4_signing_key(struct aws_signing_state_aws *state, stru
 
     struct aws_byte_cursor chained_key_cursor = aws_byte_cursor_from_buf(&output);
     output.len = 0; /* necessary evil part 1*/
-    if (aws_sha256_hmac_compute(allocator, &chained_key_cursor, &config->region, &output, 0)) {
+    if (aws_sha256_hmac_compute(allocator, &chained_key_cursor, region, &output, 0)) {
         goto cleanup;
     }
 
     chained_key_cursor = aws_byte_cursor_from_buf(&output);
     output.len = 0; /* necessary evil part 2 */
-    if (aws_sha256_hmac_compute(allocator, &chained_key_cursor, &config->service, &output, 0)) {
+    if (aws_sha256_hmac_compute(allocator, &chained_key_cursor, service, &output, 0)) {
         goto cleanup;
     }
 
@@ -1645,6 +1960,29 @@ cleanup:
     return result;
 }
 
+static int s_compute_sigv4_signing_key(struct aws_signing_state_aws *state, struct aws_byte_buf *dest) {
+    const struct aws_signing_config_aws *config = &state->config;
+
+    if (config->signing_key_cache != NULL) {
+        return aws_signing_key_cache_get_sigv4_key(
+            config->signing_key_cache,
+            state->credentials->access_key_id,
+            state->credentials->secret_access_key,
+            &config->date,
+            &config->region,
+            &config->service,
+            dest);
+    }
+
+    return aws_signing_derive_sigv4_signing_key(
+        state->allocator,
+        state->credentials->secret_access_key,
+        &config->date,
+        &config->region,
+        &config->service,
+        dest);
+}
+
 /*
  * Appends a hex-encoding of the final signature value from the sigv4 signing process to a buffer
  */
@@ -1835,17 +2173,9 @@ int aws_signing_build_authorization_value(struct aws_signing_state_aws *state) {
         if (s_is_query_param_auth(state->config.algorithm)) {
             property_list_name = g_aws_http_query_params_property_list_name;
 
-            if (aws_byte_buf_init(&uri_encoded_buf, state->allocator, session_token.len)) {
+            if (s_get_uri_encoded_session_token(state, &uri_encoded_buf, &session_token)) {
                 goto cleanup;
             }
-
-            /* uri encode it */
-            if (aws_byte_buf_append_encoding_uri_param(&uri_encoded_buf, &session_token)) {
-                aws_byte_buf_clean_up(&uri_encoded_buf);
-                goto cleanup;
-            }
-
-            session_token = aws_byte_cursor_from_buf(&uri_encoded_buf);
         }
 
         if (aws_signing_result_append_property_list(
@@ -1854,13 +2184,24 @@ int aws_signing_build_authorization_value(struct aws_signing_state_aws *state) {
         }
     }
 
-    AWS_LOGF_INFO(
+    /*
+     * Both the header and query param forms of the authorization value end with the hex-encoded signature.  Retain
+     * it and its inputs in this thread's recent-request ring rather than logging them, so that a later signature
+     * failure can still be diagnosed.
+     */
+    struct aws_byte_cursor canonical_request_cursor = aws_byte_cursor_from_buf(&state->canonical_request);
+    struct aws_byte_cursor string_to_sign_cursor = aws_byte_cursor_from_buf(&state->string_to_sign);
+    struct aws_byte_cursor signature_cursor = aws_byte_cursor_from_buf(&authorization_value);
+    if (signature_cursor.len >= AWS_SHA256_LEN * 2) {
+        aws_byte_cursor_advance(&signature_cursor, signature_cursor.len - AWS_SHA256_LEN * 2);
+    }
+    aws_signing_ring_record(&canonical_request_cursor, &string_to_sign_cursor, &signature_cursor);
+
+    AWS_LOGF_DEBUG(
         AWS_LS_AUTH_SIGNING,
-        "(id=%p) Http request successfully built final authorization value via algorithm %s, with contents \"" PRInSTR
-        "\"",
+        "(id=%p) Http request successfully built final authorization value via algorithm %s",
         (void *)state->signable,
-        aws_signing_algorithm_to_string(state->config.algorithm),
-        AWS_BYTE_BUF_PRI(authorization_value));
+        aws_signing_algorithm_to_string(state->config.algorithm));
 
     result = AWS_OP_SUCCESS;
 
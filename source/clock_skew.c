@@ -0,0 +1,290 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/clock_skew.h>
+
+#include <aws/common/clock.h>
+#include <aws/common/hash_table.h>
+#include <aws/common/mutex.h>
+#include <aws/common/string.h>
+
+#include <inttypes.h>
+
+#define SKEW_TABLE_DEFAULT_SIZE 8
+#define DEFAULT_MIN_SKEW_MS 3000
+
+struct clock_skew_entry {
+    struct aws_allocator *allocator;
+    struct aws_string *endpoint;
+
+    /* the table key; points into endpoint */
+    struct aws_byte_cursor key;
+
+    /* the most recent observed offsets, oldest overwritten first */
+    int64_t samples_ms[AWS_CLOCK_SKEW_SAMPLE_COUNT];
+    size_t sample_count;
+    size_t next_sample;
+
+    /* the offset applied to signing dates */
+    int64_t offset_ms;
+};
+
+struct aws_clock_skew_tracker {
+    struct aws_allocator *allocator;
+    aws_io_clock_fn *clock_fn;
+    int64_t min_skew_ms;
+
+    struct aws_mutex lock;
+
+    /* struct aws_byte_cursor * -> struct clock_skew_entry *, protected by lock */
+    struct aws_hash_table entries;
+};
+
+static void s_clock_skew_entry_destroy(void *value) {
+    struct clock_skew_entry *entry = value;
+
+    aws_string_destroy(entry->endpoint);
+    aws_mem_release(entry->allocator, entry);
+}
+
+struct aws_clock_skew_tracker *aws_clock_skew_tracker_new(
+    struct aws_allocator *allocator,
+    const struct aws_clock_skew_tracker_options *options) {
+
+    struct aws_clock_skew_tracker *tracker = aws_mem_acquire(allocator, sizeof(struct aws_clock_skew_tracker));
+    if (tracker == NULL) {
+        return NULL;
+    }
+
+    AWS_ZERO_STRUCT(*tracker);
+    tracker->allocator = allocator;
+    tracker->clock_fn = aws_sys_clock_get_ticks;
+    if (options != NULL && options->clock_fn != NULL) {
+        tracker->clock_fn = options->clock_fn;
+    }
+
+    tracker->min_skew_ms = DEFAULT_MIN_SKEW_MS;
+    if (options != NULL && options->min_skew_ms != 0) {
+        tracker->min_skew_ms = (int64_t)options->min_skew_ms;
+    }
+
+    if (aws_mutex_init(&tracker->lock)) {
+        goto on_error;
+    }
+
+    if (aws_hash_table_init(
+            &tracker->entries,
+            allocator,
+            SKEW_TABLE_DEFAULT_SIZE,
+            aws_hash_byte_cursor_ptr_ignore_case,
+            (aws_hash_callback_eq_fn *)aws_byte_cursor_eq_ignore_case,
+            NULL, /* The key is owned by the value (and destroy cleans it up), so we don't have to */
+            s_clock_skew_entry_destroy)) {
+        goto on_error;
+    }
+
+    return tracker;
+
+on_error:
+
+    aws_mutex_clean_up(&tracker->lock);
+    aws_mem_release(allocator, tracker);
+
+    return NULL;
+}
+
+void aws_clock_skew_tracker_destroy(struct aws_clock_skew_tracker *tracker) {
+    if (tracker == NULL) {
+        return;
+    }
+
+    aws_hash_table_clean_up(&tracker->entries);
+    aws_mutex_clean_up(&tracker->lock);
+
+    aws_mem_release(tracker->allocator, tracker);
+}
+
+static int s_get_local_time_ms(struct aws_clock_skew_tracker *tracker, int64_t *out_time_ms) {
+    uint64_t now_ns = 0;
+    if (tracker->clock_fn(&now_ns)) {
+        return AWS_OP_ERR;
+    }
+
+    *out_time_ms = (int64_t)aws_timestamp_convert(now_ns, AWS_TIMESTAMP_NANOS, AWS_TIMESTAMP_MILLIS, NULL);
+
+    return AWS_OP_SUCCESS;
+}
+
+/*
+ * Network and server delays only ever make a Date header look older than it is, so of the recent samples the
+ * largest one is the closest to the true offset.  Offsets smaller than the minimum skew are within the Date header's
+ * resolution plus ordinary latency, and aren't applied.
+ */
+static void s_add_sample(struct aws_clock_skew_tracker *tracker, struct clock_skew_entry *entry, int64_t sample_ms) {
+    entry->samples_ms[entry->next_sample] = sample_ms;
+    entry->next_sample = (entry->next_sample + 1) % AWS_CLOCK_SKEW_SAMPLE_COUNT;
+    if (entry->sample_count < AWS_CLOCK_SKEW_SAMPLE_COUNT) {
+        ++entry->sample_count;
+    }
+
+    int64_t estimate_ms = entry->samples_ms[0];
+    for (size_t i = 1; i < entry->sample_count; ++i) {
+        if (entry->samples_ms[i] > estimate_ms) {
+            estimate_ms = entry->samples_ms[i];
+        }
+    }
+
+    int64_t magnitude_ms = estimate_ms < 0 ? -estimate_ms : estimate_ms;
+    entry->offset_ms = magnitude_ms >= tracker->min_skew_ms ? estimate_ms : 0;
+}
+
+static int s_record_offset(
+    struct aws_clock_skew_tracker *tracker,
+    struct aws_byte_cursor endpoint,
+    int64_t sample_ms,
+    int64_t *out_offset_ms) {
+
+    int result = AWS_OP_ERR;
+
+    aws_mutex_lock(&tracker->lock);
+
+    struct aws_hash_element *element = NULL;
+    if (aws_hash_table_find(&tracker->entries, &endpoint, &element)) {
+        goto done;
+    }
+
+    if (element != NULL) {
+        struct clock_skew_entry *entry = element->value;
+        s_add_sample(tracker, entry, sample_ms);
+        *out_offset_ms = entry->offset_ms;
+        result = AWS_OP_SUCCESS;
+        goto done;
+    }
+
+    struct clock_skew_entry *entry = aws_mem_acquire(tracker->allocator, sizeof(struct clock_skew_entry));
+    if (entry == NULL) {
+        goto done;
+    }
+
+    AWS_ZERO_STRUCT(*entry);
+    entry->allocator = tracker->allocator;
+    s_add_sample(tracker, entry, sample_ms);
+    *out_offset_ms = entry->offset_ms;
+    entry->endpoint = aws_string_new_from_array(tracker->allocator, endpoint.ptr, endpoint.len);
+    if (entry->endpoint == NULL) {
+        aws_mem_release(tracker->allocator, entry);
+        goto done;
+    }
+
+    entry->key = aws_byte_cursor_from_string(entry->endpoint);
+
+    if (aws_hash_table_put(&tracker->entries, &entry->key, entry, NULL)) {
+        s_clock_skew_entry_destroy(entry);
+        goto done;
+    }
+
+    result = AWS_OP_SUCCESS;
+
+done:
+
+    aws_mutex_unlock(&tracker->lock);
+
+    return result;
+}
+
+int aws_clock_skew_tracker_record_server_time(
+    struct aws_clock_skew_tracker *tracker,
+    struct aws_byte_cursor endpoint,
+    const struct aws_date_time *server_time) {
+
+    int64_t local_time_ms = 0;
+    if (s_get_local_time_ms(tracker, &local_time_ms)) {
+        return AWS_OP_ERR;
+    }
+
+    int64_t sample_ms = (int64_t)aws_date_time_as_millis(server_time) - local_time_ms;
+    int64_t offset_ms = 0;
+
+    if (s_record_offset(tracker, endpoint, sample_ms, &offset_ms)) {
+        return AWS_OP_ERR;
+    }
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_AUTH_SIGNING,
+        "(id=%p) Observed a clock skew of %" PRId64 "ms for endpoint \"" PRInSTR "\", applied skew is now %" PRId64
+        "ms",
+        (void *)tracker,
+        sample_ms,
+        AWS_BYTE_CURSOR_PRI(endpoint),
+        offset_ms);
+
+    return AWS_OP_SUCCESS;
+}
+
+int aws_clock_skew_tracker_record_date_header(
+    struct aws_clock_skew_tracker *tracker,
+    struct aws_byte_cursor endpoint,
+    struct aws_byte_cursor date_header_value) {
+
+    struct aws_byte_buf date_buf = aws_byte_buf_from_array(date_header_value.ptr, date_header_value.len);
+
+    struct aws_date_time server_time;
+    if (aws_date_time_init_from_str(&server_time, &date_buf, AWS_DATE_FORMAT_RFC822)) {
+        AWS_LOGF_WARN(
+            AWS_LS_AUTH_SIGNING,
+            "(id=%p) Unable to parse Date header \"" PRInSTR "\" for clock skew correction",
+            (void *)tracker,
+            AWS_BYTE_CURSOR_PRI(date_header_value));
+        return AWS_OP_ERR;
+    }
+
+    return aws_clock_skew_tracker_record_server_time(tracker, endpoint, &server_time);
+}
+
+int64_t aws_clock_skew_tracker_get_offset_ms(struct aws_clock_skew_tracker *tracker, struct aws_byte_cursor endpoint) {
+    int64_t offset_ms = 0;
+
+    aws_mutex_lock(&tracker->lock);
+
+    struct aws_hash_element *element = NULL;
+    aws_hash_table_find(&tracker->entries, &endpoint, &element);
+    if (element != NULL) {
+        offset_ms = ((struct clock_skew_entry *)element->value)->offset_ms;
+    }
+
+    aws_mutex_unlock(&tracker->lock);
+
+    return offset_ms;
+}
+
+int aws_clock_skew_tracker_now(
+    struct aws_clock_skew_tracker *tracker,
+    struct aws_byte_cursor endpoint,
+    struct aws_date_time *out_date) {
+
+    int64_t local_time_ms = 0;
+    if (s_get_local_time_ms(tracker, &local_time_ms)) {
+        return AWS_OP_ERR;
+    }
+
+    int64_t corrected_time_ms = local_time_ms + aws_clock_skew_tracker_get_offset_ms(tracker, endpoint);
+    if (corrected_time_ms < 0) {
+        corrected_time_ms = 0;
+    }
+
+    aws_date_time_init_epoch_millis(out_date, (uint64_t)corrected_time_ms);
+
+    return AWS_OP_SUCCESS;
+}
@@ -17,6 +17,7 @@
 
 #include <aws/common/clock.h>
 #include <aws/common/string.h>
+#include <aws/io/uri.h>
 
 #define DEFAULT_CREDENTIAL_PROVIDER_REFRESH_MS (15 * 60 * 1000)
 
@@ -59,20 +60,37 @@ struct aws_credentials *aws_credentials_new(
         session_token != NULL ? &session_token_cursor : NULL);
 }
 
-struct aws_credentials *aws_credentials_new_copy(struct aws_allocator *allocator, struct aws_credentials *credentials) {
-    if (credentials != NULL) {
-        return aws_credentials_new(
-            allocator, credentials->access_key_id, credentials->secret_access_key, credentials->session_token);
+static struct aws_string *s_uri_encode_session_token(
+    struct aws_allocator *allocator,
+    const struct aws_string *session_token) {
+
+    struct aws_byte_cursor session_token_cursor = aws_byte_cursor_from_string(session_token);
+
+    struct aws_byte_buf uri_encoded_buf;
+    if (aws_byte_buf_init(&uri_encoded_buf, allocator, session_token_cursor.len)) {
+        return NULL;
     }
 
-    return NULL;
+    struct aws_string *uri_encoded_session_token = NULL;
+    if (aws_byte_buf_append_encoding_uri_param(&uri_encoded_buf, &session_token_cursor) == AWS_OP_SUCCESS) {
+        uri_encoded_session_token = aws_string_new_from_array(allocator, uri_encoded_buf.buffer, uri_encoded_buf.len);
+    }
+
+    aws_byte_buf_clean_up(&uri_encoded_buf);
+
+    return uri_encoded_session_token;
 }
 
-struct aws_credentials *aws_credentials_new_from_cursors(
+/*
+ * Common constructor.  If the caller already has the uri-encoded session token (a copy, for instance), it is
+ * duplicated rather than re-encoded.
+ */
+static struct aws_credentials *s_credentials_new(
     struct aws_allocator *allocator,
     const struct aws_byte_cursor *access_key_id_cursor,
     const struct aws_byte_cursor *secret_access_key_cursor,
-    const struct aws_byte_cursor *session_token_cursor) {
+    const struct aws_byte_cursor *session_token_cursor,
+    const struct aws_string *uri_encoded_session_token) {
 
     struct aws_credentials *credentials = aws_mem_acquire(allocator, sizeof(struct aws_credentials));
     if (credentials == NULL) {
@@ -105,6 +123,16 @@ struct aws_credentials *aws_credentials_new_from_cursors(
         if (credentials->session_token == NULL) {
             goto error;
         }
+
+        if (uri_encoded_session_token != NULL) {
+            credentials->uri_encoded_session_token = aws_string_new_from_string(allocator, uri_encoded_session_token);
+        } else {
+            credentials->uri_encoded_session_token = s_uri_encode_session_token(allocator, credentials->session_token);
+        }
+
+        if (credentials->uri_encoded_session_token == NULL) {
+            goto error;
+        }
     }
 
     return credentials;
@@ -116,6 +144,46 @@ error:
     return NULL;
 }
 
+struct aws_credentials *aws_credentials_new_from_cursors(
+    struct aws_allocator *allocator,
+    const struct aws_byte_cursor *access_key_id_cursor,
+    const struct aws_byte_cursor *secret_access_key_cursor,
+    const struct aws_byte_cursor *session_token_cursor) {
+
+    return s_credentials_new(allocator, access_key_id_cursor, secret_access_key_cursor, session_token_cursor, NULL);
+}
+
+struct aws_credentials *aws_credentials_new_copy(struct aws_allocator *allocator, struct aws_credentials *credentials) {
+    if (credentials == NULL) {
+        return NULL;
+    }
+
+    struct aws_byte_cursor access_key_id_cursor;
+    AWS_ZERO_STRUCT(access_key_id_cursor);
+    if (credentials->access_key_id) {
+        access_key_id_cursor = aws_byte_cursor_from_string(credentials->access_key_id);
+    }
+
+    struct aws_byte_cursor secret_access_key_cursor;
+    AWS_ZERO_STRUCT(secret_access_key_cursor);
+    if (credentials->secret_access_key) {
+        secret_access_key_cursor = aws_byte_cursor_from_string(credentials->secret_access_key);
+    }
+
+    struct aws_byte_cursor session_token_cursor;
+    AWS_ZERO_STRUCT(session_token_cursor);
+    if (credentials->session_token) {
+        session_token_cursor = aws_byte_cursor_from_string(credentials->session_token);
+    }
+
+    return s_credentials_new(
+        allocator,
+        credentials->access_key_id != NULL ? &access_key_id_cursor : NULL,
+        credentials->secret_access_key != NULL ? &secret_access_key_cursor : NULL,
+        credentials->session_token != NULL ? &session_token_cursor : NULL,
+        credentials->uri_encoded_session_token);
+}
+
 void aws_credentials_destroy(struct aws_credentials *credentials) {
     if (credentials == NULL) {
         return;
@@ -133,6 +201,10 @@ void aws_credentials_destroy(struct aws_credentials *credentials) {
         aws_string_destroy(credentials->session_token);
     }
 
+    if (credentials->uri_encoded_session_token != NULL) {
+        aws_string_destroy(credentials->uri_encoded_session_token);
+    }
+
     aws_mem_release(credentials->allocator, credentials);
 }
 
@@ -202,6 +274,17 @@ struct aws_credentials_provider *aws_credentials_provider_new_sts_cached(
     return cached_provider;
 }
 
+static struct aws_credentials_provider *s_new_default_imds_provider(
+    struct aws_allocator *allocator,
+    void *factory_user_data) {
+
+    struct aws_credentials_provider_imds_options imds_options;
+    AWS_ZERO_STRUCT(imds_options);
+    imds_options.bootstrap = factory_user_data;
+
+    return aws_credentials_provider_new_imds(allocator, &imds_options);
+}
+
 /*
  * Default provider chain implementation
  */
@@ -238,15 +321,18 @@ struct aws_credentials_provider *aws_credentials_provider_new_chain_default(
         providers[index++] = profile_provider;
     }
 
-    struct aws_credentials_provider_imds_options imds_options;
+    /* most processes get credentials from the environment or a profile, so don't set up imds until it's needed */
+    struct aws_credentials_provider_lazy_options imds_options;
     AWS_ZERO_STRUCT(imds_options);
-    imds_options.bootstrap = options->bootstrap;
-    imds_provider = aws_credentials_provider_new_imds(allocator, &imds_options);
+    imds_options.factory = s_new_default_imds_provider;
+    imds_options.factory_user_data = options->bootstrap;
+    imds_provider = aws_credentials_provider_new_lazy(allocator, &imds_options);
     if (imds_provider == NULL) {
         goto on_error;
     }
 
-    providers[index] = imds_provider;
+    providers[index++] = imds_provider;
+
     struct aws_credentials_provider_chain_options chain_options;
     AWS_ZERO_STRUCT(chain_options);
     chain_options.provider_count = index;
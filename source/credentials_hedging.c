@@ -0,0 +1,374 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/private/credentials_hedging.h>
+
+#include <aws/auth/private/credentials_utils.h>
+#include <aws/common/clock.h>
+#include <aws/common/task_scheduler.h>
+#include <aws/io/event_loop.h>
+
+/* used until there are enough samples for a meaningful percentile */
+#define HEDGING_INITIAL_DELAY_MS 1000
+#define HEDGING_MIN_SAMPLE_COUNT 8
+
+/* one hedge, in budget units */
+#define HEDGING_BUDGET_HEDGE_COST 100
+
+/* the budget never banks more than a single hedge, so bursts can't exceed twice the request rate either */
+#define HEDGING_BUDGET_MAX HEDGING_BUDGET_HEDGE_COST
+
+/* the original fetch plus at most one hedge */
+#define HEDGED_REQUEST_MAX_ATTEMPTS 2
+
+struct aws_credentials_hedged_attempt {
+    struct aws_credentials_hedged_request *request;
+
+    /* protected by the request's lock */
+    struct aws_http_connection *connection;
+    bool is_active;
+};
+
+struct aws_credentials_hedged_request {
+    struct aws_allocator *allocator;
+    struct aws_credentials_hedging *hedging;
+    struct aws_credentials_provider *provider;
+    aws_on_get_credentials_callback_fn *callback;
+    void *user_data;
+
+    uint64_t start_ns;
+    struct aws_task hedge_task;
+
+    struct aws_mutex lock;
+
+    /* protected by lock */
+    size_t ref_count;
+    bool is_complete;
+    size_t attempt_count;
+    struct aws_credentials_hedged_attempt attempts[HEDGED_REQUEST_MAX_ATTEMPTS];
+};
+
+int aws_credentials_hedging_init(
+    struct aws_credentials_hedging *hedging,
+    struct aws_allocator *allocator,
+    const struct aws_credentials_provider_hedging_options *options,
+    struct aws_event_loop_group *event_loop_group,
+    struct aws_credentials_provider_system_vtable *function_table,
+    aws_credentials_hedged_attempt_start_fn *start_attempt) {
+
+    AWS_ZERO_STRUCT(*hedging);
+
+    if (options == NULL || options->latency_percentile == 0) {
+        return AWS_OP_SUCCESS;
+    }
+
+    if (options->latency_percentile > 99 || options->max_hedges_per_100_requests > 100 || event_loop_group == NULL) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    if (aws_mutex_init(&hedging->lock)) {
+        return AWS_OP_ERR;
+    }
+
+    hedging->allocator = allocator;
+    hedging->event_loop_group = event_loop_group;
+    hedging->function_table = function_table;
+    hedging->start_attempt = start_attempt;
+    hedging->latency_percentile = options->latency_percentile;
+    hedging->min_delay_ns =
+        aws_timestamp_convert(options->min_delay_ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+    hedging->max_hedges_per_100_requests = options->max_hedges_per_100_requests;
+    if (hedging->max_hedges_per_100_requests == 0) {
+        hedging->max_hedges_per_100_requests = 100;
+    }
+
+    /* start with a full budget; a provider may only fetch a handful of times over its whole life */
+    hedging->budget = HEDGING_BUDGET_MAX;
+
+    return AWS_OP_SUCCESS;
+}
+
+void aws_credentials_hedging_clean_up(struct aws_credentials_hedging *hedging) {
+    if (!aws_credentials_hedging_is_enabled(hedging)) {
+        return;
+    }
+
+    aws_mutex_clean_up(&hedging->lock);
+    AWS_ZERO_STRUCT(*hedging);
+}
+
+bool aws_credentials_hedging_is_enabled(const struct aws_credentials_hedging *hedging) {
+    return hedging->allocator != NULL;
+}
+
+uint64_t aws_credentials_hedging_get_delay_ns(struct aws_credentials_hedging *hedging) {
+    uint64_t sorted_samples[AWS_CREDENTIALS_HEDGING_SAMPLE_COUNT];
+
+    aws_mutex_lock(&hedging->lock);
+    size_t sample_count = hedging->latency_sample_count;
+    for (size_t i = 0; i < sample_count; ++i) {
+        sorted_samples[i] = hedging->latency_samples_ns[i];
+    }
+    aws_mutex_unlock(&hedging->lock);
+
+    uint64_t delay_ns =
+        aws_timestamp_convert(HEDGING_INITIAL_DELAY_MS, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+
+    if (sample_count >= HEDGING_MIN_SAMPLE_COUNT) {
+        /* insertion sort, there are only a few dozen samples */
+        for (size_t i = 1; i < sample_count; ++i) {
+            uint64_t sample = sorted_samples[i];
+            size_t j = i;
+            for (; j > 0 && sorted_samples[j - 1] > sample; --j) {
+                sorted_samples[j] = sorted_samples[j - 1];
+            }
+            sorted_samples[j] = sample;
+        }
+
+        delay_ns = sorted_samples[sample_count * hedging->latency_percentile / 100];
+    }
+
+    if (delay_ns < hedging->min_delay_ns) {
+        delay_ns = hedging->min_delay_ns;
+    }
+
+    return delay_ns;
+}
+
+void aws_credentials_hedging_record_latency(struct aws_credentials_hedging *hedging, uint64_t latency_ns) {
+    aws_mutex_lock(&hedging->lock);
+
+    hedging->latency_samples_ns[hedging->next_latency_sample] = latency_ns;
+    hedging->next_latency_sample = (hedging->next_latency_sample + 1) % AWS_CREDENTIALS_HEDGING_SAMPLE_COUNT;
+    if (hedging->latency_sample_count < AWS_CREDENTIALS_HEDGING_SAMPLE_COUNT) {
+        ++hedging->latency_sample_count;
+    }
+
+    aws_mutex_unlock(&hedging->lock);
+}
+
+void aws_credentials_hedging_on_request(struct aws_credentials_hedging *hedging) {
+    aws_mutex_lock(&hedging->lock);
+
+    hedging->budget += hedging->max_hedges_per_100_requests;
+    if (hedging->budget > HEDGING_BUDGET_MAX) {
+        hedging->budget = HEDGING_BUDGET_MAX;
+    }
+
+    aws_mutex_unlock(&hedging->lock);
+}
+
+bool aws_credentials_hedging_try_acquire_hedge(struct aws_credentials_hedging *hedging) {
+    bool acquired = false;
+
+    aws_mutex_lock(&hedging->lock);
+
+    if (hedging->budget >= HEDGING_BUDGET_HEDGE_COST) {
+        hedging->budget -= HEDGING_BUDGET_HEDGE_COST;
+        acquired = true;
+    }
+
+    aws_mutex_unlock(&hedging->lock);
+
+    return acquired;
+}
+
+static void s_hedged_request_release(struct aws_credentials_hedged_request *request) {
+    aws_mutex_lock(&request->lock);
+    size_t ref_count = --request->ref_count;
+    aws_mutex_unlock(&request->lock);
+
+    if (ref_count > 0) {
+        return;
+    }
+
+    aws_mutex_clean_up(&request->lock);
+    aws_credentials_provider_release(request->provider);
+    aws_mem_release(request->allocator, request);
+}
+
+static void s_hedge_task_fn(struct aws_task *task, void *arg, enum aws_task_status status) {
+    (void)task;
+
+    struct aws_credentials_hedged_request *request = arg;
+    struct aws_credentials_hedged_attempt *hedge = NULL;
+
+    if (status == AWS_TASK_STATUS_RUN_READY) {
+        aws_mutex_lock(&request->lock);
+
+        if (!request->is_complete && request->attempt_count < HEDGED_REQUEST_MAX_ATTEMPTS &&
+            aws_credentials_hedging_try_acquire_hedge(request->hedging)) {
+            hedge = &request->attempts[request->attempt_count++];
+            hedge->request = request;
+            hedge->is_active = true;
+            ++request->ref_count;
+        }
+
+        aws_mutex_unlock(&request->lock);
+    }
+
+    if (hedge != NULL) {
+        AWS_LOGF_DEBUG(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+            "(id=%p): credentials fetch is taking longer than usual, starting a duplicate fetch",
+            (void *)request->provider);
+
+        request->hedging->start_attempt(request->provider, hedge);
+    }
+
+    /* the scheduled task's reference */
+    s_hedged_request_release(request);
+}
+
+int aws_credentials_hedged_request_start(
+    struct aws_credentials_hedging *hedging,
+    struct aws_credentials_provider *provider,
+    aws_on_get_credentials_callback_fn callback,
+    void *user_data) {
+
+    struct aws_credentials_hedged_request *request =
+        aws_mem_calloc(hedging->allocator, 1, sizeof(struct aws_credentials_hedged_request));
+    if (request == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    if (aws_mutex_init(&request->lock)) {
+        aws_mem_release(hedging->allocator, request);
+        return AWS_OP_ERR;
+    }
+
+    request->allocator = hedging->allocator;
+    request->hedging = hedging;
+    request->provider = provider;
+    request->callback = callback;
+    request->user_data = user_data;
+    aws_high_res_clock_get_ticks(&request->start_ns);
+    aws_credentials_provider_acquire(provider);
+
+    /* one reference for this function, one for the first attempt */
+    request->ref_count = 2;
+    request->attempt_count = 1;
+    request->attempts[0].request = request;
+    request->attempts[0].is_active = true;
+
+    aws_credentials_hedging_on_request(hedging);
+
+    hedging->start_attempt(provider, &request->attempts[0]);
+
+    aws_mutex_lock(&request->lock);
+    bool should_schedule_hedge = !request->is_complete;
+    if (should_schedule_hedge) {
+        ++request->ref_count;
+    }
+    aws_mutex_unlock(&request->lock);
+
+    if (should_schedule_hedge) {
+        struct aws_event_loop *loop = aws_event_loop_group_get_next_loop(hedging->event_loop_group);
+
+        uint64_t now = 0;
+        aws_event_loop_current_clock_time(loop, &now);
+
+        request->hedge_task.fn = s_hedge_task_fn;
+        request->hedge_task.arg = request;
+
+        /*
+         * The task isn't cancelled if the request completes first (that would have to happen on the loop's thread);
+         * it just finds the request complete and drops its reference.
+         */
+        uint64_t delay_ns = aws_credentials_hedging_get_delay_ns(hedging);
+        aws_event_loop_schedule_task_future(loop, &request->hedge_task, now + delay_ns);
+    }
+
+    s_hedged_request_release(request);
+
+    return AWS_OP_SUCCESS;
+}
+
+bool aws_credentials_hedged_attempt_set_connection(
+    struct aws_credentials_hedged_attempt *attempt,
+    struct aws_http_connection *connection) {
+
+    struct aws_credentials_hedged_request *request = attempt->request;
+    bool is_usable = true;
+
+    aws_mutex_lock(&request->lock);
+
+    if (connection != NULL && request->is_complete) {
+        is_usable = false;
+    } else {
+        attempt->connection = connection;
+    }
+
+    aws_mutex_unlock(&request->lock);
+
+    return is_usable;
+}
+
+bool aws_credentials_hedged_attempt_is_cancelled(struct aws_credentials_hedged_attempt *attempt) {
+    struct aws_credentials_hedged_request *request = attempt->request;
+
+    aws_mutex_lock(&request->lock);
+    bool is_cancelled = request->is_complete;
+    aws_mutex_unlock(&request->lock);
+
+    return is_cancelled;
+}
+
+void aws_credentials_hedged_attempt_complete(
+    struct aws_credentials_hedged_attempt *attempt,
+    struct aws_credentials *credentials) {
+
+    struct aws_credentials_hedged_request *request = attempt->request;
+    bool should_invoke_callback = false;
+
+    aws_mutex_lock(&request->lock);
+
+    attempt->is_active = false;
+    attempt->connection = NULL;
+
+    bool has_active_attempt = false;
+    for (size_t i = 0; i < request->attempt_count; ++i) {
+        has_active_attempt = has_active_attempt || request->attempts[i].is_active;
+    }
+
+    if (!request->is_complete && (credentials != NULL || !has_active_attempt)) {
+        request->is_complete = true;
+        should_invoke_callback = true;
+
+        /* the loser can't be stopped mid-request, but closing its connection makes it fail fast */
+        for (size_t i = 0; i < request->attempt_count; ++i) {
+            struct aws_credentials_hedged_attempt *other = &request->attempts[i];
+            if (other->is_active && other->connection != NULL) {
+                request->hedging->function_table->aws_http_connection_close(other->connection);
+            }
+        }
+    }
+
+    aws_mutex_unlock(&request->lock);
+
+    if (should_invoke_callback) {
+        if (credentials != NULL) {
+            uint64_t now = 0;
+            aws_high_res_clock_get_ticks(&now);
+            aws_credentials_hedging_record_latency(
+                request->hedging, now > request->start_ns ? now - request->start_ns : 0);
+        }
+
+        request->callback(credentials, request->user_data);
+    }
+
+    /* the attempt's reference */
+    s_hedged_request_release(request);
+}
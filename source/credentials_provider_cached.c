@@ -15,6 +15,7 @@
 
 #include <aws/auth/credentials.h>
 
+#include <aws/auth/private/auth_probes.h>
 #include <aws/auth/private/credentials_utils.h>
 #include <aws/common/clock.h>
 #include <aws/common/mutex.h>
@@ -62,6 +63,8 @@ static void s_cached_credentials_provider_get_credentials_async_callback(
     struct aws_credentials_provider *provider = user_data;
     struct aws_credentials_provider_cached *impl = provider->impl;
 
+    AWS_AUTH_PROBE_FETCH_DONE(provider, provider, "cached", credentials);
+
     aws_mutex_lock(&impl->lock);
 
     /*
@@ -154,6 +157,9 @@ static int s_cached_credentials_provider_get_credentials_async(
             "(id=%p) Cached credentials provider has expired credentials.  Requerying.",
             (void *)provider);
 
+        /* only one refresh is in flight at a time, so the provider identifies it */
+        AWS_AUTH_PROBE_FETCH_START(provider, provider, "cached");
+
         aws_credentials_provider_get_credentials(
             impl->source, s_cached_credentials_provider_get_credentials_async_callback, provider);
 
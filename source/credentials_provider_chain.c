@@ -15,6 +15,7 @@
 
 #include <aws/auth/credentials.h>
 
+#include <aws/auth/private/auth_probes.h>
 #include <aws/auth/private/credentials_utils.h>
 
 struct aws_credentials_provider_chain_shutdown_callback_record {
@@ -80,6 +81,8 @@ void aws_provider_chain_member_callback(struct aws_credentials *credentials, voi
 
 on_terminate_chain:
 
+    AWS_AUTH_PROBE_FETCH_DONE(provider, wrapped_user_data, "chain", credentials);
+
     wrapped_user_data->original_callback(credentials, wrapped_user_data->original_user_data);
     aws_credentials_provider_release(provider);
     aws_mem_release(wrapped_user_data->allocator, wrapped_user_data);
@@ -118,6 +121,8 @@ static int s_credentials_provider_chain_get_credentials_async(
         "(id=%p) Credentials provider chain get credentials dispatch",
         (void *)provider);
 
+    AWS_AUTH_PROBE_FETCH_START(provider, wrapped_user_data, "chain");
+
     aws_credentials_provider_get_credentials(first_provider, aws_provider_chain_member_callback, wrapped_user_data);
 
     return AWS_OP_SUCCESS;
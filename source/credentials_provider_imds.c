@@ -16,14 +16,13 @@
 #include <aws/auth/credentials.h>
 
 #include <aws/auth/external/cJSON.h>
+#include <aws/auth/imds_client.h>
+#include <aws/auth/private/auth_probes.h>
+#include <aws/auth/private/credentials_hedging.h>
 #include <aws/auth/private/credentials_utils.h>
-#include <aws/common/clock.h>
 #include <aws/common/string.h>
-#include <aws/http/connection.h>
-#include <aws/http/connection_manager.h>
-#include <aws/http/request_response.h>
+#include <aws/io/channel_bootstrap.h>
 #include <aws/io/logging.h>
-#include <aws/io/socket.h>
 
 #if defined(_MSC_VER)
 #    pragma warning(disable : 4204)
@@ -31,29 +30,12 @@
 
 /* instance role credentials body response is currently ~ 1300 characters + name length */
 #define IMDS_RESPONSE_SIZE_INITIAL 2048
-#define IMDS_RESPONSE_SIZE_LIMIT 10000
-#define IMDS_CONNECT_TIMEOUT_DEFAULT_IN_SECONDS 2
 
 struct aws_credentials_provider_imds_impl {
-    struct aws_http_connection_manager *connection_manager;
-    struct aws_credentials_provider_system_vtable *function_table;
+    struct aws_imds_client *client;
+    struct aws_credentials_hedging hedging;
 };
 
-static struct aws_credentials_provider_system_vtable s_default_function_table = {
-    .aws_http_connection_manager_new = aws_http_connection_manager_new,
-    .aws_http_connection_manager_release = aws_http_connection_manager_release,
-    .aws_http_connection_manager_acquire_connection = aws_http_connection_manager_acquire_connection,
-    .aws_http_connection_manager_release_connection = aws_http_connection_manager_release_connection,
-    .aws_http_connection_make_request = aws_http_connection_make_request,
-    .aws_http_stream_get_incoming_response_status = aws_http_stream_get_incoming_response_status,
-    .aws_http_stream_release = aws_http_stream_release,
-    .aws_http_connection_close = aws_http_connection_close};
-
-/*
- * It takes two http requests to get IMDS credentials.  This tracks which request we're on.
- */
-enum aws_imds_query_state { AWS_IMDS_QS_ROLE_NAME, AWS_IMDS_QS_ROLE_CREDENTIALS };
-
 /*
  * Tracking structure for each outstanding async query to an imds provider
  */
@@ -64,12 +46,11 @@ struct aws_credentials_provider_imds_user_data {
     aws_on_get_credentials_callback_fn *original_callback;
     void *original_user_data;
 
+    /* if hedging, the result goes here instead of to the original callback */
+    struct aws_credentials_hedged_attempt *hedged_attempt;
+
     /* mutable */
-    enum aws_imds_query_state query_state;
-    struct aws_http_connection *connection;
-    struct aws_http_message *request;
     struct aws_byte_buf current_result;
-    int status_code;
 };
 
 static void s_aws_credentials_provider_imds_user_data_destroy(
@@ -78,19 +59,8 @@ static void s_aws_credentials_provider_imds_user_data_destroy(
         return;
     }
 
-    struct aws_credentials_provider_imds_impl *impl = user_data->imds_provider->impl;
-
-    if (user_data->connection) {
-        impl->function_table->aws_http_connection_manager_release_connection(
-            impl->connection_manager, user_data->connection);
-    }
-
     aws_byte_buf_clean_up(&user_data->current_result);
 
-    if (user_data->request) {
-        aws_http_message_destroy(user_data->request);
-    }
-
     aws_mem_release(user_data->allocator, user_data);
 }
 
@@ -116,6 +86,8 @@ static struct aws_credentials_provider_imds_user_data *s_aws_credentials_provide
         goto on_error;
     }
 
+    AWS_AUTH_PROBE_FETCH_START(imds_provider, wrapped_user_data, "imds");
+
     return wrapped_user_data;
 
 on_error:
@@ -125,17 +97,6 @@ on_error:
     return NULL;
 }
 
-static void s_aws_credentials_provider_imds_user_data_reset_response(
-    struct aws_credentials_provider_imds_user_data *imds_user_data) {
-    imds_user_data->current_result.len = 0;
-    imds_user_data->status_code = 0;
-
-    if (imds_user_data->request) {
-        aws_http_message_destroy(imds_user_data->request);
-        imds_user_data->request = NULL;
-    }
-}
-
 AWS_STATIC_STRING_FROM_LITERAL(s_empty_empty_string, "\0");
 AWS_STATIC_STRING_FROM_LITERAL(s_access_key_id_name, "AccessKeyId");
 AWS_STATIC_STRING_FROM_LITERAL(s_secret_access_key_name, "SecretAccessKey");
@@ -222,8 +183,15 @@ static void s_imds_finalize_get_credentials_query(struct aws_credentials_provide
     struct aws_credentials *credentials =
         s_parse_credentials_from_imds_document(imds_user_data->allocator, &imds_user_data->current_result);
 
+    AWS_AUTH_PROBE_FETCH_DONE(imds_user_data->imds_provider, imds_user_data, "imds", credentials);
+
     /* pass the credentials back */
-    imds_user_data->original_callback(credentials, imds_user_data->original_user_data);
+    if (imds_user_data->hedged_attempt != NULL) {
+        aws_credentials_hedged_attempt_complete(imds_user_data->hedged_attempt, credentials);
+        imds_user_data->hedged_attempt = NULL;
+    } else {
+        imds_user_data->original_callback(credentials, imds_user_data->original_user_data);
+    }
     if (credentials != NULL) {
         AWS_LOGF_INFO(
             AWS_LS_AUTH_CREDENTIALS_PROVIDER,
@@ -243,192 +211,57 @@ static void s_imds_finalize_get_credentials_query(struct aws_credentials_provide
     aws_credentials_destroy(credentials);
 }
 
-static int s_imds_on_incoming_body_fn(
-    struct aws_http_stream *stream,
-    const struct aws_byte_cursor *data,
-    void *user_data) {
-
-    (void)stream;
-    (void)data;
-
-    struct aws_credentials_provider_imds_user_data *imds_user_data = user_data;
-    struct aws_credentials_provider_imds_impl *impl = imds_user_data->imds_provider->impl;
+AWS_STATIC_STRING_FROM_LITERAL(s_imds_metadata_resource_path, "/latest/meta-data/iam/security-credentials/");
 
-    AWS_LOGF_DEBUG(
-        AWS_LS_AUTH_CREDENTIALS_PROVIDER,
-        "(id=%p) IMDS credentials provider received %zu response bytes",
-        (void *)imds_user_data->imds_provider,
-        data->len);
+/*
+ * Keeps a private copy of a resource; the client's buffer is only valid during its callback and may be shared with
+ * other providers.
+ */
+static int s_imds_copy_resource(
+    struct aws_credentials_provider_imds_user_data *imds_user_data,
+    const struct aws_byte_buf *resource,
+    int error_code) {
 
-    if (data->len + imds_user_data->current_result.len > IMDS_RESPONSE_SIZE_LIMIT) {
-        impl->function_table->aws_http_connection_close(imds_user_data->connection);
-        AWS_LOGF_ERROR(
-            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
-            "(id=%p) IMDS credentials provider query response exceeded maximum allowed length",
-            (void *)imds_user_data->imds_provider);
+    imds_user_data->current_result.len = 0;
 
+    if (resource == NULL || error_code != AWS_ERROR_SUCCESS) {
         return AWS_OP_ERR;
     }
 
-    if (aws_byte_buf_append_dynamic(&imds_user_data->current_result, data)) {
-        impl->function_table->aws_http_connection_close(imds_user_data->connection);
-        AWS_LOGF_ERROR(
-            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
-            "(id=%p) IMDS credentials provider query error appending response",
-            (void *)imds_user_data->imds_provider);
-
+    /* a hedged query that lost the race stops between the two requests */
+    if (imds_user_data->hedged_attempt != NULL &&
+        aws_credentials_hedged_attempt_is_cancelled(imds_user_data->hedged_attempt)) {
         return AWS_OP_ERR;
     }
 
-    return AWS_OP_SUCCESS;
-}
-
-static int s_imds_on_incoming_headers_fn(
-    struct aws_http_stream *stream,
-    enum aws_http_header_block header_block,
-    const struct aws_http_header *header_array,
-    size_t num_headers,
-    void *user_data) {
-
-    (void)header_array;
-    (void)num_headers;
-
-    if (header_block != AWS_HTTP_HEADER_BLOCK_MAIN) {
-        return AWS_OP_SUCCESS;
-    }
-
-    struct aws_credentials_provider_imds_user_data *imds_user_data = user_data;
-    if (header_block == AWS_HTTP_HEADER_BLOCK_MAIN) {
-        if (imds_user_data->status_code == 0) {
-            struct aws_credentials_provider_imds_impl *impl = imds_user_data->imds_provider->impl;
-            if (impl->function_table->aws_http_stream_get_incoming_response_status(
-                    stream, &imds_user_data->status_code)) {
-
-                AWS_LOGF_ERROR(
-                    AWS_LS_AUTH_CREDENTIALS_PROVIDER,
-                    "(id=%p) IMDS credentials provider failed to get http status code",
-                    (void *)imds_user_data->imds_provider);
-
-                return AWS_OP_ERR;
-            }
-            AWS_LOGF_DEBUG(
-                AWS_LS_AUTH_CREDENTIALS_PROVIDER,
-                "(id=%p) IMDS credentials provider query received http status code %d",
-                (void *)imds_user_data->imds_provider,
-                imds_user_data->status_code);
-        }
-    }
-
-    return AWS_OP_SUCCESS;
+    struct aws_byte_cursor resource_cursor = aws_byte_cursor_from_buf(resource);
+    return aws_byte_buf_append_dynamic(&imds_user_data->current_result, &resource_cursor);
 }
 
-static void s_imds_query_instance_role_credentials(struct aws_credentials_provider_imds_user_data *imds_user_data);
-
-static void s_imds_on_stream_complete_fn(struct aws_http_stream *stream, int error_code, void *user_data) {
-    struct aws_credentials_provider_imds_user_data *imds_user_data = user_data;
-
-    aws_http_message_destroy(imds_user_data->request);
-    imds_user_data->request = NULL;
+static int s_imds_get_resource(
+    struct aws_credentials_provider_imds_user_data *imds_user_data,
+    struct aws_byte_cursor resource_path,
+    aws_imds_client_on_get_resource_fn *callback) {
 
     struct aws_credentials_provider_imds_impl *impl = imds_user_data->imds_provider->impl;
-    impl->function_table->aws_http_stream_release(stream);
 
-    /*
-     * On anything other than a 200, nullify the response and pretend there was
-     * an error
-     */
-    if (imds_user_data->status_code != 200) {
-        imds_user_data->current_result.len = 0;
-        error_code = AWS_ERROR_HTTP_UNKNOWN;
+    /* a hedge exists to route around a stalled request, so it mustn't just join that same request */
+    if (imds_user_data->hedged_attempt != NULL) {
+        return aws_imds_client_get_resource_uncoalesced(impl->client, resource_path, callback, imds_user_data);
     }
 
-    if (error_code == AWS_ERROR_SUCCESS && imds_user_data->query_state == AWS_IMDS_QS_ROLE_NAME) {
-        imds_user_data->query_state = AWS_IMDS_QS_ROLE_CREDENTIALS;
-        s_imds_query_instance_role_credentials(imds_user_data);
-    } else {
-        s_imds_finalize_get_credentials_query(imds_user_data);
-    }
+    return aws_imds_client_get_resource(impl->client, resource_path, callback, imds_user_data);
 }
 
-AWS_STATIC_STRING_FROM_LITERAL(s_imds_metadata_resource_path, "/latest/meta-data/iam/security-credentials/");
-AWS_STATIC_STRING_FROM_LITERAL(s_imds_accept_header, "Accept");
-AWS_STATIC_STRING_FROM_LITERAL(s_imds_accept_header_value, "*/*");
-AWS_STATIC_STRING_FROM_LITERAL(s_imds_host, "169.254.169.254");
-AWS_STATIC_STRING_FROM_LITERAL(s_imds_user_agent_header, "User-Agent");
-AWS_STATIC_STRING_FROM_LITERAL(s_imds_user_agent_header_value, "aws-sdk-crt/imds-credentials-provider");
-AWS_STATIC_STRING_FROM_LITERAL(s_imds_h1_0_keep_alive_header, "Connection");
-AWS_STATIC_STRING_FROM_LITERAL(s_imds_h1_0_keep_alive_header_value, "keep-alive");
-
-static int s_make_imds_http_query(
-    struct aws_credentials_provider_imds_user_data *imds_user_data,
-    struct aws_byte_cursor *uri) {
-    AWS_FATAL_ASSERT(imds_user_data->connection);
-
-    struct aws_http_message *request = aws_http_message_new_request(imds_user_data->allocator);
-    if (request == NULL) {
-        return AWS_OP_ERR;
-    }
-
-    struct aws_http_header accept_header = {
-        .name = aws_byte_cursor_from_string(s_imds_accept_header),
-        .value = aws_byte_cursor_from_string(s_imds_accept_header_value),
-    };
-    if (aws_http_message_add_header(request, accept_header)) {
-        goto on_error;
-    }
-
-    struct aws_http_header user_agent_header = {
-        .name = aws_byte_cursor_from_string(s_imds_user_agent_header),
-        .value = aws_byte_cursor_from_string(s_imds_user_agent_header_value),
-    };
-    if (aws_http_message_add_header(request, user_agent_header)) {
-        goto on_error;
-    }
-
-    struct aws_http_header keep_alive_header = {
-        .name = aws_byte_cursor_from_string(s_imds_h1_0_keep_alive_header),
-        .value = aws_byte_cursor_from_string(s_imds_h1_0_keep_alive_header_value),
-    };
-    if (aws_http_message_add_header(request, keep_alive_header)) {
-        goto on_error;
-    }
-
-    if (aws_http_message_set_request_path(request, *uri)) {
-        goto on_error;
-    }
-
-    if (aws_http_message_set_request_method(request, aws_byte_cursor_from_c_str("GET"))) {
-        goto on_error;
-    }
-
-    imds_user_data->request = request;
-
-    struct aws_http_make_request_options request_options = {
-        .self_size = sizeof(request_options),
-        .on_response_headers = s_imds_on_incoming_headers_fn,
-        .on_response_header_block_done = NULL,
-        .on_response_body = s_imds_on_incoming_body_fn,
-        .on_complete = s_imds_on_stream_complete_fn,
-        .user_data = imds_user_data,
-        .request = request,
-    };
-
-    struct aws_credentials_provider_imds_impl *impl = imds_user_data->imds_provider->impl;
-    struct aws_http_stream *stream =
-        impl->function_table->aws_http_connection_make_request(imds_user_data->connection, &request_options);
-
-    return stream == NULL ? AWS_OP_ERR : AWS_OP_SUCCESS;
-
-on_error:
+static void s_imds_on_role_credentials(const struct aws_byte_buf *resource, int error_code, void *user_data) {
+    struct aws_credentials_provider_imds_user_data *imds_user_data = user_data;
 
-    aws_http_message_destroy(request);
+    s_imds_copy_resource(imds_user_data, resource, error_code);
 
-    return AWS_OP_ERR;
+    s_imds_finalize_get_credentials_query(imds_user_data);
 }
 
 static void s_imds_query_instance_role_credentials(struct aws_credentials_provider_imds_user_data *imds_user_data) {
-    AWS_FATAL_ASSERT(imds_user_data->connection);
-
     int result = AWS_OP_ERR;
     struct aws_byte_buf uri;
     AWS_ZERO_STRUCT(uri);
@@ -459,49 +292,65 @@ static void s_imds_query_instance_role_credentials(struct aws_credentials_provid
     }
 
     /* "Clear" the result */
-    s_aws_credentials_provider_imds_user_data_reset_response(imds_user_data);
+    imds_user_data->current_result.len = 0;
 
-    struct aws_byte_cursor uri_cursor = aws_byte_cursor_from_buf(&uri);
-    if (s_make_imds_http_query(imds_user_data, &uri_cursor) == AWS_OP_SUCCESS) {
+    if (s_imds_get_resource(imds_user_data, aws_byte_cursor_from_buf(&uri), s_imds_on_role_credentials) ==
+        AWS_OP_SUCCESS) {
         result = AWS_OP_SUCCESS;
     }
 
 cleanup:
 
     if (result == AWS_OP_ERR) {
+        imds_user_data->current_result.len = 0;
         s_imds_finalize_get_credentials_query(imds_user_data);
     }
 
     aws_byte_buf_clean_up(&uri);
 }
 
-static void s_imds_query_instance_role_name(struct aws_credentials_provider_imds_user_data *imds_user_data) {
-
-    struct aws_byte_cursor uri = aws_byte_cursor_from_string(s_imds_metadata_resource_path);
-    if (s_make_imds_http_query(imds_user_data, &uri)) {
-        s_imds_finalize_get_credentials_query(imds_user_data);
-    }
-}
-
-static void s_imds_on_acquire_connection(struct aws_http_connection *connection, int error_code, void *user_data) {
+static void s_imds_on_role_name(const struct aws_byte_buf *resource, int error_code, void *user_data) {
     struct aws_credentials_provider_imds_user_data *imds_user_data = user_data;
 
-    if (connection == NULL) {
+    if (s_imds_copy_resource(imds_user_data, resource, error_code)) {
         AWS_LOGF_WARN(
             AWS_LS_AUTH_CREDENTIALS_PROVIDER,
-            "id=%p: Instance metadata provider failed to acquire a connection, error code %d(%s)",
+            "id=%p: Instance metadata provider failed to query the instance role name, error code %d(%s)",
             (void *)imds_user_data->imds_provider,
             error_code,
             aws_error_str(error_code));
 
+        imds_user_data->current_result.len = 0;
         s_imds_finalize_get_credentials_query(imds_user_data);
         return;
     }
 
-    imds_user_data->connection = connection;
-    imds_user_data->query_state = AWS_IMDS_QS_ROLE_NAME;
+    s_imds_query_instance_role_credentials(imds_user_data);
+}
 
-    s_imds_query_instance_role_name(imds_user_data);
+static void s_imds_query_instance_role_name(struct aws_credentials_provider_imds_user_data *imds_user_data) {
+    struct aws_byte_cursor uri = aws_byte_cursor_from_string(s_imds_metadata_resource_path);
+    if (s_imds_get_resource(imds_user_data, uri, s_imds_on_role_name)) {
+        s_imds_finalize_get_credentials_query(imds_user_data);
+    }
+}
+
+static void s_imds_start_hedged_attempt(
+    struct aws_credentials_provider *provider,
+    struct aws_credentials_hedged_attempt *attempt) {
+
+    struct aws_credentials_provider_imds_user_data *wrapped_user_data =
+        s_aws_credentials_provider_imds_user_data_new(provider, NULL, NULL);
+    if (wrapped_user_data == NULL) {
+        aws_credentials_hedged_attempt_complete(attempt, NULL);
+        return;
+    }
+
+    wrapped_user_data->hedged_attempt = attempt;
+
+    aws_credentials_provider_acquire(provider);
+
+    s_imds_query_instance_role_name(wrapped_user_data);
 }
 
 static int s_credentials_provider_imds_get_credentials_async(
@@ -511,24 +360,32 @@ static int s_credentials_provider_imds_get_credentials_async(
 
     struct aws_credentials_provider_imds_impl *impl = provider->impl;
 
+    if (aws_credentials_hedging_is_enabled(&impl->hedging)) {
+        return aws_credentials_hedged_request_start(&impl->hedging, provider, callback, user_data);
+    }
+
     struct aws_credentials_provider_imds_user_data *wrapped_user_data =
         s_aws_credentials_provider_imds_user_data_new(provider, callback, user_data);
     if (wrapped_user_data == NULL) {
-        goto error;
+        return AWS_OP_ERR;
     }
 
     aws_credentials_provider_acquire(provider);
 
-    impl->function_table->aws_http_connection_manager_acquire_connection(
-        impl->connection_manager, s_imds_on_acquire_connection, wrapped_user_data);
+    s_imds_query_instance_role_name(wrapped_user_data);
 
     return AWS_OP_SUCCESS;
+}
+
+static void s_on_imds_client_released(void *user_data) {
+    struct aws_credentials_provider *provider = user_data;
+    struct aws_credentials_provider_imds_impl *impl = provider->impl;
 
-error:
+    aws_credentials_hedging_clean_up(&impl->hedging);
 
-    s_aws_credentials_provider_imds_user_data_destroy(wrapped_user_data);
+    aws_credentials_provider_invoke_shutdown_callback(provider);
 
-    return AWS_OP_ERR;
+    aws_mem_release(provider->allocator, provider);
 }
 
 static void s_credentials_provider_imds_destroy(struct aws_credentials_provider *provider) {
@@ -537,9 +394,13 @@ static void s_credentials_provider_imds_destroy(struct aws_credentials_provider
         return;
     }
 
-    impl->function_table->aws_http_connection_manager_release(impl->connection_manager);
+    if (impl->client == NULL) {
+        s_on_imds_client_released(provider);
+        return;
+    }
 
-    /* freeing the provider takes place in the shutdown callback below */
+    /* freeing the provider takes place once the client no longer needs the bootstrap, see above */
+    aws_imds_client_release(impl->client, s_on_imds_client_released, provider);
 }
 
 static struct aws_credentials_provider_vtable s_aws_credentials_provider_imds_vtable = {
@@ -547,14 +408,6 @@ static struct aws_credentials_provider_vtable s_aws_credentials_provider_imds_vt
     .destroy = s_credentials_provider_imds_destroy,
 };
 
-static void s_on_connection_manager_shutdown(void *user_data) {
-    struct aws_credentials_provider *provider = user_data;
-
-    aws_credentials_provider_invoke_shutdown_callback(provider);
-
-    aws_mem_release(provider->allocator, provider);
-}
-
 struct aws_credentials_provider *aws_credentials_provider_new_imds(
     struct aws_allocator *allocator,
     const struct aws_credentials_provider_imds_options *options) {
@@ -579,32 +432,33 @@ struct aws_credentials_provider *aws_credentials_provider_new_imds(
 
     aws_credentials_provider_init_base(provider, allocator, &s_aws_credentials_provider_imds_vtable, impl);
 
-    struct aws_socket_options socket_options;
-    AWS_ZERO_STRUCT(socket_options);
-    socket_options.type = AWS_SOCKET_STREAM;
-    socket_options.domain = AWS_SOCKET_IPV4;
-    socket_options.connect_timeout_ms = (uint32_t)aws_timestamp_convert(
-        IMDS_CONNECT_TIMEOUT_DEFAULT_IN_SECONDS, AWS_TIMESTAMP_SECS, AWS_TIMESTAMP_MILLIS, NULL);
-
-    struct aws_http_connection_manager_options manager_options;
-    AWS_ZERO_STRUCT(manager_options);
-    manager_options.bootstrap = options->bootstrap;
-    manager_options.initial_window_size = IMDS_RESPONSE_SIZE_LIMIT;
-    manager_options.socket_options = &socket_options;
-    manager_options.tls_connection_options = NULL;
-    manager_options.host = aws_byte_cursor_from_string(s_imds_host);
-    manager_options.port = 80;
-    manager_options.max_connections = 2;
-    manager_options.shutdown_complete_callback = s_on_connection_manager_shutdown;
-    manager_options.shutdown_complete_user_data = provider;
-
-    impl->function_table = options->function_table;
-    if (impl->function_table == NULL) {
-        impl->function_table = &s_default_function_table;
-    }
-
-    impl->connection_manager = impl->function_table->aws_http_connection_manager_new(allocator, &manager_options);
-    if (impl->connection_manager == NULL) {
+    if (options->client != NULL) {
+        impl->client = options->client;
+        aws_imds_client_acquire(impl->client);
+    } else {
+        struct aws_imds_client_options client_options;
+        AWS_ZERO_STRUCT(client_options);
+        client_options.bootstrap = options->bootstrap;
+        client_options.function_table = options->function_table;
+
+        if (options->function_table != NULL) {
+            impl->client = aws_imds_client_new(allocator, &client_options);
+        } else {
+            impl->client = aws_imds_client_acquire_shared(allocator, &client_options);
+        }
+    }
+
+    if (impl->client == NULL) {
+        goto on_error;
+    }
+
+    if (aws_credentials_hedging_init(
+            &impl->hedging,
+            allocator,
+            &options->hedging,
+            options->bootstrap != NULL ? options->bootstrap->event_loop_group : NULL,
+            NULL,
+            s_imds_start_hedged_attempt)) {
         goto on_error;
     }
 
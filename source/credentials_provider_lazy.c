@@ -0,0 +1,180 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/credentials.h>
+
+#include <aws/auth/private/credentials_utils.h>
+#include <aws/common/mutex.h>
+
+struct aws_credentials_provider_lazy {
+    aws_credentials_provider_factory_fn *factory;
+    void *factory_user_data;
+
+    struct aws_mutex lock;
+
+    /* created on first use, protected by lock */
+    struct aws_credentials_provider *source;
+    struct aws_credentials_provider_shutdown_options source_shutdown_options;
+};
+
+static void s_on_source_provider_shutdown(void *user_data);
+
+/*
+ * Returns a new reference to the wrapped provider, creating it if this is the first query.
+ */
+static struct aws_credentials_provider *s_acquire_source(struct aws_credentials_provider *provider) {
+    struct aws_credentials_provider_lazy *impl = provider->impl;
+
+    aws_mutex_lock(&impl->lock);
+
+    if (impl->source == NULL) {
+        struct aws_credentials_provider *source = impl->factory(provider->allocator, impl->factory_user_data);
+        if (source != NULL) {
+            AWS_LOGF_DEBUG(
+                AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+                "(id=%p) Lazy credentials provider created its wrapped provider (id=%p)",
+                (void *)provider,
+                (void *)source);
+
+            /*
+             * Save the wrapped provider's shutdown callback and then swap it with our own.
+             */
+            impl->source_shutdown_options = source->shutdown_options;
+            source->shutdown_options.shutdown_callback = s_on_source_provider_shutdown;
+            source->shutdown_options.shutdown_user_data = provider;
+
+            impl->source = source;
+        }
+    }
+
+    struct aws_credentials_provider *source = impl->source;
+    if (source != NULL) {
+        aws_credentials_provider_acquire(source);
+    }
+
+    aws_mutex_unlock(&impl->lock);
+
+    return source;
+}
+
+static int s_lazy_credentials_provider_get_credentials_async(
+    struct aws_credentials_provider *provider,
+    aws_on_get_credentials_callback_fn callback,
+    void *user_data) {
+
+    struct aws_credentials_provider *source = s_acquire_source(provider);
+    if (source == NULL) {
+        AWS_LOGF_WARN(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+            "(id=%p) Lazy credentials provider failed to create its wrapped provider, error %d(%s)",
+            (void *)provider,
+            aws_last_error(),
+            aws_error_str(aws_last_error()));
+
+        /* a chain only moves on to its next member through the callback; creation is retried by the next query */
+        callback(NULL, user_data);
+        return AWS_OP_SUCCESS;
+    }
+
+    int result = aws_credentials_provider_get_credentials(source, callback, user_data);
+
+    aws_credentials_provider_release(source);
+
+    return result;
+}
+
+static void s_lazy_credentials_provider_clean_up(struct aws_credentials_provider *provider) {
+    struct aws_credentials_provider_lazy *impl = provider->impl;
+
+    /* Invoke our own shutdown callback */
+    aws_credentials_provider_invoke_shutdown_callback(provider);
+
+    aws_mutex_clean_up(&impl->lock);
+
+    aws_mem_release(provider->allocator, provider);
+}
+
+static void s_lazy_credentials_provider_destroy(struct aws_credentials_provider *provider) {
+    struct aws_credentials_provider_lazy *impl = provider->impl;
+    if (impl == NULL) {
+        return;
+    }
+
+    /* the last reference is gone, so nothing can be creating the source concurrently */
+    if (impl->source == NULL) {
+        s_lazy_credentials_provider_clean_up(provider);
+        return;
+    }
+
+    aws_credentials_provider_release(impl->source);
+
+    /* Clean up memory, mutex, etc... in the shutdown callback below */
+}
+
+static void s_on_source_provider_shutdown(void *user_data) {
+    struct aws_credentials_provider *provider = user_data;
+    struct aws_credentials_provider_lazy *impl = provider->impl;
+
+    /* The wrapped provider has shut down, invoke its shutdown callback if there was one */
+    if (impl->source_shutdown_options.shutdown_callback != NULL) {
+        impl->source_shutdown_options.shutdown_callback(impl->source_shutdown_options.shutdown_user_data);
+    }
+
+    s_lazy_credentials_provider_clean_up(provider);
+}
+
+static struct aws_credentials_provider_vtable s_aws_credentials_provider_lazy_vtable = {
+    .get_credentials = s_lazy_credentials_provider_get_credentials_async,
+    .destroy = s_lazy_credentials_provider_destroy,
+};
+
+struct aws_credentials_provider *aws_credentials_provider_new_lazy(
+    struct aws_allocator *allocator,
+    const struct aws_credentials_provider_lazy_options *options) {
+
+    AWS_ASSERT(options->factory != NULL);
+
+    struct aws_credentials_provider *provider = NULL;
+    struct aws_credentials_provider_lazy *impl = NULL;
+
+    aws_mem_acquire_many(
+        allocator,
+        2,
+        &provider,
+        sizeof(struct aws_credentials_provider),
+        &impl,
+        sizeof(struct aws_credentials_provider_lazy));
+
+    if (!provider) {
+        return NULL;
+    }
+
+    AWS_ZERO_STRUCT(*provider);
+    AWS_ZERO_STRUCT(*impl);
+
+    aws_credentials_provider_init_base(provider, allocator, &s_aws_credentials_provider_lazy_vtable, impl);
+
+    if (aws_mutex_init(&impl->lock)) {
+        aws_mem_release(allocator, provider);
+        return NULL;
+    }
+
+    impl->factory = options->factory;
+    impl->factory_user_data = options->factory_user_data;
+
+    provider->shutdown_options = options->shutdown_options;
+
+    return provider;
+}
@@ -15,10 +15,15 @@
 
 #include <aws/auth/credentials.h>
 
+#include <aws/auth/private/auth_probes.h>
 #include <aws/auth/private/aws_profile.h>
 #include <aws/auth/private/credentials_utils.h>
+#include <aws/common/condition_variable.h>
+#include <aws/common/linked_list.h>
+#include <aws/common/mutex.h>
 #include <aws/common/process.h>
 #include <aws/common/string.h>
+#include <aws/common/thread.h>
 
 #ifdef _MSC_VER
 /* allow non-constant declared initializers. */
@@ -41,17 +46,27 @@ static struct aws_byte_cursor s_environment_name = AWS_BYTE_CUR_INIT_FROM_STRING
 
 #define MAX_SESSION_NAME_LEN ((size_t)64)
 
+/*
+ * Profile files are read and parsed on a per-provider io thread, started by the first query, so that a query made
+ * from an event loop thread never blocks it on (possibly network mounted) filesystem io.
+ */
 struct aws_credentials_provider_profile_file_impl {
     struct aws_string *config_file_path;
     struct aws_string *credentials_file_path;
     struct aws_string *profile_name;
-};
 
-static int s_profile_file_credentials_provider_get_credentials_async(
-    struct aws_credentials_provider *provider,
-    aws_on_get_credentials_callback_fn callback,
-    void *user_data) {
+    struct aws_thread io_thread;
+    struct aws_mutex lock;
+    struct aws_condition_variable signal;
+
+    /* protected by lock */
+    struct aws_linked_list pending_queries;
+    bool is_io_thread_started;
+    bool should_quit;
+    bool is_destroyed_on_io_thread;
+};
 
+static struct aws_credentials *s_load_profile_credentials(struct aws_credentials_provider *provider) {
     struct aws_credentials_provider_profile_file_impl *impl = provider->impl;
     struct aws_credentials *credentials = NULL;
 
@@ -123,32 +138,165 @@ static int s_profile_file_credentials_provider_get_credentials_async(
             (void *)provider);
     }
 
-    callback(credentials, user_data);
-
     /*
      * clean up
      */
-    aws_credentials_destroy(credentials);
     aws_profile_collection_destroy(merged_profiles);
     aws_profile_collection_destroy(config_profiles);
     aws_profile_collection_destroy(credentials_profiles);
 
-    return AWS_OP_SUCCESS;
+    return credentials;
 }
 
-static void s_profile_file_credentials_provider_destroy(struct aws_credentials_provider *provider) {
+static void s_profile_file_credentials_provider_clean_up(struct aws_credentials_provider *provider) {
     struct aws_credentials_provider_profile_file_impl *impl = provider->impl;
-    if (impl == NULL) {
-        return;
-    }
 
     aws_string_destroy(impl->config_file_path);
     aws_string_destroy(impl->credentials_file_path);
     aws_string_destroy(impl->profile_name);
+    aws_condition_variable_clean_up(&impl->signal);
+    aws_mutex_clean_up(&impl->lock);
 
-    aws_credentials_provider_invoke_shutdown_callback(provider);
+    /* signal shutdown last, the io thread may still be unwinding from here */
+    struct aws_credentials_provider_shutdown_options shutdown_options = provider->shutdown_options;
 
     aws_mem_release(provider->allocator, provider);
+
+    if (shutdown_options.shutdown_callback != NULL) {
+        shutdown_options.shutdown_callback(shutdown_options.shutdown_user_data);
+    }
+}
+
+static bool s_has_io_thread_work(void *user_data) {
+    struct aws_credentials_provider_profile_file_impl *impl = user_data;
+
+    return impl->should_quit || !aws_linked_list_empty(&impl->pending_queries);
+}
+
+static void s_profile_file_io_thread_fn(void *user_data) {
+    struct aws_credentials_provider *provider = user_data;
+    struct aws_credentials_provider_profile_file_impl *impl = provider->impl;
+
+    struct aws_linked_list queries;
+    aws_linked_list_init(&queries);
+
+    aws_mutex_lock(&impl->lock);
+
+    while (true) {
+        aws_condition_variable_wait_pred(&impl->signal, &impl->lock, s_has_io_thread_work, impl);
+        if (aws_linked_list_empty(&impl->pending_queries)) {
+            break;
+        }
+
+        aws_linked_list_swap_contents(&queries, &impl->pending_queries);
+
+        aws_mutex_unlock(&impl->lock);
+
+        /* every query that queued up behind the previous load shares the next one */
+        struct aws_credentials *credentials = s_load_profile_credentials(provider);
+
+        /* the last query's clean up may release the final reference, see destroy below */
+        while (!aws_linked_list_empty(&queries)) {
+            struct aws_linked_list_node *node = aws_linked_list_pop_front(&queries);
+            struct aws_credentials_query *query = AWS_CONTAINER_OF(node, struct aws_credentials_query, node);
+            AWS_AUTH_PROBE_FETCH_DONE(provider, query, "profile", credentials);
+            query->callback(credentials, query->user_data);
+            aws_credentials_query_clean_up(query);
+            aws_mem_release(provider->allocator, query);
+        }
+
+        aws_credentials_destroy(credentials);
+
+        aws_mutex_lock(&impl->lock);
+    }
+
+    bool is_destroyed_on_io_thread = impl->is_destroyed_on_io_thread;
+
+    aws_mutex_unlock(&impl->lock);
+
+    /* nothing can join this thread, so detach it and finish the provider's clean up here */
+    if (is_destroyed_on_io_thread) {
+        aws_thread_clean_up(&impl->io_thread);
+        s_profile_file_credentials_provider_clean_up(provider);
+    }
+}
+
+static int s_profile_file_credentials_provider_get_credentials_async(
+    struct aws_credentials_provider *provider,
+    aws_on_get_credentials_callback_fn callback,
+    void *user_data) {
+
+    struct aws_credentials_provider_profile_file_impl *impl = provider->impl;
+
+    struct aws_credentials_query *query = aws_mem_acquire(provider->allocator, sizeof(struct aws_credentials_query));
+    if (query == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    aws_credentials_query_init(query, provider, callback, user_data);
+
+    int result = AWS_OP_SUCCESS;
+
+    aws_mutex_lock(&impl->lock);
+
+    if (!impl->is_io_thread_started) {
+        struct aws_thread_options thread_options;
+        AWS_ZERO_STRUCT(thread_options);
+
+        if (aws_thread_launch(&impl->io_thread, s_profile_file_io_thread_fn, provider, &thread_options)) {
+            AWS_LOGF_ERROR(
+                AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+                "(id=%p) Profile credentials provider failed to launch its io thread",
+                (void *)provider);
+            result = AWS_OP_ERR;
+        } else {
+            impl->is_io_thread_started = true;
+        }
+    }
+
+    if (result == AWS_OP_SUCCESS) {
+        AWS_AUTH_PROBE_FETCH_START(provider, query, "profile");
+        aws_linked_list_push_back(&impl->pending_queries, &query->node);
+        aws_condition_variable_notify_one(&impl->signal);
+    }
+
+    aws_mutex_unlock(&impl->lock);
+
+    if (result != AWS_OP_SUCCESS) {
+        aws_credentials_query_clean_up(query);
+        aws_mem_release(provider->allocator, query);
+    }
+
+    return result;
+}
+
+static void s_profile_file_credentials_provider_destroy(struct aws_credentials_provider *provider) {
+    struct aws_credentials_provider_profile_file_impl *impl = provider->impl;
+    if (impl == NULL) {
+        return;
+    }
+
+    /* every query holds a reference, so no queries are pending */
+    aws_mutex_lock(&impl->lock);
+    bool is_io_thread_started = impl->is_io_thread_started;
+    bool is_on_io_thread =
+        is_io_thread_started && aws_thread_current_thread_id() == aws_thread_get_id(&impl->io_thread);
+    impl->should_quit = true;
+    impl->is_destroyed_on_io_thread = is_on_io_thread;
+    aws_condition_variable_notify_one(&impl->signal);
+    aws_mutex_unlock(&impl->lock);
+
+    if (is_on_io_thread) {
+        /* the io thread finishes the clean up once it unwinds from the final query */
+        return;
+    }
+
+    if (is_io_thread_started) {
+        aws_thread_join(&impl->io_thread);
+    }
+    aws_thread_clean_up(&impl->io_thread);
+
+    s_profile_file_credentials_provider_clean_up(provider);
 }
 
 static struct aws_credentials_provider_vtable s_aws_credentials_provider_profile_file_vtable = {
@@ -181,12 +329,37 @@ static struct aws_credentials_provider *s_create_profile_based_provider(
     AWS_ZERO_STRUCT(*provider);
     AWS_ZERO_STRUCT(*impl);
 
+    if (aws_mutex_init(&impl->lock)) {
+        goto on_mutex_error;
+    }
+
+    if (aws_condition_variable_init(&impl->signal)) {
+        goto on_signal_error;
+    }
+
+    if (aws_thread_init(&impl->io_thread, allocator)) {
+        goto on_thread_error;
+    }
+
+    aws_linked_list_init(&impl->pending_queries);
+
     aws_credentials_provider_init_base(provider, allocator, &s_aws_credentials_provider_profile_file_vtable, impl);
     impl->credentials_file_path = aws_string_clone_or_reuse(allocator, credentials_file_path);
     impl->config_file_path = aws_string_clone_or_reuse(allocator, config_file_path);
     impl->profile_name = aws_string_clone_or_reuse(allocator, profile_name);
 
     return provider;
+
+on_thread_error:
+    aws_condition_variable_clean_up(&impl->signal);
+
+on_signal_error:
+    aws_mutex_clean_up(&impl->lock);
+
+on_mutex_error:
+    aws_mem_release(allocator, provider);
+
+    return NULL;
 }
 
 /* use the selected property that specifies a role_arn to load an STS based provider. */
@@ -13,16 +13,22 @@
  * permissions and limitations under the License.
  */
 #include <aws/auth/credentials.h>
+#include <aws/auth/clock_skew.h>
+#include <aws/auth/private/auth_probes.h>
+#include <aws/auth/private/credentials_hedging.h>
 #include <aws/auth/private/credentials_utils.h>
 #include <aws/auth/private/xml_parser.h>
 #include <aws/auth/signable.h>
 #include <aws/auth/signing.h>
 #include <aws/auth/signing_config.h>
+#include <aws/common/atomics.h>
+#include <aws/common/clock.h>
 #include <aws/common/mutex.h>
 #include <aws/common/string.h>
 #include <aws/http/connection.h>
 #include <aws/http/connection_manager.h>
 #include <aws/http/request_response.h>
+#include <aws/io/channel_bootstrap.h>
 #include <aws/io/socket.h>
 #include <aws/io/stream.h>
 #include <aws/io/tls_channel_handler.h>
@@ -37,10 +43,7 @@
 #    pragma warning(disable : 4221)
 #endif
 
-static struct aws_http_header s_host_header = {
-    .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("host"),
-    .value = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("sts.amazonaws.com"),
-};
+static struct aws_byte_cursor s_host_header_name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("host");
 
 static struct aws_http_header s_content_type_header = {
     .name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("content-type"),
@@ -53,8 +56,14 @@ static struct aws_http_header s_api_version_header = {
 };
 
 static struct aws_byte_cursor s_content_length = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("content-length");
+static struct aws_byte_cursor s_date_header_name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("date");
 static struct aws_byte_cursor s_path = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("/");
-static struct aws_byte_cursor s_signing_region = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("us-east-1");
+static struct aws_byte_cursor s_global_endpoint_region = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("us-east-1");
+static struct aws_byte_cursor s_global_endpoint_host = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("sts.amazonaws.com");
+static struct aws_byte_cursor s_regional_host_prefix = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("sts.");
+static struct aws_byte_cursor s_regional_host_suffix = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL(".amazonaws.com");
+static struct aws_byte_cursor s_china_region_prefix = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("cn-");
+static struct aws_byte_cursor s_china_host_suffix = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL(".amazonaws.com.cn");
 static struct aws_byte_cursor s_service_name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("sts");
 static struct aws_byte_cursor s_assume_role_root_name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("AssumeRoleResponse");
 static struct aws_byte_cursor s_assume_role_result_name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("AssumeRoleResult");
@@ -65,6 +74,16 @@ static struct aws_byte_cursor s_assume_role_access_key_id_name = AWS_BYTE_CUR_IN
 
 const uint16_t aws_sts_assume_role_default_duration_secs = 900;
 
+/* tried endpoints are tracked per-request in a bit mask */
+#define STS_MAX_ENDPOINTS 32
+
+/* failed endpoints sit out for this long, doubling with each consecutive failure up to the max */
+#define STS_ENDPOINT_QUARANTINE_BASE_SECS 5
+#define STS_ENDPOINT_QUARANTINE_MAX_SECS 300
+
+/* latency samples are folded into a moving average with this weight (as a power of two) */
+#define STS_LATENCY_EWMA_SHIFT 2
+
 static struct aws_credentials_provider_system_vtable s_default_function_table = {
     .aws_http_connection_manager_new = aws_http_connection_manager_new,
     .aws_http_connection_manager_release = aws_http_connection_manager_release,
@@ -76,17 +95,42 @@ static struct aws_credentials_provider_system_vtable s_default_function_table =
     .aws_http_connection_close = aws_http_connection_close,
 };
 
-struct aws_credentials_provider_sts_impl {
+struct sts_endpoint {
+    struct aws_string *region;
+    struct aws_string *host;
+    struct aws_tls_connection_options connection_options;
     struct aws_http_connection_manager *connection_manager;
+
+    /* protected by the provider impl's lock */
+    uint64_t latency_ns; /* moving average, 0 until the first completed request */
+    uint32_t consecutive_failures;
+    uint64_t unhealthy_until_ns;
+};
+
+struct aws_credentials_provider_sts_impl {
     struct aws_string *assume_role_profile;
     struct aws_string *role_session_name;
     uint16_t duration_seconds;
     struct aws_credentials_provider *provider;
     struct aws_tls_ctx *ctx;
-    struct aws_tls_connection_options connection_options;
     struct aws_credentials_provider_shutdown_options source_shutdown_options;
     struct aws_credentials_provider_system_vtable *function_table;
+    struct aws_clock_skew_tracker *clock_skew_tracker;
     bool owns_ctx;
+
+    struct sts_endpoint *endpoints;
+    size_t endpoint_count;
+    bool enable_latency_routing;
+    struct aws_mutex lock;
+
+    struct aws_credentials_hedging hedging;
+};
+
+/* cursors into the AssumeRole response body */
+struct sts_assume_role_response {
+    struct aws_byte_cursor access_key_id;
+    struct aws_byte_cursor secret_access_key;
+    struct aws_byte_cursor session_token;
 };
 
 struct sts_creds_provider_user_data {
@@ -102,41 +146,173 @@ struct sts_creds_provider_user_data {
     struct aws_http_message *message;
     struct aws_byte_buf output_buf;
     void *user_data;
-};
 
-static void s_clean_up_user_data(struct sts_creds_provider_user_data *user_data) {
-    user_data->callback(user_data->credentials, user_data->user_data);
+    /* endpoint of the current attempt, plus every endpoint tried so far (bit i = endpoints[i]) */
+    struct sts_endpoint *endpoint;
+    uint32_t tried_endpoints;
+    uint64_t attempt_start_ns;
 
-    if (user_data->credentials) {
-        aws_credentials_destroy(user_data->credentials);
-    }
+    /*
+     * Each attempt signs and acquires its connection concurrently.  pending_operations counts the two down, and
+     * whichever finishes last sends the request.  Each operation stores its error code (and the connection or the
+     * signed message) before counting down.
+     */
+    struct aws_atomic_var pending_operations;
+    int signing_error_code;
+    int connection_error_code;
+
+    /* if hedging, the result goes here instead of to the callback */
+    struct aws_credentials_hedged_attempt *hedged_attempt;
+};
 
+/* releases everything tied to the current endpoint, so that the request can be retried against another one */
+static void s_clean_up_attempt(struct sts_creds_provider_user_data *user_data) {
     if (user_data->connection) {
+        if (user_data->hedged_attempt != NULL) {
+            aws_credentials_hedged_attempt_set_connection(user_data->hedged_attempt, NULL);
+        }
+
         struct aws_credentials_provider_sts_impl *provider_impl = user_data->provider->impl;
         provider_impl->function_table->aws_http_connection_manager_release_connection(
-            provider_impl->connection_manager, user_data->connection);
+            user_data->endpoint->connection_manager, user_data->connection);
+        user_data->connection = NULL;
     }
 
-    aws_credentials_provider_release(user_data->provider);
-
     if (user_data->signable) {
         aws_signable_destroy(user_data->signable);
+        user_data->signable = NULL;
     }
 
     if (user_data->input_stream) {
         aws_input_stream_destroy(user_data->input_stream);
+        user_data->input_stream = NULL;
     }
 
-    aws_byte_buf_clean_up(&user_data->payload_body);
-
     if (user_data->message) {
         aws_http_message_destroy(user_data->message);
+        user_data->message = NULL;
     }
 
     aws_byte_buf_clean_up(&user_data->output_buf);
+}
+
+static void s_clean_up_user_data(struct sts_creds_provider_user_data *user_data) {
+    AWS_AUTH_PROBE_FETCH_DONE(user_data->provider, user_data, "sts", user_data->credentials);
+
+    if (user_data->hedged_attempt != NULL) {
+        aws_credentials_hedged_attempt_complete(user_data->hedged_attempt, user_data->credentials);
+        user_data->hedged_attempt = NULL;
+    } else {
+        user_data->callback(user_data->credentials, user_data->user_data);
+    }
+
+    if (user_data->credentials) {
+        aws_credentials_destroy(user_data->credentials);
+    }
+
+    s_clean_up_attempt(user_data);
+
+    aws_credentials_provider_release(user_data->provider);
+
+    aws_byte_buf_clean_up(&user_data->payload_body);
+
     aws_mem_release(user_data->allocator, user_data);
 }
 
+/*
+ * Picks the endpoint for the next attempt among those not yet tried by this request: healthy endpoints before
+ * quarantined ones, then either the lowest latency or the configuration order.  Quarantined endpoints are only used
+ * once every healthy one has been tried, soonest-to-recover first.
+ */
+static bool s_select_endpoint(
+    struct aws_credentials_provider_sts_impl *impl,
+    uint32_t tried_endpoints,
+    size_t *out_endpoint_index) {
+
+    uint64_t now = 0;
+    aws_high_res_clock_get_ticks(&now);
+
+    bool found = false;
+    bool best_is_healthy = false;
+    size_t best_index = 0;
+
+    aws_mutex_lock(&impl->lock);
+
+    for (size_t i = 0; i < impl->endpoint_count; ++i) {
+        if (tried_endpoints & ((uint32_t)1 << i)) {
+            continue;
+        }
+
+        const struct sts_endpoint *endpoint = &impl->endpoints[i];
+        bool is_healthy = endpoint->unhealthy_until_ns <= now;
+
+        bool is_better = false;
+        if (!found) {
+            is_better = true;
+        } else if (is_healthy != best_is_healthy) {
+            is_better = is_healthy;
+        } else if (!is_healthy) {
+            is_better = endpoint->unhealthy_until_ns < impl->endpoints[best_index].unhealthy_until_ns;
+        } else if (impl->enable_latency_routing) {
+            is_better = endpoint->latency_ns < impl->endpoints[best_index].latency_ns;
+        }
+
+        if (is_better) {
+            found = true;
+            best_is_healthy = is_healthy;
+            best_index = i;
+        }
+    }
+
+    aws_mutex_unlock(&impl->lock);
+
+    *out_endpoint_index = best_index;
+
+    return found;
+}
+
+static void s_record_endpoint_result(
+    struct aws_credentials_provider_sts_impl *impl,
+    struct sts_endpoint *endpoint,
+    uint64_t attempt_start_ns,
+    bool success) {
+
+    uint64_t now = 0;
+    aws_high_res_clock_get_ticks(&now);
+
+    aws_mutex_lock(&impl->lock);
+
+    if (success) {
+        uint64_t sample_ns = now > attempt_start_ns ? now - attempt_start_ns : 0;
+        if (endpoint->latency_ns == 0) {
+            endpoint->latency_ns = sample_ns;
+        } else {
+            endpoint->latency_ns = endpoint->latency_ns - (endpoint->latency_ns >> STS_LATENCY_EWMA_SHIFT) +
+                                   (sample_ns >> STS_LATENCY_EWMA_SHIFT);
+        }
+
+        endpoint->consecutive_failures = 0;
+        endpoint->unhealthy_until_ns = 0;
+    } else {
+        ++endpoint->consecutive_failures;
+
+        uint32_t doublings = endpoint->consecutive_failures - 1;
+        if (doublings > 8) {
+            doublings = 8;
+        }
+
+        uint64_t quarantine_secs = (uint64_t)STS_ENDPOINT_QUARANTINE_BASE_SECS << doublings;
+        if (quarantine_secs > STS_ENDPOINT_QUARANTINE_MAX_SECS) {
+            quarantine_secs = STS_ENDPOINT_QUARANTINE_MAX_SECS;
+        }
+
+        endpoint->unhealthy_until_ns =
+            now + aws_timestamp_convert(quarantine_secs, AWS_TIMESTAMP_SECS, AWS_TIMESTAMP_NANOS, NULL);
+    }
+
+    aws_mutex_unlock(&impl->lock);
+}
+
 static int s_write_body_to_buffer(struct aws_credentials_provider *provider, struct aws_byte_buf *body) {
     struct aws_credentials_provider_sts_impl *provider_impl = provider->impl;
 
@@ -174,6 +350,35 @@ static int s_write_body_to_buffer(struct aws_credentials_provider *provider, str
     return AWS_OP_SUCCESS;
 }
 
+static int s_on_incoming_headers_fn(
+    struct aws_http_stream *stream,
+    enum aws_http_header_block header_block,
+    const struct aws_http_header *header_array,
+    size_t num_headers,
+    void *user_data) {
+
+    (void)stream;
+
+    struct sts_creds_provider_user_data *provider_user_data = user_data;
+    struct aws_credentials_provider_sts_impl *provider_impl = provider_user_data->provider->impl;
+
+    if (header_block != AWS_HTTP_HEADER_BLOCK_MAIN || provider_impl->clock_skew_tracker == NULL) {
+        return AWS_OP_SUCCESS;
+    }
+
+    for (size_t i = 0; i < num_headers; ++i) {
+        if (aws_byte_cursor_eq_ignore_case(&header_array[i].name, &s_date_header_name)) {
+            /* a bad Date header only costs us the skew correction, not the credentials */
+            aws_clock_skew_tracker_record_date_header(
+                provider_impl->clock_skew_tracker,
+                aws_byte_cursor_from_string(provider_user_data->endpoint->host),
+                header_array[i].value);
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
 static int s_on_incoming_body_fn(struct aws_http_stream *stream, const struct aws_byte_cursor *data, void *user_data) {
     (void)stream;
 
@@ -200,41 +405,24 @@ static bool s_on_node_encountered_fn(struct aws_xml_parser *parser, struct aws_x
     if (aws_byte_cursor_eq_ignore_case(&node->name, &s_assume_role_root_name) ||
         aws_byte_cursor_eq_ignore_case(&node->name, &s_assume_role_result_name) ||
         aws_byte_cursor_eq_ignore_case(&node->name, &s_assume_role_credentials_name)) {
-        return aws_xml_node_traverse(parser, node, s_on_node_encountered_fn, user_data);
-    }
-
-    struct aws_credentials *credentials = user_data;
-    struct aws_byte_cursor credential_data;
-    AWS_ZERO_STRUCT(credential_data);
-    if (aws_byte_cursor_eq_ignore_case(&node->name, &s_assume_role_access_key_id_name)) {
-        aws_xml_node_as_body(parser, node, &credential_data);
-        credentials->access_key_id =
-            aws_string_new_from_array(credentials->allocator, credential_data.ptr, credential_data.len);
-
-        if (credentials->access_key_id) {
-            AWS_LOGF_DEBUG(
-                AWS_LS_AUTH_CREDENTIALS_PROVIDER,
-                "(credentials=%p): AccessKeyId %s",
-                (void *)credentials,
-                aws_string_c_str(credentials->access_key_id));
-        }
+        return aws_xml_node_traverse(parser, node, s_on_node_encountered_fn, user_data) == AWS_OP_SUCCESS;
     }
 
-    if (aws_byte_cursor_eq_ignore_case(&node->name, &s_assume_role_secret_key_name)) {
-        aws_xml_node_as_body(parser, node, &credential_data);
-        credentials->secret_access_key =
-            aws_string_new_from_array(credentials->allocator, credential_data.ptr, credential_data.len);
-    }
+    struct sts_assume_role_response *response = user_data;
 
-    if (aws_byte_cursor_eq_ignore_case(&node->name, &s_assume_role_session_token_name)) {
-        aws_xml_node_as_body(parser, node, &credential_data);
-        credentials->session_token =
-            aws_string_new_from_array(credentials->allocator, credential_data.ptr, credential_data.len);
+    if (aws_byte_cursor_eq_ignore_case(&node->name, &s_assume_role_access_key_id_name)) {
+        aws_xml_node_as_body(parser, node, &response->access_key_id);
+    } else if (aws_byte_cursor_eq_ignore_case(&node->name, &s_assume_role_secret_key_name)) {
+        aws_xml_node_as_body(parser, node, &response->secret_access_key);
+    } else if (aws_byte_cursor_eq_ignore_case(&node->name, &s_assume_role_session_token_name)) {
+        aws_xml_node_as_body(parser, node, &response->session_token);
     }
 
     return true;
 }
 
+static bool s_try_next_endpoint(struct sts_creds_provider_user_data *user_data);
+
 /* called upon completion of http request */
 static void s_on_stream_complete_fn(struct aws_http_stream *stream, int error_code, void *user_data) {
     int http_response_code = 0;
@@ -242,15 +430,30 @@ static void s_on_stream_complete_fn(struct aws_http_stream *stream, int error_co
     struct aws_credentials_provider_sts_impl *provider_impl = provider_user_data->provider->impl;
 
     if (provider_impl->function_table->aws_http_stream_get_incoming_response_status(stream, &http_response_code)) {
-        goto finish;
+        http_response_code = 0;
     }
 
     AWS_LOGF_DEBUG(
         AWS_LS_AUTH_CREDENTIALS_PROVIDER,
-        "(id=%p): AssumeRole call completed with http status %d",
+        "(id=%p): AssumeRole call to %s completed with error code %d and http status %d",
         (void *)provider_user_data->provider,
+        aws_string_c_str(provider_user_data->endpoint->host),
+        error_code,
         http_response_code);
-    if (!error_code && http_response_code == 200) {
+
+    /* transport errors and server errors may be local to this endpoint, anything else would fail everywhere */
+    if (error_code || http_response_code == 0 || http_response_code >= 500) {
+        if (s_try_next_endpoint(provider_user_data)) {
+            return;
+        }
+
+        goto finish;
+    }
+
+    s_record_endpoint_result(
+        provider_impl, provider_user_data->endpoint, provider_user_data->attempt_start_ns, true /* success */);
+
+    if (http_response_code == 200) {
         struct aws_xml_parser xml_parser;
         struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&provider_user_data->output_buf);
 
@@ -258,32 +461,43 @@ static void s_on_stream_complete_fn(struct aws_http_stream *stream, int error_co
             goto finish;
         }
 
-        provider_user_data->credentials =
-            aws_mem_calloc(provider_user_data->allocator, 1, sizeof(struct aws_credentials));
-        AWS_LOGF_DEBUG(
-            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
-            "(credentials=%p): parsing credentials",
-            (void *)provider_user_data->credentials);
-        provider_user_data->credentials->allocator = provider_user_data->allocator;
-        if (aws_xml_parser_parse(&xml_parser, s_on_node_encountered_fn, provider_user_data->credentials)) {
+        struct sts_assume_role_response response;
+        AWS_ZERO_STRUCT(response);
+
+        int parse_result = aws_xml_parser_parse(&xml_parser, s_on_node_encountered_fn, &response);
+        aws_xml_parser_clean_up(&xml_parser);
+
+        if (parse_result) {
             AWS_LOGF_ERROR(
                 AWS_LS_AUTH_CREDENTIALS_PROVIDER,
-                "{credentials=%p): parsing failed with error %s",
-                (void *)provider_user_data->credentials,
+                "(id=%p): parsing credentials failed with error %s",
+                (void *)provider_user_data->provider,
                 aws_error_debug_str(aws_last_error()));
             goto finish;
         }
 
-        aws_xml_parser_clean_up(&xml_parser);
-
-        if (!(provider_user_data->credentials->access_key_id && provider_user_data->credentials->secret_access_key &&
-              provider_user_data->credentials->session_token)) {
+        if (response.access_key_id.len == 0 || response.secret_access_key.len == 0 ||
+            response.session_token.len == 0) {
             AWS_LOGF_ERROR(
                 AWS_LS_AUTH_CREDENTIALS_PROVIDER,
                 "(id=%p): credentials document was corrupted, treating as an error.",
                 (void *)provider_user_data->provider);
-            aws_credentials_destroy(provider_user_data->credentials);
-            provider_user_data->credentials = NULL;
+            goto finish;
+        }
+
+        /* built in one step so that the uri-encoded session token is computed along with everything else */
+        provider_user_data->credentials = aws_credentials_new_from_cursors(
+            provider_user_data->allocator,
+            &response.access_key_id,
+            &response.secret_access_key,
+            &response.session_token);
+
+        if (provider_user_data->credentials != NULL) {
+            AWS_LOGF_DEBUG(
+                AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+                "(id=%p): parsed credentials with AccessKeyId " PRInSTR,
+                (void *)provider_user_data->provider,
+                AWS_BYTE_CURSOR_PRI(response.access_key_id));
         }
     }
 
@@ -291,22 +505,33 @@ finish:
     s_clean_up_user_data(provider_user_data);
 }
 
-/* called upon acquiring a connection from the pool */
-static void s_on_connection_setup_fn(struct aws_http_connection *connection, int error_code, void *user_data) {
-    struct sts_creds_provider_user_data *provider_user_data = user_data;
+/*
+ * Called by signing and by connection acquisition as each finishes.  The last one to finish sends the signed
+ * request over the acquired connection, or, if either failed, releases whatever the other produced and then fails
+ * over or completes the request.
+ */
+static void s_on_attempt_operation_complete(struct sts_creds_provider_user_data *provider_user_data) {
+    if (aws_atomic_fetch_sub(&provider_user_data->pending_operations, 1) != 1) {
+        return;
+    }
+
     struct aws_credentials_provider_sts_impl *provider_impl = provider_user_data->provider->impl;
 
-    AWS_LOGF_DEBUG(
-        AWS_LS_AUTH_CREDENTIALS_PROVIDER,
-        "(id=%p): connection returned with error code %d",
-        (void *)provider_user_data->provider,
-        error_code);
+    if (provider_user_data->signing_error_code) {
+        aws_raise_error(provider_user_data->signing_error_code);
+        goto error;
+    }
 
-    if (error_code) {
-        aws_raise_error(error_code);
+    if (provider_user_data->hedged_attempt != NULL &&
+        aws_credentials_hedged_attempt_is_cancelled(provider_user_data->hedged_attempt)) {
+        /* a duplicate request already won while this one was signing or connecting */
         goto error;
     }
-    provider_user_data->connection = connection;
+
+    if (provider_user_data->connection_error_code) {
+        aws_raise_error(provider_user_data->connection_error_code);
+        goto endpoint_error;
+    }
 
     if (aws_byte_buf_init(&provider_user_data->output_buf, provider_impl->provider->allocator, 2048)) {
         goto error;
@@ -314,34 +539,58 @@ static void s_on_connection_setup_fn(struct aws_http_connection *connection, int
 
     struct aws_http_make_request_options options = {
         .manual_window_management = false,
-        .user_data = user_data,
+        .user_data = provider_user_data,
         .request = provider_user_data->message,
         .self_size = sizeof(struct aws_http_make_request_options),
-        .on_response_headers = NULL,
+        .on_response_headers = s_on_incoming_headers_fn,
         .on_response_header_block_done = NULL,
         .on_response_body = s_on_incoming_body_fn,
         .on_complete = s_on_stream_complete_fn,
     };
 
     struct aws_http_stream *stream =
-        provider_impl->function_table->aws_http_connection_make_request(connection, &options);
+        provider_impl->function_table->aws_http_connection_make_request(provider_user_data->connection, &options);
     if (!stream) {
-        goto error;
+        goto endpoint_error;
     }
 
     provider_impl->function_table->aws_http_stream_release(stream);
 
     return;
+
+endpoint_error:
+    if (s_try_next_endpoint(provider_user_data)) {
+        return;
+    }
+
 error:
     s_clean_up_user_data(provider_user_data);
 }
 
+/* called upon acquiring a connection from the pool */
+static void s_on_connection_setup_fn(struct aws_http_connection *connection, int error_code, void *user_data) {
+    struct sts_creds_provider_user_data *provider_user_data = user_data;
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+        "(id=%p): connection returned with error code %d",
+        (void *)provider_user_data->provider,
+        error_code);
+
+    provider_user_data->connection_error_code = error_code;
+    provider_user_data->connection = connection;
+
+    /* lets a duplicate that wins first close this connection; if one already has, the join notices */
+    if (connection != NULL && provider_user_data->hedged_attempt != NULL) {
+        aws_credentials_hedged_attempt_set_connection(provider_user_data->hedged_attempt, connection);
+    }
+
+    s_on_attempt_operation_complete(provider_user_data);
+}
+
 /* called once sigv4 signing is complete. */
 void s_on_signing_complete(struct aws_signing_result *result, int error_code, void *userdata) {
-    (void)result;
-    (void)error_code;
     struct sts_creds_provider_user_data *provider_user_data = userdata;
-    struct aws_credentials_provider_sts_impl *sts_impl = provider_user_data->provider->impl;
 
     AWS_LOGF_DEBUG(
         AWS_LS_AUTH_CREDENTIALS_PROVIDER,
@@ -349,69 +598,56 @@ void s_on_signing_complete(struct aws_signing_result *result, int error_code, vo
         (void *)provider_user_data->provider,
         error_code);
 
-    if (error_code) {
-        aws_raise_error(error_code);
-        goto error;
+    /* the signing result is only valid for the duration of this callback, so it is applied now */
+    if (!error_code && aws_apply_signing_result_to_http_request(
+                           provider_user_data->message, provider_user_data->provider->allocator, result)) {
+        error_code = aws_last_error();
     }
 
-    if (aws_apply_signing_result_to_http_request(
-            provider_user_data->message, provider_user_data->provider->allocator, result)) {
-        goto error;
-    }
-
-    sts_impl->function_table->aws_http_connection_manager_acquire_connection(
-        sts_impl->connection_manager, s_on_connection_setup_fn, provider_user_data);
-    return;
+    provider_user_data->signing_error_code = error_code;
 
-error:
-    s_clean_up_user_data(provider_user_data);
+    s_on_attempt_operation_complete(provider_user_data);
 }
 
-static int s_sts_get_creds(
-    struct aws_credentials_provider *provider,
-    aws_on_get_credentials_callback_fn callback,
-    void *user_data) {
-
-    AWS_LOGF_DEBUG(AWS_LS_AUTH_CREDENTIALS_PROVIDER, "(id=%p): fetching credentials", (void *)provider);
-
+/*
+ * Builds a request for an endpoint, then signs it while a connection to the endpoint is acquired.  The request is
+ * sent once both have finished, so a cold fetch waits on the slower of the two rather than on their sum.
+ */
+static int s_start_attempt(struct sts_creds_provider_user_data *provider_user_data, size_t endpoint_index) {
+    struct aws_credentials_provider *provider = provider_user_data->provider;
     struct aws_credentials_provider_sts_impl *sts_impl = provider->impl;
-    struct sts_creds_provider_user_data *provider_user_data =
-        aws_mem_calloc(provider->allocator, 1, sizeof(struct sts_creds_provider_user_data));
+    struct sts_endpoint *endpoint = &sts_impl->endpoints[endpoint_index];
 
-    if (!provider_user_data) {
-        return AWS_OP_ERR;
-    }
+    provider_user_data->endpoint = endpoint;
+    provider_user_data->tried_endpoints |= (uint32_t)1 << endpoint_index;
 
-    provider_user_data->allocator = provider->allocator;
-    provider_user_data->provider = provider;
-    aws_credentials_provider_acquire(provider);
-    provider_user_data->callback = callback;
-    provider_user_data->user_data = user_data;
+    AWS_LOGF_DEBUG(
+        AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+        "(id=%p): sending AssumeRole request to %s",
+        (void *)provider,
+        aws_string_c_str(endpoint->host));
 
     provider_user_data->message = aws_http_message_new_request(provider->allocator);
 
     if (!provider_user_data->message) {
-        goto error;
+        return AWS_OP_ERR;
     }
 
-    if (aws_http_message_add_header(provider_user_data->message, s_host_header)) {
-        goto error;
+    struct aws_http_header host_header = {
+        .name = s_host_header_name,
+        .value = aws_byte_cursor_from_string(endpoint->host),
+    };
+
+    if (aws_http_message_add_header(provider_user_data->message, host_header)) {
+        return AWS_OP_ERR;
     }
 
     if (aws_http_message_add_header(provider_user_data->message, s_content_type_header)) {
-        goto error;
+        return AWS_OP_ERR;
     }
 
     if (aws_http_message_add_header(provider_user_data->message, s_api_version_header)) {
-        goto error;
-    }
-
-    if (aws_byte_buf_init(&provider_user_data->payload_body, provider->allocator, 256)) {
-        goto error;
-    }
-
-    if (s_write_body_to_buffer(provider, &provider_user_data->payload_body)) {
-        goto error;
+        return AWS_OP_ERR;
     }
 
     char content_length[21];
@@ -424,48 +660,150 @@ static int s_sts_get_creds(
     };
 
     if (aws_http_message_add_header(provider_user_data->message, content_len_header)) {
-        goto error;
+        return AWS_OP_ERR;
     }
 
     struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&provider_user_data->payload_body);
-    provider_user_data->input_stream =
-        aws_input_stream_new_from_cursor(provider_user_data->provider->allocator, &payload_cur);
+    provider_user_data->input_stream = aws_input_stream_new_from_cursor(provider->allocator, &payload_cur);
 
     if (!provider_user_data->input_stream) {
-        goto error;
+        return AWS_OP_ERR;
     }
 
     aws_http_message_set_body_stream(provider_user_data->message, provider_user_data->input_stream);
 
     if (aws_http_message_set_request_method(provider_user_data->message, aws_http_method_post)) {
-        goto error;
+        return AWS_OP_ERR;
     }
 
     if (aws_http_message_set_request_path(provider_user_data->message, s_path)) {
-        goto error;
+        return AWS_OP_ERR;
     }
 
     provider_user_data->signable = aws_signable_new_http_request(provider->allocator, provider_user_data->message);
 
     if (!provider_user_data->signable) {
-        goto error;
+        return AWS_OP_ERR;
     }
 
+    AWS_ZERO_STRUCT(provider_user_data->signing_config);
     provider_user_data->signing_config.algorithm = AWS_SIGNING_ALGORITHM_SIG_V4_HEADER;
     provider_user_data->signing_config.body_signing_type = AWS_BODY_SIGNING_ON;
     provider_user_data->signing_config.config_type = AWS_SIGNING_CONFIG_AWS;
     provider_user_data->signing_config.credentials_provider = sts_impl->provider;
     aws_date_time_init_now(&provider_user_data->signing_config.date);
-    provider_user_data->signing_config.region = s_signing_region;
+    provider_user_data->signing_config.clock_skew_tracker = sts_impl->clock_skew_tracker;
+    provider_user_data->signing_config.clock_skew_endpoint = host_header.value;
+    provider_user_data->signing_config.region = aws_byte_cursor_from_string(endpoint->region);
     provider_user_data->signing_config.service = s_service_name;
     provider_user_data->signing_config.use_double_uri_encode = false;
 
+    aws_atomic_init_int(&provider_user_data->pending_operations, 2);
+    provider_user_data->signing_error_code = AWS_ERROR_SUCCESS;
+    provider_user_data->connection_error_code = AWS_ERROR_SUCCESS;
+
+    aws_high_res_clock_get_ticks(&provider_user_data->attempt_start_ns);
+
+    /* signing is started first so that a failure to start it can still be reported synchronously */
     if (aws_sign_request_aws(
             provider->allocator,
             provider_user_data->signable,
             (struct aws_signing_config_base *)&provider_user_data->signing_config,
             s_on_signing_complete,
             provider_user_data)) {
+        return AWS_OP_ERR;
+    }
+
+    sts_impl->function_table->aws_http_connection_manager_acquire_connection(
+        endpoint->connection_manager, s_on_connection_setup_fn, provider_user_data);
+
+    return AWS_OP_SUCCESS;
+}
+
+/*
+ * Retries a request against the next endpoint after a failure that may be local to the current one.  Returns false
+ * if there's nothing left to try, in which case the caller completes the request as failed.
+ */
+static bool s_try_next_endpoint(struct sts_creds_provider_user_data *user_data) {
+    struct aws_credentials_provider_sts_impl *provider_impl = user_data->provider->impl;
+
+    /*
+     * A duplicate already won and closed this attempt's connection on purpose.  That says nothing about the
+     * endpoint's health, so it isn't recorded as a failure.
+     */
+    if (user_data->hedged_attempt != NULL && aws_credentials_hedged_attempt_is_cancelled(user_data->hedged_attempt)) {
+        return false;
+    }
+
+    s_record_endpoint_result(provider_impl, user_data->endpoint, user_data->attempt_start_ns, false /* success */);
+
+    size_t endpoint_index = 0;
+    if (!s_select_endpoint(provider_impl, user_data->tried_endpoints, &endpoint_index)) {
+        return false;
+    }
+
+    AWS_LOGF_INFO(
+        AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+        "(id=%p): AssumeRole request to %s failed, failing over to %s",
+        (void *)user_data->provider,
+        aws_string_c_str(user_data->endpoint->host),
+        aws_string_c_str(provider_impl->endpoints[endpoint_index].host));
+
+    s_clean_up_attempt(user_data);
+
+    if (s_start_attempt(user_data, endpoint_index)) {
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+            "(id=%p): error occurred while creating an http request for signing: %s",
+            (void *)user_data->provider,
+            aws_error_debug_str(aws_last_error()));
+        return false;
+    }
+
+    return true;
+}
+
+static int s_sts_start_query(
+    struct aws_credentials_provider *provider,
+    aws_on_get_credentials_callback_fn callback,
+    void *user_data,
+    struct aws_credentials_hedged_attempt *hedged_attempt) {
+
+    AWS_LOGF_DEBUG(AWS_LS_AUTH_CREDENTIALS_PROVIDER, "(id=%p): fetching credentials", (void *)provider);
+
+    struct aws_credentials_provider_sts_impl *sts_impl = provider->impl;
+    struct sts_creds_provider_user_data *provider_user_data =
+        aws_mem_calloc(provider->allocator, 1, sizeof(struct sts_creds_provider_user_data));
+
+    if (!provider_user_data) {
+        if (hedged_attempt != NULL) {
+            aws_credentials_hedged_attempt_complete(hedged_attempt, NULL);
+        }
+        return AWS_OP_ERR;
+    }
+
+    provider_user_data->hedged_attempt = hedged_attempt;
+    provider_user_data->allocator = provider->allocator;
+    provider_user_data->provider = provider;
+    aws_credentials_provider_acquire(provider);
+    provider_user_data->callback = callback;
+    provider_user_data->user_data = user_data;
+
+    AWS_AUTH_PROBE_FETCH_START(provider, provider_user_data, "sts");
+
+    /* the body is the same for every endpoint, so it's built once and shared by all attempts */
+    if (aws_byte_buf_init(&provider_user_data->payload_body, provider->allocator, 256)) {
+        goto error;
+    }
+
+    if (s_write_body_to_buffer(provider, &provider_user_data->payload_body)) {
+        goto error;
+    }
+
+    size_t endpoint_index = 0;
+    s_select_endpoint(sts_impl, 0, &endpoint_index);
+
+    if (s_start_attempt(provider_user_data, endpoint_index)) {
         goto error;
     }
 
@@ -485,6 +823,28 @@ error:
     return AWS_OP_ERR;
 }
 
+static void s_sts_start_hedged_attempt(
+    struct aws_credentials_provider *provider,
+    struct aws_credentials_hedged_attempt *attempt) {
+
+    /* failures are reported through the attempt */
+    s_sts_start_query(provider, NULL, NULL, attempt);
+}
+
+static int s_sts_get_creds(
+    struct aws_credentials_provider *provider,
+    aws_on_get_credentials_callback_fn callback,
+    void *user_data) {
+
+    struct aws_credentials_provider_sts_impl *sts_impl = provider->impl;
+
+    if (aws_credentials_hedging_is_enabled(&sts_impl->hedging)) {
+        return aws_credentials_hedged_request_start(&sts_impl->hedging, provider, callback, user_data);
+    }
+
+    return s_sts_start_query(provider, callback, user_data, NULL);
+}
+
 static void s_on_credentials_provider_shutdown(void *user_data) {
     struct aws_credentials_provider *provider = user_data;
     if (provider == NULL) {
@@ -511,7 +871,19 @@ static void s_on_credentials_provider_shutdown(void *user_data) {
         aws_tls_ctx_destroy(impl->ctx);
     }
 
-    aws_tls_connection_options_clean_up(&impl->connection_options);
+    for (size_t i = 0; i < impl->endpoint_count; ++i) {
+        struct sts_endpoint *endpoint = &impl->endpoints[i];
+        aws_tls_connection_options_clean_up(&endpoint->connection_options);
+        aws_string_destroy(endpoint->region);
+        aws_string_destroy(endpoint->host);
+    }
+
+    if (impl->endpoints != NULL) {
+        aws_mem_release(provider->allocator, impl->endpoints);
+    }
+
+    aws_credentials_hedging_clean_up(&impl->hedging);
+    aws_mutex_clean_up(&impl->lock);
     aws_mem_release(provider->allocator, provider);
 }
 
@@ -520,13 +892,128 @@ void s_destroy(struct aws_credentials_provider *provider) {
 
     struct aws_credentials_provider_sts_impl *sts_impl = provider->impl;
 
-    if (sts_impl->connection_manager) {
-        sts_impl->function_table->aws_http_connection_manager_release(sts_impl->connection_manager);
+    for (size_t i = 0; i < sts_impl->endpoint_count; ++i) {
+        if (sts_impl->endpoints[i].connection_manager) {
+            sts_impl->function_table->aws_http_connection_manager_release(sts_impl->endpoints[i].connection_manager);
+        }
     }
 
     aws_credentials_provider_release(sts_impl->provider);
 }
 
+static struct aws_string *s_new_regional_host(struct aws_allocator *allocator, struct aws_byte_cursor region) {
+    struct aws_byte_cursor suffix = s_regional_host_suffix;
+
+    struct aws_byte_cursor region_prefix = region;
+    if (region_prefix.len >= s_china_region_prefix.len) {
+        region_prefix.len = s_china_region_prefix.len;
+        if (aws_byte_cursor_eq_ignore_case(&region_prefix, &s_china_region_prefix)) {
+            suffix = s_china_host_suffix;
+        }
+    }
+
+    struct aws_string *host = NULL;
+
+    struct aws_byte_buf host_buf;
+    if (aws_byte_buf_init(&host_buf, allocator, s_regional_host_prefix.len + region.len + suffix.len)) {
+        return NULL;
+    }
+
+    if (aws_byte_buf_append_dynamic(&host_buf, &s_regional_host_prefix) ||
+        aws_byte_buf_append_dynamic(&host_buf, &region) || aws_byte_buf_append_dynamic(&host_buf, &suffix)) {
+        goto done;
+    }
+
+    host = aws_string_new_from_array(allocator, host_buf.buffer, host_buf.len);
+
+done:
+    aws_byte_buf_clean_up(&host_buf);
+
+    return host;
+}
+
+static int s_init_endpoint(
+    struct aws_credentials_provider *provider,
+    struct sts_endpoint *endpoint,
+    const struct aws_credentials_provider_sts_endpoint *endpoint_options,
+    struct aws_client_bootstrap *bootstrap) {
+
+    struct aws_allocator *allocator = provider->allocator;
+    struct aws_credentials_provider_sts_impl *impl = provider->impl;
+
+    if (endpoint_options->region.len == 0) {
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER, "(id=%p): STS endpoints must specify a region", (void *)provider);
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    endpoint->region =
+        aws_string_new_from_array(allocator, endpoint_options->region.ptr, endpoint_options->region.len);
+    if (!endpoint->region) {
+        return AWS_OP_ERR;
+    }
+
+    if (endpoint_options->host.len > 0) {
+        endpoint->host = aws_string_new_from_array(allocator, endpoint_options->host.ptr, endpoint_options->host.len);
+    } else {
+        endpoint->host = s_new_regional_host(allocator, endpoint_options->region);
+    }
+
+    if (!endpoint->host) {
+        return AWS_OP_ERR;
+    }
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+        "(id=%p): using STS endpoint %s for region %s",
+        (void *)provider,
+        aws_string_c_str(endpoint->host),
+        aws_string_c_str(endpoint->region));
+
+    struct aws_byte_cursor host_cur = aws_byte_cursor_from_string(endpoint->host);
+
+    aws_tls_connection_options_init_from_ctx(&endpoint->connection_options, impl->ctx);
+
+    if (aws_tls_connection_options_set_server_name(&endpoint->connection_options, allocator, &host_cur)) {
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+            "(id=%p): failed to create a tls connection options with error %s",
+            (void *)provider,
+            aws_error_debug_str(aws_last_error()));
+        return AWS_OP_ERR;
+    }
+
+    struct aws_socket_options socket_options = {
+        .type = AWS_SOCKET_STREAM,
+        .domain = AWS_SOCKET_IPV6,
+        .connect_timeout_ms = 3000,
+    };
+
+    struct aws_http_connection_manager_options connection_manager_options = {
+        .bootstrap = bootstrap,
+        .host = host_cur,
+        .initial_window_size = SIZE_MAX,
+        .max_connections = 2,
+        .port = 443,
+        .socket_options = &socket_options,
+        .tls_connection_options = &endpoint->connection_options,
+    };
+
+    endpoint->connection_manager =
+        impl->function_table->aws_http_connection_manager_new(allocator, &connection_manager_options);
+
+    if (!endpoint->connection_manager) {
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+            "(id=%p): failed to create a connection manager with error %s",
+            (void *)provider,
+            aws_error_debug_str(aws_last_error()));
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
 static struct aws_credentials_provider_vtable s_aws_credentials_provider_sts_vtable = {
     .get_credentials = s_sts_get_creds,
     .destroy = s_destroy,
@@ -556,6 +1043,10 @@ struct aws_credentials_provider *aws_credentials_provider_new_sts(
 
     aws_credentials_provider_init_base(provider, allocator, &s_aws_credentials_provider_sts_vtable, impl);
 
+    if (aws_mutex_init(&impl->lock)) {
+        goto cleanup_provider;
+    }
+
     impl->function_table = &s_default_function_table;
 
     if (options->function_table) {
@@ -638,42 +1129,48 @@ struct aws_credentials_provider *aws_credentials_provider_new_sts(
     impl->provider = options->creds_provider;
     aws_credentials_provider_acquire(impl->provider);
 
-    aws_tls_connection_options_init_from_ctx(&impl->connection_options, impl->ctx);
+    impl->clock_skew_tracker = options->clock_skew_tracker;
 
-    if (aws_tls_connection_options_set_server_name(&impl->connection_options, allocator, &s_host_header.value)) {
+    if (options->endpoint_count > STS_MAX_ENDPOINTS) {
         AWS_LOGF_ERROR(
             AWS_LS_AUTH_CREDENTIALS_PROVIDER,
-            "(id=%p): failed to create a tls connection options with error %s",
+            "(id=%p): at most %d STS endpoints are supported",
             (void *)provider,
-            aws_error_debug_str(aws_last_error()));
+            STS_MAX_ENDPOINTS);
+        aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
         goto cleanup_provider;
     }
 
-    struct aws_socket_options socket_options = {
-        .type = AWS_SOCKET_STREAM,
-        .domain = AWS_SOCKET_IPV6,
-        .connect_timeout_ms = 3000,
-    };
+    size_t endpoint_count = options->endpoint_count > 0 ? options->endpoint_count : 1;
+    impl->endpoints = aws_mem_calloc(allocator, endpoint_count, sizeof(struct sts_endpoint));
+    if (!impl->endpoints) {
+        goto cleanup_provider;
+    }
 
-    struct aws_http_connection_manager_options connection_manager_options = {
-        .bootstrap = options->bootstrap,
-        .host = s_host_header.value,
-        .initial_window_size = SIZE_MAX,
-        .max_connections = 2,
-        .port = 443,
-        .socket_options = &socket_options,
-        .tls_connection_options = &impl->connection_options,
-    };
+    impl->endpoint_count = endpoint_count;
+    impl->enable_latency_routing = options->enable_latency_routing;
 
-    impl->connection_manager =
-        impl->function_table->aws_http_connection_manager_new(allocator, &connection_manager_options);
+    for (size_t i = 0; i < endpoint_count; ++i) {
+        struct aws_credentials_provider_sts_endpoint global_endpoint = {
+            .region = s_global_endpoint_region,
+            .host = s_global_endpoint_host,
+        };
 
-    if (!impl->connection_manager) {
-        AWS_LOGF_ERROR(
-            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
-            "(id=%p): failed to create a connection manager with error %s",
-            (void *)provider,
-            aws_error_debug_str(aws_last_error()));
+        const struct aws_credentials_provider_sts_endpoint *endpoint_options =
+            options->endpoint_count > 0 ? &options->endpoints[i] : &global_endpoint;
+
+        if (s_init_endpoint(provider, &impl->endpoints[i], endpoint_options, options->bootstrap)) {
+            goto cleanup_provider;
+        }
+    }
+
+    if (aws_credentials_hedging_init(
+            &impl->hedging,
+            allocator,
+            &options->hedging,
+            options->bootstrap != NULL ? options->bootstrap->event_loop_group : NULL,
+            impl->function_table,
+            s_sts_start_hedged_attempt)) {
         goto cleanup_provider;
     }
 
@@ -0,0 +1,896 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/imds_client.h>
+
+#include <aws/auth/external/cJSON.h>
+#include <aws/auth/private/credentials_utils.h>
+#include <aws/common/array_list.h>
+#include <aws/common/clock.h>
+#include <aws/common/hash_table.h>
+#include <aws/common/mutex.h>
+#include <aws/common/string.h>
+#include <aws/http/connection.h>
+#include <aws/http/connection_manager.h>
+#include <aws/http/request_response.h>
+#include <aws/io/logging.h>
+#include <aws/io/socket.h>
+
+#if defined(_MSC_VER)
+#    pragma warning(disable : 4204)
+#endif /* _MSC_VER */
+
+/* instance role credentials body response is currently ~ 1300 characters + name length */
+#define IMDS_RESPONSE_SIZE_INITIAL 2048
+#define IMDS_RESPONSE_SIZE_LIMIT 10000
+#define IMDS_CONNECT_TIMEOUT_DEFAULT_IN_SECONDS 2
+#define IMDS_DEFAULT_MAX_CONNECTIONS 2
+#define IMDS_IN_FLIGHT_TABLE_DEFAULT_SIZE 8
+#define IMDS_GET_WAITERS_DEFAULT_SIZE 2
+
+static struct aws_credentials_provider_system_vtable s_default_function_table = {
+    .aws_http_connection_manager_new = aws_http_connection_manager_new,
+    .aws_http_connection_manager_release = aws_http_connection_manager_release,
+    .aws_http_connection_manager_acquire_connection = aws_http_connection_manager_acquire_connection,
+    .aws_http_connection_manager_release_connection = aws_http_connection_manager_release_connection,
+    .aws_http_connection_make_request = aws_http_connection_make_request,
+    .aws_http_stream_get_incoming_response_status = aws_http_stream_get_incoming_response_status,
+    .aws_http_stream_release = aws_http_stream_release,
+    .aws_http_connection_close = aws_http_connection_close};
+
+AWS_STATIC_STRING_FROM_LITERAL(s_imds_accept_header, "Accept");
+AWS_STATIC_STRING_FROM_LITERAL(s_imds_accept_header_value, "*/*");
+AWS_STATIC_STRING_FROM_LITERAL(s_imds_host, "169.254.169.254");
+AWS_STATIC_STRING_FROM_LITERAL(s_imds_user_agent_header, "User-Agent");
+AWS_STATIC_STRING_FROM_LITERAL(s_imds_user_agent_header_value, "aws-sdk-crt/imds-credentials-provider");
+AWS_STATIC_STRING_FROM_LITERAL(s_imds_h1_0_keep_alive_header, "Connection");
+AWS_STATIC_STRING_FROM_LITERAL(s_imds_h1_0_keep_alive_header_value, "keep-alive");
+
+struct aws_imds_client {
+    struct aws_allocator *allocator;
+    struct aws_http_connection_manager *connection_manager;
+    struct aws_credentials_provider_system_vtable *function_table;
+
+    /* what the client was created with, for matching shared clients; max_connections has its default applied */
+    struct aws_client_bootstrap *bootstrap;
+    size_t max_connections;
+
+    /* protected by s_client_ref_lock */
+    size_t ref_count;
+    bool is_shared;
+    struct aws_imds_client *next_shared;
+
+    /* from the final release, invoked once the connection manager has shut down */
+    aws_imds_client_on_released_fn *on_released;
+    void *on_released_user_data;
+
+    struct aws_mutex lock;
+
+    /* struct aws_byte_cursor * -> struct imds_get_request *, for gets that can still be joined; protected by lock */
+    struct aws_hash_table in_flight_gets;
+
+    /* set at most once, protected by lock until has_identity is seen to be true and immutable afterwards */
+    struct aws_imds_instance_identity identity;
+    bool has_identity;
+};
+
+/*
+ * Reference counts of every client, and the list of shared clients, are protected by one lock so that acquiring a
+ * shared client can't race with its final release.  There is one shared client per bootstrap and set of options,
+ * so no caller's client ever depends on another caller's bootstrap.
+ */
+static struct aws_mutex s_client_ref_lock = AWS_MUTEX_INIT;
+static struct aws_imds_client *s_shared_clients = NULL;
+
+struct imds_get_waiter {
+    aws_imds_client_on_get_resource_fn *callback;
+    void *user_data;
+};
+
+/*
+ * Tracking structure for one http GET, and every caller waiting on its result
+ */
+struct imds_get_request {
+    struct aws_allocator *allocator;
+    struct aws_imds_client *client;
+    struct aws_string *resource_path;
+
+    /* the in-flight table key; points into resource_path */
+    struct aws_byte_cursor key;
+    bool is_joinable;
+
+    /* struct imds_get_waiter; only appended to under the client's lock, while the get is in the table */
+    struct aws_array_list waiters;
+
+    struct aws_http_connection *connection;
+    struct aws_http_message *request;
+    struct aws_byte_buf response;
+    int status_code;
+};
+
+static void s_on_connection_manager_shutdown(void *user_data) {
+    struct aws_imds_client *client = user_data;
+
+    aws_imds_client_on_released_fn *on_released = client->on_released;
+    void *on_released_user_data = client->on_released_user_data;
+
+    aws_string_destroy(client->identity.region);
+    aws_string_destroy(client->identity.availability_zone);
+    aws_string_destroy(client->identity.account_id);
+    aws_string_destroy(client->identity.instance_id);
+    aws_hash_table_clean_up(&client->in_flight_gets);
+    aws_mutex_clean_up(&client->lock);
+    aws_mem_release(client->allocator, client);
+
+    if (on_released != NULL) {
+        on_released(on_released_user_data);
+    }
+}
+
+static struct aws_imds_client *s_imds_client_new(
+    struct aws_allocator *allocator,
+    const struct aws_imds_client_options *options) {
+
+    struct aws_imds_client *client = aws_mem_calloc(allocator, 1, sizeof(struct aws_imds_client));
+    if (client == NULL) {
+        return NULL;
+    }
+
+    client->allocator = allocator;
+    client->ref_count = 1;
+    client->function_table = options->function_table;
+    if (client->function_table == NULL) {
+        client->function_table = &s_default_function_table;
+    }
+
+    client->bootstrap = options->bootstrap;
+    client->max_connections = options->max_connections;
+    if (client->max_connections == 0) {
+        client->max_connections = IMDS_DEFAULT_MAX_CONNECTIONS;
+    }
+
+    if (aws_mutex_init(&client->lock)) {
+        goto on_mutex_error;
+    }
+
+    if (aws_hash_table_init(
+            &client->in_flight_gets,
+            allocator,
+            IMDS_IN_FLIGHT_TABLE_DEFAULT_SIZE,
+            aws_hash_byte_cursor_ptr,
+            (aws_hash_callback_eq_fn *)aws_byte_cursor_eq,
+            NULL, /* keys and values are owned by the get requests */
+            NULL)) {
+        goto on_table_error;
+    }
+
+    struct aws_socket_options socket_options;
+    AWS_ZERO_STRUCT(socket_options);
+    socket_options.type = AWS_SOCKET_STREAM;
+    socket_options.domain = AWS_SOCKET_IPV4;
+    socket_options.connect_timeout_ms = (uint32_t)aws_timestamp_convert(
+        IMDS_CONNECT_TIMEOUT_DEFAULT_IN_SECONDS, AWS_TIMESTAMP_SECS, AWS_TIMESTAMP_MILLIS, NULL);
+
+    struct aws_http_connection_manager_options manager_options;
+    AWS_ZERO_STRUCT(manager_options);
+    manager_options.bootstrap = options->bootstrap;
+    manager_options.initial_window_size = IMDS_RESPONSE_SIZE_LIMIT;
+    manager_options.socket_options = &socket_options;
+    manager_options.tls_connection_options = NULL;
+    manager_options.host = aws_byte_cursor_from_string(s_imds_host);
+    manager_options.port = 80;
+    manager_options.max_connections = client->max_connections;
+    manager_options.shutdown_complete_callback = s_on_connection_manager_shutdown;
+    manager_options.shutdown_complete_user_data = client;
+
+    client->connection_manager = client->function_table->aws_http_connection_manager_new(allocator, &manager_options);
+    if (client->connection_manager == NULL) {
+        goto on_manager_error;
+    }
+
+    return client;
+
+on_manager_error:
+    aws_hash_table_clean_up(&client->in_flight_gets);
+
+on_table_error:
+    aws_mutex_clean_up(&client->lock);
+
+on_mutex_error:
+    aws_mem_release(allocator, client);
+
+    return NULL;
+}
+
+struct aws_imds_client *aws_imds_client_new(
+    struct aws_allocator *allocator,
+    const struct aws_imds_client_options *options) {
+
+    return s_imds_client_new(allocator, options);
+}
+
+struct aws_imds_client *aws_imds_client_acquire_shared(
+    struct aws_allocator *allocator,
+    const struct aws_imds_client_options *options) {
+
+    struct aws_credentials_provider_system_vtable *function_table = options->function_table;
+    if (function_table == NULL) {
+        function_table = &s_default_function_table;
+    }
+
+    size_t max_connections = options->max_connections;
+    if (max_connections == 0) {
+        max_connections = IMDS_DEFAULT_MAX_CONNECTIONS;
+    }
+
+    aws_mutex_lock(&s_client_ref_lock);
+
+    struct aws_imds_client *client = s_shared_clients;
+    while (client != NULL && (client->bootstrap != options->bootstrap || client->max_connections != max_connections ||
+                              client->function_table != function_table)) {
+        client = client->next_shared;
+    }
+
+    if (client != NULL) {
+        ++client->ref_count;
+    } else {
+        client = s_imds_client_new(allocator, options);
+        if (client != NULL) {
+            client->is_shared = true;
+            client->next_shared = s_shared_clients;
+            s_shared_clients = client;
+        }
+    }
+
+    aws_mutex_unlock(&s_client_ref_lock);
+
+    return client;
+}
+
+void aws_imds_client_acquire(struct aws_imds_client *client) {
+    aws_mutex_lock(&s_client_ref_lock);
+    ++client->ref_count;
+    aws_mutex_unlock(&s_client_ref_lock);
+}
+
+void aws_imds_client_release(
+    struct aws_imds_client *client,
+    aws_imds_client_on_released_fn *on_released,
+    void *user_data) {
+
+    if (client == NULL) {
+        return;
+    }
+
+    aws_mutex_lock(&s_client_ref_lock);
+
+    bool is_last_reference = --client->ref_count == 0;
+    if (is_last_reference && client->is_shared) {
+        struct aws_imds_client **link = &s_shared_clients;
+        while (*link != client) {
+            link = &(*link)->next_shared;
+        }
+        *link = client->next_shared;
+    }
+
+    aws_mutex_unlock(&s_client_ref_lock);
+
+    if (!is_last_reference) {
+        if (on_released != NULL) {
+            on_released(user_data);
+        }
+        return;
+    }
+
+    client->on_released = on_released;
+    client->on_released_user_data = user_data;
+
+    /* freeing the client takes place in the connection manager's shutdown callback */
+    client->function_table->aws_http_connection_manager_release(client->connection_manager);
+}
+
+static void s_imds_get_request_destroy(struct imds_get_request *get) {
+    if (get->connection != NULL) {
+        get->client->function_table->aws_http_connection_manager_release_connection(
+            get->client->connection_manager, get->connection);
+    }
+
+    if (get->request != NULL) {
+        aws_http_message_destroy(get->request);
+    }
+
+    aws_byte_buf_clean_up(&get->response);
+    aws_array_list_clean_up(&get->waiters);
+    aws_string_destroy(get->resource_path);
+
+    aws_imds_client_release(get->client, NULL, NULL);
+
+    aws_mem_release(get->allocator, get);
+}
+
+static struct imds_get_request *s_imds_get_request_new(
+    struct aws_imds_client *client,
+    struct aws_byte_cursor resource_path) {
+
+    struct imds_get_request *get = aws_mem_calloc(client->allocator, 1, sizeof(struct imds_get_request));
+    if (get == NULL) {
+        return NULL;
+    }
+
+    get->allocator = client->allocator;
+    get->client = client;
+    aws_imds_client_acquire(client);
+
+    get->resource_path = aws_string_new_from_array(client->allocator, resource_path.ptr, resource_path.len);
+    if (get->resource_path == NULL) {
+        goto on_error;
+    }
+
+    get->key = aws_byte_cursor_from_string(get->resource_path);
+
+    if (aws_array_list_init_dynamic(
+            &get->waiters, client->allocator, IMDS_GET_WAITERS_DEFAULT_SIZE, sizeof(struct imds_get_waiter))) {
+        goto on_error;
+    }
+
+    if (aws_byte_buf_init(&get->response, client->allocator, IMDS_RESPONSE_SIZE_INITIAL)) {
+        goto on_error;
+    }
+
+    return get;
+
+on_error:
+
+    s_imds_get_request_destroy(get);
+
+    return NULL;
+}
+
+/*
+ * No matter the result, this always gets called once a get has been started
+ */
+static void s_imds_get_request_complete(struct imds_get_request *get, int error_code) {
+    struct aws_imds_client *client = get->client;
+
+    /* once out of the table, nobody else can join, so the waiter list is final */
+    if (get->is_joinable) {
+        aws_mutex_lock(&client->lock);
+        aws_hash_table_remove(&client->in_flight_gets, &get->key, NULL, NULL);
+        aws_mutex_unlock(&client->lock);
+    }
+
+    if (error_code == AWS_ERROR_SUCCESS && get->status_code != 200) {
+        error_code = AWS_ERROR_HTTP_UNKNOWN;
+    }
+
+    /* hand the connection back before the callbacks, which may well start the next get */
+    if (get->connection != NULL) {
+        client->function_table->aws_http_connection_manager_release_connection(
+            client->connection_manager, get->connection);
+        get->connection = NULL;
+    }
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+        "(id=%p) IMDS get of %s completed with error code %d for %zu caller(s)",
+        (void *)client,
+        aws_string_c_str(get->resource_path),
+        error_code,
+        aws_array_list_length(&get->waiters));
+
+    const struct aws_byte_buf *resource = error_code == AWS_ERROR_SUCCESS ? &get->response : NULL;
+
+    size_t waiter_count = aws_array_list_length(&get->waiters);
+    for (size_t i = 0; i < waiter_count; ++i) {
+        struct imds_get_waiter waiter;
+        if (aws_array_list_get_at(&get->waiters, &waiter, i)) {
+            continue;
+        }
+
+        waiter.callback(resource, error_code, waiter.user_data);
+    }
+
+    s_imds_get_request_destroy(get);
+}
+
+static int s_imds_on_incoming_body_fn(
+    struct aws_http_stream *stream,
+    const struct aws_byte_cursor *data,
+    void *user_data) {
+
+    (void)stream;
+
+    struct imds_get_request *get = user_data;
+    struct aws_imds_client *client = get->client;
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_AUTH_CREDENTIALS_PROVIDER, "(id=%p) IMDS client received %zu response bytes", (void *)client, data->len);
+
+    if (data->len + get->response.len > IMDS_RESPONSE_SIZE_LIMIT) {
+        client->function_table->aws_http_connection_close(get->connection);
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+            "(id=%p) IMDS client query response exceeded maximum allowed length",
+            (void *)client);
+
+        return AWS_OP_ERR;
+    }
+
+    if (aws_byte_buf_append_dynamic(&get->response, data)) {
+        client->function_table->aws_http_connection_close(get->connection);
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER, "(id=%p) IMDS client query error appending response", (void *)client);
+
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_imds_on_incoming_headers_fn(
+    struct aws_http_stream *stream,
+    enum aws_http_header_block header_block,
+    const struct aws_http_header *header_array,
+    size_t num_headers,
+    void *user_data) {
+
+    (void)header_array;
+    (void)num_headers;
+
+    if (header_block != AWS_HTTP_HEADER_BLOCK_MAIN) {
+        return AWS_OP_SUCCESS;
+    }
+
+    struct imds_get_request *get = user_data;
+    if (get->status_code == 0) {
+        struct aws_imds_client *client = get->client;
+        if (client->function_table->aws_http_stream_get_incoming_response_status(stream, &get->status_code)) {
+
+            AWS_LOGF_ERROR(
+                AWS_LS_AUTH_CREDENTIALS_PROVIDER, "(id=%p) IMDS client failed to get http status code", (void *)client);
+
+            return AWS_OP_ERR;
+        }
+        AWS_LOGF_DEBUG(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+            "(id=%p) IMDS client query received http status code %d",
+            (void *)client,
+            get->status_code);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static void s_imds_on_stream_complete_fn(struct aws_http_stream *stream, int error_code, void *user_data) {
+    struct imds_get_request *get = user_data;
+
+    get->client->function_table->aws_http_stream_release(stream);
+
+    s_imds_get_request_complete(get, error_code);
+}
+
+static int s_make_imds_http_query(struct imds_get_request *get) {
+    AWS_FATAL_ASSERT(get->connection);
+
+    struct aws_http_message *request = aws_http_message_new_request(get->allocator);
+    if (request == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_http_header accept_header = {
+        .name = aws_byte_cursor_from_string(s_imds_accept_header),
+        .value = aws_byte_cursor_from_string(s_imds_accept_header_value),
+    };
+    if (aws_http_message_add_header(request, accept_header)) {
+        goto on_error;
+    }
+
+    struct aws_http_header user_agent_header = {
+        .name = aws_byte_cursor_from_string(s_imds_user_agent_header),
+        .value = aws_byte_cursor_from_string(s_imds_user_agent_header_value),
+    };
+    if (aws_http_message_add_header(request, user_agent_header)) {
+        goto on_error;
+    }
+
+    struct aws_http_header keep_alive_header = {
+        .name = aws_byte_cursor_from_string(s_imds_h1_0_keep_alive_header),
+        .value = aws_byte_cursor_from_string(s_imds_h1_0_keep_alive_header_value),
+    };
+    if (aws_http_message_add_header(request, keep_alive_header)) {
+        goto on_error;
+    }
+
+    if (aws_http_message_set_request_path(request, aws_byte_cursor_from_string(get->resource_path))) {
+        goto on_error;
+    }
+
+    if (aws_http_message_set_request_method(request, aws_byte_cursor_from_c_str("GET"))) {
+        goto on_error;
+    }
+
+    get->request = request;
+
+    struct aws_http_make_request_options request_options = {
+        .self_size = sizeof(request_options),
+        .on_response_headers = s_imds_on_incoming_headers_fn,
+        .on_response_header_block_done = NULL,
+        .on_response_body = s_imds_on_incoming_body_fn,
+        .on_complete = s_imds_on_stream_complete_fn,
+        .user_data = get,
+        .request = request,
+    };
+
+    struct aws_http_stream *stream =
+        get->client->function_table->aws_http_connection_make_request(get->connection, &request_options);
+
+    return stream == NULL ? AWS_OP_ERR : AWS_OP_SUCCESS;
+
+on_error:
+
+    aws_http_message_destroy(request);
+
+    return AWS_OP_ERR;
+}
+
+static void s_imds_on_acquire_connection(struct aws_http_connection *connection, int error_code, void *user_data) {
+    struct imds_get_request *get = user_data;
+
+    if (connection == NULL) {
+        AWS_LOGF_WARN(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+            "id=%p: IMDS client failed to acquire a connection, error code %d(%s)",
+            (void *)get->client,
+            error_code,
+            aws_error_str(error_code));
+
+        s_imds_get_request_complete(get, error_code != AWS_ERROR_SUCCESS ? error_code : AWS_ERROR_HTTP_UNKNOWN);
+        return;
+    }
+
+    get->connection = connection;
+
+    if (s_make_imds_http_query(get)) {
+        s_imds_get_request_complete(get, aws_last_error());
+    }
+}
+
+static int s_get_resource(
+    struct aws_imds_client *client,
+    struct aws_byte_cursor resource_path,
+    aws_imds_client_on_get_resource_fn *callback,
+    void *user_data,
+    bool is_joinable) {
+
+    struct imds_get_waiter waiter = {
+        .callback = callback,
+        .user_data = user_data,
+    };
+
+    struct imds_get_request *get = s_imds_get_request_new(client, resource_path);
+    if (get == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    if (aws_array_list_push_back(&get->waiters, &waiter)) {
+        goto on_error;
+    }
+
+    if (is_joinable) {
+        aws_mutex_lock(&client->lock);
+
+        struct aws_hash_element *element = NULL;
+        int result = aws_hash_table_find(&client->in_flight_gets, &get->key, &element);
+        if (result == AWS_OP_SUCCESS && element != NULL) {
+            struct imds_get_request *in_flight_get = element->value;
+            result = aws_array_list_push_back(&in_flight_get->waiters, &waiter);
+            aws_mutex_unlock(&client->lock);
+
+            if (result == AWS_OP_SUCCESS) {
+                AWS_LOGF_DEBUG(
+                    AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+                    "(id=%p) IMDS client joined the outstanding get of %s",
+                    (void *)client,
+                    aws_string_c_str(get->resource_path));
+            }
+
+            s_imds_get_request_destroy(get);
+            return result;
+        }
+
+        if (result == AWS_OP_SUCCESS) {
+            result = aws_hash_table_put(&client->in_flight_gets, &get->key, get, NULL);
+        }
+
+        get->is_joinable = result == AWS_OP_SUCCESS;
+
+        aws_mutex_unlock(&client->lock);
+
+        if (result != AWS_OP_SUCCESS) {
+            goto on_error;
+        }
+    }
+
+    client->function_table->aws_http_connection_manager_acquire_connection(
+        client->connection_manager, s_imds_on_acquire_connection, get);
+
+    return AWS_OP_SUCCESS;
+
+on_error:
+
+    s_imds_get_request_destroy(get);
+
+    return AWS_OP_ERR;
+}
+
+int aws_imds_client_get_resource(
+    struct aws_imds_client *client,
+    struct aws_byte_cursor resource_path,
+    aws_imds_client_on_get_resource_fn *callback,
+    void *user_data) {
+
+    return s_get_resource(client, resource_path, callback, user_data, true /* is_joinable */);
+}
+
+int aws_imds_client_get_resource_uncoalesced(
+    struct aws_imds_client *client,
+    struct aws_byte_cursor resource_path,
+    aws_imds_client_on_get_resource_fn *callback,
+    void *user_data) {
+
+    return s_get_resource(client, resource_path, callback, user_data, false /* is_joinable */);
+}
+
+AWS_STATIC_STRING_FROM_LITERAL(s_imds_identity_document_path, "/latest/dynamic/instance-identity/document");
+AWS_STATIC_STRING_FROM_LITERAL(s_identity_region_name, "region");
+AWS_STATIC_STRING_FROM_LITERAL(s_identity_availability_zone_name, "availabilityZone");
+AWS_STATIC_STRING_FROM_LITERAL(s_identity_account_id_name, "accountId");
+AWS_STATIC_STRING_FROM_LITERAL(s_identity_instance_id_name, "instanceId");
+
+/*
+ * Tracking structure for an identity query that has to wait on the identity document
+ */
+struct imds_identity_query {
+    struct aws_allocator *allocator;
+    struct aws_imds_client *client;
+
+    /* exactly one of the two callbacks is set */
+    aws_imds_client_on_get_instance_identity_fn *identity_callback;
+    aws_imds_client_on_get_identity_field_fn *field_callback;
+
+    /* offset of the requested aws_string * within struct aws_imds_instance_identity, for field queries */
+    size_t field_offset;
+    void *user_data;
+};
+
+static struct aws_string *s_new_identity_field(
+    struct aws_allocator *allocator,
+    cJSON *root,
+    const struct aws_string *name) {
+
+    cJSON *field = cJSON_GetObjectItemCaseSensitive(root, aws_string_c_str(name));
+    if (!cJSON_IsString(field) || field->valuestring == NULL || field->valuestring[0] == '\0') {
+        return NULL;
+    }
+
+    return aws_string_new_from_c_str(allocator, field->valuestring);
+}
+
+/*
+ * The identity document looks something like:
+
+{
+  "accountId" : "123456789012",
+  "availabilityZone" : "us-west-2b",
+  "instanceId" : "i-0123456789abcdef0",
+  "region" : "us-west-2",
+  ...
+}
+
+ */
+static int s_parse_instance_identity(
+    struct aws_allocator *allocator,
+    const struct aws_byte_buf *document,
+    struct aws_imds_instance_identity *identity) {
+
+    AWS_ZERO_STRUCT(*identity);
+
+    int result = AWS_OP_ERR;
+    cJSON *document_root = NULL;
+
+    /* the document isn't null terminated */
+    struct aws_string *document_string = aws_string_new_from_array(allocator, document->buffer, document->len);
+    if (document_string == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    document_root = cJSON_Parse(aws_string_c_str(document_string));
+    if (document_root == NULL) {
+        goto done;
+    }
+
+    identity->region = s_new_identity_field(allocator, document_root, s_identity_region_name);
+    identity->availability_zone = s_new_identity_field(allocator, document_root, s_identity_availability_zone_name);
+    identity->account_id = s_new_identity_field(allocator, document_root, s_identity_account_id_name);
+    identity->instance_id = s_new_identity_field(allocator, document_root, s_identity_instance_id_name);
+
+    if (identity->region == NULL || identity->availability_zone == NULL || identity->account_id == NULL ||
+        identity->instance_id == NULL) {
+        goto done;
+    }
+
+    result = AWS_OP_SUCCESS;
+
+done:
+
+    if (result != AWS_OP_SUCCESS) {
+        aws_string_destroy(identity->region);
+        aws_string_destroy(identity->availability_zone);
+        aws_string_destroy(identity->account_id);
+        aws_string_destroy(identity->instance_id);
+        AWS_ZERO_STRUCT(*identity);
+    }
+
+    if (document_root != NULL) {
+        cJSON_Delete(document_root);
+    }
+
+    aws_string_destroy(document_string);
+
+    return result;
+}
+
+static void s_complete_identity_query(
+    struct imds_identity_query *query,
+    const struct aws_imds_instance_identity *identity,
+    int error_code) {
+
+    if (query->identity_callback != NULL) {
+        query->identity_callback(identity, error_code, query->user_data);
+        return;
+    }
+
+    struct aws_byte_cursor value;
+    AWS_ZERO_STRUCT(value);
+    if (identity != NULL) {
+        const struct aws_string *field = *(struct aws_string **)((uint8_t *)identity + query->field_offset);
+        value = aws_byte_cursor_from_string(field);
+    }
+
+    query->field_callback(value, error_code, query->user_data);
+}
+
+static void s_on_identity_document(const struct aws_byte_buf *resource, int error_code, void *user_data) {
+    struct imds_identity_query *query = user_data;
+    struct aws_imds_client *client = query->client;
+
+    const struct aws_imds_instance_identity *identity = NULL;
+
+    if (resource != NULL && error_code == AWS_ERROR_SUCCESS) {
+        struct aws_imds_instance_identity parsed_identity;
+        if (s_parse_instance_identity(query->allocator, resource, &parsed_identity) == AWS_OP_SUCCESS) {
+            aws_mutex_lock(&client->lock);
+            if (!client->has_identity) {
+                client->identity = parsed_identity;
+                client->has_identity = true;
+                AWS_ZERO_STRUCT(parsed_identity);
+            }
+            aws_mutex_unlock(&client->lock);
+
+            /* someone else may have cached an identical document first */
+            aws_string_destroy(parsed_identity.region);
+            aws_string_destroy(parsed_identity.availability_zone);
+            aws_string_destroy(parsed_identity.account_id);
+            aws_string_destroy(parsed_identity.instance_id);
+
+            identity = &client->identity;
+        } else {
+            AWS_LOGF_ERROR(
+                AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+                "(id=%p) IMDS client failed to parse the instance identity document",
+                (void *)client);
+            error_code = AWS_ERROR_HTTP_UNKNOWN;
+        }
+    } else if (error_code == AWS_ERROR_SUCCESS) {
+        error_code = AWS_ERROR_HTTP_UNKNOWN;
+    }
+
+    s_complete_identity_query(query, identity, error_code);
+
+    aws_mem_release(query->allocator, query);
+}
+
+static int s_get_identity(
+    struct aws_imds_client *client,
+    aws_imds_client_on_get_instance_identity_fn *identity_callback,
+    aws_imds_client_on_get_identity_field_fn *field_callback,
+    size_t field_offset,
+    void *user_data) {
+
+    struct imds_identity_query query = {
+        .allocator = client->allocator,
+        .client = client,
+        .identity_callback = identity_callback,
+        .field_callback = field_callback,
+        .field_offset = field_offset,
+        .user_data = user_data,
+    };
+
+    aws_mutex_lock(&client->lock);
+    bool has_identity = client->has_identity;
+    aws_mutex_unlock(&client->lock);
+
+    if (has_identity) {
+        s_complete_identity_query(&query, &client->identity, AWS_ERROR_SUCCESS);
+        return AWS_OP_SUCCESS;
+    }
+
+    struct imds_identity_query *pending_query = aws_mem_acquire(client->allocator, sizeof(struct imds_identity_query));
+    if (pending_query == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    *pending_query = query;
+
+    /* concurrent queries all join the same get of the document */
+    struct aws_byte_cursor document_path = aws_byte_cursor_from_string(s_imds_identity_document_path);
+    if (aws_imds_client_get_resource(client, document_path, s_on_identity_document, pending_query)) {
+        aws_mem_release(client->allocator, pending_query);
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+int aws_imds_client_get_instance_identity(
+    struct aws_imds_client *client,
+    aws_imds_client_on_get_instance_identity_fn *callback,
+    void *user_data) {
+
+    return s_get_identity(client, callback, NULL, 0, user_data);
+}
+
+int aws_imds_client_get_region(
+    struct aws_imds_client *client,
+    aws_imds_client_on_get_identity_field_fn *callback,
+    void *user_data) {
+
+    return s_get_identity(client, NULL, callback, offsetof(struct aws_imds_instance_identity, region), user_data);
+}
+
+int aws_imds_client_get_availability_zone(
+    struct aws_imds_client *client,
+    aws_imds_client_on_get_identity_field_fn *callback,
+    void *user_data) {
+
+    return s_get_identity(
+        client, NULL, callback, offsetof(struct aws_imds_instance_identity, availability_zone), user_data);
+}
+
+int aws_imds_client_get_account_id(
+    struct aws_imds_client *client,
+    aws_imds_client_on_get_identity_field_fn *callback,
+    void *user_data) {
+
+    return s_get_identity(client, NULL, callback, offsetof(struct aws_imds_instance_identity, account_id), user_data);
+}
+
+int aws_imds_client_get_instance_id(
+    struct aws_imds_client *client,
+    aws_imds_client_on_get_identity_field_fn *callback,
+    void *user_data) {
+
+    return s_get_identity(client, NULL, callback, offsetof(struct aws_imds_instance_identity, instance_id), user_data);
+}
@@ -0,0 +1,765 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/multipart_upload_signer.h>
+
+#include <aws/auth/credentials.h>
+#include <aws/auth/private/aws_signing.h>
+#include <aws/auth/signing_result.h>
+#include <aws/cal/hash.h>
+#include <aws/cal/hmac.h>
+#include <aws/common/clock.h>
+#include <aws/common/condition_variable.h>
+#include <aws/common/date_time.h>
+#include <aws/common/encoding.h>
+#include <aws/common/linked_list.h>
+#include <aws/common/mutex.h>
+#include <aws/common/string.h>
+#include <aws/common/system_info.h>
+#include <aws/common/thread.h>
+#include <aws/io/stream.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#if defined(_MSC_VER)
+#    pragma warning(disable : 4204)
+#endif /* _MSC_VER */
+
+#define MULTIPART_UPLOAD_SIGNER_MAX_THREAD_COUNT 64
+#define SECONDS_PER_DAY 86400
+#define PART_BODY_READ_SIZE (64 * 1024)
+#define PART_SCRATCH_STARTING_SIZE 512
+
+/* longest decimal part number plus a terminator */
+#define PART_NUMBER_STR_MAX_LEN 11
+
+AWS_STATIC_STRING_FROM_LITERAL(s_default_service, "s3");
+AWS_STATIC_STRING_FROM_LITERAL(s_signed_headers, "host;x-amz-content-sha256;x-amz-date");
+AWS_STATIC_STRING_FROM_LITERAL(
+    s_signed_headers_with_token,
+    "host;x-amz-content-sha256;x-amz-date;x-amz-security-token");
+
+/*
+ * A part waiting for a hashing thread
+ */
+struct pending_part {
+    struct aws_linked_list_node node;
+    uint32_t part_number;
+    struct aws_input_stream *body;
+    aws_multipart_upload_part_signed_fn *callback;
+    void *user_data;
+};
+
+struct aws_multipart_upload_signer {
+    struct aws_allocator *allocator;
+    aws_io_clock_fn *clock_fn;
+    struct aws_credentials *credentials;
+    struct aws_string *region;
+    struct aws_string *service;
+    struct aws_string *path;
+
+    /*
+     * Templates, immutable after creation.  A part's canonical request is
+     *
+     *   canonical_prefix <part number> canonical_before_hash <payload hash> "\nx-amz-date:" <date>
+     *   canonical_after_date <payload hash>
+     *
+     * and its authorization value is
+     *
+     *   authorization_prefix <credential scope> authorization_before_signature <signature>
+     */
+    struct aws_byte_buf encoded_upload_id;
+    struct aws_byte_buf canonical_prefix;
+    struct aws_byte_buf canonical_before_hash;
+    struct aws_byte_buf canonical_after_date;
+    struct aws_byte_buf authorization_prefix;
+    struct aws_byte_buf authorization_before_signature;
+
+    struct aws_thread threads[MULTIPART_UPLOAD_SIGNER_MAX_THREAD_COUNT];
+    size_t thread_count;
+
+    struct aws_mutex lock;
+
+    /* everything below is protected by lock */
+
+    struct aws_condition_variable signal;
+    struct aws_linked_list pending_parts;
+    bool should_quit;
+
+    /* the signing key for key_day, derived by whichever thread first needed it */
+    bool has_key;
+    int64_t key_day;
+    uint8_t key[AWS_SHA256_LEN];
+};
+
+/*
+ * Per-thread buffers, reused from part to part
+ */
+struct part_signing_scratch {
+    struct aws_byte_buf body;
+    struct aws_byte_buf payload_hash;
+    struct aws_byte_buf date;
+    struct aws_byte_buf credential_scope;
+    struct aws_byte_buf canonical_request;
+    struct aws_byte_buf string_to_sign;
+    struct aws_byte_buf authorization;
+};
+
+static int s_append_cursors(struct aws_byte_buf *dest, const struct aws_byte_cursor *cursors, size_t cursor_count) {
+    for (size_t i = 0; i < cursor_count; ++i) {
+        if (aws_byte_buf_append_dynamic(dest, &cursors[i])) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_append_part_number(struct aws_byte_buf *dest, uint32_t part_number) {
+    char part_number_str[PART_NUMBER_STR_MAX_LEN];
+    snprintf(part_number_str, sizeof(part_number_str), "%" PRIu32, part_number);
+
+    struct aws_byte_cursor part_number_cursor = aws_byte_cursor_from_c_str(part_number_str);
+    return aws_byte_buf_append_dynamic(dest, &part_number_cursor);
+}
+
+static int s_build_templates(
+    struct aws_multipart_upload_signer *signer,
+    const struct aws_multipart_upload_signer_options *options) {
+
+    struct aws_allocator *allocator = signer->allocator;
+    const struct aws_credentials *credentials = signer->credentials;
+
+    struct aws_byte_cursor service = options->service;
+    if (service.len == 0) {
+        service = aws_byte_cursor_from_string(s_default_service);
+    }
+
+    const struct aws_string *signed_headers =
+        credentials->session_token != NULL ? s_signed_headers_with_token : s_signed_headers;
+
+    signer->region = aws_string_new_from_array(allocator, options->region.ptr, options->region.len);
+    signer->service = aws_string_new_from_array(allocator, service.ptr, service.len);
+    signer->path = aws_string_new_from_array(allocator, options->path.ptr, options->path.len);
+    if (signer->region == NULL || signer->service == NULL || signer->path == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    if (aws_byte_buf_init(&signer->encoded_upload_id, allocator, options->upload_id.len) ||
+        aws_byte_buf_append_encoding_uri_param(&signer->encoded_upload_id, &options->upload_id)) {
+        return AWS_OP_ERR;
+    }
+
+    if (aws_byte_buf_init(&signer->canonical_prefix, allocator, PART_SCRATCH_STARTING_SIZE) ||
+        aws_byte_buf_init(&signer->canonical_before_hash, allocator, PART_SCRATCH_STARTING_SIZE) ||
+        aws_byte_buf_init(&signer->canonical_after_date, allocator, PART_SCRATCH_STARTING_SIZE) ||
+        aws_byte_buf_init(&signer->authorization_prefix, allocator, PART_SCRATCH_STARTING_SIZE) ||
+        aws_byte_buf_init(&signer->authorization_before_signature, allocator, PART_SCRATCH_STARTING_SIZE)) {
+        return AWS_OP_ERR;
+    }
+
+    /* query params sort partNumber before uploadId, and the signed headers are already in canonical order */
+    struct aws_byte_cursor canonical_prefix[] = {
+        aws_byte_cursor_from_c_str("PUT\n"),
+        options->path,
+        aws_byte_cursor_from_c_str("\npartNumber="),
+    };
+
+    struct aws_byte_cursor canonical_before_hash[] = {
+        aws_byte_cursor_from_c_str("&uploadId="),
+        aws_byte_cursor_from_buf(&signer->encoded_upload_id),
+        aws_byte_cursor_from_c_str("\nhost:"),
+        options->host,
+        aws_byte_cursor_from_c_str("\nx-amz-content-sha256:"),
+    };
+
+    if (s_append_cursors(&signer->canonical_prefix, canonical_prefix, AWS_ARRAY_SIZE(canonical_prefix)) ||
+        s_append_cursors(
+            &signer->canonical_before_hash, canonical_before_hash, AWS_ARRAY_SIZE(canonical_before_hash))) {
+        return AWS_OP_ERR;
+    }
+
+    if (credentials->session_token != NULL) {
+        struct aws_byte_cursor token_header[] = {
+            aws_byte_cursor_from_c_str("\nx-amz-security-token:"),
+            aws_byte_cursor_from_string(credentials->session_token),
+        };
+
+        if (s_append_cursors(&signer->canonical_after_date, token_header, AWS_ARRAY_SIZE(token_header))) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    struct aws_byte_cursor canonical_after_date[] = {
+        aws_byte_cursor_from_c_str("\n\n"),
+        aws_byte_cursor_from_string(signed_headers),
+        aws_byte_cursor_from_c_str("\n"),
+    };
+
+    struct aws_byte_cursor authorization_prefix[] = {
+        aws_byte_cursor_from_string(g_aws_signing_sigv4_algorithm),
+        aws_byte_cursor_from_c_str(" Credential="),
+        aws_byte_cursor_from_string(credentials->access_key_id),
+        aws_byte_cursor_from_c_str("/"),
+    };
+
+    struct aws_byte_cursor authorization_before_signature[] = {
+        aws_byte_cursor_from_c_str(", SignedHeaders="),
+        aws_byte_cursor_from_string(signed_headers),
+        aws_byte_cursor_from_c_str(", Signature="),
+    };
+
+    if (s_append_cursors(&signer->canonical_after_date, canonical_after_date, AWS_ARRAY_SIZE(canonical_after_date)) ||
+        s_append_cursors(&signer->authorization_prefix, authorization_prefix, AWS_ARRAY_SIZE(authorization_prefix)) ||
+        s_append_cursors(
+            &signer->authorization_before_signature,
+            authorization_before_signature,
+            AWS_ARRAY_SIZE(authorization_before_signature))) {
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_scratch_init(struct part_signing_scratch *scratch, struct aws_allocator *allocator) {
+    AWS_ZERO_STRUCT(*scratch);
+
+    if (aws_byte_buf_init(&scratch->body, allocator, PART_BODY_READ_SIZE) ||
+        aws_byte_buf_init(&scratch->payload_hash, allocator, AWS_SHA256_LEN * 2) ||
+        aws_byte_buf_init(&scratch->date, allocator, AWS_DATE_TIME_STR_MAX_LEN) ||
+        aws_byte_buf_init(&scratch->credential_scope, allocator, PART_SCRATCH_STARTING_SIZE) ||
+        aws_byte_buf_init(&scratch->canonical_request, allocator, PART_SCRATCH_STARTING_SIZE) ||
+        aws_byte_buf_init(&scratch->string_to_sign, allocator, PART_SCRATCH_STARTING_SIZE) ||
+        aws_byte_buf_init(&scratch->authorization, allocator, PART_SCRATCH_STARTING_SIZE)) {
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static void s_scratch_clean_up(struct part_signing_scratch *scratch) {
+    aws_byte_buf_clean_up(&scratch->body);
+    aws_byte_buf_clean_up(&scratch->payload_hash);
+    aws_byte_buf_clean_up(&scratch->date);
+    aws_byte_buf_clean_up(&scratch->credential_scope);
+    aws_byte_buf_clean_up(&scratch->canonical_request);
+    aws_byte_buf_clean_up(&scratch->string_to_sign);
+    aws_byte_buf_clean_up(&scratch->authorization);
+}
+
+static int s_hash_part_body(
+    struct aws_allocator *allocator,
+    struct aws_input_stream *body,
+    struct part_signing_scratch *scratch) {
+
+    struct aws_hash *hash = aws_sha256_new(allocator);
+    if (hash == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    int result = AWS_OP_ERR;
+
+    if (body != NULL) {
+        if (aws_input_stream_seek(body, 0, AWS_SSB_BEGIN)) {
+            goto done;
+        }
+
+        struct aws_stream_status body_status;
+        AWS_ZERO_STRUCT(body_status);
+
+        while (!body_status.is_end_of_stream) {
+            scratch->body.len = 0;
+            if (aws_input_stream_read(body, &scratch->body)) {
+                goto done;
+            }
+
+            if (scratch->body.len > 0) {
+                struct aws_byte_cursor body_cursor = aws_byte_cursor_from_buf(&scratch->body);
+                if (aws_hash_update(hash, &body_cursor)) {
+                    goto done;
+                }
+            }
+
+            if (aws_input_stream_get_status(body, &body_status)) {
+                goto done;
+            }
+        }
+
+        /* rewind for sending */
+        if (aws_input_stream_seek(body, 0, AWS_SSB_BEGIN)) {
+            goto done;
+        }
+    }
+
+    uint8_t digest[AWS_SHA256_LEN];
+    struct aws_byte_buf digest_buf = aws_byte_buf_from_empty_array(digest, sizeof(digest));
+    if (aws_hash_finalize(hash, &digest_buf, 0)) {
+        goto done;
+    }
+
+    struct aws_byte_cursor digest_cursor = aws_byte_cursor_from_buf(&digest_buf);
+    scratch->payload_hash.len = 0;
+    if (aws_hex_encode_append_dynamic(&digest_cursor, &scratch->payload_hash)) {
+        goto done;
+    }
+
+    result = AWS_OP_SUCCESS;
+
+done:
+
+    aws_hash_destroy(hash);
+
+    return result;
+}
+
+/*
+ * Copies out the key for day, deriving (and keeping) it first if the cached one is for another day
+ */
+static int s_get_signing_key(
+    struct aws_multipart_upload_signer *signer,
+    const struct aws_date_time *date,
+    int64_t day,
+    uint8_t *key) {
+
+    aws_mutex_lock(&signer->lock);
+    bool is_cached = signer->has_key && signer->key_day == day;
+    if (is_cached) {
+        memcpy(key, signer->key, AWS_SHA256_LEN);
+    }
+    aws_mutex_unlock(&signer->lock);
+
+    if (is_cached) {
+        return AWS_OP_SUCCESS;
+    }
+
+    struct aws_byte_cursor region = aws_byte_cursor_from_string(signer->region);
+    struct aws_byte_cursor service = aws_byte_cursor_from_string(signer->service);
+
+    struct aws_byte_buf key_buf = aws_byte_buf_from_empty_array(key, AWS_SHA256_LEN);
+    if (aws_signing_derive_sigv4_signing_key(
+            signer->allocator, signer->credentials->secret_access_key, date, &region, &service, &key_buf)) {
+        return AWS_OP_ERR;
+    }
+
+    aws_mutex_lock(&signer->lock);
+    if (!signer->has_key || day >= signer->key_day) {
+        signer->has_key = true;
+        signer->key_day = day;
+        memcpy(signer->key, key, AWS_SHA256_LEN);
+    }
+    aws_mutex_unlock(&signer->lock);
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_sign_part(
+    struct aws_multipart_upload_signer *signer,
+    struct pending_part *part,
+    struct part_signing_scratch *scratch,
+    struct aws_signing_result *result) {
+
+    struct aws_allocator *allocator = signer->allocator;
+
+    if (s_hash_part_body(allocator, part->body, scratch)) {
+        return AWS_OP_ERR;
+    }
+
+    /* the date is taken after hashing so that it's as fresh as possible when the request goes out */
+    uint64_t now_ns = 0;
+    if (signer->clock_fn(&now_ns)) {
+        return AWS_OP_ERR;
+    }
+
+    uint64_t now_ms = aws_timestamp_convert(now_ns, AWS_TIMESTAMP_NANOS, AWS_TIMESTAMP_MILLIS, NULL);
+    int64_t day = (int64_t)(now_ms / 1000 / SECONDS_PER_DAY);
+
+    struct aws_date_time date;
+    aws_date_time_init_epoch_millis(&date, now_ms);
+
+    struct aws_byte_cursor region = aws_byte_cursor_from_string(signer->region);
+    struct aws_byte_cursor service = aws_byte_cursor_from_string(signer->service);
+
+    scratch->date.len = 0;
+    scratch->credential_scope.len = 0;
+    if (aws_date_time_to_utc_time_str(&date, AWS_DATE_FORMAT_ISO_8601_BASIC, &scratch->date) ||
+        aws_signing_append_sigv4_credential_scope(&date, &region, &service, &scratch->credential_scope)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_byte_cursor payload_hash = aws_byte_cursor_from_buf(&scratch->payload_hash);
+    struct aws_byte_cursor date_cursor = aws_byte_cursor_from_buf(&scratch->date);
+    struct aws_byte_cursor credential_scope_cursor = aws_byte_cursor_from_buf(&scratch->credential_scope);
+
+    /*
+     * Canonical request
+     */
+    scratch->canonical_request.len = 0;
+    struct aws_byte_cursor canonical_prefix = aws_byte_cursor_from_buf(&signer->canonical_prefix);
+    if (aws_byte_buf_append_dynamic(&scratch->canonical_request, &canonical_prefix) ||
+        s_append_part_number(&scratch->canonical_request, part->part_number)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_byte_cursor canonical_rest[] = {
+        aws_byte_cursor_from_buf(&signer->canonical_before_hash),
+        payload_hash,
+        aws_byte_cursor_from_c_str("\nx-amz-date:"),
+        date_cursor,
+        aws_byte_cursor_from_buf(&signer->canonical_after_date),
+        payload_hash,
+    };
+
+    if (s_append_cursors(&scratch->canonical_request, canonical_rest, AWS_ARRAY_SIZE(canonical_rest))) {
+        return AWS_OP_ERR;
+    }
+
+    /*
+     * String to sign
+     */
+    uint8_t digest[AWS_SHA256_LEN];
+    struct aws_byte_buf digest_buf = aws_byte_buf_from_empty_array(digest, sizeof(digest));
+    struct aws_byte_cursor canonical_request_cursor = aws_byte_cursor_from_buf(&scratch->canonical_request);
+    if (aws_sha256_compute(allocator, &canonical_request_cursor, &digest_buf, 0)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_byte_cursor string_to_sign_prefix[] = {
+        aws_byte_cursor_from_string(g_aws_signing_sigv4_algorithm),
+        aws_byte_cursor_from_c_str("\n"),
+        date_cursor,
+        aws_byte_cursor_from_c_str("\n"),
+        credential_scope_cursor,
+        aws_byte_cursor_from_c_str("\n"),
+    };
+
+    scratch->string_to_sign.len = 0;
+    struct aws_byte_cursor digest_cursor = aws_byte_cursor_from_buf(&digest_buf);
+    if (s_append_cursors(&scratch->string_to_sign, string_to_sign_prefix, AWS_ARRAY_SIZE(string_to_sign_prefix)) ||
+        aws_hex_encode_append_dynamic(&digest_cursor, &scratch->string_to_sign)) {
+        return AWS_OP_ERR;
+    }
+
+    /*
+     * Signature and authorization value
+     */
+    uint8_t key[AWS_SHA256_LEN];
+    if (s_get_signing_key(signer, &date, day, key)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_byte_cursor key_cursor = aws_byte_cursor_from_array(key, sizeof(key));
+    struct aws_byte_cursor string_to_sign_cursor = aws_byte_cursor_from_buf(&scratch->string_to_sign);
+    digest_buf.len = 0;
+    int hmac_result = aws_sha256_hmac_compute(allocator, &key_cursor, &string_to_sign_cursor, &digest_buf, 0);
+    aws_secure_zero(key, sizeof(key));
+    if (hmac_result) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_byte_cursor authorization_prefix[] = {
+        aws_byte_cursor_from_buf(&signer->authorization_prefix),
+        credential_scope_cursor,
+        aws_byte_cursor_from_buf(&signer->authorization_before_signature),
+    };
+
+    scratch->authorization.len = 0;
+    digest_cursor = aws_byte_cursor_from_buf(&digest_buf);
+    if (s_append_cursors(&scratch->authorization, authorization_prefix, AWS_ARRAY_SIZE(authorization_prefix)) ||
+        aws_hex_encode_append_dynamic(&digest_cursor, &scratch->authorization)) {
+        return AWS_OP_ERR;
+    }
+
+    /*
+     * Signed headers
+     */
+    struct aws_byte_cursor content_header_name = aws_byte_cursor_from_string(g_aws_signing_content_header_name);
+    struct aws_byte_cursor date_header_name = aws_byte_cursor_from_string(g_aws_signing_date_name);
+    struct aws_byte_cursor authorization_header_name =
+        aws_byte_cursor_from_string(g_aws_signing_authorization_header_name);
+    struct aws_byte_cursor authorization_cursor = aws_byte_cursor_from_buf(&scratch->authorization);
+
+    if (aws_signing_result_append_property_list(
+            result, g_aws_http_headers_property_list_name, &content_header_name, &payload_hash) ||
+        aws_signing_result_append_property_list(
+            result, g_aws_http_headers_property_list_name, &date_header_name, &date_cursor) ||
+        aws_signing_result_append_property_list(
+            result, g_aws_http_headers_property_list_name, &authorization_header_name, &authorization_cursor)) {
+        return AWS_OP_ERR;
+    }
+
+    if (signer->credentials->session_token != NULL) {
+        struct aws_byte_cursor token_header_name = aws_byte_cursor_from_string(g_aws_signing_security_token_name);
+        struct aws_byte_cursor token = aws_byte_cursor_from_string(signer->credentials->session_token);
+        if (aws_signing_result_append_property_list(
+                result, g_aws_http_headers_property_list_name, &token_header_name, &token)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static bool s_has_work_or_should_quit(void *user_data) {
+    struct aws_multipart_upload_signer *signer = user_data;
+
+    return signer->should_quit || !aws_linked_list_empty(&signer->pending_parts);
+}
+
+static void s_signing_thread_fn(void *user_data) {
+    struct aws_multipart_upload_signer *signer = user_data;
+    struct aws_allocator *allocator = signer->allocator;
+
+    struct part_signing_scratch scratch;
+    int scratch_error = AWS_ERROR_SUCCESS;
+    if (s_scratch_init(&scratch, allocator)) {
+        scratch_error = aws_last_error();
+    }
+
+    aws_mutex_lock(&signer->lock);
+
+    while (true) {
+        aws_condition_variable_wait_pred(&signer->signal, &signer->lock, s_has_work_or_should_quit, signer);
+
+        /* queued parts are drained before quitting */
+        if (aws_linked_list_empty(&signer->pending_parts)) {
+            break;
+        }
+
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(&signer->pending_parts);
+        aws_mutex_unlock(&signer->lock);
+
+        struct pending_part *part = AWS_CONTAINER_OF(node, struct pending_part, node);
+
+        struct aws_signing_result result;
+        int error_code = scratch_error;
+        if (error_code == AWS_ERROR_SUCCESS) {
+            if (aws_signing_result_init(&result, allocator)) {
+                error_code = aws_last_error();
+            } else {
+                if (s_sign_part(signer, part, &scratch, &result)) {
+                    error_code = aws_last_error();
+                    if (error_code == AWS_ERROR_SUCCESS) {
+                        error_code = AWS_ERROR_UNKNOWN;
+                    }
+                }
+
+                if (error_code == AWS_ERROR_SUCCESS) {
+                    part->callback(part->part_number, &result, AWS_ERROR_SUCCESS, part->user_data);
+                }
+
+                aws_signing_result_clean_up(&result);
+            }
+        }
+
+        if (error_code != AWS_ERROR_SUCCESS) {
+            AWS_LOGF_ERROR(
+                AWS_LS_AUTH_SIGNING,
+                "(id=%p) Failed to sign part %" PRIu32 " of multipart upload with error %d(%s)",
+                (void *)signer,
+                part->part_number,
+                error_code,
+                aws_error_str(error_code));
+
+            part->callback(part->part_number, NULL, error_code, part->user_data);
+        }
+
+        aws_mem_release(allocator, part);
+
+        aws_mutex_lock(&signer->lock);
+    }
+
+    aws_mutex_unlock(&signer->lock);
+
+    s_scratch_clean_up(&scratch);
+}
+
+static void s_clean_up_templates(struct aws_multipart_upload_signer *signer) {
+    aws_string_destroy(signer->region);
+    aws_string_destroy(signer->service);
+    aws_string_destroy(signer->path);
+    aws_byte_buf_clean_up(&signer->encoded_upload_id);
+    aws_byte_buf_clean_up(&signer->canonical_prefix);
+    aws_byte_buf_clean_up(&signer->canonical_before_hash);
+    aws_byte_buf_clean_up(&signer->canonical_after_date);
+    aws_byte_buf_clean_up(&signer->authorization_prefix);
+    aws_byte_buf_clean_up(&signer->authorization_before_signature);
+}
+
+static void s_join_threads(struct aws_multipart_upload_signer *signer) {
+    aws_mutex_lock(&signer->lock);
+    signer->should_quit = true;
+    aws_condition_variable_notify_all(&signer->signal);
+    aws_mutex_unlock(&signer->lock);
+
+    for (size_t i = 0; i < signer->thread_count; ++i) {
+        aws_thread_join(&signer->threads[i]);
+        aws_thread_clean_up(&signer->threads[i]);
+    }
+
+    signer->thread_count = 0;
+}
+
+struct aws_multipart_upload_signer *aws_multipart_upload_signer_new(
+    struct aws_allocator *allocator,
+    const struct aws_multipart_upload_signer_options *options) {
+
+    if (options->credentials == NULL || options->region.len == 0 || options->host.len == 0 ||
+        options->path.len == 0 || options->upload_id.len == 0) {
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_SIGNING,
+            "(id=%p) Multipart upload signer options are missing credentials, a region, a host, a path or an upload "
+            "id",
+            (void *)options);
+        aws_raise_error(AWS_AUTH_SIGNING_INVALID_CONFIGURATION);
+        return NULL;
+    }
+
+    struct aws_multipart_upload_signer *signer =
+        aws_mem_calloc(allocator, 1, sizeof(struct aws_multipart_upload_signer));
+    if (signer == NULL) {
+        return NULL;
+    }
+
+    signer->allocator = allocator;
+    signer->clock_fn = options->clock_fn != NULL ? options->clock_fn : aws_sys_clock_get_ticks;
+    aws_linked_list_init(&signer->pending_parts);
+
+    size_t thread_count = options->thread_count;
+    if (thread_count == 0) {
+        thread_count = aws_system_info_processor_count();
+    }
+
+    if (thread_count > MULTIPART_UPLOAD_SIGNER_MAX_THREAD_COUNT) {
+        thread_count = MULTIPART_UPLOAD_SIGNER_MAX_THREAD_COUNT;
+    }
+
+    if (aws_mutex_init(&signer->lock)) {
+        goto on_mutex_error;
+    }
+
+    if (aws_condition_variable_init(&signer->signal)) {
+        goto on_signal_error;
+    }
+
+    signer->credentials = aws_credentials_new_copy(allocator, (struct aws_credentials *)options->credentials);
+    if (signer->credentials == NULL) {
+        goto on_error;
+    }
+
+    if (s_build_templates(signer, options)) {
+        goto on_error;
+    }
+
+    for (size_t i = 0; i < thread_count; ++i) {
+        struct aws_thread *thread = &signer->threads[i];
+        if (aws_thread_init(thread, allocator)) {
+            goto on_error;
+        }
+
+        struct aws_thread_options thread_options;
+        AWS_ZERO_STRUCT(thread_options);
+        if (aws_thread_launch(thread, s_signing_thread_fn, signer, &thread_options)) {
+            aws_thread_clean_up(thread);
+            goto on_error;
+        }
+
+        ++signer->thread_count;
+    }
+
+    return signer;
+
+on_error:
+    s_join_threads(signer);
+    s_clean_up_templates(signer);
+    aws_credentials_destroy(signer->credentials);
+    aws_condition_variable_clean_up(&signer->signal);
+
+on_signal_error:
+    aws_mutex_clean_up(&signer->lock);
+
+on_mutex_error:
+    aws_mem_release(allocator, signer);
+
+    return NULL;
+}
+
+void aws_multipart_upload_signer_destroy(struct aws_multipart_upload_signer *signer) {
+    if (signer == NULL) {
+        return;
+    }
+
+    s_join_threads(signer);
+
+    s_clean_up_templates(signer);
+    aws_credentials_destroy(signer->credentials);
+    aws_secure_zero(signer->key, sizeof(signer->key));
+
+    aws_condition_variable_clean_up(&signer->signal);
+    aws_mutex_clean_up(&signer->lock);
+
+    aws_mem_release(signer->allocator, signer);
+}
+
+int aws_multipart_upload_signer_sign_part(
+    struct aws_multipart_upload_signer *signer,
+    uint32_t part_number,
+    struct aws_input_stream *body,
+    aws_multipart_upload_part_signed_fn *callback,
+    void *user_data) {
+
+    AWS_FATAL_ASSERT(callback != NULL);
+
+    if (part_number == 0 || part_number > AWS_MULTIPART_UPLOAD_MAX_PART_NUMBER) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    struct pending_part *part = aws_mem_calloc(signer->allocator, 1, sizeof(struct pending_part));
+    if (part == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    part->part_number = part_number;
+    part->body = body;
+    part->callback = callback;
+    part->user_data = user_data;
+
+    aws_mutex_lock(&signer->lock);
+    aws_linked_list_push_back(&signer->pending_parts, &part->node);
+    aws_condition_variable_notify_one(&signer->signal);
+    aws_mutex_unlock(&signer->lock);
+
+    return AWS_OP_SUCCESS;
+}
+
+int aws_multipart_upload_signer_append_part_path(
+    const struct aws_multipart_upload_signer *signer,
+    uint32_t part_number,
+    struct aws_byte_buf *dest) {
+
+    struct aws_byte_cursor path = aws_byte_cursor_from_string(signer->path);
+    struct aws_byte_cursor part_number_param = aws_byte_cursor_from_c_str("?partNumber=");
+    if (aws_byte_buf_append_dynamic(dest, &path) || aws_byte_buf_append_dynamic(dest, &part_number_param) ||
+        s_append_part_number(dest, part_number)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_byte_cursor upload_id_param[] = {
+        aws_byte_cursor_from_c_str("&uploadId="),
+        aws_byte_cursor_from_buf(&signer->encoded_upload_id),
+    };
+
+    return s_append_cursors(dest, upload_id_param, AWS_ARRAY_SIZE(upload_id_param));
+}
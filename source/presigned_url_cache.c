@@ -0,0 +1,626 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/presigned_url_cache.h>
+
+#include <aws/auth/credentials.h>
+#include <aws/auth/signable.h>
+#include <aws/auth/signing.h>
+#include <aws/auth/signing_result.h>
+#include <aws/common/clock.h>
+#include <aws/common/date_time.h>
+#include <aws/common/hash_table.h>
+#include <aws/common/mutex.h>
+#include <aws/common/string.h>
+#include <aws/http/request_response.h>
+
+#include <inttypes.h>
+
+#if defined(_MSC_VER)
+#    pragma warning(disable : 4204)
+#endif /* _MSC_VER */
+
+#define DEFAULT_PRESIGNED_URL_EXPIRATION_SECS 3600
+#define DEFAULT_PRESIGNED_URL_MIN_REMAINING_VALIDITY_SECS 300
+#define DEFAULT_PRESIGNED_URL_MAX_ENTRIES 1024
+#define PRESIGNED_URL_TABLE_DEFAULT_SIZE 64
+
+struct presigned_url_entry {
+    struct aws_allocator *allocator;
+
+    /* the table key; points into key_buf */
+    struct aws_byte_buf key_buf;
+    struct aws_byte_cursor key;
+
+    /* everything below is protected by the cache's lock */
+    struct aws_string *presigned_path;
+    uint64_t expiration_time;
+    uint64_t last_used_time;
+};
+
+struct aws_presigned_url_cache {
+    struct aws_allocator *allocator;
+    struct aws_atomic_var ref_count;
+
+    struct aws_credentials_provider *credentials_provider;
+    struct aws_signing_key_cache *signing_key_cache;
+    uint64_t expiration_in_seconds;
+    uint64_t min_remaining_validity_in_ns;
+    size_t max_entries;
+    aws_io_clock_fn *clock_fn;
+
+    struct aws_mutex lock;
+
+    /* struct aws_byte_cursor * -> struct presigned_url_entry *, protected by lock */
+    struct aws_hash_table entries;
+
+    /* access key id of the most recently sourced credentials, protected by lock; every entry was signed with it */
+    struct aws_string *access_key_id;
+};
+
+/*
+ * Per-call state; lives from aws_presigned_url_cache_get until its callback has been invoked.  Holds a reference
+ * to the cache.
+ */
+struct presigned_url_lookup {
+    struct aws_presigned_url_cache *url_cache;
+    aws_presigned_url_complete_fn *callback;
+    void *user_data;
+
+    /* method, host, path, region and service, each followed by a newline; the request cursors point into it */
+    struct aws_byte_buf request_storage;
+    struct aws_presigned_url_cache_request request;
+
+    /* request_storage followed by the access key id */
+    struct aws_byte_buf key;
+
+    /* the access key id at the end of key */
+    struct aws_byte_cursor access_key_id;
+
+    /* signing state, only set on a miss */
+    uint64_t sign_time;
+    struct aws_credentials_provider *signing_credentials_provider;
+    struct aws_http_message *http_request;
+    struct aws_signable *signable;
+};
+
+static void s_presigned_url_entry_destroy(void *value) {
+    struct presigned_url_entry *entry = value;
+    if (entry == NULL) {
+        return;
+    }
+
+    aws_byte_buf_clean_up(&entry->key_buf);
+    aws_string_destroy(entry->presigned_path);
+
+    aws_mem_release(entry->allocator, entry);
+}
+
+static void s_presigned_url_cache_destroy(struct aws_presigned_url_cache *url_cache) {
+    aws_hash_table_clean_up(&url_cache->entries);
+    aws_string_destroy(url_cache->access_key_id);
+    aws_credentials_provider_release(url_cache->credentials_provider);
+    aws_mutex_clean_up(&url_cache->lock);
+
+    aws_mem_release(url_cache->allocator, url_cache);
+}
+
+void aws_presigned_url_cache_acquire(struct aws_presigned_url_cache *url_cache) {
+    aws_atomic_fetch_add(&url_cache->ref_count, 1);
+}
+
+void aws_presigned_url_cache_release(struct aws_presigned_url_cache *url_cache) {
+    if (url_cache == NULL) {
+        return;
+    }
+
+    size_t old_value = aws_atomic_fetch_sub(&url_cache->ref_count, 1);
+    if (old_value == 1) {
+        s_presigned_url_cache_destroy(url_cache);
+    }
+}
+
+static void s_presigned_url_lookup_destroy(struct presigned_url_lookup *lookup) {
+    struct aws_presigned_url_cache *url_cache = lookup->url_cache;
+
+    aws_signable_destroy(lookup->signable);
+    if (lookup->http_request != NULL) {
+        aws_http_message_release(lookup->http_request);
+    }
+    aws_credentials_provider_release(lookup->signing_credentials_provider);
+    aws_byte_buf_clean_up(&lookup->key);
+    aws_byte_buf_clean_up(&lookup->request_storage);
+    aws_mem_release(url_cache->allocator, lookup);
+
+    aws_presigned_url_cache_release(url_cache);
+}
+
+/* Invokes the lookup's callback and destroys the lookup.  Takes ownership of presigned_path. */
+static void s_presigned_url_lookup_finish(
+    struct presigned_url_lookup *lookup,
+    struct aws_string *presigned_path,
+    int error_code) {
+
+    if (presigned_path != NULL) {
+        struct aws_byte_cursor path_cursor = aws_byte_cursor_from_string(presigned_path);
+        lookup->callback(&path_cursor, AWS_ERROR_SUCCESS, lookup->user_data);
+        aws_string_destroy(presigned_path);
+    } else {
+        if (error_code == AWS_ERROR_SUCCESS) {
+            error_code = AWS_ERROR_UNKNOWN;
+        }
+        lookup->callback(NULL, error_code, lookup->user_data);
+    }
+
+    s_presigned_url_lookup_destroy(lookup);
+}
+
+/*
+ * Makes room for one more url by evicting the least recently used one.  Called with the lock held.
+ */
+static void s_evict_least_recently_used(struct aws_presigned_url_cache *url_cache) {
+    if (aws_hash_table_get_entry_count(&url_cache->entries) < url_cache->max_entries) {
+        return;
+    }
+
+    struct presigned_url_entry *oldest = NULL;
+
+    struct aws_hash_iter iter = aws_hash_iter_begin(&url_cache->entries);
+    while (!aws_hash_iter_done(&iter)) {
+        struct presigned_url_entry *entry = iter.element.value;
+        if (oldest == NULL || entry->last_used_time < oldest->last_used_time) {
+            oldest = entry;
+        }
+
+        aws_hash_iter_next(&iter);
+    }
+
+    if (oldest != NULL) {
+        aws_hash_table_remove(&url_cache->entries, &oldest->key, NULL, NULL);
+    }
+}
+
+/*
+ * Installs a freshly signed path under the lookup's key, replacing whatever was cached there.  Called with the
+ * lock held.
+ */
+static int s_store_presigned_path(
+    struct presigned_url_lookup *lookup,
+    const struct aws_string *presigned_path,
+    uint64_t expiration_time) {
+
+    struct aws_presigned_url_cache *url_cache = lookup->url_cache;
+    struct aws_byte_cursor key = aws_byte_cursor_from_buf(&lookup->key);
+
+    /* the credentials rotated while this lookup was signing; its url would never be served again */
+    if (url_cache->access_key_id == NULL ||
+        !aws_string_eq_byte_cursor(url_cache->access_key_id, &lookup->access_key_id)) {
+        return AWS_OP_SUCCESS;
+    }
+
+    struct aws_string *path_copy = aws_string_new_from_string(url_cache->allocator, presigned_path);
+    if (path_copy == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_hash_element *element = NULL;
+    if (aws_hash_table_find(&url_cache->entries, &key, &element)) {
+        goto on_error;
+    }
+
+    struct presigned_url_entry *entry = NULL;
+    if (element != NULL) {
+        entry = element->value;
+    } else {
+        s_evict_least_recently_used(url_cache);
+
+        entry = aws_mem_calloc(url_cache->allocator, 1, sizeof(struct presigned_url_entry));
+        if (entry == NULL) {
+            goto on_error;
+        }
+
+        entry->allocator = url_cache->allocator;
+        if (aws_byte_buf_init_copy_from_cursor(&entry->key_buf, url_cache->allocator, key)) {
+            s_presigned_url_entry_destroy(entry);
+            goto on_error;
+        }
+        entry->key = aws_byte_cursor_from_buf(&entry->key_buf);
+
+        if (aws_hash_table_put(&url_cache->entries, &entry->key, entry, NULL)) {
+            s_presigned_url_entry_destroy(entry);
+            goto on_error;
+        }
+    }
+
+    aws_string_destroy(entry->presigned_path);
+    entry->presigned_path = path_copy;
+    entry->expiration_time = expiration_time;
+    entry->last_used_time = lookup->sign_time;
+
+    return AWS_OP_SUCCESS;
+
+on_error:
+
+    aws_string_destroy(path_copy);
+
+    return AWS_OP_ERR;
+}
+
+static void s_on_presigned_url_signing_complete(struct aws_signing_result *result, int error_code, void *userdata) {
+    struct presigned_url_lookup *lookup = userdata;
+    struct aws_presigned_url_cache *url_cache = lookup->url_cache;
+
+    struct aws_string *presigned_path = NULL;
+
+    if (result == NULL) {
+        goto done;
+    }
+
+    if (aws_apply_signing_result_to_http_request(lookup->http_request, url_cache->allocator, result)) {
+        error_code = aws_last_error();
+        goto done;
+    }
+
+    struct aws_byte_cursor path_cursor;
+    AWS_ZERO_STRUCT(path_cursor);
+    if (aws_http_message_get_request_path(lookup->http_request, &path_cursor)) {
+        error_code = aws_last_error();
+        goto done;
+    }
+
+    presigned_path = aws_string_new_from_array(url_cache->allocator, path_cursor.ptr, path_cursor.len);
+    if (presigned_path == NULL) {
+        error_code = aws_last_error();
+        goto done;
+    }
+
+    uint64_t expiration_in_ns =
+        aws_timestamp_convert(url_cache->expiration_in_seconds, AWS_TIMESTAMP_SECS, AWS_TIMESTAMP_NANOS, NULL);
+
+    aws_mutex_lock(&url_cache->lock);
+    int store_result = s_store_presigned_path(lookup, presigned_path, lookup->sign_time + expiration_in_ns);
+    aws_mutex_unlock(&url_cache->lock);
+
+    /* the url is still good even if it couldn't be cached */
+    if (store_result) {
+        AWS_LOGF_WARN(
+            AWS_LS_AUTH_SIGNING,
+            "(id=%p) Presigned url cache failed to cache a signed url with error %d(%s)",
+            (void *)url_cache,
+            aws_last_error(),
+            aws_error_str(aws_last_error()));
+    }
+
+done:
+
+    s_presigned_url_lookup_finish(lookup, presigned_path, error_code);
+}
+
+AWS_STATIC_STRING_FROM_LITERAL(s_host_header_name, "host");
+
+static int s_presigned_url_lookup_build_request(struct presigned_url_lookup *lookup) {
+    struct aws_allocator *allocator = lookup->url_cache->allocator;
+
+    lookup->http_request = aws_http_message_new_request(allocator);
+    if (lookup->http_request == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_http_header host_header = {
+        .name = aws_byte_cursor_from_string(s_host_header_name),
+        .value = lookup->request.host,
+    };
+
+    if (aws_http_message_set_request_method(lookup->http_request, lookup->request.method) ||
+        aws_http_message_set_request_path(lookup->http_request, lookup->request.path) ||
+        aws_http_message_add_header(lookup->http_request, host_header)) {
+        return AWS_OP_ERR;
+    }
+
+    lookup->signable = aws_signable_new_http_request(allocator, lookup->http_request);
+    if (lookup->signable == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+/*
+ * Signs the lookup's request with exactly the credentials its key was built from, so the cached url always
+ * matches the identity it is filed under.  Completion always runs through s_presigned_url_lookup_finish.
+ */
+static void s_presigned_url_lookup_sign(struct presigned_url_lookup *lookup, struct aws_credentials *credentials) {
+    struct aws_presigned_url_cache *url_cache = lookup->url_cache;
+
+    struct aws_credentials_provider_static_options static_options;
+    AWS_ZERO_STRUCT(static_options);
+    static_options.access_key_id = aws_byte_cursor_from_string(credentials->access_key_id);
+    static_options.secret_access_key = aws_byte_cursor_from_string(credentials->secret_access_key);
+    if (credentials->session_token != NULL) {
+        static_options.session_token = aws_byte_cursor_from_string(credentials->session_token);
+    }
+
+    lookup->signing_credentials_provider = aws_credentials_provider_new_static(url_cache->allocator, &static_options);
+    if (lookup->signing_credentials_provider == NULL) {
+        goto on_error;
+    }
+
+    if (s_presigned_url_lookup_build_request(lookup)) {
+        goto on_error;
+    }
+
+    /* s3 compares the path exactly as sent */
+    bool is_s3 = aws_byte_cursor_eq_c_str(&lookup->request.service, "s3");
+
+    struct aws_signing_config_aws config;
+    AWS_ZERO_STRUCT(config);
+
+    config.config_type = AWS_SIGNING_CONFIG_AWS;
+    config.algorithm = AWS_SIGNING_ALGORITHM_SIG_V4_QUERY_PARAM;
+    config.credentials_provider = lookup->signing_credentials_provider;
+    config.region = lookup->request.region;
+    config.service = lookup->request.service;
+    config.use_double_uri_encode = !is_s3;
+    config.should_normalize_uri_path = !is_s3;
+    config.body_signing_type = AWS_BODY_SIGNING_OFF;
+    config.expiration_in_seconds = url_cache->expiration_in_seconds;
+    config.signing_key_cache = url_cache->signing_key_cache;
+
+    aws_date_time_init_epoch_millis(
+        &config.date, aws_timestamp_convert(lookup->sign_time, AWS_TIMESTAMP_NANOS, AWS_TIMESTAMP_MILLIS, NULL));
+
+    if (aws_sign_request_aws(
+            url_cache->allocator,
+            lookup->signable,
+            (struct aws_signing_config_base *)&config,
+            s_on_presigned_url_signing_complete,
+            lookup)) {
+        goto on_error;
+    }
+
+    return;
+
+on_error:
+
+    s_presigned_url_lookup_finish(lookup, NULL, aws_last_error());
+}
+
+static void s_on_presigned_url_lookup_credentials(struct aws_credentials *credentials, void *user_data) {
+    struct presigned_url_lookup *lookup = user_data;
+    struct aws_presigned_url_cache *url_cache = lookup->url_cache;
+
+    if (credentials == NULL) {
+        s_presigned_url_lookup_finish(lookup, NULL, AWS_AUTH_SIGNING_NO_CREDENTIALS);
+        return;
+    }
+
+    uint64_t now = 0;
+    if (url_cache->clock_fn(&now)) {
+        s_presigned_url_lookup_finish(lookup, NULL, aws_last_error());
+        return;
+    }
+
+    struct aws_byte_cursor request_cursor = aws_byte_cursor_from_buf(&lookup->request_storage);
+    struct aws_byte_cursor access_key_id = aws_byte_cursor_from_string(credentials->access_key_id);
+    if (aws_byte_buf_init(&lookup->key, url_cache->allocator, request_cursor.len + access_key_id.len) ||
+        aws_byte_buf_append(&lookup->key, &request_cursor) || aws_byte_buf_append(&lookup->key, &access_key_id)) {
+        s_presigned_url_lookup_finish(lookup, NULL, aws_last_error());
+        return;
+    }
+
+    struct aws_byte_cursor key = aws_byte_cursor_from_buf(&lookup->key);
+    lookup->access_key_id = key;
+    aws_byte_cursor_advance(&lookup->access_key_id, request_cursor.len);
+
+    struct aws_string *cached_path = NULL;
+    int error_code = AWS_ERROR_SUCCESS;
+
+    aws_mutex_lock(&url_cache->lock);
+
+    /* urls signed with a rotated-out access key id would never be looked up again, so drop them all */
+    if (url_cache->access_key_id == NULL || !aws_string_eq_byte_cursor(url_cache->access_key_id, &access_key_id)) {
+        struct aws_string *new_access_key_id =
+            aws_string_new_from_string(url_cache->allocator, credentials->access_key_id);
+        if (new_access_key_id == NULL) {
+            error_code = aws_last_error();
+        } else {
+            if (url_cache->access_key_id != NULL) {
+                AWS_LOGF_DEBUG(
+                    AWS_LS_AUTH_SIGNING,
+                    "(id=%p) Presigned url cache credentials rotated, dropping every cached url",
+                    (void *)url_cache);
+            }
+
+            aws_hash_table_clear(&url_cache->entries);
+            aws_string_destroy(url_cache->access_key_id);
+            url_cache->access_key_id = new_access_key_id;
+        }
+    }
+
+    struct aws_hash_element *element = NULL;
+    if (error_code == AWS_ERROR_SUCCESS && aws_hash_table_find(&url_cache->entries, &key, &element) == AWS_OP_SUCCESS &&
+        element != NULL) {
+        struct presigned_url_entry *entry = element->value;
+        if (entry->expiration_time >= now + url_cache->min_remaining_validity_in_ns) {
+            entry->last_used_time = now;
+            cached_path = aws_string_new_from_string(url_cache->allocator, entry->presigned_path);
+            if (cached_path == NULL) {
+                error_code = aws_last_error();
+            }
+        }
+    }
+
+    aws_mutex_unlock(&url_cache->lock);
+
+    if (cached_path != NULL || error_code != AWS_ERROR_SUCCESS) {
+        s_presigned_url_lookup_finish(lookup, cached_path, error_code);
+        return;
+    }
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_AUTH_SIGNING,
+        "(id=%p) Presigned url cache has no url valid until %" PRIu64 ", signing",
+        (void *)url_cache,
+        now + url_cache->min_remaining_validity_in_ns);
+
+    lookup->sign_time = now;
+    s_presigned_url_lookup_sign(lookup, credentials);
+}
+
+static int s_append_key_field(struct aws_byte_buf *storage, struct aws_byte_cursor field, struct aws_byte_cursor *out) {
+    static const uint8_t s_separator = '\n';
+    struct aws_byte_cursor separator = aws_byte_cursor_from_array(&s_separator, 1);
+
+    out->ptr = storage->buffer + storage->len;
+    out->len = field.len;
+
+    if (aws_byte_buf_append(storage, &field) || aws_byte_buf_append(storage, &separator)) {
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+int aws_presigned_url_cache_get(
+    struct aws_presigned_url_cache *url_cache,
+    const struct aws_presigned_url_cache_request *request,
+    aws_presigned_url_complete_fn *callback,
+    void *user_data) {
+
+    if (request->method.len == 0 || request->host.len == 0 || request->path.len == 0 || request->region.len == 0 ||
+        request->service.len == 0) {
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_SIGNING,
+            "(id=%p) Presigned url request is missing a method, host, path, region or service",
+            (void *)url_cache);
+        return aws_raise_error(AWS_AUTH_SIGNING_INVALID_CONFIGURATION);
+    }
+
+    struct presigned_url_lookup *lookup =
+        aws_mem_calloc(url_cache->allocator, 1, sizeof(struct presigned_url_lookup));
+    if (lookup == NULL) {
+        return AWS_OP_ERR;
+    }
+
+    aws_presigned_url_cache_acquire(url_cache);
+    lookup->url_cache = url_cache;
+    lookup->callback = callback;
+    lookup->user_data = user_data;
+
+    /* one separator per field; the buffer is sized up front so the cursors into it stay valid */
+    size_t storage_size = request->method.len + request->host.len + request->path.len + request->region.len +
+                          request->service.len + 5;
+
+    if (aws_byte_buf_init(&lookup->request_storage, url_cache->allocator, storage_size) ||
+        s_append_key_field(&lookup->request_storage, request->method, &lookup->request.method) ||
+        s_append_key_field(&lookup->request_storage, request->host, &lookup->request.host) ||
+        s_append_key_field(&lookup->request_storage, request->path, &lookup->request.path) ||
+        s_append_key_field(&lookup->request_storage, request->region, &lookup->request.region) ||
+        s_append_key_field(&lookup->request_storage, request->service, &lookup->request.service)) {
+        goto on_error;
+    }
+
+    if (aws_credentials_provider_get_credentials(
+            url_cache->credentials_provider, s_on_presigned_url_lookup_credentials, lookup)) {
+        goto on_error;
+    }
+
+    return AWS_OP_SUCCESS;
+
+on_error:
+
+    s_presigned_url_lookup_destroy(lookup);
+
+    return AWS_OP_ERR;
+}
+
+struct aws_presigned_url_cache *aws_presigned_url_cache_new(
+    struct aws_allocator *allocator,
+    const struct aws_presigned_url_cache_options *options) {
+
+    if (options->credentials_provider == NULL) {
+        AWS_LOGF_ERROR(AWS_LS_AUTH_SIGNING, "Presigned url cache options are missing a credentials provider");
+        aws_raise_error(AWS_AUTH_SIGNING_INVALID_CONFIGURATION);
+        return NULL;
+    }
+
+    struct aws_presigned_url_cache *url_cache = aws_mem_calloc(allocator, 1, sizeof(struct aws_presigned_url_cache));
+    if (url_cache == NULL) {
+        return NULL;
+    }
+
+    url_cache->allocator = allocator;
+    aws_atomic_init_int(&url_cache->ref_count, 1);
+
+    if (aws_mutex_init(&url_cache->lock)) {
+        goto on_mutex_error;
+    }
+
+    if (aws_hash_table_init(
+            &url_cache->entries,
+            allocator,
+            PRESIGNED_URL_TABLE_DEFAULT_SIZE,
+            aws_hash_byte_cursor_ptr,
+            (aws_hash_callback_eq_fn *)aws_byte_cursor_eq,
+            NULL, /* The key is owned by the value (and destroy cleans it up), so we don't have to */
+            s_presigned_url_entry_destroy)) {
+        goto on_table_error;
+    }
+
+    url_cache->credentials_provider = options->credentials_provider;
+    aws_credentials_provider_acquire(url_cache->credentials_provider);
+
+    url_cache->signing_key_cache = options->signing_key_cache;
+
+    url_cache->expiration_in_seconds = options->expiration_in_seconds;
+    if (url_cache->expiration_in_seconds == 0) {
+        url_cache->expiration_in_seconds = DEFAULT_PRESIGNED_URL_EXPIRATION_SECS;
+    }
+
+    uint64_t min_remaining_validity_in_seconds = options->min_remaining_validity_in_seconds;
+    if (min_remaining_validity_in_seconds == 0) {
+        min_remaining_validity_in_seconds = DEFAULT_PRESIGNED_URL_MIN_REMAINING_VALIDITY_SECS;
+    }
+
+    if (min_remaining_validity_in_seconds > url_cache->expiration_in_seconds / 2) {
+        min_remaining_validity_in_seconds = url_cache->expiration_in_seconds / 2;
+    }
+
+    url_cache->min_remaining_validity_in_ns =
+        aws_timestamp_convert(min_remaining_validity_in_seconds, AWS_TIMESTAMP_SECS, AWS_TIMESTAMP_NANOS, NULL);
+
+    url_cache->max_entries = options->max_entries;
+    if (url_cache->max_entries == 0) {
+        url_cache->max_entries = DEFAULT_PRESIGNED_URL_MAX_ENTRIES;
+    }
+
+    if (options->clock_fn != NULL) {
+        url_cache->clock_fn = options->clock_fn;
+    } else {
+        url_cache->clock_fn = &aws_sys_clock_get_ticks;
+    }
+
+    return url_cache;
+
+on_table_error:
+
+    aws_mutex_clean_up(&url_cache->lock);
+
+on_mutex_error:
+
+    aws_mem_release(allocator, url_cache);
+
+    return NULL;
+}
@@ -0,0 +1,522 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/s3_post_policy.h>
+
+#include <aws/auth/credentials.h>
+#include <aws/auth/private/aws_signing.h>
+#include <aws/cal/hash.h>
+#include <aws/cal/hmac.h>
+#include <aws/common/encoding.h>
+#include <aws/common/string.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#if defined(_MSC_VER)
+#    pragma warning(disable : 4204)
+#endif /* _MSC_VER */
+
+#define POLICY_DOCUMENT_STARTING_SIZE 512
+#define CREDENTIAL_STARTING_SIZE 128
+#define MAX_UINT64_STRING_LENGTH 21
+
+AWS_STATIC_STRING_FROM_LITERAL(s_default_post_policy_service, "s3");
+
+enum s3_post_policy_field {
+    S3_POST_POLICY_FIELD_POLICY,
+    S3_POST_POLICY_FIELD_ALGORITHM,
+    S3_POST_POLICY_FIELD_CREDENTIAL,
+    S3_POST_POLICY_FIELD_DATE,
+    S3_POST_POLICY_FIELD_SIGNATURE,
+    S3_POST_POLICY_FIELD_SECURITY_TOKEN,
+    S3_POST_POLICY_FIELD_COUNT,
+};
+
+/*
+ * Output buffers may be reallocated as fields are appended, so field locations are tracked as offsets and only
+ * turned into cursors once all appends are done.
+ */
+struct s3_post_policy_field_ranges {
+    size_t offset[S3_POST_POLICY_FIELD_COUNT];
+    size_t length[S3_POST_POLICY_FIELD_COUNT];
+};
+
+/*
+ * Everything that is shared by every policy signed with the same options: derived once, reused per policy.
+ */
+struct s3_post_policy_signer {
+    struct aws_allocator *allocator;
+    const struct aws_s3_post_policy_signing_options *options;
+
+    struct aws_byte_buf signing_key;
+    struct aws_byte_buf credential;
+    struct aws_byte_buf date;
+
+    /* per-policy scratch space */
+    struct aws_byte_buf policy_document;
+    struct aws_byte_buf encoded_policy;
+    struct aws_byte_buf digest;
+};
+
+static void s_s3_post_policy_signer_clean_up(struct s3_post_policy_signer *signer) {
+    aws_byte_buf_clean_up_secure(&signer->signing_key);
+    aws_byte_buf_clean_up(&signer->credential);
+    aws_byte_buf_clean_up(&signer->date);
+    aws_byte_buf_clean_up(&signer->policy_document);
+    aws_byte_buf_clean_up(&signer->encoded_policy);
+    aws_byte_buf_clean_up(&signer->digest);
+}
+
+static int s_s3_post_policy_signer_init(
+    struct s3_post_policy_signer *signer,
+    struct aws_allocator *allocator,
+    const struct aws_s3_post_policy_signing_options *options) {
+
+    AWS_ZERO_STRUCT(*signer);
+
+    if (options->credentials == NULL || options->region.len == 0) {
+        AWS_LOGF_ERROR(AWS_LS_AUTH_SIGNING, "S3 POST policy signing options are missing credentials or a region");
+        return aws_raise_error(AWS_AUTH_SIGNING_INVALID_CONFIGURATION);
+    }
+
+    signer->allocator = allocator;
+    signer->options = options;
+
+    struct aws_byte_cursor service = options->service;
+    if (service.len == 0) {
+        service = aws_byte_cursor_from_string(s_default_post_policy_service);
+    }
+
+    if (aws_byte_buf_init(&signer->signing_key, allocator, AWS_SHA256_LEN) ||
+        aws_byte_buf_init(&signer->credential, allocator, CREDENTIAL_STARTING_SIZE) ||
+        aws_byte_buf_init(&signer->date, allocator, AWS_DATE_TIME_STR_MAX_LEN) ||
+        aws_byte_buf_init(&signer->policy_document, allocator, POLICY_DOCUMENT_STARTING_SIZE) ||
+        aws_byte_buf_init(&signer->encoded_policy, allocator, POLICY_DOCUMENT_STARTING_SIZE) ||
+        aws_byte_buf_init(&signer->digest, allocator, AWS_SHA256_LEN)) {
+        goto on_error;
+    }
+
+    if (aws_signing_derive_sigv4_signing_key(
+            allocator,
+            options->credentials->secret_access_key,
+            &options->date,
+            &options->region,
+            &service,
+            &signer->signing_key)) {
+        goto on_error;
+    }
+
+    if (aws_date_time_to_utc_time_str(&options->date, AWS_DATE_FORMAT_ISO_8601_BASIC, &signer->date)) {
+        goto on_error;
+    }
+
+    /* <access key>/<date>/<region>/<service>/aws4_request */
+    struct aws_byte_cursor access_key_cursor = aws_byte_cursor_from_string(options->credentials->access_key_id);
+    struct aws_byte_cursor slash_cursor = aws_byte_cursor_from_c_str("/");
+
+    if (aws_byte_buf_append_dynamic(&signer->credential, &access_key_cursor) ||
+        aws_byte_buf_append_dynamic(&signer->credential, &slash_cursor) ||
+        aws_signing_append_sigv4_credential_scope(&options->date, &options->region, &service, &signer->credential)) {
+        goto on_error;
+    }
+
+    return AWS_OP_SUCCESS;
+
+on_error:
+
+    s_s3_post_policy_signer_clean_up(signer);
+
+    return AWS_OP_ERR;
+}
+
+/*
+ * Policy document construction
+ */
+
+static int s_append_literal(struct aws_byte_buf *dest, const char *literal) {
+    struct aws_byte_cursor literal_cursor = aws_byte_cursor_from_c_str(literal);
+    return aws_byte_buf_append_dynamic(dest, &literal_cursor);
+}
+
+/*
+ * Appends a quoted, escaped json string
+ */
+static int s_append_json_string(struct aws_byte_buf *dest, struct aws_byte_cursor value) {
+    if (s_append_literal(dest, "\"")) {
+        return AWS_OP_ERR;
+    }
+
+    for (size_t i = 0; i < value.len; ++i) {
+        uint8_t c = value.ptr[i];
+        char escaped[7];
+
+        if (c == '"' || c == '\\') {
+            snprintf(escaped, sizeof(escaped), "\\%c", (char)c);
+        } else if (c < 0x20) {
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned int)c);
+        } else {
+            struct aws_byte_cursor char_cursor = {.ptr = value.ptr + i, .len = 1};
+            if (aws_byte_buf_append_dynamic(dest, &char_cursor)) {
+                return AWS_OP_ERR;
+            }
+            continue;
+        }
+
+        if (s_append_literal(dest, escaped)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    return s_append_literal(dest, "\"");
+}
+
+static int s_append_condition_separator(struct aws_byte_buf *dest, bool *is_first) {
+    if (*is_first) {
+        *is_first = false;
+        return AWS_OP_SUCCESS;
+    }
+
+    return s_append_literal(dest, ",");
+}
+
+/* {"<name>":"<value>"} */
+static int s_append_exact_condition(
+    struct aws_byte_buf *dest,
+    const char *name,
+    struct aws_byte_cursor value,
+    bool *is_first) {
+
+    if (value.len == 0) {
+        return AWS_OP_SUCCESS;
+    }
+
+    if (s_append_condition_separator(dest, is_first) || s_append_literal(dest, "{") ||
+        s_append_json_string(dest, aws_byte_cursor_from_c_str(name)) || s_append_literal(dest, ":") ||
+        s_append_json_string(dest, value) || s_append_literal(dest, "}")) {
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+/* ["starts-with","<field>","<prefix>"] */
+static int s_append_starts_with_condition(
+    struct aws_byte_buf *dest,
+    const char *field,
+    struct aws_byte_cursor prefix,
+    bool *is_first) {
+
+    if (prefix.len == 0) {
+        return AWS_OP_SUCCESS;
+    }
+
+    if (s_append_condition_separator(dest, is_first) || s_append_literal(dest, "[\"starts-with\",") ||
+        s_append_json_string(dest, aws_byte_cursor_from_c_str(field)) || s_append_literal(dest, ",") ||
+        s_append_json_string(dest, prefix) || s_append_literal(dest, "]")) {
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_append_content_length_range_condition(
+    struct aws_byte_buf *dest,
+    const struct aws_s3_post_policy_conditions *conditions,
+    bool *is_first) {
+
+    if (!conditions->has_content_length_range) {
+        return AWS_OP_SUCCESS;
+    }
+
+    char min_value[MAX_UINT64_STRING_LENGTH];
+    char max_value[MAX_UINT64_STRING_LENGTH];
+    snprintf(min_value, sizeof(min_value), "%" PRIu64, conditions->content_length_min);
+    snprintf(max_value, sizeof(max_value), "%" PRIu64, conditions->content_length_max);
+
+    if (s_append_condition_separator(dest, is_first) || s_append_literal(dest, "[\"content-length-range\",") ||
+        s_append_literal(dest, min_value) || s_append_literal(dest, ",") || s_append_literal(dest, max_value) ||
+        s_append_literal(dest, "]")) {
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_build_policy_document(
+    struct s3_post_policy_signer *signer,
+    const struct aws_s3_post_policy_conditions *conditions) {
+
+    struct aws_byte_buf *dest = &signer->policy_document;
+    dest->len = 0;
+
+    uint8_t expiration_storage[AWS_DATE_TIME_STR_MAX_LEN];
+    struct aws_byte_buf expiration_buf = aws_byte_buf_from_empty_array(expiration_storage, sizeof(expiration_storage));
+    if (aws_date_time_to_utc_time_str(&conditions->expiration, AWS_DATE_FORMAT_ISO_8601, &expiration_buf)) {
+        return AWS_OP_ERR;
+    }
+
+    if (s_append_literal(dest, "{\"expiration\":") ||
+        s_append_json_string(dest, aws_byte_cursor_from_buf(&expiration_buf)) ||
+        s_append_literal(dest, ",\"conditions\":[")) {
+        return AWS_OP_ERR;
+    }
+
+    bool is_first = true;
+    const struct aws_credentials *credentials = signer->options->credentials;
+    struct aws_byte_cursor session_token;
+    AWS_ZERO_STRUCT(session_token);
+    if (credentials->session_token != NULL) {
+        session_token = aws_byte_cursor_from_string(credentials->session_token);
+    }
+
+    if (s_append_exact_condition(dest, "bucket", conditions->bucket, &is_first) ||
+        s_append_exact_condition(dest, "key", conditions->key, &is_first) ||
+        s_append_starts_with_condition(dest, "$key", conditions->key_prefix, &is_first) ||
+        s_append_exact_condition(dest, "acl", conditions->acl, &is_first) ||
+        s_append_starts_with_condition(dest, "$Content-Type", conditions->content_type_prefix, &is_first) ||
+        s_append_exact_condition(dest, "success_action_status", conditions->success_action_status, &is_first) ||
+        s_append_content_length_range_condition(dest, conditions, &is_first) ||
+        s_append_exact_condition(
+            dest, "x-amz-algorithm", aws_byte_cursor_from_string(g_aws_signing_sigv4_algorithm), &is_first) ||
+        s_append_exact_condition(
+            dest, "x-amz-credential", aws_byte_cursor_from_buf(&signer->credential), &is_first) ||
+        s_append_exact_condition(dest, "x-amz-date", aws_byte_cursor_from_buf(&signer->date), &is_first) ||
+        s_append_exact_condition(dest, "x-amz-security-token", session_token, &is_first)) {
+        return AWS_OP_ERR;
+    }
+
+    return s_append_literal(dest, "]}");
+}
+
+/*
+ * Signing
+ */
+
+static int s_append_field(
+    struct aws_byte_buf *output,
+    struct aws_byte_cursor value,
+    struct s3_post_policy_field_ranges *ranges,
+    enum s3_post_policy_field field) {
+
+    ranges->offset[field] = output->len;
+    ranges->length[field] = value.len;
+
+    return aws_byte_buf_append_dynamic(output, &value);
+}
+
+/*
+ * Base64-encodes the policy document into the signer's scratch buffer
+ */
+static int s_encode_policy_document(struct s3_post_policy_signer *signer, struct aws_byte_cursor policy_document) {
+    size_t encoded_length = 0;
+    if (aws_base64_compute_encoded_len(policy_document.len, &encoded_length)) {
+        return AWS_OP_ERR;
+    }
+
+    signer->encoded_policy.len = 0;
+    if (aws_byte_buf_reserve(&signer->encoded_policy, encoded_length)) {
+        return AWS_OP_ERR;
+    }
+
+    if (aws_base64_encode(&policy_document, &signer->encoded_policy)) {
+        return AWS_OP_ERR;
+    }
+
+    /* the encoder null-terminates its output; that is not part of the field value */
+    while (signer->encoded_policy.len > 0 && signer->encoded_policy.buffer[signer->encoded_policy.len - 1] == 0) {
+        --signer->encoded_policy.len;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_sign_policy_document(
+    struct s3_post_policy_signer *signer,
+    struct aws_byte_cursor policy_document,
+    struct aws_byte_buf *output,
+    struct s3_post_policy_field_ranges *ranges) {
+
+    if (s_encode_policy_document(signer, policy_document)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_byte_cursor encoded_policy_cursor = aws_byte_cursor_from_buf(&signer->encoded_policy);
+    struct aws_byte_cursor signing_key_cursor = aws_byte_cursor_from_buf(&signer->signing_key);
+
+    signer->digest.len = 0;
+    if (aws_sha256_hmac_compute(signer->allocator, &signing_key_cursor, &encoded_policy_cursor, &signer->digest, 0)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_byte_cursor session_token;
+    AWS_ZERO_STRUCT(session_token);
+    if (signer->options->credentials->session_token != NULL) {
+        session_token = aws_byte_cursor_from_string(signer->options->credentials->session_token);
+    }
+
+    if (s_append_field(output, encoded_policy_cursor, ranges, S3_POST_POLICY_FIELD_POLICY) ||
+        s_append_field(
+            output,
+            aws_byte_cursor_from_string(g_aws_signing_sigv4_algorithm),
+            ranges,
+            S3_POST_POLICY_FIELD_ALGORITHM) ||
+        s_append_field(
+            output, aws_byte_cursor_from_buf(&signer->credential), ranges, S3_POST_POLICY_FIELD_CREDENTIAL) ||
+        s_append_field(output, aws_byte_cursor_from_buf(&signer->date), ranges, S3_POST_POLICY_FIELD_DATE) ||
+        s_append_field(output, session_token, ranges, S3_POST_POLICY_FIELD_SECURITY_TOKEN)) {
+        return AWS_OP_ERR;
+    }
+
+    ranges->offset[S3_POST_POLICY_FIELD_SIGNATURE] = output->len;
+
+    struct aws_byte_cursor digest_cursor = aws_byte_cursor_from_buf(&signer->digest);
+    if (aws_hex_encode_append_dynamic(&digest_cursor, output)) {
+        return AWS_OP_ERR;
+    }
+
+    ranges->length[S3_POST_POLICY_FIELD_SIGNATURE] = output->len - ranges->offset[S3_POST_POLICY_FIELD_SIGNATURE];
+
+    return AWS_OP_SUCCESS;
+}
+
+static struct aws_byte_cursor s_field_cursor(
+    const struct aws_byte_buf *output,
+    const struct s3_post_policy_field_ranges *ranges,
+    enum s3_post_policy_field field) {
+
+    struct aws_byte_cursor cursor;
+    AWS_ZERO_STRUCT(cursor);
+
+    if (ranges->length[field] > 0) {
+        cursor.ptr = output->buffer + ranges->offset[field];
+        cursor.len = ranges->length[field];
+    }
+
+    return cursor;
+}
+
+static void s_resolve_form_fields(
+    const struct aws_byte_buf *output,
+    const struct s3_post_policy_field_ranges *ranges,
+    struct aws_s3_post_policy_form_fields *out_fields) {
+
+    out_fields->policy = s_field_cursor(output, ranges, S3_POST_POLICY_FIELD_POLICY);
+    out_fields->algorithm = s_field_cursor(output, ranges, S3_POST_POLICY_FIELD_ALGORITHM);
+    out_fields->credential = s_field_cursor(output, ranges, S3_POST_POLICY_FIELD_CREDENTIAL);
+    out_fields->date = s_field_cursor(output, ranges, S3_POST_POLICY_FIELD_DATE);
+    out_fields->signature = s_field_cursor(output, ranges, S3_POST_POLICY_FIELD_SIGNATURE);
+    out_fields->security_token = s_field_cursor(output, ranges, S3_POST_POLICY_FIELD_SECURITY_TOKEN);
+}
+
+int aws_s3_post_policy_sign(
+    struct aws_allocator *allocator,
+    const struct aws_s3_post_policy_signing_options *options,
+    const struct aws_byte_cursor *policy_document,
+    struct aws_byte_buf *output,
+    struct aws_s3_post_policy_form_fields *out_fields) {
+
+    struct s3_post_policy_signer signer;
+    if (s_s3_post_policy_signer_init(&signer, allocator, options)) {
+        return AWS_OP_ERR;
+    }
+
+    int result = AWS_OP_ERR;
+    size_t original_output_len = output->len;
+
+    struct s3_post_policy_field_ranges ranges;
+    AWS_ZERO_STRUCT(ranges);
+
+    if (s_sign_policy_document(&signer, *policy_document, output, &ranges)) {
+        output->len = original_output_len;
+        goto done;
+    }
+
+    s_resolve_form_fields(output, &ranges, out_fields);
+    result = AWS_OP_SUCCESS;
+
+done:
+
+    s_s3_post_policy_signer_clean_up(&signer);
+
+    return result;
+}
+
+int aws_s3_post_policy_sign_conditions(
+    struct aws_allocator *allocator,
+    const struct aws_s3_post_policy_signing_options *options,
+    const struct aws_s3_post_policy_conditions *conditions,
+    struct aws_byte_buf *output,
+    struct aws_s3_post_policy_form_fields *out_fields) {
+
+    return aws_s3_post_policy_sign_conditions_bulk(allocator, options, conditions, 1, output, out_fields);
+}
+
+int aws_s3_post_policy_sign_conditions_bulk(
+    struct aws_allocator *allocator,
+    const struct aws_s3_post_policy_signing_options *options,
+    const struct aws_s3_post_policy_conditions *conditions_array,
+    size_t condition_count,
+    struct aws_byte_buf *output,
+    struct aws_s3_post_policy_form_fields *out_fields_array) {
+
+    if (condition_count == 0) {
+        return AWS_OP_SUCCESS;
+    }
+
+    struct s3_post_policy_signer signer;
+    if (s_s3_post_policy_signer_init(&signer, allocator, options)) {
+        return AWS_OP_ERR;
+    }
+
+    int result = AWS_OP_ERR;
+    size_t original_output_len = output->len;
+
+    struct s3_post_policy_field_ranges *ranges =
+        aws_mem_calloc(allocator, condition_count, sizeof(struct s3_post_policy_field_ranges));
+    if (ranges == NULL) {
+        goto done;
+    }
+
+    for (size_t i = 0; i < condition_count; ++i) {
+        if (s_build_policy_document(&signer, &conditions_array[i])) {
+            goto done;
+        }
+
+        if (s_sign_policy_document(&signer, aws_byte_cursor_from_buf(&signer.policy_document), output, &ranges[i])) {
+            goto done;
+        }
+    }
+
+    for (size_t i = 0; i < condition_count; ++i) {
+        s_resolve_form_fields(output, &ranges[i], &out_fields_array[i]);
+    }
+
+    result = AWS_OP_SUCCESS;
+
+done:
+
+    if (result != AWS_OP_SUCCESS) {
+        output->len = original_output_len;
+    }
+
+    if (ranges != NULL) {
+        aws_mem_release(allocator, ranges);
+    }
+
+    s_s3_post_policy_signer_clean_up(&signer);
+
+    return result;
+}
@@ -0,0 +1,1107 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/s3_session_cache.h>
+
+#include <aws/auth/private/credentials_utils.h>
+#include <aws/auth/private/xml_parser.h>
+#include <aws/auth/signable.h>
+#include <aws/auth/signing.h>
+#include <aws/auth/signing_config.h>
+#include <aws/auth/signing_result.h>
+#include <aws/common/clock.h>
+#include <aws/common/date_time.h>
+#include <aws/common/hash_table.h>
+#include <aws/common/linked_list.h>
+#include <aws/common/mutex.h>
+#include <aws/common/string.h>
+#include <aws/http/connection.h>
+#include <aws/http/connection_manager.h>
+#include <aws/http/request_response.h>
+#include <aws/io/channel_bootstrap.h>
+#include <aws/io/socket.h>
+#include <aws/io/tls_channel_handler.h>
+
+#include <inttypes.h>
+
+#ifdef _MSC_VER
+/* allow non-constant declared initializers. */
+#    pragma warning(disable : 4204)
+/* allow passing of address of automatic variable */
+#    pragma warning(disable : 4221)
+#endif
+
+#define S3_SESSION_DEFAULT_MAX_SESSIONS 64
+#define S3_SESSION_DEFAULT_REFRESH_AHEAD_SECS 60
+#define S3_SESSION_TABLE_DEFAULT_SIZE 16
+
+/* sessions last five minutes; assumed if a CreateSession response carries no usable expiration */
+#define S3_SESSION_DEFAULT_LIFETIME_SECS 300
+
+static struct aws_byte_cursor s_host_header_name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("host");
+static struct aws_byte_cursor s_get_method = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("GET");
+static struct aws_byte_cursor s_create_session_path = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("/?session");
+static struct aws_byte_cursor s_service_name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("s3express");
+static struct aws_byte_cursor s_directory_bucket_suffix = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("--x-s3");
+static struct aws_byte_cursor s_zone_host_prefix = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("s3express-");
+static struct aws_byte_cursor s_regional_host_suffix = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL(".amazonaws.com");
+static struct aws_byte_cursor s_dot = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL(".");
+static struct aws_byte_cursor s_create_session_result_name =
+    AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("CreateSessionResult");
+static struct aws_byte_cursor s_credentials_name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Credentials");
+static struct aws_byte_cursor s_session_token_name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("SessionToken");
+static struct aws_byte_cursor s_secret_key_name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("SecretAccessKey");
+static struct aws_byte_cursor s_access_key_id_name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("AccessKeyId");
+static struct aws_byte_cursor s_expiration_name = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("Expiration");
+
+static struct aws_credentials_provider_system_vtable s_default_function_table = {
+    .aws_http_connection_manager_new = aws_http_connection_manager_new,
+    .aws_http_connection_manager_release = aws_http_connection_manager_release,
+    .aws_http_connection_manager_acquire_connection = aws_http_connection_manager_acquire_connection,
+    .aws_http_connection_manager_release_connection = aws_http_connection_manager_release_connection,
+    .aws_http_connection_make_request = aws_http_connection_make_request,
+    .aws_http_stream_get_incoming_response_status = aws_http_stream_get_incoming_response_status,
+    .aws_http_stream_release = aws_http_stream_release,
+    .aws_http_connection_close = aws_http_connection_close,
+};
+
+struct s3_session_entry {
+    struct aws_allocator *allocator;
+    struct aws_credentials_provider_system_vtable *function_table;
+    struct aws_string *bucket;
+
+    /* the table key; points into bucket */
+    struct aws_byte_cursor key;
+
+    struct aws_string *host;
+    struct aws_tls_connection_options connection_options;
+    struct aws_http_connection_manager *connection_manager;
+
+    /* everything below is protected by the cache's lock */
+    struct aws_credentials *credentials;
+    uint64_t expiration_time;
+    uint64_t refresh_time;
+    uint64_t last_used_time;
+    bool create_in_progress;
+    struct aws_linked_list pending_queries;
+};
+
+/* Invoked once a released cache and all of its connection managers are gone */
+typedef void(s3_session_cache_on_destroyed_fn)(void *user_data);
+
+struct aws_s3_session_cache {
+    struct aws_allocator *allocator;
+    struct aws_atomic_var ref_count;
+
+    /*
+     * Connection managers that haven't finished shutting down, plus one held by the cache itself until its last
+     * reference is released.  Whoever drops this to zero frees the cache.
+     */
+    struct aws_atomic_var live_manager_count;
+    s3_session_cache_on_destroyed_fn *on_destroyed;
+    void *on_destroyed_user_data;
+
+    struct aws_credentials_provider *creds_provider;
+    struct aws_client_bootstrap *bootstrap;
+    struct aws_tls_ctx *tls_ctx;
+    bool owns_tls_ctx;
+    struct aws_string *region;
+    struct aws_string *endpoint_host_suffix;
+    size_t max_sessions;
+    uint64_t refresh_ahead_in_ns;
+    aws_io_clock_fn *clock_fn;
+    struct aws_credentials_provider_system_vtable *function_table;
+
+    struct aws_mutex lock;
+
+    /* struct aws_byte_cursor * -> struct s3_session_entry *, protected by lock */
+    struct aws_hash_table entries;
+};
+
+struct s3_session_query {
+    struct aws_linked_list_node node;
+    aws_on_get_credentials_callback_fn *callback;
+    void *user_data;
+};
+
+/*
+ * Per-call state; lives from the start of a CreateSession call until its completion.  Holds a reference to the
+ * cache, and its entry can't be evicted while create_in_progress is set.
+ */
+struct s3_create_session_request {
+    struct aws_s3_session_cache *session_cache;
+    struct s3_session_entry *entry;
+    uint64_t start_time;
+    struct aws_http_message *message;
+    struct aws_signable *signable;
+    struct aws_signing_config_aws signing_config;
+    struct aws_http_connection *connection;
+    struct aws_byte_buf output_buf;
+};
+
+/* cursors into the response body */
+struct s3_create_session_response {
+    struct aws_byte_cursor access_key_id;
+    struct aws_byte_cursor secret_access_key;
+    struct aws_byte_cursor session_token;
+    struct aws_byte_cursor expiration;
+};
+
+static void s_session_query_list_notify_and_clean_up(
+    struct aws_linked_list *query_list,
+    struct aws_allocator *allocator,
+    struct aws_credentials *credentials) {
+
+    while (!aws_linked_list_empty(query_list)) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(query_list);
+        struct s3_session_query *query = AWS_CONTAINER_OF(node, struct s3_session_query, node);
+        query->callback(credentials, query->user_data);
+        aws_mem_release(allocator, query);
+    }
+}
+
+static void s_session_entry_destroy(void *value) {
+    struct s3_session_entry *entry = value;
+
+    /* entries are only destroyed while idle, so nothing is waiting on them */
+    AWS_ASSERT(aws_linked_list_empty(&entry->pending_queries));
+
+    if (entry->connection_manager != NULL) {
+        entry->function_table->aws_http_connection_manager_release(entry->connection_manager);
+    }
+
+    aws_tls_connection_options_clean_up(&entry->connection_options);
+    aws_credentials_destroy(entry->credentials);
+    aws_string_destroy(entry->host);
+    aws_string_destroy(entry->bucket);
+
+    aws_mem_release(entry->allocator, entry);
+}
+
+/*
+ * Frees what's left of the cache once every connection manager has shut down; the tls context has to outlive them
+ */
+static void s_s3_session_cache_finish_destroy(struct aws_s3_session_cache *session_cache) {
+    AWS_LOGF_DEBUG(
+        AWS_LS_AUTH_CREDENTIALS_PROVIDER, "(id=%p) S3 session cache shutdown complete", (void *)session_cache);
+
+    s3_session_cache_on_destroyed_fn *on_destroyed = session_cache->on_destroyed;
+    void *on_destroyed_user_data = session_cache->on_destroyed_user_data;
+
+    aws_mutex_clean_up(&session_cache->lock);
+
+    aws_credentials_provider_release(session_cache->creds_provider);
+
+    if (session_cache->owns_tls_ctx) {
+        aws_tls_ctx_destroy(session_cache->tls_ctx);
+    }
+
+    aws_string_destroy(session_cache->region);
+    aws_string_destroy(session_cache->endpoint_host_suffix);
+
+    aws_mem_release(session_cache->allocator, session_cache);
+
+    if (on_destroyed != NULL) {
+        on_destroyed(on_destroyed_user_data);
+    }
+}
+
+static void s_release_live_manager(struct aws_s3_session_cache *session_cache) {
+    size_t old_value = aws_atomic_fetch_sub(&session_cache->live_manager_count, 1);
+    if (old_value == 1) {
+        s_s3_session_cache_finish_destroy(session_cache);
+    }
+}
+
+static void s_on_connection_manager_shutdown(void *user_data) {
+    s_release_live_manager(user_data);
+}
+
+static void s_s3_session_cache_destroy(
+    struct aws_s3_session_cache *session_cache,
+    s3_session_cache_on_destroyed_fn *on_destroyed,
+    void *on_destroyed_user_data) {
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_AUTH_CREDENTIALS_PROVIDER, "(id=%p) Destroying S3 session cache", (void *)session_cache);
+
+    session_cache->on_destroyed = on_destroyed;
+    session_cache->on_destroyed_user_data = on_destroyed_user_data;
+
+    /* releases every entry's connection manager; each one reports back through s_on_connection_manager_shutdown */
+    aws_hash_table_clean_up(&session_cache->entries);
+
+    s_release_live_manager(session_cache);
+}
+
+/*
+ * Drops a reference.  If it was the last one, on_destroyed (optional) is invoked once the cache's connection managers
+ * have all shut down; otherwise it is invoked right away, since the caller holds nothing else.
+ */
+static void s_s3_session_cache_release_with_callback(
+    struct aws_s3_session_cache *session_cache,
+    s3_session_cache_on_destroyed_fn *on_destroyed,
+    void *on_destroyed_user_data) {
+
+    size_t old_value = aws_atomic_fetch_sub(&session_cache->ref_count, 1);
+    if (old_value == 1) {
+        s_s3_session_cache_destroy(session_cache, on_destroyed, on_destroyed_user_data);
+    } else if (on_destroyed != NULL) {
+        on_destroyed(on_destroyed_user_data);
+    }
+}
+
+void aws_s3_session_cache_acquire(struct aws_s3_session_cache *session_cache) {
+    aws_atomic_fetch_add(&session_cache->ref_count, 1);
+}
+
+void aws_s3_session_cache_release(struct aws_s3_session_cache *session_cache) {
+    if (session_cache == NULL) {
+        return;
+    }
+
+    s_s3_session_cache_release_with_callback(session_cache, NULL, NULL);
+}
+
+/*
+ * Directory bucket names end in "--<zone id>--x-s3", and the zone's endpoint is
+ * "s3express-<zone id>.<region>.amazonaws.com".
+ */
+static int s_append_zonal_host_suffix(
+    struct aws_s3_session_cache *session_cache,
+    struct aws_byte_cursor bucket,
+    struct aws_byte_buf *host_buf) {
+
+    if (bucket.len <= s_directory_bucket_suffix.len) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    /* leaves bucket pointing at what should be the "--x-s3" suffix */
+    struct aws_byte_cursor name_and_zone = aws_byte_cursor_advance(&bucket, bucket.len - s_directory_bucket_suffix.len);
+    if (!aws_byte_cursor_eq(&bucket, &s_directory_bucket_suffix)) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    /* the zone id starts after the last "--" */
+    size_t zone_start = 0;
+    for (size_t i = name_and_zone.len; i >= 2; --i) {
+        if (name_and_zone.ptr[i - 1] == '-' && name_and_zone.ptr[i - 2] == '-') {
+            zone_start = i;
+            break;
+        }
+    }
+
+    /* there must be both a name and a zone id */
+    if (zone_start <= 2 || zone_start == name_and_zone.len) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    struct aws_byte_cursor zone_id =
+        aws_byte_cursor_from_array(name_and_zone.ptr + zone_start, name_and_zone.len - zone_start);
+    struct aws_byte_cursor region = aws_byte_cursor_from_string(session_cache->region);
+
+    if (aws_byte_buf_append_dynamic(host_buf, &s_zone_host_prefix) ||
+        aws_byte_buf_append_dynamic(host_buf, &zone_id) || aws_byte_buf_append_dynamic(host_buf, &s_dot) ||
+        aws_byte_buf_append_dynamic(host_buf, &region) ||
+        aws_byte_buf_append_dynamic(host_buf, &s_regional_host_suffix)) {
+        return AWS_OP_ERR;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static struct aws_string *s_new_bucket_host(struct aws_s3_session_cache *session_cache, struct aws_byte_cursor bucket) {
+    struct aws_string *host = NULL;
+
+    struct aws_byte_buf host_buf;
+    if (aws_byte_buf_init(&host_buf, session_cache->allocator, bucket.len + 64)) {
+        return NULL;
+    }
+
+    if (aws_byte_buf_append_dynamic(&host_buf, &bucket) || aws_byte_buf_append_dynamic(&host_buf, &s_dot)) {
+        goto done;
+    }
+
+    if (session_cache->endpoint_host_suffix != NULL) {
+        struct aws_byte_cursor suffix = aws_byte_cursor_from_string(session_cache->endpoint_host_suffix);
+        if (aws_byte_buf_append_dynamic(&host_buf, &suffix)) {
+            goto done;
+        }
+    } else if (s_append_zonal_host_suffix(session_cache, bucket, &host_buf)) {
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+            "(id=%p) Unable to derive an endpoint for bucket \"" PRInSTR
+            "\"; expected a name of the form <name>--<zone id>--x-s3",
+            (void *)session_cache,
+            AWS_BYTE_CURSOR_PRI(bucket));
+        goto done;
+    }
+
+    host = aws_string_new_from_array(session_cache->allocator, host_buf.buffer, host_buf.len);
+
+done:
+    aws_byte_buf_clean_up(&host_buf);
+
+    return host;
+}
+
+static struct s3_session_entry *s_session_entry_new(
+    struct aws_s3_session_cache *session_cache,
+    struct aws_byte_cursor bucket) {
+
+    struct aws_allocator *allocator = session_cache->allocator;
+
+    struct s3_session_entry *entry = aws_mem_calloc(allocator, 1, sizeof(struct s3_session_entry));
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    entry->allocator = allocator;
+    entry->function_table = session_cache->function_table;
+    aws_linked_list_init(&entry->pending_queries);
+
+    entry->bucket = aws_string_new_from_array(allocator, bucket.ptr, bucket.len);
+    if (entry->bucket == NULL) {
+        goto on_error;
+    }
+
+    entry->key = aws_byte_cursor_from_string(entry->bucket);
+
+    entry->host = s_new_bucket_host(session_cache, bucket);
+    if (entry->host == NULL) {
+        goto on_error;
+    }
+
+    struct aws_byte_cursor host_cur = aws_byte_cursor_from_string(entry->host);
+
+    aws_tls_connection_options_init_from_ctx(&entry->connection_options, session_cache->tls_ctx);
+    if (aws_tls_connection_options_set_server_name(&entry->connection_options, allocator, &host_cur)) {
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+            "(id=%p) Failed to create tls connection options with error %s",
+            (void *)session_cache,
+            aws_error_debug_str(aws_last_error()));
+        goto on_error;
+    }
+
+    struct aws_socket_options socket_options = {
+        .type = AWS_SOCKET_STREAM,
+        .domain = AWS_SOCKET_IPV6,
+        .connect_timeout_ms = 3000,
+    };
+
+    struct aws_http_connection_manager_options connection_manager_options = {
+        .bootstrap = session_cache->bootstrap,
+        .host = host_cur,
+        .initial_window_size = SIZE_MAX,
+        .max_connections = 2,
+        .port = 443,
+        .socket_options = &socket_options,
+        .tls_connection_options = &entry->connection_options,
+        .shutdown_complete_callback = s_on_connection_manager_shutdown,
+        .shutdown_complete_user_data = session_cache,
+    };
+
+    entry->connection_manager =
+        session_cache->function_table->aws_http_connection_manager_new(allocator, &connection_manager_options);
+    if (entry->connection_manager != NULL) {
+        aws_atomic_fetch_add(&session_cache->live_manager_count, 1);
+    } else {
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+            "(id=%p) Failed to create a connection manager with error %s",
+            (void *)session_cache,
+            aws_error_debug_str(aws_last_error()));
+        goto on_error;
+    }
+
+    return entry;
+
+on_error:
+
+    s_session_entry_destroy(entry);
+
+    return NULL;
+}
+
+/*
+ * Makes room for one more bucket by evicting the least recently used idle one.  Buckets with a CreateSession call
+ * in flight are never evicted, so the table can briefly exceed max_sessions if every bucket is busy.
+ * Called with the lock held.
+ */
+static void s_evict_least_recently_used(struct aws_s3_session_cache *session_cache) {
+    if (aws_hash_table_get_entry_count(&session_cache->entries) < session_cache->max_sessions) {
+        return;
+    }
+
+    struct s3_session_entry *oldest = NULL;
+
+    struct aws_hash_iter iter = aws_hash_iter_begin(&session_cache->entries);
+    while (!aws_hash_iter_done(&iter)) {
+        struct s3_session_entry *entry = iter.element.value;
+        if (!entry->create_in_progress && (oldest == NULL || entry->last_used_time < oldest->last_used_time)) {
+            oldest = entry;
+        }
+
+        aws_hash_iter_next(&iter);
+    }
+
+    if (oldest == NULL) {
+        return;
+    }
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+        "(id=%p) S3 session cache is full, evicting bucket %s",
+        (void *)session_cache,
+        aws_string_c_str(oldest->bucket));
+
+    aws_hash_table_remove(&session_cache->entries, &oldest->key, NULL, NULL);
+}
+
+/* Called with the lock held */
+static struct s3_session_entry *s_find_or_add_entry(
+    struct aws_s3_session_cache *session_cache,
+    struct aws_byte_cursor bucket) {
+
+    struct aws_hash_element *element = NULL;
+    if (aws_hash_table_find(&session_cache->entries, &bucket, &element)) {
+        return NULL;
+    }
+
+    if (element != NULL) {
+        return element->value;
+    }
+
+    s_evict_least_recently_used(session_cache);
+
+    struct s3_session_entry *entry = s_session_entry_new(session_cache, bucket);
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    if (aws_hash_table_put(&session_cache->entries, &entry->key, entry, NULL)) {
+        s_session_entry_destroy(entry);
+        return NULL;
+    }
+
+    return entry;
+}
+
+/*
+ * Finishes a CreateSession call: installs the new session (on success), clears the in-progress flag and notifies
+ * everyone who was waiting on it.  Takes ownership of credentials.
+ */
+static void s_s3_session_cache_finish_create(
+    struct aws_s3_session_cache *session_cache,
+    struct s3_session_entry *entry,
+    struct aws_credentials *credentials,
+    uint64_t start_time,
+    uint64_t expiration_time) {
+
+    struct aws_linked_list pending_queries;
+    aws_linked_list_init(&pending_queries);
+
+    struct aws_credentials *notify_credentials = NULL;
+
+    aws_mutex_lock(&session_cache->lock);
+
+    aws_linked_list_swap_contents(&pending_queries, &entry->pending_queries);
+    entry->create_in_progress = false;
+
+    if (credentials != NULL) {
+        aws_credentials_destroy(entry->credentials);
+        entry->credentials = credentials;
+        entry->expiration_time = expiration_time;
+
+        uint64_t refresh_ahead_in_ns = session_cache->refresh_ahead_in_ns;
+        if (expiration_time > start_time && refresh_ahead_in_ns > (expiration_time - start_time) / 2) {
+            refresh_ahead_in_ns = (expiration_time - start_time) / 2;
+        }
+
+        entry->refresh_time =
+            expiration_time > refresh_ahead_in_ns ? expiration_time - refresh_ahead_in_ns : expiration_time;
+
+        /* the entry may be refreshed or evicted as soon as we unlock, so notify from our own copy */
+        if (!aws_linked_list_empty(&pending_queries)) {
+            notify_credentials = aws_credentials_new_copy(session_cache->allocator, credentials);
+        }
+
+        AWS_LOGF_DEBUG(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+            "(id=%p) Created session for bucket %s, valid until %" PRIu64,
+            (void *)session_cache,
+            aws_string_c_str(entry->bucket),
+            expiration_time);
+    } else {
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+            "(id=%p) Failed to create a session for bucket %s",
+            (void *)session_cache,
+            aws_string_c_str(entry->bucket));
+    }
+
+    aws_mutex_unlock(&session_cache->lock);
+
+    s_session_query_list_notify_and_clean_up(&pending_queries, session_cache->allocator, notify_credentials);
+
+    aws_credentials_destroy(notify_credentials);
+}
+
+static void s_create_session_request_complete(
+    struct s3_create_session_request *request,
+    struct aws_credentials *credentials,
+    uint64_t expiration_time) {
+
+    struct aws_s3_session_cache *session_cache = request->session_cache;
+
+    /*
+     * The entry can only be touched while create_in_progress pins it; once finish_create clears that, it may be
+     * evicted (and destroyed) by another thread at any time.
+     */
+    if (request->connection != NULL) {
+        session_cache->function_table->aws_http_connection_manager_release_connection(
+            request->entry->connection_manager, request->connection);
+        request->connection = NULL;
+    }
+
+    s_s3_session_cache_finish_create(session_cache, request->entry, credentials, request->start_time, expiration_time);
+    request->entry = NULL;
+
+    aws_signable_destroy(request->signable);
+    if (request->message != NULL) {
+        aws_http_message_destroy(request->message);
+    }
+    aws_byte_buf_clean_up(&request->output_buf);
+
+    aws_mem_release(session_cache->allocator, request);
+
+    aws_s3_session_cache_release(session_cache);
+}
+
+static int s_on_incoming_body_fn(struct aws_http_stream *stream, const struct aws_byte_cursor *data, void *user_data) {
+    (void)stream;
+
+    struct s3_create_session_request *request = user_data;
+    return aws_byte_buf_append_dynamic(&request->output_buf, data);
+}
+
+/* parse doc of form
+<CreateSessionResult>
+     <Credentials>
+          <SessionToken>sessionToken</SessionToken>
+          <SecretAccessKey>secretKey</SecretAccessKey>
+          <AccessKeyId>accessKeyId</AccessKeyId>
+          <Expiration>2019-11-30T12:00:00Z</Expiration>
+     </Credentials>
+</CreateSessionResult>
+ */
+static bool s_on_node_encountered_fn(struct aws_xml_parser *parser, struct aws_xml_node *node, void *user_data) {
+    if (aws_byte_cursor_eq_ignore_case(&node->name, &s_create_session_result_name) ||
+        aws_byte_cursor_eq_ignore_case(&node->name, &s_credentials_name)) {
+        return aws_xml_node_traverse(parser, node, s_on_node_encountered_fn, user_data) == AWS_OP_SUCCESS;
+    }
+
+    struct s3_create_session_response *response = user_data;
+
+    if (aws_byte_cursor_eq_ignore_case(&node->name, &s_access_key_id_name)) {
+        aws_xml_node_as_body(parser, node, &response->access_key_id);
+    } else if (aws_byte_cursor_eq_ignore_case(&node->name, &s_secret_key_name)) {
+        aws_xml_node_as_body(parser, node, &response->secret_access_key);
+    } else if (aws_byte_cursor_eq_ignore_case(&node->name, &s_session_token_name)) {
+        aws_xml_node_as_body(parser, node, &response->session_token);
+    } else if (aws_byte_cursor_eq_ignore_case(&node->name, &s_expiration_name)) {
+        aws_xml_node_as_body(parser, node, &response->expiration);
+    }
+
+    return true;
+}
+
+static uint64_t s_parse_expiration(struct s3_create_session_request *request, struct aws_byte_cursor expiration) {
+    uint64_t default_expiration_time =
+        request->start_time +
+        aws_timestamp_convert(S3_SESSION_DEFAULT_LIFETIME_SECS, AWS_TIMESTAMP_SECS, AWS_TIMESTAMP_NANOS, NULL);
+
+    if (expiration.len == 0) {
+        return default_expiration_time;
+    }
+
+    struct aws_byte_buf expiration_buf = aws_byte_buf_from_array(expiration.ptr, expiration.len);
+
+    struct aws_date_time expiration_date;
+    if (aws_date_time_init_from_str(&expiration_date, &expiration_buf, AWS_DATE_FORMAT_ISO_8601)) {
+        AWS_LOGF_WARN(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+            "(id=%p) Unable to parse session expiration \"" PRInSTR "\", assuming the default session lifetime",
+            (void *)request->session_cache,
+            AWS_BYTE_CURSOR_PRI(expiration));
+        return default_expiration_time;
+    }
+
+    return aws_timestamp_convert(
+        aws_date_time_as_millis(&expiration_date), AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+}
+
+static void s_on_stream_complete_fn(struct aws_http_stream *stream, int error_code, void *user_data) {
+    struct s3_create_session_request *request = user_data;
+    struct aws_s3_session_cache *session_cache = request->session_cache;
+
+    struct aws_credentials *credentials = NULL;
+    uint64_t expiration_time = 0;
+
+    int http_response_code = 0;
+    if (session_cache->function_table->aws_http_stream_get_incoming_response_status(stream, &http_response_code)) {
+        http_response_code = 0;
+    }
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+        "(id=%p) CreateSession call to %s completed with error code %d and http status %d",
+        (void *)session_cache,
+        aws_string_c_str(request->entry->host),
+        error_code,
+        http_response_code);
+
+    if (error_code != AWS_ERROR_SUCCESS || http_response_code != 200) {
+        goto done;
+    }
+
+    struct s3_create_session_response response;
+    AWS_ZERO_STRUCT(response);
+
+    struct aws_byte_cursor payload_cur = aws_byte_cursor_from_buf(&request->output_buf);
+
+    struct aws_xml_parser xml_parser;
+    if (aws_xml_parser_init(&xml_parser, session_cache->allocator, &payload_cur, 0)) {
+        goto done;
+    }
+
+    int parse_result = aws_xml_parser_parse(&xml_parser, s_on_node_encountered_fn, &response);
+    aws_xml_parser_clean_up(&xml_parser);
+
+    if (parse_result || response.access_key_id.len == 0 || response.secret_access_key.len == 0 ||
+        response.session_token.len == 0) {
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+            "(id=%p) CreateSession response was corrupted, treating as an error.",
+            (void *)session_cache);
+        goto done;
+    }
+
+    credentials = aws_credentials_new_from_cursors(
+        session_cache->allocator, &response.access_key_id, &response.secret_access_key, &response.session_token);
+    expiration_time = s_parse_expiration(request, response.expiration);
+
+done:
+    s_create_session_request_complete(request, credentials, expiration_time);
+}
+
+static void s_on_connection_setup_fn(struct aws_http_connection *connection, int error_code, void *user_data) {
+    struct s3_create_session_request *request = user_data;
+    struct aws_s3_session_cache *session_cache = request->session_cache;
+
+    if (error_code) {
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+            "(id=%p) Failed to connect to %s with error %d(%s)",
+            (void *)session_cache,
+            aws_string_c_str(request->entry->host),
+            error_code,
+            aws_error_str(error_code));
+        goto error;
+    }
+
+    request->connection = connection;
+
+    if (aws_byte_buf_init(&request->output_buf, session_cache->allocator, 2048)) {
+        goto error;
+    }
+
+    struct aws_http_make_request_options options = {
+        .self_size = sizeof(struct aws_http_make_request_options),
+        .request = request->message,
+        .user_data = request,
+        .manual_window_management = false,
+        .on_response_body = s_on_incoming_body_fn,
+        .on_complete = s_on_stream_complete_fn,
+    };
+
+    struct aws_http_stream *stream =
+        session_cache->function_table->aws_http_connection_make_request(connection, &options);
+    if (stream == NULL) {
+        goto error;
+    }
+
+    session_cache->function_table->aws_http_stream_release(stream);
+
+    return;
+
+error:
+    s_create_session_request_complete(request, NULL, 0);
+}
+
+static void s_on_signing_complete(struct aws_signing_result *result, int error_code, void *userdata) {
+    struct s3_create_session_request *request = userdata;
+    struct aws_s3_session_cache *session_cache = request->session_cache;
+
+    if (error_code || result == NULL) {
+        goto error;
+    }
+
+    if (aws_apply_signing_result_to_http_request(request->message, session_cache->allocator, result)) {
+        goto error;
+    }
+
+    session_cache->function_table->aws_http_connection_manager_acquire_connection(
+        request->entry->connection_manager, s_on_connection_setup_fn, request);
+
+    return;
+
+error:
+    s_create_session_request_complete(request, NULL, 0);
+}
+
+/*
+ * Starts an async CreateSession call.  Completion (success or failure) always runs through
+ * s_s3_session_cache_finish_create, even when setup fails synchronously.
+ */
+static void s_s3_session_cache_begin_create(
+    struct aws_s3_session_cache *session_cache,
+    struct s3_session_entry *entry,
+    uint64_t now) {
+
+    struct s3_create_session_request *request =
+        aws_mem_calloc(session_cache->allocator, 1, sizeof(struct s3_create_session_request));
+    if (request == NULL) {
+        s_s3_session_cache_finish_create(session_cache, entry, NULL, now, 0);
+        return;
+    }
+
+    aws_s3_session_cache_acquire(session_cache);
+    request->session_cache = session_cache;
+    request->entry = entry;
+    request->start_time = now;
+
+    request->message = aws_http_message_new_request(session_cache->allocator);
+    if (request->message == NULL) {
+        goto on_error;
+    }
+
+    struct aws_http_header host_header = {
+        .name = s_host_header_name,
+        .value = aws_byte_cursor_from_string(entry->host),
+    };
+
+    if (aws_http_message_set_request_method(request->message, s_get_method) ||
+        aws_http_message_set_request_path(request->message, s_create_session_path) ||
+        aws_http_message_add_header(request->message, host_header)) {
+        goto on_error;
+    }
+
+    request->signable = aws_signable_new_http_request(session_cache->allocator, request->message);
+    if (request->signable == NULL) {
+        goto on_error;
+    }
+
+    request->signing_config.config_type = AWS_SIGNING_CONFIG_AWS;
+    request->signing_config.algorithm = AWS_SIGNING_ALGORITHM_SIG_V4_HEADER;
+    request->signing_config.body_signing_type = AWS_BODY_SIGNING_ON;
+    request->signing_config.credentials_provider = session_cache->creds_provider;
+    request->signing_config.region = aws_byte_cursor_from_string(session_cache->region);
+    request->signing_config.service = s_service_name;
+    request->signing_config.use_double_uri_encode = false;
+    aws_date_time_init_epoch_millis(
+        &request->signing_config.date, aws_timestamp_convert(now, AWS_TIMESTAMP_NANOS, AWS_TIMESTAMP_MILLIS, NULL));
+
+    if (aws_sign_request_aws(
+            session_cache->allocator,
+            request->signable,
+            (struct aws_signing_config_base *)&request->signing_config,
+            s_on_signing_complete,
+            request)) {
+        goto on_error;
+    }
+
+    return;
+
+on_error:
+    s_create_session_request_complete(request, NULL, 0);
+}
+
+int aws_s3_session_cache_get_credentials(
+    struct aws_s3_session_cache *session_cache,
+    struct aws_byte_cursor bucket,
+    aws_on_get_credentials_callback_fn callback,
+    void *user_data) {
+
+    uint64_t now = 0;
+    if (session_cache->clock_fn(&now)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_credentials *cached_credentials = NULL;
+    struct s3_session_entry *create_entry = NULL;
+    bool perform_callback = false;
+
+    aws_mutex_lock(&session_cache->lock);
+
+    struct s3_session_entry *entry = s_find_or_add_entry(session_cache, bucket);
+    if (entry == NULL) {
+        perform_callback = true;
+    } else {
+        entry->last_used_time = now;
+
+        if (entry->credentials != NULL && now < entry->expiration_time) {
+            perform_callback = true;
+            cached_credentials = aws_credentials_new_copy(session_cache->allocator, entry->credentials);
+
+            if (now >= entry->refresh_time && !entry->create_in_progress) {
+                entry->create_in_progress = true;
+                create_entry = entry;
+            }
+        } else {
+            struct s3_session_query *query =
+                aws_mem_calloc(session_cache->allocator, 1, sizeof(struct s3_session_query));
+            if (query != NULL) {
+                query->callback = callback;
+                query->user_data = user_data;
+                aws_linked_list_push_back(&entry->pending_queries, &query->node);
+
+                if (!entry->create_in_progress) {
+                    entry->create_in_progress = true;
+                    create_entry = entry;
+                }
+            } else {
+                perform_callback = true;
+            }
+        }
+    }
+
+    aws_mutex_unlock(&session_cache->lock);
+
+    if (create_entry != NULL) {
+        AWS_LOGF_DEBUG(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+            "(id=%p) Bucket " PRInSTR " %s, calling CreateSession",
+            (void *)session_cache,
+            AWS_BYTE_CURSOR_PRI(bucket),
+            perform_callback ? "entered the refresh-ahead window" : "has no valid session");
+
+        s_s3_session_cache_begin_create(session_cache, create_entry, now);
+    }
+
+    if (perform_callback) {
+        callback(cached_credentials, user_data);
+        aws_credentials_destroy(cached_credentials);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+struct aws_s3_session_cache *aws_s3_session_cache_new(
+    struct aws_allocator *allocator,
+    const struct aws_s3_session_cache_options *options) {
+
+    if (options->creds_provider == NULL || options->region.len == 0) {
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_CREDENTIALS_PROVIDER, "S3 session cache requires a credentials provider and a region");
+        aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        return NULL;
+    }
+
+    struct aws_s3_session_cache *session_cache = aws_mem_calloc(allocator, 1, sizeof(struct aws_s3_session_cache));
+    if (session_cache == NULL) {
+        return NULL;
+    }
+
+    session_cache->allocator = allocator;
+    aws_atomic_init_int(&session_cache->ref_count, 1);
+    aws_atomic_init_int(&session_cache->live_manager_count, 1);
+
+    if (aws_mutex_init(&session_cache->lock)) {
+        goto on_lock_error;
+    }
+
+    if (aws_hash_table_init(
+            &session_cache->entries,
+            allocator,
+            S3_SESSION_TABLE_DEFAULT_SIZE,
+            aws_hash_byte_cursor_ptr,
+            (aws_hash_callback_eq_fn *)aws_byte_cursor_eq,
+            NULL, /* The key is owned by the value (and destroy cleans it up), so we don't have to */
+            s_session_entry_destroy)) {
+        goto on_table_error;
+    }
+
+    session_cache->creds_provider = options->creds_provider;
+    aws_credentials_provider_acquire(session_cache->creds_provider);
+
+    session_cache->bootstrap = options->bootstrap;
+
+    session_cache->function_table = &s_default_function_table;
+    if (options->function_table != NULL) {
+        session_cache->function_table = options->function_table;
+    }
+
+    session_cache->clock_fn = &aws_sys_clock_get_ticks;
+    if (options->clock_fn != NULL) {
+        session_cache->clock_fn = options->clock_fn;
+    }
+
+    session_cache->max_sessions = options->max_sessions;
+    if (session_cache->max_sessions == 0) {
+        session_cache->max_sessions = S3_SESSION_DEFAULT_MAX_SESSIONS;
+    }
+
+    uint64_t refresh_ahead_in_seconds = options->refresh_ahead_in_seconds;
+    if (refresh_ahead_in_seconds == 0) {
+        refresh_ahead_in_seconds = S3_SESSION_DEFAULT_REFRESH_AHEAD_SECS;
+    }
+
+    session_cache->refresh_ahead_in_ns =
+        aws_timestamp_convert(refresh_ahead_in_seconds, AWS_TIMESTAMP_SECS, AWS_TIMESTAMP_NANOS, NULL);
+
+    session_cache->region = aws_string_new_from_array(allocator, options->region.ptr, options->region.len);
+    if (session_cache->region == NULL) {
+        goto on_error;
+    }
+
+    if (options->endpoint_host_suffix.len > 0) {
+        session_cache->endpoint_host_suffix = aws_string_new_from_array(
+            allocator, options->endpoint_host_suffix.ptr, options->endpoint_host_suffix.len);
+        if (session_cache->endpoint_host_suffix == NULL) {
+            goto on_error;
+        }
+    }
+
+    if (options->tls_ctx != NULL) {
+        session_cache->tls_ctx = options->tls_ctx;
+    } else {
+        struct aws_tls_ctx_options tls_options;
+        aws_tls_ctx_options_init_default_client(&tls_options, allocator);
+        session_cache->tls_ctx = aws_tls_client_ctx_new(allocator, &tls_options);
+        aws_tls_ctx_options_clean_up(&tls_options);
+
+        if (session_cache->tls_ctx == NULL) {
+            AWS_LOGF_ERROR(
+                AWS_LS_AUTH_CREDENTIALS_PROVIDER,
+                "(id=%p) Failed to create a tls context with error %s",
+                (void *)session_cache,
+                aws_error_debug_str(aws_last_error()));
+            goto on_error;
+        }
+
+        session_cache->owns_tls_ctx = true;
+    }
+
+    return session_cache;
+
+on_error:
+    s_s3_session_cache_destroy(session_cache, NULL, NULL);
+    return NULL;
+
+on_table_error:
+    aws_mutex_clean_up(&session_cache->lock);
+
+on_lock_error:
+    aws_mem_release(allocator, session_cache);
+
+    return NULL;
+}
+
+/*
+ * Per-bucket credentials provider
+ */
+
+struct aws_credentials_provider_s3_session_impl {
+    struct aws_s3_session_cache *session_cache;
+    struct aws_string *bucket;
+};
+
+static int s_s3_session_credentials_provider_get_credentials_async(
+    struct aws_credentials_provider *provider,
+    aws_on_get_credentials_callback_fn callback,
+    void *user_data) {
+
+    struct aws_credentials_provider_s3_session_impl *impl = provider->impl;
+
+    return aws_s3_session_cache_get_credentials(
+        impl->session_cache, aws_byte_cursor_from_string(impl->bucket), callback, user_data);
+}
+
+static void s_on_session_cache_released(void *user_data) {
+    struct aws_credentials_provider *provider = user_data;
+
+    aws_credentials_provider_invoke_shutdown_callback(provider);
+
+    aws_mem_release(provider->allocator, provider);
+}
+
+static void s_s3_session_credentials_provider_destroy(struct aws_credentials_provider *provider) {
+    struct aws_credentials_provider_s3_session_impl *impl = provider->impl;
+
+    aws_string_destroy(impl->bucket);
+
+    /* if this was the cache's last reference, shutdown completes once the cache's connection managers are gone */
+    s_s3_session_cache_release_with_callback(impl->session_cache, s_on_session_cache_released, provider);
+}
+
+static struct aws_credentials_provider_vtable s_aws_credentials_provider_s3_session_vtable = {
+    .get_credentials = s_s3_session_credentials_provider_get_credentials_async,
+    .destroy = s_s3_session_credentials_provider_destroy,
+};
+
+struct aws_credentials_provider *aws_credentials_provider_new_s3_session(
+    struct aws_allocator *allocator,
+    const struct aws_credentials_provider_s3_session_options *options) {
+
+    if (options->session_cache == NULL || options->bucket.len == 0) {
+        aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        return NULL;
+    }
+
+    struct aws_credentials_provider *provider = NULL;
+    struct aws_credentials_provider_s3_session_impl *impl = NULL;
+
+    aws_mem_acquire_many(
+        allocator,
+        2,
+        &provider,
+        sizeof(struct aws_credentials_provider),
+        &impl,
+        sizeof(struct aws_credentials_provider_s3_session_impl));
+
+    if (!provider) {
+        return NULL;
+    }
+
+    AWS_ZERO_STRUCT(*provider);
+    AWS_ZERO_STRUCT(*impl);
+
+    impl->bucket = aws_string_new_from_array(allocator, options->bucket.ptr, options->bucket.len);
+    if (impl->bucket == NULL) {
+        aws_mem_release(allocator, provider);
+        return NULL;
+    }
+
+    aws_credentials_provider_init_base(provider, allocator, &s_aws_credentials_provider_s3_session_vtable, impl);
+
+    impl->session_cache = options->session_cache;
+    aws_s3_session_cache_acquire(impl->session_cache);
+
+    provider->shutdown_options = options->shutdown_options;
+
+    return provider;
+}
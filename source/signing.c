@@ -16,6 +16,7 @@
 #include <aws/auth/signing.h>
 
 #include <aws/auth/credentials.h>
+#include <aws/auth/private/auth_probes.h>
 #include <aws/auth/private/aws_signing.h>
 #include <aws/io/uri.h>
 
@@ -25,6 +26,14 @@
 
 aws_on_get_credentials_callback_fn s_aws_signing_on_get_credentials;
 
+static aws_signing_capture_fn *s_capture_fn = NULL;
+static void *s_capture_user_data = NULL;
+
+void aws_signing_set_capture_fn(aws_signing_capture_fn *capture_fn, void *user_data) {
+    s_capture_fn = capture_fn;
+    s_capture_user_data = user_data;
+}
+
 int aws_sign_request_aws(
     struct aws_allocator *allocator,
     const struct aws_signable *signable,
@@ -40,12 +49,18 @@ int aws_sign_request_aws(
 
     const struct aws_signing_config_aws *config = (void *)base_config;
 
+    if (s_capture_fn != NULL) {
+        s_capture_fn(signable, config, s_capture_user_data);
+    }
+
     struct aws_signing_state_aws *signing_state =
         aws_signing_state_new(allocator, config, signable, on_complete, userdata);
     if (!signing_state) {
         return AWS_OP_ERR;
     }
 
+    AWS_AUTH_PROBE2(sign__start, (void *)signable, (int)config->algorithm);
+
     if (aws_credentials_provider_get_credentials(
             config->credentials_provider, s_aws_signing_on_get_credentials, signing_state)) {
         goto cleanup;
@@ -54,6 +69,9 @@ int aws_sign_request_aws(
     return AWS_OP_SUCCESS;
 
 cleanup:
+    /* every sign__start is matched by a sign__done, even when the callback will never run */
+    AWS_AUTH_PROBE2(sign__done, (void *)signable, aws_last_error());
+
     aws_signing_state_destroy(signing_state);
     return AWS_OP_ERR;
 }
@@ -64,6 +82,8 @@ void s_aws_signing_on_get_credentials(struct aws_credentials *credentials, void
     struct aws_signing_result *result = NULL;
     int error_code = AWS_ERROR_SUCCESS;
 
+    AWS_AUTH_PROBE2(sign__credentials, (void *)state->signable, credentials != NULL);
+
     if (!credentials) {
         AWS_LOGF_ERROR(
             AWS_LS_AUTH_SIGNING, "(id=%p) Credentials Provider provided no credentials", (void *)state->signable);
@@ -84,12 +104,11 @@ void s_aws_signing_on_get_credentials(struct aws_credentials *credentials, void
         goto cleanup;
     }
 
-    AWS_LOGF_INFO(
-        AWS_LS_AUTH_SIGNING,
-        "(id=%p) Http request successfully built canonical request for algorithm %s, with contents \"" PRInSTR "\"",
+    AWS_AUTH_PROBE3(
+        sign__canonical__request,
         (void *)state->signable,
-        aws_signing_algorithm_to_string(state->config.algorithm),
-        AWS_BYTE_BUF_PRI(state->canonical_request));
+        state->canonical_request.len,
+        state->payload_bytes_hashed);
 
     if (aws_signing_build_string_to_sign(state)) {
         AWS_LOGF_ERROR(
@@ -101,12 +120,7 @@ void s_aws_signing_on_get_credentials(struct aws_credentials *credentials, void
         goto cleanup;
     }
 
-    AWS_LOGF_INFO(
-        AWS_LS_AUTH_SIGNING,
-        "(id=%p) Http request successfully built string-to-sign via algorithm %s, with contents \"" PRInSTR "\"",
-        (void *)state->signable,
-        aws_signing_algorithm_to_string(state->config.algorithm),
-        AWS_BYTE_BUF_PRI(state->string_to_sign));
+    AWS_AUTH_PROBE2(sign__string__to__sign, (void *)state->signable, state->string_to_sign.len);
 
     if (aws_signing_build_authorization_value(state)) {
         AWS_LOGF_ERROR(
@@ -122,6 +136,8 @@ void s_aws_signing_on_get_credentials(struct aws_credentials *credentials, void
 
 cleanup:
 
+    AWS_AUTH_PROBE2(sign__done, (void *)state->signable, error_code);
+
     state->on_complete(result, error_code, state->userdata);
     aws_signing_state_destroy(state);
 }
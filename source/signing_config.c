@@ -15,6 +15,8 @@
 
 #include <aws/auth/signing_config.h>
 
+#include <inttypes.h>
+
 static const char *s_algorithm_names[AWS_SIGNING_ALGORITHM_COUNT] = {"Aws SigV4"};
 
 const char *aws_signing_algorithm_to_string(enum aws_signing_algorithm algorithm) {
@@ -40,6 +42,16 @@ int aws_validate_aws_signing_config_aws(const struct aws_signing_config_aws *con
         return aws_raise_error(AWS_AUTH_SIGNING_INVALID_CONFIGURATION);
     }
 
+    if (config->expiration_in_seconds > AWS_SIGV4_MAX_EXPIRATION_IN_SECONDS) {
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_SIGNING,
+            "(id=%p) Signing config expiration of %" PRIu64 " seconds exceeds the sigv4 maximum of %d",
+            (void *)config,
+            config->expiration_in_seconds,
+            AWS_SIGV4_MAX_EXPIRATION_IN_SECONDS);
+        return aws_raise_error(AWS_AUTH_SIGNING_INVALID_CONFIGURATION);
+    }
+
     if (config->credentials_provider == NULL) {
         AWS_LOGF_ERROR(
             AWS_LS_AUTH_SIGNING,
@@ -0,0 +1,601 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/signing_key_cache.h>
+
+#include <aws/auth/private/aws_signing.h>
+#include <aws/cal/hash.h>
+#include <aws/common/array_list.h>
+#include <aws/common/clock.h>
+#include <aws/common/condition_variable.h>
+#include <aws/common/date_time.h>
+#include <aws/common/hash_table.h>
+#include <aws/common/mutex.h>
+#include <aws/common/string.h>
+#include <aws/common/thread.h>
+
+#include <inttypes.h>
+
+#define SIGNING_KEY_TABLE_DEFAULT_SIZE 16
+#define SECONDS_PER_DAY 86400
+#define DEFAULT_PREDERIVE_LEAD_TIME_SECS 300
+
+/* one day's key for a scope */
+struct signing_key_slot {
+    bool is_valid;
+    int64_t day;
+    uint8_t key[AWS_SHA256_LEN];
+};
+
+struct signing_key_entry {
+    struct aws_allocator *allocator;
+
+    /* access key id, region and service, newline separated */
+    struct aws_string *scope;
+
+    /* the table key; points into scope */
+    struct aws_byte_cursor key;
+
+    /* point into scope */
+    struct aws_byte_cursor region;
+    struct aws_byte_cursor service;
+
+    struct aws_string *secret_access_key;
+
+    int64_t last_used_day;
+
+    /* today's and one neighbouring day's key, so requests dated either side of midnight both hit */
+    struct signing_key_slot slots[2];
+};
+
+struct aws_signing_key_cache {
+    struct aws_allocator *allocator;
+    aws_io_clock_fn *clock_fn;
+    uint64_t prederive_lead_time_secs;
+
+    struct aws_mutex lock;
+
+    /* everything below is protected by lock */
+
+    /* struct aws_byte_cursor * -> struct signing_key_entry * */
+    struct aws_hash_table entries;
+
+    struct aws_condition_variable signal;
+    struct aws_thread prederive_thread;
+    bool is_prederive_thread_started;
+    bool should_quit;
+
+    /* the most recent day that aws_signing_key_cache_prederive derived keys for */
+    int64_t prederived_day;
+
+    struct aws_signing_key_cache_stats stats;
+};
+
+/*
+ * A scope whose next day's key still needs deriving, copied out of the table so that the derivation can happen
+ * without holding the lock
+ */
+struct pending_prederivation {
+    struct aws_string *scope;
+    struct aws_string *secret_access_key;
+    struct aws_byte_cursor region;
+    struct aws_byte_cursor service;
+    uint8_t key[AWS_SHA256_LEN];
+};
+
+static void s_signing_key_entry_destroy(void *value) {
+    struct signing_key_entry *entry = value;
+
+    aws_string_destroy(entry->scope);
+    aws_string_destroy_secure(entry->secret_access_key);
+
+    aws_secure_zero(entry->slots, sizeof(entry->slots));
+    aws_mem_release(entry->allocator, entry);
+}
+
+static int s_get_current_day(struct aws_signing_key_cache *cache, int64_t *out_day, uint64_t *out_secs) {
+    uint64_t now_ns = 0;
+    if (cache->clock_fn(&now_ns)) {
+        return AWS_OP_ERR;
+    }
+
+    uint64_t now_secs = aws_timestamp_convert(now_ns, AWS_TIMESTAMP_NANOS, AWS_TIMESTAMP_SECS, NULL);
+
+    *out_day = (int64_t)(now_secs / SECONDS_PER_DAY);
+    if (out_secs != NULL) {
+        *out_secs = now_secs;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_derive_key_for_day(
+    struct aws_allocator *allocator,
+    const struct aws_string *secret_access_key,
+    int64_t day,
+    const struct aws_byte_cursor *region,
+    const struct aws_byte_cursor *service,
+    uint8_t *key) {
+
+    struct aws_date_time date;
+    aws_date_time_init_epoch_secs(&date, (double)(day * SECONDS_PER_DAY));
+
+    struct aws_byte_buf key_buf = aws_byte_buf_from_empty_array(key, AWS_SHA256_LEN);
+
+    return aws_signing_derive_sigv4_signing_key(allocator, secret_access_key, &date, region, service, &key_buf);
+}
+
+static struct signing_key_slot *s_find_slot(struct signing_key_entry *entry, int64_t day) {
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(entry->slots); ++i) {
+        if (entry->slots[i].is_valid && entry->slots[i].day == day) {
+            return &entry->slots[i];
+        }
+    }
+
+    return NULL;
+}
+
+/*
+ * Stores a key over the slot holding the oldest day, which keeps the current day's key around when the next day's
+ * arrives.  Keys older than both cached days (a straggling request dated before midnight) aren't worth a slot.
+ */
+static void s_store_key(struct signing_key_entry *entry, int64_t day, const uint8_t *key) {
+    struct signing_key_slot *slot = s_find_slot(entry, day);
+    if (slot == NULL) {
+        slot = &entry->slots[0];
+        if (entry->slots[1].is_valid == false ||
+            (entry->slots[0].is_valid && entry->slots[0].day > entry->slots[1].day)) {
+            slot = &entry->slots[1];
+        }
+
+        if (slot->is_valid && slot->day > day) {
+            return;
+        }
+    }
+
+    slot->is_valid = true;
+    slot->day = day;
+    memcpy(slot->key, key, AWS_SHA256_LEN);
+}
+
+static struct signing_key_entry *s_signing_key_entry_new(
+    struct aws_allocator *allocator,
+    struct aws_byte_cursor scope,
+    size_t region_offset,
+    size_t region_length,
+    const struct aws_string *secret_access_key) {
+
+    struct signing_key_entry *entry = aws_mem_calloc(allocator, 1, sizeof(struct signing_key_entry));
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    entry->allocator = allocator;
+    entry->scope = aws_string_new_from_array(allocator, scope.ptr, scope.len);
+    entry->secret_access_key = aws_string_new_from_string(allocator, secret_access_key);
+    if (entry->scope == NULL || entry->secret_access_key == NULL) {
+        s_signing_key_entry_destroy(entry);
+        return NULL;
+    }
+
+    entry->key = aws_byte_cursor_from_string(entry->scope);
+
+    entry->region = entry->key;
+    aws_byte_cursor_advance(&entry->region, region_offset);
+    entry->service = entry->region;
+    aws_byte_cursor_advance(&entry->service, region_length + 1);
+    entry->region.len = region_length;
+
+    return entry;
+}
+
+int aws_signing_key_cache_get_sigv4_key(
+    struct aws_signing_key_cache *cache,
+    const struct aws_string *access_key_id,
+    const struct aws_string *secret_access_key,
+    const struct aws_date_time *date,
+    const struct aws_byte_cursor *region,
+    const struct aws_byte_cursor *service,
+    struct aws_byte_buf *dest) {
+
+    int64_t day = (int64_t)aws_date_time_as_epoch_secs(date) / SECONDS_PER_DAY;
+
+    int result = AWS_OP_ERR;
+
+    struct aws_byte_buf scope;
+    if (aws_byte_buf_init(&scope, cache->allocator, access_key_id->len + region->len + service->len + 2)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_byte_cursor access_key_id_cursor = aws_byte_cursor_from_string(access_key_id);
+    struct aws_byte_cursor separator = aws_byte_cursor_from_c_str("\n");
+    aws_byte_buf_append(&scope, &access_key_id_cursor);
+    aws_byte_buf_append(&scope, &separator);
+    size_t region_offset = scope.len;
+    aws_byte_buf_append(&scope, region);
+    aws_byte_buf_append(&scope, &separator);
+    aws_byte_buf_append(&scope, service);
+
+    struct aws_byte_cursor scope_cursor = aws_byte_cursor_from_buf(&scope);
+
+    uint8_t key[AWS_SHA256_LEN];
+
+    aws_mutex_lock(&cache->lock);
+
+    struct aws_hash_element *element = NULL;
+    aws_hash_table_find(&cache->entries, &scope_cursor, &element);
+    if (element != NULL) {
+        struct signing_key_entry *entry = element->value;
+        struct signing_key_slot *slot = s_find_slot(entry, day);
+        if (slot != NULL && aws_string_eq(entry->secret_access_key, secret_access_key)) {
+            memcpy(key, slot->key, sizeof(key));
+            if (day > entry->last_used_day) {
+                entry->last_used_day = day;
+            }
+            ++cache->stats.hit_count;
+
+            aws_mutex_unlock(&cache->lock);
+            goto on_key;
+        }
+    }
+
+    aws_mutex_unlock(&cache->lock);
+
+    /* a miss; derive outside the lock so that other scopes aren't held up */
+    if (s_derive_key_for_day(cache->allocator, secret_access_key, day, region, service, key)) {
+        goto done;
+    }
+
+    aws_mutex_lock(&cache->lock);
+
+    ++cache->stats.derive_count;
+
+    element = NULL;
+    aws_hash_table_find(&cache->entries, &scope_cursor, &element);
+
+    struct signing_key_entry *entry = element != NULL ? element->value : NULL;
+    if (entry != NULL && !aws_string_eq(entry->secret_access_key, secret_access_key)) {
+        /* the secret for this access key changed; nothing cached for the old one is any use */
+        aws_hash_table_remove(&cache->entries, &scope_cursor, NULL, NULL);
+        entry = NULL;
+    }
+
+    if (entry == NULL) {
+        entry = s_signing_key_entry_new(cache->allocator, scope_cursor, region_offset, region->len, secret_access_key);
+        if (entry != NULL && aws_hash_table_put(&cache->entries, &entry->key, entry, NULL)) {
+            s_signing_key_entry_destroy(entry);
+            entry = NULL;
+        }
+    }
+
+    /* failing to cache only costs a derivation next time */
+    if (entry != NULL) {
+        s_store_key(entry, day, key);
+        if (day > entry->last_used_day) {
+            entry->last_used_day = day;
+        }
+    }
+
+    aws_mutex_unlock(&cache->lock);
+
+on_key:
+
+    result = aws_byte_buf_write(dest, key, sizeof(key)) ? AWS_OP_SUCCESS : aws_raise_error(AWS_ERROR_SHORT_BUFFER);
+
+done:
+
+    aws_secure_zero(key, sizeof(key));
+    aws_byte_buf_clean_up(&scope);
+
+    return result;
+}
+
+struct prederive_collect_context {
+    struct aws_signing_key_cache *cache;
+    int64_t today;
+    int64_t tomorrow;
+    struct aws_array_list *pending;
+    int error_code;
+};
+
+static int s_collect_scope_for_prederivation(void *context, struct aws_hash_element *element) {
+    struct prederive_collect_context *collect = context;
+    struct signing_key_entry *entry = element->value;
+
+    /* scopes that have been idle since before yesterday have dropped out of use */
+    if (entry->last_used_day < collect->today - 1) {
+        return AWS_COMMON_HASH_TABLE_ITER_CONTINUE | AWS_COMMON_HASH_TABLE_ITER_DELETE;
+    }
+
+    if (s_find_slot(entry, collect->tomorrow) != NULL || collect->error_code != AWS_ERROR_SUCCESS) {
+        return AWS_COMMON_HASH_TABLE_ITER_CONTINUE;
+    }
+
+    struct aws_allocator *allocator = collect->cache->allocator;
+
+    struct pending_prederivation pending;
+    AWS_ZERO_STRUCT(pending);
+    pending.scope = aws_string_new_from_string(allocator, entry->scope);
+    pending.secret_access_key = aws_string_new_from_string(allocator, entry->secret_access_key);
+    if (pending.scope == NULL || pending.secret_access_key == NULL ||
+        aws_array_list_push_back(collect->pending, &pending)) {
+        collect->error_code = aws_last_error();
+        aws_string_destroy(pending.scope);
+        aws_string_destroy_secure(pending.secret_access_key);
+        return AWS_COMMON_HASH_TABLE_ITER_CONTINUE;
+    }
+
+    /* the copies have the same layout as the entry's scope */
+    struct pending_prederivation *stored = NULL;
+    aws_array_list_get_at_ptr(collect->pending, (void **)&stored, aws_array_list_length(collect->pending) - 1);
+    struct aws_byte_cursor scope_cursor = aws_byte_cursor_from_string(stored->scope);
+    stored->region = scope_cursor;
+    aws_byte_cursor_advance(&stored->region, (size_t)(entry->region.ptr - entry->key.ptr));
+    stored->region.len = entry->region.len;
+    stored->service = scope_cursor;
+    aws_byte_cursor_advance(&stored->service, (size_t)(entry->service.ptr - entry->key.ptr));
+
+    return AWS_COMMON_HASH_TABLE_ITER_CONTINUE;
+}
+
+int aws_signing_key_cache_prederive(struct aws_signing_key_cache *cache, size_t *out_derived_count) {
+    int64_t today = 0;
+    if (s_get_current_day(cache, &today, NULL)) {
+        return AWS_OP_ERR;
+    }
+
+    int64_t tomorrow = today + 1;
+
+    struct aws_array_list pending;
+    if (aws_array_list_init_dynamic(
+            &pending, cache->allocator, SIGNING_KEY_TABLE_DEFAULT_SIZE, sizeof(struct pending_prederivation))) {
+        return AWS_OP_ERR;
+    }
+
+    struct prederive_collect_context collect = {
+        .cache = cache,
+        .today = today,
+        .tomorrow = tomorrow,
+        .pending = &pending,
+        .error_code = AWS_ERROR_SUCCESS,
+    };
+
+    aws_mutex_lock(&cache->lock);
+    aws_hash_table_foreach(&cache->entries, s_collect_scope_for_prederivation, &collect);
+    aws_mutex_unlock(&cache->lock);
+
+    int result = AWS_OP_SUCCESS;
+    if (collect.error_code != AWS_ERROR_SUCCESS) {
+        result = aws_raise_error(collect.error_code);
+    }
+
+    size_t pending_count = aws_array_list_length(&pending);
+    size_t derived_count = 0;
+
+    for (size_t i = 0; i < pending_count; ++i) {
+        struct pending_prederivation *scope = NULL;
+        aws_array_list_get_at_ptr(&pending, (void **)&scope, i);
+
+        if (s_derive_key_for_day(
+                cache->allocator, scope->secret_access_key, tomorrow, &scope->region, &scope->service, scope->key)) {
+            result = AWS_OP_ERR;
+            aws_string_destroy_secure(scope->secret_access_key);
+            scope->secret_access_key = NULL;
+        }
+    }
+
+    aws_mutex_lock(&cache->lock);
+
+    for (size_t i = 0; i < pending_count; ++i) {
+        struct pending_prederivation *scope = NULL;
+        aws_array_list_get_at_ptr(&pending, (void **)&scope, i);
+
+        if (scope->secret_access_key != NULL) {
+            /* the scope may have been dropped, or its secret rotated, while the lock was released */
+            struct aws_byte_cursor scope_cursor = aws_byte_cursor_from_string(scope->scope);
+            struct aws_hash_element *element = NULL;
+            aws_hash_table_find(&cache->entries, &scope_cursor, &element);
+            if (element != NULL) {
+                struct signing_key_entry *entry = element->value;
+                if (aws_string_eq(entry->secret_access_key, scope->secret_access_key)) {
+                    s_store_key(entry, tomorrow, scope->key);
+                    ++derived_count;
+                }
+            }
+        }
+
+        aws_secure_zero(scope->key, sizeof(scope->key));
+        aws_string_destroy(scope->scope);
+        aws_string_destroy_secure(scope->secret_access_key);
+    }
+
+    if (result == AWS_OP_SUCCESS) {
+        cache->prederived_day = tomorrow;
+    }
+
+    aws_mutex_unlock(&cache->lock);
+
+    aws_array_list_clean_up(&pending);
+
+    if (out_derived_count != NULL) {
+        *out_derived_count = derived_count;
+    }
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_AUTH_SIGNING,
+        "(id=%p) Signing key cache pre-derived keys for %zu scopes for day %" PRId64,
+        (void *)cache,
+        derived_count,
+        tomorrow);
+
+    return result;
+}
+
+void aws_signing_key_cache_get_stats(
+    struct aws_signing_key_cache *cache,
+    struct aws_signing_key_cache_stats *out_stats) {
+    aws_mutex_lock(&cache->lock);
+    *out_stats = cache->stats;
+    aws_mutex_unlock(&cache->lock);
+}
+
+static bool s_should_quit(void *user_data) {
+    struct aws_signing_key_cache *cache = user_data;
+
+    return cache->should_quit;
+}
+
+static void s_prederive_thread_fn(void *user_data) {
+    struct aws_signing_key_cache *cache = user_data;
+
+    aws_mutex_lock(&cache->lock);
+
+    while (!cache->should_quit) {
+        int64_t today = 0;
+        uint64_t now_secs = 0;
+        if (s_get_current_day(cache, &today, &now_secs)) {
+            break;
+        }
+
+        uint64_t midnight_secs = (uint64_t)(today + 1) * SECONDS_PER_DAY;
+        uint64_t prederive_secs =
+            midnight_secs > cache->prederive_lead_time_secs ? midnight_secs - cache->prederive_lead_time_secs : 0;
+
+        if (now_secs >= prederive_secs && cache->prederived_day != today + 1) {
+            aws_mutex_unlock(&cache->lock);
+            if (aws_signing_key_cache_prederive(cache, NULL)) {
+                AWS_LOGF_WARN(
+                    AWS_LS_AUTH_SIGNING,
+                    "(id=%p) Signing key cache failed to pre-derive keys, error %d(%s)",
+                    (void *)cache,
+                    aws_last_error(),
+                    aws_error_str(aws_last_error()));
+            }
+            aws_mutex_lock(&cache->lock);
+
+            if (cache->prederived_day != today + 1) {
+                /* don't spin on a persistent failure; misses will still derive on demand */
+                cache->prederived_day = today + 1;
+            }
+            continue;
+        }
+
+        /* sleep until it's time to pre-derive, or until midnight if that's already done for today */
+        uint64_t wake_secs = now_secs < prederive_secs ? prederive_secs : midnight_secs;
+        uint64_t wait_ns = aws_timestamp_convert(wake_secs - now_secs, AWS_TIMESTAMP_SECS, AWS_TIMESTAMP_NANOS, NULL);
+
+        aws_condition_variable_wait_for_pred(&cache->signal, &cache->lock, (int64_t)wait_ns, s_should_quit, cache);
+    }
+
+    aws_mutex_unlock(&cache->lock);
+}
+
+struct aws_signing_key_cache *aws_signing_key_cache_new(
+    struct aws_allocator *allocator,
+    const struct aws_signing_key_cache_options *options) {
+
+    struct aws_signing_key_cache *cache = aws_mem_calloc(allocator, 1, sizeof(struct aws_signing_key_cache));
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    cache->allocator = allocator;
+    cache->clock_fn = aws_sys_clock_get_ticks;
+    cache->prederive_lead_time_secs = DEFAULT_PREDERIVE_LEAD_TIME_SECS;
+    bool manual_prederive = false;
+    if (options != NULL) {
+        if (options->clock_fn != NULL) {
+            cache->clock_fn = options->clock_fn;
+        }
+
+        if (options->prederive_lead_time_secs > 0) {
+            cache->prederive_lead_time_secs = options->prederive_lead_time_secs;
+        }
+
+        manual_prederive = options->manual_prederive;
+    }
+
+    if (aws_mutex_init(&cache->lock)) {
+        goto on_mutex_error;
+    }
+
+    if (aws_condition_variable_init(&cache->signal)) {
+        goto on_signal_error;
+    }
+
+    if (aws_hash_table_init(
+            &cache->entries,
+            allocator,
+            SIGNING_KEY_TABLE_DEFAULT_SIZE,
+            aws_hash_byte_cursor_ptr,
+            (aws_hash_callback_eq_fn *)aws_byte_cursor_eq,
+            NULL, /* The key is owned by the value (and destroy cleans it up), so we don't have to */
+            s_signing_key_entry_destroy)) {
+        goto on_table_error;
+    }
+
+    if (!manual_prederive) {
+        if (aws_thread_init(&cache->prederive_thread, allocator)) {
+            goto on_thread_error;
+        }
+
+        struct aws_thread_options thread_options;
+        AWS_ZERO_STRUCT(thread_options);
+        if (aws_thread_launch(&cache->prederive_thread, s_prederive_thread_fn, cache, &thread_options)) {
+            aws_thread_clean_up(&cache->prederive_thread);
+            goto on_thread_error;
+        }
+
+        cache->is_prederive_thread_started = true;
+    }
+
+    return cache;
+
+on_thread_error:
+    aws_hash_table_clean_up(&cache->entries);
+
+on_table_error:
+    aws_condition_variable_clean_up(&cache->signal);
+
+on_signal_error:
+    aws_mutex_clean_up(&cache->lock);
+
+on_mutex_error:
+    aws_mem_release(allocator, cache);
+
+    return NULL;
+}
+
+void aws_signing_key_cache_destroy(struct aws_signing_key_cache *cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    if (cache->is_prederive_thread_started) {
+        aws_mutex_lock(&cache->lock);
+        cache->should_quit = true;
+        aws_condition_variable_notify_all(&cache->signal);
+        aws_mutex_unlock(&cache->lock);
+
+        aws_thread_join(&cache->prederive_thread);
+        aws_thread_clean_up(&cache->prederive_thread);
+    }
+
+    aws_hash_table_clean_up(&cache->entries);
+    aws_condition_variable_clean_up(&cache->signal);
+    aws_mutex_clean_up(&cache->lock);
+
+    aws_mem_release(cache->allocator, cache);
+}
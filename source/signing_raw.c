@@ -0,0 +1,202 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/signing.h>
+
+#include <aws/auth/credentials.h>
+#include <aws/auth/private/aws_signing.h>
+#include <aws/cal/hash.h>
+#include <aws/cal/hmac.h>
+#include <aws/common/encoding.h>
+#include <aws/common/string.h>
+
+#if defined(_MSC_VER)
+#    pragma warning(disable : 4204)
+#endif /* _MSC_VER */
+
+#define RAW_STRING_TO_SIGN_STARTING_SIZE 256
+
+static int s_validate_raw_signing_options(const struct aws_sigv4_raw_signing_options *options) {
+    if (options->credentials == NULL || options->region.len == 0 || options->service.len == 0) {
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_SIGNING,
+            "(id=%p) Raw sigv4 signing options are missing credentials, a region, or a service",
+            (void *)options);
+        return aws_raise_error(AWS_AUTH_SIGNING_INVALID_CONFIGURATION);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+int aws_sigv4_sign_string_to_sign(
+    struct aws_allocator *allocator,
+    const struct aws_sigv4_raw_signing_options *options,
+    const struct aws_byte_cursor *string_to_sign,
+    struct aws_byte_buf *out_signature) {
+
+    if (s_validate_raw_signing_options(options)) {
+        return AWS_OP_ERR;
+    }
+
+    int result = AWS_OP_ERR;
+
+    struct aws_byte_buf key;
+    AWS_ZERO_STRUCT(key);
+
+    struct aws_byte_buf digest;
+    AWS_ZERO_STRUCT(digest);
+
+    if (aws_byte_buf_init(&key, allocator, AWS_SHA256_LEN) || aws_byte_buf_init(&digest, allocator, AWS_SHA256_LEN)) {
+        goto done;
+    }
+
+    if (aws_signing_derive_sigv4_signing_key(
+            allocator,
+            options->credentials->secret_access_key,
+            &options->date,
+            &options->region,
+            &options->service,
+            &key)) {
+        goto done;
+    }
+
+    struct aws_byte_cursor key_cursor = aws_byte_cursor_from_buf(&key);
+    if (aws_sha256_hmac_compute(allocator, &key_cursor, string_to_sign, &digest, 0)) {
+        goto done;
+    }
+
+    struct aws_byte_cursor digest_cursor = aws_byte_cursor_from_buf(&digest);
+    if (aws_hex_encode_append_dynamic(&digest_cursor, out_signature)) {
+        goto done;
+    }
+
+    result = AWS_OP_SUCCESS;
+
+done:
+
+    aws_byte_buf_clean_up_secure(&key);
+    aws_byte_buf_clean_up(&digest);
+
+    return result;
+}
+
+/*
+ * AWS4-HMAC-SHA256\n<date>\n<date short>/<region>/<service>/aws4_request\n<canonical request hash>
+ */
+static int s_build_raw_string_to_sign(
+    const struct aws_sigv4_raw_signing_options *options,
+    const struct aws_byte_cursor *canonical_request_hash,
+    struct aws_byte_buf *dest) {
+
+    struct aws_byte_cursor algorithm_cursor = aws_byte_cursor_from_string(g_aws_signing_sigv4_algorithm);
+    struct aws_byte_cursor newline_cursor = aws_byte_cursor_from_c_str("\n");
+
+    if (aws_byte_buf_append_dynamic(dest, &algorithm_cursor) || aws_byte_buf_append_dynamic(dest, &newline_cursor)) {
+        return AWS_OP_ERR;
+    }
+
+    /* date output uses the non-dynamic append, so make sure there's enough room first */
+    if (aws_byte_buf_reserve_relative(dest, AWS_DATE_TIME_STR_MAX_LEN) ||
+        aws_date_time_to_utc_time_str(&options->date, AWS_DATE_FORMAT_ISO_8601_BASIC, dest) ||
+        aws_byte_buf_append_dynamic(dest, &newline_cursor)) {
+        return AWS_OP_ERR;
+    }
+
+    if (aws_signing_append_sigv4_credential_scope(&options->date, &options->region, &options->service, dest) ||
+        aws_byte_buf_append_dynamic(dest, &newline_cursor)) {
+        return AWS_OP_ERR;
+    }
+
+    return aws_byte_buf_append_dynamic(dest, canonical_request_hash);
+}
+
+int aws_sigv4_sign_canonical_request_hash(
+    struct aws_allocator *allocator,
+    const struct aws_sigv4_raw_signing_options *options,
+    const struct aws_byte_cursor *canonical_request_hash,
+    struct aws_byte_buf *out_signature) {
+
+    if (canonical_request_hash->len != AWS_SHA256_LEN * 2) {
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_SIGNING,
+            "(id=%p) Canonical request hash must be a hex-encoded sha256 digest, but has length %zu",
+            (void *)options,
+            canonical_request_hash->len);
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    struct aws_byte_buf string_to_sign;
+    if (aws_byte_buf_init(&string_to_sign, allocator, RAW_STRING_TO_SIGN_STARTING_SIZE)) {
+        return AWS_OP_ERR;
+    }
+
+    int result = AWS_OP_ERR;
+
+    if (s_build_raw_string_to_sign(options, canonical_request_hash, &string_to_sign)) {
+        goto done;
+    }
+
+    struct aws_byte_cursor string_to_sign_cursor = aws_byte_cursor_from_buf(&string_to_sign);
+    if (aws_sigv4_sign_string_to_sign(allocator, options, &string_to_sign_cursor, out_signature)) {
+        goto done;
+    }
+
+    result = AWS_OP_SUCCESS;
+
+done:
+
+    aws_byte_buf_clean_up(&string_to_sign);
+
+    return result;
+}
+
+int aws_sigv4_sign_canonical_request(
+    struct aws_allocator *allocator,
+    const struct aws_sigv4_raw_signing_options *options,
+    const struct aws_byte_cursor *canonical_request,
+    struct aws_byte_buf *out_signature) {
+
+    uint8_t digest_storage[AWS_SHA256_LEN];
+    struct aws_byte_buf digest = aws_byte_buf_from_empty_array(digest_storage, sizeof(digest_storage));
+
+    struct aws_byte_buf hex_digest;
+    if (aws_byte_buf_init(&hex_digest, allocator, AWS_SHA256_LEN * 2 + 1)) {
+        return AWS_OP_ERR;
+    }
+
+    int result = AWS_OP_ERR;
+
+    if (aws_sha256_compute(allocator, canonical_request, &digest, 0)) {
+        goto done;
+    }
+
+    struct aws_byte_cursor digest_cursor = aws_byte_cursor_from_buf(&digest);
+    if (aws_hex_encode_append_dynamic(&digest_cursor, &hex_digest)) {
+        goto done;
+    }
+
+    struct aws_byte_cursor hex_digest_cursor = aws_byte_cursor_from_buf(&hex_digest);
+    if (aws_sigv4_sign_canonical_request_hash(allocator, options, &hex_digest_cursor, out_signature)) {
+        goto done;
+    }
+
+    result = AWS_OP_SUCCESS;
+
+done:
+
+    aws_byte_buf_clean_up(&hex_digest);
+
+    return result;
+}
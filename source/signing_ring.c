@@ -0,0 +1,323 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/private/signing_ring.h>
+
+#include <aws/auth/signing.h>
+#include <aws/common/atomics.h>
+#include <aws/common/linked_list.h>
+#include <aws/common/mutex.h>
+#include <aws/common/thread.h>
+
+#include <string.h>
+
+#define SIGNATURE_MAX_LENGTH 64
+
+struct signing_ring_slot {
+    /* odd while the owning thread is writing the slot, incremented again once the slot is consistent */
+    struct aws_atomic_var sequence;
+
+    size_t signature_length;
+    size_t string_to_sign_length;
+    size_t canonical_request_length;
+    bool canonical_request_truncated;
+
+    uint8_t signature[SIGNATURE_MAX_LENGTH];
+
+    /* string-to-sign followed by the (possibly truncated) canonical request */
+    uint8_t data[AWS_SIGNING_RING_SLOT_DATA_SIZE];
+};
+
+struct signing_ring {
+    struct aws_linked_list_node node;
+
+    /* protected by s_ring_lock; a ring is owned by at most one thread at a time */
+    bool is_claimed;
+
+    /* only touched by the owning thread */
+    size_t next_slot;
+
+    struct signing_ring_slot slots[AWS_SIGNING_RING_SLOT_COUNT];
+};
+
+/*
+ * Every ring is tracked here so that rings can be visited from any thread and freed at library clean up.  There are
+ * never more than AWS_SIGNING_RING_MAX_COUNT of them: a thread hands its ring back when it exits, and a thread that
+ * signs for the first time reuses a returned ring before allocating a new one.  The lock is only taken when a thread
+ * claims or returns a ring, and by readers.
+ */
+static struct aws_mutex s_ring_lock = AWS_MUTEX_INIT;
+static struct aws_linked_list s_rings;
+static size_t s_ring_count = 0;
+static struct aws_allocator *s_ring_allocator = NULL;
+
+/* bumped on every clean up, so threads know their cached ring pointer has been freed */
+static size_t s_ring_generation = 0;
+
+static AWS_THREAD_LOCAL struct signing_ring *tl_ring = NULL;
+static AWS_THREAD_LOCAL size_t tl_ring_generation = 0;
+
+void aws_signing_ring_init(struct aws_allocator *allocator) {
+    aws_mutex_lock(&s_ring_lock);
+
+    aws_linked_list_init(&s_rings);
+    s_ring_count = 0;
+    s_ring_allocator = allocator;
+    ++s_ring_generation;
+
+    aws_mutex_unlock(&s_ring_lock);
+}
+
+void aws_signing_ring_clean_up(void) {
+    aws_mutex_lock(&s_ring_lock);
+
+    while (s_ring_allocator != NULL && !aws_linked_list_empty(&s_rings)) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(&s_rings);
+        struct signing_ring *ring = AWS_CONTAINER_OF(node, struct signing_ring, node);
+
+        aws_mem_release(s_ring_allocator, ring);
+    }
+
+    s_ring_count = 0;
+    s_ring_allocator = NULL;
+    ++s_ring_generation;
+
+    aws_mutex_unlock(&s_ring_lock);
+}
+
+/* called on thread exit; the ring, and the entries it holds, stay visible until another thread claims it */
+static void s_return_thread_ring(void *user_data) {
+    (void)user_data;
+
+    aws_mutex_lock(&s_ring_lock);
+
+    /* a ring from before the last clean up has already been freed */
+    if (tl_ring != NULL && tl_ring_generation == s_ring_generation) {
+        tl_ring->is_claimed = false;
+    }
+
+    aws_mutex_unlock(&s_ring_lock);
+
+    tl_ring = NULL;
+}
+
+/* must be called with s_ring_lock held */
+static struct signing_ring *s_claim_ring_synced(void) {
+    for (struct aws_linked_list_node *node = aws_linked_list_begin(&s_rings); node != aws_linked_list_end(&s_rings);
+         node = aws_linked_list_next(node)) {
+        struct signing_ring *ring = AWS_CONTAINER_OF(node, struct signing_ring, node);
+        if (!ring->is_claimed) {
+            ring->is_claimed = true;
+            return ring;
+        }
+    }
+
+    if (s_ring_count >= AWS_SIGNING_RING_MAX_COUNT) {
+        return NULL;
+    }
+
+    struct signing_ring *ring = aws_mem_acquire(s_ring_allocator, sizeof(struct signing_ring));
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    AWS_ZERO_STRUCT(*ring);
+    for (size_t i = 0; i < AWS_SIGNING_RING_SLOT_COUNT; ++i) {
+        aws_atomic_init_int(&ring->slots[i].sequence, 0);
+    }
+
+    ring->is_claimed = true;
+    aws_linked_list_push_back(&s_rings, &ring->node);
+    ++s_ring_count;
+
+    return ring;
+}
+
+static struct signing_ring *s_get_thread_ring(void) {
+    if (tl_ring != NULL && tl_ring_generation == s_ring_generation) {
+        return tl_ring;
+    }
+
+    tl_ring = NULL;
+
+    aws_mutex_lock(&s_ring_lock);
+
+    if (s_ring_allocator != NULL) {
+        tl_ring = s_claim_ring_synced();
+        tl_ring_generation = s_ring_generation;
+    }
+
+    aws_mutex_unlock(&s_ring_lock);
+
+    /*
+     * Only threads launched through aws_thread get an exit hook.  Others keep their ring until library clean up,
+     * which is still bounded by the ring count.
+     */
+    if (tl_ring != NULL) {
+        aws_thread_current_at_exit(s_return_thread_ring, NULL);
+    }
+
+    return tl_ring;
+}
+
+void aws_signing_ring_record(
+    const struct aws_byte_cursor *canonical_request,
+    const struct aws_byte_cursor *string_to_sign,
+    const struct aws_byte_cursor *signature) {
+
+    if (signature->len > SIGNATURE_MAX_LENGTH || string_to_sign->len > AWS_SIGNING_RING_SLOT_DATA_SIZE) {
+        return;
+    }
+
+    struct signing_ring *ring = s_get_thread_ring();
+    if (ring == NULL) {
+        return;
+    }
+
+    struct signing_ring_slot *slot = &ring->slots[ring->next_slot];
+    ring->next_slot = (ring->next_slot + 1) % AWS_SIGNING_RING_SLOT_COUNT;
+
+    size_t sequence = aws_atomic_load_int_explicit(&slot->sequence, aws_memory_order_relaxed);
+    aws_atomic_store_int_explicit(&slot->sequence, sequence + 1, aws_memory_order_relaxed);
+    aws_atomic_thread_fence(aws_memory_order_release);
+
+    size_t canonical_request_capacity = AWS_SIGNING_RING_SLOT_DATA_SIZE - string_to_sign->len;
+    size_t canonical_request_length = canonical_request->len;
+    slot->canonical_request_truncated = canonical_request_length > canonical_request_capacity;
+    if (slot->canonical_request_truncated) {
+        canonical_request_length = canonical_request_capacity;
+    }
+
+    memcpy(slot->signature, signature->ptr, signature->len);
+    slot->signature_length = signature->len;
+
+    memcpy(slot->data, string_to_sign->ptr, string_to_sign->len);
+    slot->string_to_sign_length = string_to_sign->len;
+
+    memcpy(slot->data + string_to_sign->len, canonical_request->ptr, canonical_request_length);
+    slot->canonical_request_length = canonical_request_length;
+
+    aws_atomic_store_int_explicit(&slot->sequence, sequence + 2, aws_memory_order_release);
+}
+
+/*
+ * Copies a slot out of a ring owned by another thread.  Returns false if the slot is empty or was being written
+ * while it was copied.
+ */
+static bool s_read_slot(const struct signing_ring_slot *slot, struct signing_ring_slot *copy) {
+    size_t sequence_before =
+        aws_atomic_load_int_explicit((struct aws_atomic_var *)&slot->sequence, aws_memory_order_acquire);
+    if (sequence_before == 0 || (sequence_before & 1) != 0) {
+        return false;
+    }
+
+    copy->signature_length = slot->signature_length;
+    copy->string_to_sign_length = slot->string_to_sign_length;
+    copy->canonical_request_length = slot->canonical_request_length;
+    copy->canonical_request_truncated = slot->canonical_request_truncated;
+    memcpy(copy->signature, slot->signature, sizeof(slot->signature));
+    memcpy(copy->data, slot->data, sizeof(slot->data));
+
+    aws_atomic_thread_fence(aws_memory_order_acquire);
+    size_t sequence_after =
+        aws_atomic_load_int_explicit((struct aws_atomic_var *)&slot->sequence, aws_memory_order_relaxed);
+
+    return sequence_before == sequence_after;
+}
+
+void aws_signing_visit_recent_requests(aws_signing_recent_request_fn *visit_fn, void *user_data) {
+    aws_mutex_lock(&s_ring_lock);
+
+    if (s_ring_allocator == NULL) {
+        aws_mutex_unlock(&s_ring_lock);
+        return;
+    }
+
+    /* slots are large, so copy through a heap scratch slot rather than the stack */
+    struct signing_ring_slot *copy = aws_mem_acquire(s_ring_allocator, sizeof(struct signing_ring_slot));
+    if (copy == NULL) {
+        aws_mutex_unlock(&s_ring_lock);
+        return;
+    }
+
+    for (struct aws_linked_list_node *node = aws_linked_list_begin(&s_rings); node != aws_linked_list_end(&s_rings);
+         node = aws_linked_list_next(node)) {
+        struct signing_ring *ring = AWS_CONTAINER_OF(node, struct signing_ring, node);
+
+        /* next_slot is racy here, but it only picks the starting point of the walk */
+        size_t start = ring->next_slot % AWS_SIGNING_RING_SLOT_COUNT;
+        for (size_t i = 0; i < AWS_SIGNING_RING_SLOT_COUNT; ++i) {
+            const struct signing_ring_slot *slot = &ring->slots[(start + i) % AWS_SIGNING_RING_SLOT_COUNT];
+            if (!s_read_slot(slot, copy)) {
+                continue;
+            }
+
+            struct aws_signing_recent_request request = {
+                .signature = aws_byte_cursor_from_array(copy->signature, copy->signature_length),
+                .string_to_sign = aws_byte_cursor_from_array(copy->data, copy->string_to_sign_length),
+                .canonical_request = aws_byte_cursor_from_array(
+                    copy->data + copy->string_to_sign_length, copy->canonical_request_length),
+                .canonical_request_truncated = copy->canonical_request_truncated,
+            };
+
+            visit_fn(&request, user_data);
+        }
+    }
+
+    aws_mem_release(s_ring_allocator, copy);
+
+    aws_mutex_unlock(&s_ring_lock);
+}
+
+struct signature_failure_search {
+    const struct aws_byte_cursor *signature;
+    bool found;
+};
+
+static void s_log_if_signature_matches(const struct aws_signing_recent_request *request, void *user_data) {
+    struct signature_failure_search *search = user_data;
+    if (search->found || !aws_byte_cursor_eq(&request->signature, search->signature)) {
+        return;
+    }
+
+    search->found = true;
+
+    AWS_LOGF_ERROR(
+        AWS_LS_AUTH_SIGNING,
+        "Signature \"" PRInSTR "\" was rejected.  It was computed from string-to-sign \"" PRInSTR
+        "\" and canonical request%s \"" PRInSTR "\"",
+        AWS_BYTE_CURSOR_PRI(request->signature),
+        AWS_BYTE_CURSOR_PRI(request->string_to_sign),
+        request->canonical_request_truncated ? " (truncated)" : "",
+        AWS_BYTE_CURSOR_PRI(request->canonical_request));
+}
+
+bool aws_signing_report_signature_failure(const struct aws_byte_cursor *signature) {
+    struct signature_failure_search search = {
+        .signature = signature,
+        .found = false,
+    };
+
+    aws_signing_visit_recent_requests(s_log_if_signature_matches, &search);
+
+    if (!search.found) {
+        AWS_LOGF_WARN(
+            AWS_LS_AUTH_SIGNING,
+            "Signature \"" PRInSTR "\" was rejected, but its signing inputs are no longer retained",
+            AWS_BYTE_CURSOR_PRI(*signature));
+    }
+
+    return search.found;
+}
@@ -0,0 +1,398 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/signing_trace.h>
+
+#include <aws/auth/signable.h>
+#include <aws/auth/signing.h>
+#include <aws/common/mutex.h>
+#include <aws/common/string.h>
+#include <aws/io/stream.h>
+#include <aws/io/uri.h>
+
+#include <stdio.h>
+
+#if defined(_MSC_VER)
+#    pragma warning(disable : 4204)
+#    pragma warning(disable : 4996)
+#endif /* _MSC_VER */
+
+#define TRACE_VERSION 1
+#define TRACE_INITIAL_HEADER_COUNT 16
+#define TRACE_INITIAL_QUERY_PARAM_COUNT 10
+#define TRACE_RECORD_STARTING_SIZE 256
+
+/* u8 algorithm, u8 body signing type, u8 flags, u32 path, u16 query count, u64 payload, u16 header count */
+#define TRACE_RECORD_FIXED_SIZE 19
+/* u16 name length, u32 value length */
+#define TRACE_HEADER_FIXED_SIZE 6
+
+#define TRACE_FLAG_DOUBLE_URI_ENCODE 0x01
+#define TRACE_FLAG_NORMALIZE_URI_PATH 0x02
+
+AWS_STATIC_STRING_FROM_LITERAL(s_trace_magic, "AWSSIGTR");
+
+int aws_signing_trace_record_init(struct aws_signing_trace_record *record, struct aws_allocator *allocator) {
+    AWS_ZERO_STRUCT(*record);
+
+    return aws_array_list_init_dynamic(
+        &record->headers, allocator, TRACE_INITIAL_HEADER_COUNT, sizeof(struct aws_signing_trace_header_shape));
+}
+
+void aws_signing_trace_record_clean_up(struct aws_signing_trace_record *record) {
+    aws_array_list_clean_up(&record->headers);
+}
+
+static void s_reset_record(struct aws_signing_trace_record *record) {
+    struct aws_array_list headers = record->headers;
+    aws_array_list_clear(&headers);
+
+    AWS_ZERO_STRUCT(*record);
+    record->headers = headers;
+}
+
+static int s_capture_uri_shape(struct aws_signing_trace_record *record, const struct aws_signable *signable) {
+    struct aws_allocator *allocator = record->headers.alloc;
+
+    struct aws_byte_cursor uri_cursor;
+    if (aws_signable_get_property(signable, g_aws_http_uri_property_name, &uri_cursor)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_array_list query_params;
+    if (aws_array_list_init_dynamic(
+            &query_params, allocator, TRACE_INITIAL_QUERY_PARAM_COUNT, sizeof(struct aws_uri_param))) {
+        return AWS_OP_ERR;
+    }
+
+    int result = AWS_OP_ERR;
+
+    struct aws_uri uri;
+    AWS_ZERO_STRUCT(uri);
+
+    if (aws_uri_init_parse(&uri, allocator, &uri_cursor)) {
+        goto done;
+    }
+
+    if (aws_uri_query_string_params(&uri, &query_params)) {
+        goto done;
+    }
+
+    record->path_length = (uint32_t)aws_uri_path(&uri)->len;
+    record->query_param_count = (uint32_t)aws_array_list_length(&query_params);
+
+    result = AWS_OP_SUCCESS;
+
+done:
+
+    aws_array_list_clean_up(&query_params);
+    aws_uri_clean_up(&uri);
+
+    return result;
+}
+
+int aws_signing_trace_record_capture(
+    struct aws_signing_trace_record *record,
+    const struct aws_signable *signable,
+    const struct aws_signing_config_aws *config) {
+
+    s_reset_record(record);
+
+    record->algorithm = config->algorithm;
+    record->body_signing_type = config->body_signing_type;
+    record->use_double_uri_encode = config->use_double_uri_encode;
+    record->should_normalize_uri_path = config->should_normalize_uri_path;
+
+    if (s_capture_uri_shape(record, signable)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_array_list *signable_headers = NULL;
+    if (aws_signable_get_property_list(signable, g_aws_http_headers_property_list_name, &signable_headers)) {
+        return AWS_OP_ERR;
+    }
+
+    const size_t header_count = aws_array_list_length(signable_headers);
+    for (size_t i = 0; i < header_count; ++i) {
+        struct aws_signable_property_list_pair header;
+        if (aws_array_list_get_at(signable_headers, &header, i)) {
+            return AWS_OP_ERR;
+        }
+
+        struct aws_signing_trace_header_shape shape = {
+            .name = header.name,
+            .value_length = (uint32_t)header.value.len,
+        };
+
+        if (aws_array_list_push_back(&record->headers, &shape)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    struct aws_input_stream *payload_stream = NULL;
+    if (aws_signable_get_payload_stream(signable, &payload_stream)) {
+        return AWS_OP_ERR;
+    }
+
+    if (payload_stream != NULL) {
+        /* streams of unknown length are recorded as empty rather than failing the capture */
+        int64_t payload_length = 0;
+        if (aws_input_stream_get_length(payload_stream, &payload_length) == AWS_OP_SUCCESS && payload_length > 0) {
+            record->payload_size = (uint64_t)payload_length;
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+int aws_signing_trace_encode_header(struct aws_byte_buf *output) {
+    struct aws_byte_cursor magic_cursor = aws_byte_cursor_from_string(s_trace_magic);
+
+    if (aws_byte_buf_append_dynamic(output, &magic_cursor) || aws_byte_buf_reserve_relative(output, 1)) {
+        return AWS_OP_ERR;
+    }
+
+    aws_byte_buf_write_u8(output, TRACE_VERSION);
+
+    return AWS_OP_SUCCESS;
+}
+
+int aws_signing_trace_decode_header(struct aws_byte_cursor *input) {
+    struct aws_byte_cursor magic_cursor = aws_byte_cursor_from_string(s_trace_magic);
+
+    uint8_t version = 0;
+    struct aws_byte_cursor magic = aws_byte_cursor_advance(input, magic_cursor.len);
+    if (!aws_byte_cursor_eq(&magic, &magic_cursor) || !aws_byte_cursor_read_u8(input, &version) ||
+        version != TRACE_VERSION) {
+        AWS_LOGF_ERROR(AWS_LS_AUTH_SIGNING, "Signing trace has an unrecognized header");
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+int aws_signing_trace_record_encode(const struct aws_signing_trace_record *record, struct aws_byte_buf *output) {
+    const size_t header_count = aws_array_list_length(&record->headers);
+    if (header_count > UINT16_MAX || record->query_param_count > UINT16_MAX) {
+        return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+    }
+
+    size_t required_size = TRACE_RECORD_FIXED_SIZE;
+    for (size_t i = 0; i < header_count; ++i) {
+        struct aws_signing_trace_header_shape *shape = NULL;
+        aws_array_list_get_at_ptr(&record->headers, (void **)&shape, i);
+        if (shape->name.len > UINT16_MAX) {
+            return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+        }
+
+        required_size += TRACE_HEADER_FIXED_SIZE + shape->name.len;
+    }
+
+    if (aws_byte_buf_reserve_relative(output, required_size)) {
+        return AWS_OP_ERR;
+    }
+
+    uint8_t flags = 0;
+    if (record->use_double_uri_encode) {
+        flags |= TRACE_FLAG_DOUBLE_URI_ENCODE;
+    }
+    if (record->should_normalize_uri_path) {
+        flags |= TRACE_FLAG_NORMALIZE_URI_PATH;
+    }
+
+    /* capacity was reserved above, so none of these writes can fail */
+    aws_byte_buf_write_u8(output, (uint8_t)record->algorithm);
+    aws_byte_buf_write_u8(output, (uint8_t)record->body_signing_type);
+    aws_byte_buf_write_u8(output, flags);
+    aws_byte_buf_write_be32(output, record->path_length);
+    aws_byte_buf_write_be16(output, (uint16_t)record->query_param_count);
+    aws_byte_buf_write_be64(output, record->payload_size);
+    aws_byte_buf_write_be16(output, (uint16_t)header_count);
+
+    for (size_t i = 0; i < header_count; ++i) {
+        struct aws_signing_trace_header_shape *shape = NULL;
+        aws_array_list_get_at_ptr(&record->headers, (void **)&shape, i);
+
+        aws_byte_buf_write_be16(output, (uint16_t)shape->name.len);
+        aws_byte_buf_write_from_whole_cursor(output, shape->name);
+        aws_byte_buf_write_be32(output, shape->value_length);
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+int aws_signing_trace_record_decode(struct aws_signing_trace_record *record, struct aws_byte_cursor *input) {
+    s_reset_record(record);
+
+    uint8_t algorithm = 0;
+    uint8_t body_signing_type = 0;
+    uint8_t flags = 0;
+    uint16_t query_param_count = 0;
+    uint16_t header_count = 0;
+
+    if (!aws_byte_cursor_read_u8(input, &algorithm) || !aws_byte_cursor_read_u8(input, &body_signing_type) ||
+        !aws_byte_cursor_read_u8(input, &flags) || !aws_byte_cursor_read_be32(input, &record->path_length) ||
+        !aws_byte_cursor_read_be16(input, &query_param_count) ||
+        !aws_byte_cursor_read_be64(input, &record->payload_size) || !aws_byte_cursor_read_be16(input, &header_count)) {
+        goto malformed;
+    }
+
+    if (algorithm >= AWS_SIGNING_ALGORITHM_COUNT || body_signing_type > AWS_BODY_SIGNING_UNSIGNED_PAYLOAD) {
+        goto malformed;
+    }
+
+    record->algorithm = algorithm;
+    record->body_signing_type = body_signing_type;
+    record->use_double_uri_encode = (flags & TRACE_FLAG_DOUBLE_URI_ENCODE) != 0;
+    record->should_normalize_uri_path = (flags & TRACE_FLAG_NORMALIZE_URI_PATH) != 0;
+    record->query_param_count = query_param_count;
+
+    for (uint16_t i = 0; i < header_count; ++i) {
+        uint16_t name_length = 0;
+        struct aws_signing_trace_header_shape shape;
+        AWS_ZERO_STRUCT(shape);
+
+        if (!aws_byte_cursor_read_be16(input, &name_length) || input->len < name_length) {
+            goto malformed;
+        }
+
+        shape.name = aws_byte_cursor_advance(input, name_length);
+
+        if (!aws_byte_cursor_read_be32(input, &shape.value_length)) {
+            goto malformed;
+        }
+
+        if (aws_array_list_push_back(&record->headers, &shape)) {
+            return AWS_OP_ERR;
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+
+malformed:
+
+    AWS_LOGF_ERROR(AWS_LS_AUTH_SIGNING, "Signing trace contains a truncated or malformed record");
+    return aws_raise_error(AWS_ERROR_INVALID_ARGUMENT);
+}
+
+/*
+ * File capture
+ */
+
+struct aws_signing_trace_file_capture {
+    struct aws_allocator *allocator;
+    struct aws_mutex lock;
+    FILE *file;
+
+    /* protected by lock; reused across records so steady-state capture doesn't allocate */
+    struct aws_signing_trace_record record;
+    struct aws_byte_buf encoding;
+};
+
+struct aws_signing_trace_file_capture *aws_signing_trace_file_capture_new(
+    struct aws_allocator *allocator,
+    const char *file_path) {
+
+    struct aws_signing_trace_file_capture *capture =
+        aws_mem_acquire(allocator, sizeof(struct aws_signing_trace_file_capture));
+    if (capture == NULL) {
+        return NULL;
+    }
+
+    AWS_ZERO_STRUCT(*capture);
+    capture->allocator = allocator;
+
+    if (aws_mutex_init(&capture->lock)) {
+        goto on_mutex_init_failure;
+    }
+
+    if (aws_signing_trace_record_init(&capture->record, allocator) ||
+        aws_byte_buf_init(&capture->encoding, allocator, TRACE_RECORD_STARTING_SIZE)) {
+        goto on_error;
+    }
+
+    capture->file = fopen(file_path, "wb");
+    if (capture->file == NULL) {
+        AWS_LOGF_ERROR(AWS_LS_AUTH_SIGNING, "Unable to open signing trace file \"%s\"", file_path);
+        aws_raise_error(AWS_ERROR_FILE_INVALID_PATH);
+        goto on_error;
+    }
+
+    if (aws_signing_trace_encode_header(&capture->encoding)) {
+        goto on_error;
+    }
+
+    if (fwrite(capture->encoding.buffer, 1, capture->encoding.len, capture->file) != capture->encoding.len) {
+        aws_raise_error(AWS_ERROR_SYS_CALL_FAILURE);
+        goto on_error;
+    }
+
+    return capture;
+
+on_error:
+
+    aws_signing_trace_file_capture_destroy(capture);
+
+    return NULL;
+
+on_mutex_init_failure:
+
+    aws_mem_release(allocator, capture);
+
+    return NULL;
+}
+
+void aws_signing_trace_file_capture_destroy(struct aws_signing_trace_file_capture *capture) {
+    if (capture == NULL) {
+        return;
+    }
+
+    if (capture->file != NULL) {
+        fclose(capture->file);
+    }
+
+    aws_byte_buf_clean_up(&capture->encoding);
+    aws_signing_trace_record_clean_up(&capture->record);
+    aws_mutex_clean_up(&capture->lock);
+
+    aws_mem_release(capture->allocator, capture);
+}
+
+void aws_signing_trace_file_capture_fn(
+    const struct aws_signable *signable,
+    const struct aws_signing_config_aws *config,
+    void *user_data) {
+
+    struct aws_signing_trace_file_capture *capture = user_data;
+
+    aws_mutex_lock(&capture->lock);
+
+    capture->encoding.len = 0;
+
+    /* capture is best-effort: a request we can't record must still be signed */
+    if (aws_signing_trace_record_capture(&capture->record, signable, config) ||
+        aws_signing_trace_record_encode(&capture->record, &capture->encoding)) {
+        AWS_LOGF_WARN(
+            AWS_LS_AUTH_SIGNING,
+            "(id=%p) Failed to capture signing trace record, error %d(%s)",
+            (void *)signable,
+            aws_last_error(),
+            aws_error_str(aws_last_error()));
+    } else if (fwrite(capture->encoding.buffer, 1, capture->encoding.len, capture->file) != capture->encoding.len) {
+        AWS_LOGF_WARN(AWS_LS_AUTH_SIGNING, "(id=%p) Failed to write signing trace record", (void *)signable);
+    }
+
+    aws_mutex_unlock(&capture->lock);
+}
@@ -0,0 +1,569 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/private/tree_hash.h>
+
+#include <aws/cal/hash.h>
+#include <aws/common/array_list.h>
+#include <aws/common/condition_variable.h>
+#include <aws/common/mutex.h>
+#include <aws/common/system_info.h>
+#include <aws/common/thread.h>
+#include <aws/io/stream.h>
+
+/* chunk buffers in flight per hashing thread, so that reading can run ahead of hashing */
+#define TREE_HASH_CHUNKS_PER_THREAD 2
+
+struct tree_hash_job;
+
+/*
+ * The hashing pool: threads are started the first time a computation needs them and kept until the library is
+ * cleaned up, so signing doesn't pay for thread creation.  Everything below is protected by s_pool_lock.
+ */
+static struct aws_mutex s_pool_lock = AWS_MUTEX_INIT;
+static struct aws_condition_variable s_pool_signal = AWS_CONDITION_VARIABLE_INIT;
+
+/* NULL until aws_tree_hash_pool_init, and after aws_tree_hash_pool_clean_up; computations then hash serially */
+static struct aws_allocator *s_pool_allocator = NULL;
+
+/* the process-wide budget: the processor count, at most AWS_TREE_HASH_MAX_POOL_THREAD_COUNT */
+static size_t s_pool_size = 0;
+
+static struct aws_thread s_pool_threads[AWS_TREE_HASH_MAX_POOL_THREAD_COUNT];
+static size_t s_pool_thread_count = 0;
+
+/* threads claimed by running computations, never more than s_pool_size */
+static size_t s_busy_thread_count = 0;
+
+/* one entry per claimed thread that hasn't picked up its computation yet */
+static struct tree_hash_job *s_pool_assignments[AWS_TREE_HASH_MAX_POOL_THREAD_COUNT];
+static size_t s_pool_assignment_count = 0;
+
+static bool s_is_pool_shutting_down = false;
+
+struct tree_hash_digest {
+    uint8_t bytes[AWS_SHA256_LEN];
+};
+
+struct tree_hash_chunk {
+    struct aws_byte_buf buffer;
+    size_t index;
+};
+
+/*
+ * State shared between the reading thread and the hashing threads
+ */
+struct tree_hash_job {
+    struct aws_allocator *allocator;
+
+    struct aws_mutex lock;
+    struct aws_condition_variable signal;
+
+    /* everything below is protected by lock */
+
+    /* struct tree_hash_chunk *, waiting to be hashed */
+    struct aws_array_list pending_chunks;
+
+    /* struct tree_hash_chunk *, hashed and ready to be refilled */
+    struct aws_array_list free_chunks;
+
+    /* struct tree_hash_digest, by chunk index */
+    struct aws_array_list digests;
+
+    /* pool threads assigned to this computation that haven't finished with it */
+    size_t worker_count;
+
+    bool is_input_done;
+    int error_code;
+};
+
+static int s_hash_chunk(
+    struct aws_allocator *allocator,
+    const struct aws_byte_buf *chunk,
+    struct tree_hash_digest *out) {
+    struct aws_byte_buf digest_buf = aws_byte_buf_from_empty_array(out->bytes, sizeof(out->bytes));
+    struct aws_byte_cursor chunk_cursor = aws_byte_cursor_from_buf(chunk);
+
+    return aws_sha256_compute(allocator, &chunk_cursor, &digest_buf, 0);
+}
+
+static bool s_has_hashing_work(void *user_data) {
+    struct tree_hash_job *job = user_data;
+
+    return job->is_input_done || job->error_code != AWS_ERROR_SUCCESS ||
+           aws_array_list_length(&job->pending_chunks) > 0;
+}
+
+/*
+ * Hashes the job's chunks until its input is done and drained, or it fails
+ */
+static void s_hash_job_chunks(struct tree_hash_job *job) {
+    aws_mutex_lock(&job->lock);
+
+    while (true) {
+        aws_condition_variable_wait_pred(&job->signal, &job->lock, s_has_hashing_work, job);
+
+        struct tree_hash_chunk *chunk = NULL;
+        if (job->error_code != AWS_ERROR_SUCCESS || aws_array_list_back(&job->pending_chunks, &chunk)) {
+            /* failed, or the input is done and fully drained */
+            break;
+        }
+        aws_array_list_pop_back(&job->pending_chunks);
+
+        aws_mutex_unlock(&job->lock);
+
+        struct tree_hash_digest digest;
+        int result = s_hash_chunk(job->allocator, &chunk->buffer, &digest);
+        int error_code = result == AWS_OP_SUCCESS ? AWS_ERROR_SUCCESS : aws_last_error();
+
+        aws_mutex_lock(&job->lock);
+
+        if (error_code == AWS_ERROR_SUCCESS) {
+            error_code = aws_array_list_set_at(&job->digests, &digest, chunk->index) ? aws_last_error() : error_code;
+        }
+
+        if (error_code != AWS_ERROR_SUCCESS && job->error_code == AWS_ERROR_SUCCESS) {
+            job->error_code = error_code;
+        }
+
+        /* can't fail, the list was reserved for every chunk up front */
+        aws_array_list_push_back(&job->free_chunks, &chunk);
+        aws_condition_variable_notify_all(&job->signal);
+    }
+
+    /* the computing thread may clean the job up as soon as the lock is released */
+    --job->worker_count;
+    aws_condition_variable_notify_all(&job->signal);
+
+    aws_mutex_unlock(&job->lock);
+}
+
+static bool s_has_pool_work(void *user_data) {
+    (void)user_data;
+
+    return s_is_pool_shutting_down || s_pool_assignment_count > 0;
+}
+
+static void s_pool_thread_fn(void *user_data) {
+    (void)user_data;
+
+    aws_mutex_lock(&s_pool_lock);
+
+    while (true) {
+        aws_condition_variable_wait_pred(&s_pool_signal, &s_pool_lock, s_has_pool_work, NULL);
+
+        if (s_pool_assignment_count == 0) {
+            /* shutting down */
+            break;
+        }
+
+        struct tree_hash_job *job = s_pool_assignments[--s_pool_assignment_count];
+
+        aws_mutex_unlock(&s_pool_lock);
+        s_hash_job_chunks(job);
+        aws_mutex_lock(&s_pool_lock);
+    }
+
+    aws_mutex_unlock(&s_pool_lock);
+}
+
+void aws_tree_hash_pool_init(struct aws_allocator *allocator) {
+    aws_mutex_lock(&s_pool_lock);
+
+    s_pool_allocator = allocator;
+    s_pool_size = aws_system_info_processor_count();
+    if (s_pool_size > AWS_TREE_HASH_MAX_POOL_THREAD_COUNT) {
+        s_pool_size = AWS_TREE_HASH_MAX_POOL_THREAD_COUNT;
+    }
+    s_is_pool_shutting_down = false;
+
+    aws_mutex_unlock(&s_pool_lock);
+}
+
+void aws_tree_hash_pool_clean_up(void) {
+    aws_mutex_lock(&s_pool_lock);
+    s_is_pool_shutting_down = true;
+    aws_condition_variable_notify_all(&s_pool_signal);
+    size_t thread_count = s_pool_thread_count;
+    aws_mutex_unlock(&s_pool_lock);
+
+    for (size_t i = 0; i < thread_count; ++i) {
+        aws_thread_join(&s_pool_threads[i]);
+        aws_thread_clean_up(&s_pool_threads[i]);
+    }
+
+    aws_mutex_lock(&s_pool_lock);
+    s_pool_allocator = NULL;
+    s_pool_size = 0;
+    s_pool_thread_count = 0;
+    s_busy_thread_count = 0;
+    s_pool_assignment_count = 0;
+    aws_mutex_unlock(&s_pool_lock);
+}
+
+/*
+ * Claims up to wanted pool threads from the process-wide budget and assigns them to job, starting threads the pool
+ * doesn't have yet.  Returns how many were assigned.
+ */
+static size_t s_assign_pool_threads(struct tree_hash_job *job, size_t wanted) {
+    aws_mutex_lock(&s_pool_lock);
+
+    size_t available = s_pool_allocator != NULL ? s_pool_size - s_busy_thread_count : 0;
+    size_t granted = wanted < available ? wanted : available;
+
+    /* a thread is idle or on its way back to idle for every unclaimed slot, so only the shortfall is started */
+    while (s_pool_thread_count < s_busy_thread_count + granted) {
+        struct aws_thread *thread = &s_pool_threads[s_pool_thread_count];
+        if (aws_thread_init(thread, s_pool_allocator)) {
+            break;
+        }
+
+        struct aws_thread_options thread_options;
+        AWS_ZERO_STRUCT(thread_options);
+        if (aws_thread_launch(thread, s_pool_thread_fn, NULL, &thread_options)) {
+            aws_thread_clean_up(thread);
+            break;
+        }
+
+        ++s_pool_thread_count;
+    }
+
+    if (s_busy_thread_count + granted > s_pool_thread_count) {
+        granted = s_pool_thread_count - s_busy_thread_count;
+    }
+
+    /* one thread would only hash what the reading thread can */
+    if (granted == 1) {
+        granted = 0;
+    }
+
+    s_busy_thread_count += granted;
+
+    aws_mutex_lock(&job->lock);
+    job->worker_count = granted;
+    aws_mutex_unlock(&job->lock);
+
+    for (size_t i = 0; i < granted; ++i) {
+        s_pool_assignments[s_pool_assignment_count++] = job;
+    }
+
+    aws_condition_variable_notify_all(&s_pool_signal);
+    aws_mutex_unlock(&s_pool_lock);
+
+    return granted;
+}
+
+static void s_release_pool_threads(size_t count) {
+    aws_mutex_lock(&s_pool_lock);
+    s_busy_thread_count -= count;
+    aws_mutex_unlock(&s_pool_lock);
+}
+
+/*
+ * Fills a chunk buffer from the stream.  Sets is_end_of_stream once the stream is exhausted.
+ */
+static int s_read_chunk(struct aws_input_stream *stream, struct aws_byte_buf *buffer, bool *is_end_of_stream) {
+    buffer->len = 0;
+
+    if (stream == NULL) {
+        *is_end_of_stream = true;
+        return AWS_OP_SUCCESS;
+    }
+
+    while (buffer->len < buffer->capacity) {
+        if (aws_input_stream_read(stream, buffer)) {
+            return AWS_OP_ERR;
+        }
+
+        struct aws_stream_status status;
+        AWS_ZERO_STRUCT(status);
+        if (aws_input_stream_get_status(stream, &status)) {
+            return AWS_OP_ERR;
+        }
+
+        if (status.is_end_of_stream) {
+            *is_end_of_stream = true;
+            break;
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+/*
+ * Reduces the chunk digests to the root digest, in place
+ */
+static int s_build_tree(struct aws_allocator *allocator, struct aws_array_list *digests) {
+    size_t level_count = aws_array_list_length(digests);
+
+    uint8_t pair_storage[AWS_SHA256_LEN * 2];
+
+    while (level_count > 1) {
+        size_t next_level_count = 0;
+
+        for (size_t i = 0; i < level_count; i += 2) {
+            struct tree_hash_digest left;
+            aws_array_list_get_at(digests, &left, i);
+
+            struct tree_hash_digest parent = left;
+            if (i + 1 < level_count) {
+                struct tree_hash_digest right;
+                aws_array_list_get_at(digests, &right, i + 1);
+
+                memcpy(pair_storage, left.bytes, AWS_SHA256_LEN);
+                memcpy(pair_storage + AWS_SHA256_LEN, right.bytes, AWS_SHA256_LEN);
+
+                struct aws_byte_buf pair = aws_byte_buf_from_array(pair_storage, sizeof(pair_storage));
+                if (s_hash_chunk(allocator, &pair, &parent)) {
+                    return AWS_OP_ERR;
+                }
+            }
+
+            aws_array_list_set_at(digests, &parent, next_level_count++);
+        }
+
+        level_count = next_level_count;
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+static void s_destroy_chunk(struct aws_allocator *allocator, struct tree_hash_chunk *chunk) {
+    if (chunk == NULL) {
+        return;
+    }
+
+    aws_byte_buf_clean_up(&chunk->buffer);
+    aws_mem_release(allocator, chunk);
+}
+
+static struct tree_hash_chunk *s_new_chunk(struct aws_allocator *allocator) {
+    struct tree_hash_chunk *chunk = aws_mem_calloc(allocator, 1, sizeof(struct tree_hash_chunk));
+    if (chunk == NULL) {
+        return NULL;
+    }
+
+    if (aws_byte_buf_init(&chunk->buffer, allocator, AWS_TREE_HASH_CHUNK_SIZE)) {
+        aws_mem_release(allocator, chunk);
+        return NULL;
+    }
+
+    return chunk;
+}
+
+int aws_sha256_tree_hash_compute(
+    struct aws_allocator *allocator,
+    struct aws_input_stream *stream,
+    size_t thread_count,
+    aws_tree_hash_on_chunk_fn *on_chunk,
+    void *on_chunk_user_data,
+    struct aws_byte_buf *output) {
+
+    if (thread_count == 0) {
+        thread_count = aws_system_info_processor_count();
+    }
+
+    /* a single chunk buffer until pool threads are assigned, then enough to keep each of them busy */
+    size_t max_chunk_count = 1;
+
+    int result = AWS_OP_ERR;
+
+    struct tree_hash_job job;
+    AWS_ZERO_STRUCT(job);
+    job.allocator = allocator;
+
+    /* claimed from the pool once the payload is large enough to be worth threads */
+    size_t pool_thread_count = 0;
+    bool has_claimed_threads = false;
+
+    /* every chunk, wherever it is, is in this list so that clean up is simple */
+    struct aws_array_list all_chunks;
+    AWS_ZERO_STRUCT(all_chunks);
+
+    if (aws_mutex_init(&job.lock)) {
+        return AWS_OP_ERR;
+    }
+
+    if (aws_condition_variable_init(&job.signal)) {
+        aws_mutex_clean_up(&job.lock);
+        return AWS_OP_ERR;
+    }
+
+    if (aws_array_list_init_dynamic(&job.pending_chunks, allocator, max_chunk_count, sizeof(void *)) ||
+        aws_array_list_init_dynamic(&job.free_chunks, allocator, max_chunk_count, sizeof(void *)) ||
+        aws_array_list_init_dynamic(&job.digests, allocator, 16, sizeof(struct tree_hash_digest)) ||
+        aws_array_list_init_dynamic(&all_chunks, allocator, max_chunk_count, sizeof(void *))) {
+        goto done;
+    }
+
+    bool is_end_of_stream = false;
+    size_t chunk_index = 0;
+
+    while (!is_end_of_stream) {
+        struct tree_hash_chunk *chunk = NULL;
+
+        aws_mutex_lock(&job.lock);
+        if (aws_array_list_length(&job.free_chunks) == 0 && aws_array_list_length(&all_chunks) == max_chunk_count) {
+            /* read ahead is bounded; wait for a hashing thread to hand a chunk back */
+            while (aws_array_list_length(&job.free_chunks) == 0 && job.error_code == AWS_ERROR_SUCCESS) {
+                aws_condition_variable_wait(&job.signal, &job.lock);
+            }
+        }
+
+        if (job.error_code != AWS_ERROR_SUCCESS) {
+            aws_mutex_unlock(&job.lock);
+            aws_raise_error(job.error_code);
+            goto done;
+        }
+
+        if (aws_array_list_back(&job.free_chunks, &chunk) == AWS_OP_SUCCESS) {
+            aws_array_list_pop_back(&job.free_chunks);
+        }
+        aws_mutex_unlock(&job.lock);
+
+        if (chunk == NULL) {
+            chunk = s_new_chunk(allocator);
+            if (chunk == NULL) {
+                goto done;
+            }
+
+            if (aws_array_list_push_back(&all_chunks, &chunk)) {
+                s_destroy_chunk(allocator, chunk);
+                goto done;
+            }
+        }
+
+        if (s_read_chunk(stream, &chunk->buffer, &is_end_of_stream)) {
+            goto done;
+        }
+
+        /* the empty payload hashes as a single empty chunk, otherwise an empty last read adds nothing */
+        if (chunk->buffer.len == 0 && chunk_index > 0) {
+            break;
+        }
+
+        if (on_chunk != NULL) {
+            struct aws_byte_cursor chunk_cursor = aws_byte_cursor_from_buf(&chunk->buffer);
+            if (on_chunk(&chunk_cursor, on_chunk_user_data)) {
+                goto done;
+            }
+        }
+
+        chunk->index = chunk_index++;
+
+        struct tree_hash_digest empty_digest;
+        AWS_ZERO_STRUCT(empty_digest);
+
+        /* small payloads aren't worth any threads */
+        if (!has_claimed_threads && thread_count > 1 && !is_end_of_stream &&
+            chunk_index >= AWS_TREE_HASH_PARALLEL_MIN_CHUNK_COUNT) {
+            has_claimed_threads = true;
+
+            pool_thread_count = s_assign_pool_threads(&job, thread_count);
+            if (pool_thread_count > 0) {
+                max_chunk_count = pool_thread_count * TREE_HASH_CHUNKS_PER_THREAD;
+
+                /* no chunk has been handed to the threads yet, so nothing is pushed to these lists concurrently */
+                if (aws_array_list_ensure_capacity(&job.pending_chunks, max_chunk_count - 1) ||
+                    aws_array_list_ensure_capacity(&job.free_chunks, max_chunk_count - 1)) {
+                    goto done;
+                }
+            }
+        }
+
+        /* without at least two threads to spread the chunks over, hash them here */
+        if (pool_thread_count == 0) {
+            struct tree_hash_digest digest;
+            if (s_hash_chunk(allocator, &chunk->buffer, &digest)) {
+                goto done;
+            }
+
+            aws_mutex_lock(&job.lock);
+            int push_result = aws_array_list_push_back(&job.digests, &digest);
+            aws_array_list_push_back(&job.free_chunks, &chunk);
+            aws_mutex_unlock(&job.lock);
+
+            if (push_result) {
+                goto done;
+            }
+
+            continue;
+        }
+
+        aws_mutex_lock(&job.lock);
+        int push_result = aws_array_list_push_back(&job.digests, &empty_digest);
+        if (push_result == AWS_OP_SUCCESS) {
+            push_result = aws_array_list_push_back(&job.pending_chunks, &chunk);
+        }
+        aws_condition_variable_notify_all(&job.signal);
+        aws_mutex_unlock(&job.lock);
+
+        if (push_result) {
+            goto done;
+        }
+    }
+
+    result = AWS_OP_SUCCESS;
+
+done:
+
+    aws_mutex_lock(&job.lock);
+    job.is_input_done = true;
+    if (result != AWS_OP_SUCCESS && job.error_code == AWS_ERROR_SUCCESS) {
+        job.error_code = aws_last_error() != AWS_ERROR_SUCCESS ? aws_last_error() : AWS_ERROR_UNKNOWN;
+    }
+    aws_condition_variable_notify_all(&job.signal);
+
+    /* the pool threads go back to the pool once they are done with this job */
+    while (job.worker_count > 0) {
+        aws_condition_variable_wait(&job.signal, &job.lock);
+    }
+    aws_mutex_unlock(&job.lock);
+
+    s_release_pool_threads(pool_thread_count);
+
+    if (result == AWS_OP_SUCCESS && job.error_code != AWS_ERROR_SUCCESS) {
+        aws_raise_error(job.error_code);
+        result = AWS_OP_ERR;
+    }
+
+    if (result == AWS_OP_SUCCESS) {
+        result = s_build_tree(allocator, &job.digests);
+    }
+
+    if (result == AWS_OP_SUCCESS) {
+        struct tree_hash_digest root;
+        aws_array_list_get_at(&job.digests, &root, 0);
+
+        struct aws_byte_cursor root_cursor = aws_byte_cursor_from_array(root.bytes, sizeof(root.bytes));
+        result = aws_byte_buf_append_dynamic(output, &root_cursor);
+    }
+
+    size_t chunk_count = aws_array_list_length(&all_chunks);
+    for (size_t i = 0; i < chunk_count; ++i) {
+        struct tree_hash_chunk *chunk = NULL;
+        aws_array_list_get_at(&all_chunks, &chunk, i);
+        s_destroy_chunk(allocator, chunk);
+    }
+
+    aws_array_list_clean_up(&all_chunks);
+    aws_array_list_clean_up(&job.digests);
+    aws_array_list_clean_up(&job.free_chunks);
+    aws_array_list_clean_up(&job.pending_chunks);
+    aws_condition_variable_clean_up(&job.signal);
+    aws_mutex_clean_up(&job.lock);
+
+    return result;
+}
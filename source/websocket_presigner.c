@@ -0,0 +1,458 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/auth/websocket_presigner.h>
+
+#include <aws/auth/credentials.h>
+#include <aws/auth/signable.h>
+#include <aws/auth/signing.h>
+#include <aws/auth/signing_result.h>
+#include <aws/common/clock.h>
+#include <aws/common/date_time.h>
+#include <aws/common/linked_list.h>
+#include <aws/common/mutex.h>
+#include <aws/common/string.h>
+#include <aws/http/request_response.h>
+
+#include <inttypes.h>
+
+#if defined(_MSC_VER)
+#    pragma warning(disable : 4204)
+#endif /* _MSC_VER */
+
+#define DEFAULT_PRESIGN_EXPIRATION_SECS 900
+#define DEFAULT_PRESIGN_REFRESH_AHEAD_SECS 60
+
+struct aws_websocket_presigner {
+    struct aws_allocator *allocator;
+    struct aws_atomic_var ref_count;
+
+    struct aws_credentials_provider *credentials_provider;
+    struct aws_string *region;
+    struct aws_string *service;
+    struct aws_string *host;
+    struct aws_string *path;
+    uint64_t expiration_in_seconds;
+    uint64_t refresh_ahead_in_ns;
+    aws_io_clock_fn *clock_fn;
+
+    /* everything below is protected by lock */
+    struct aws_mutex lock;
+    struct aws_string *signed_path;
+    uint64_t expiration_time;
+    uint64_t refresh_time;
+    bool refresh_in_progress;
+    struct aws_linked_list pending_requests;
+};
+
+struct aws_websocket_presign_request {
+    struct aws_linked_list_node node;
+    aws_websocket_presign_complete_fn *callback;
+    void *user_data;
+};
+
+/*
+ * Per-refresh state; lives from the start of a signing pass until its completion callback
+ */
+struct aws_websocket_presign_refresh {
+    struct aws_websocket_presigner *presigner;
+    struct aws_http_message *request;
+    struct aws_signable *signable;
+    uint64_t sign_time;
+};
+
+static void s_presign_request_list_notify_and_clean_up(
+    struct aws_linked_list *request_list,
+    struct aws_allocator *allocator,
+    const struct aws_byte_cursor *signed_path,
+    int error_code) {
+
+    while (!aws_linked_list_empty(request_list)) {
+        struct aws_linked_list_node *node = aws_linked_list_pop_front(request_list);
+        struct aws_websocket_presign_request *request =
+            AWS_CONTAINER_OF(node, struct aws_websocket_presign_request, node);
+        request->callback(signed_path, error_code, request->user_data);
+        aws_mem_release(allocator, request);
+    }
+}
+
+static void s_websocket_presigner_destroy(struct aws_websocket_presigner *presigner) {
+    aws_credentials_provider_release(presigner->credentials_provider);
+    aws_string_destroy(presigner->region);
+    aws_string_destroy(presigner->service);
+    aws_string_destroy(presigner->host);
+    aws_string_destroy(presigner->path);
+    aws_string_destroy(presigner->signed_path);
+    aws_mutex_clean_up(&presigner->lock);
+
+    aws_mem_release(presigner->allocator, presigner);
+}
+
+void aws_websocket_presigner_acquire(struct aws_websocket_presigner *presigner) {
+    aws_atomic_fetch_add(&presigner->ref_count, 1);
+}
+
+void aws_websocket_presigner_release(struct aws_websocket_presigner *presigner) {
+    if (presigner == NULL) {
+        return;
+    }
+
+    size_t old_value = aws_atomic_fetch_sub(&presigner->ref_count, 1);
+    if (old_value == 1) {
+        s_websocket_presigner_destroy(presigner);
+    }
+}
+
+static void s_websocket_presign_refresh_destroy(struct aws_websocket_presign_refresh *refresh) {
+    struct aws_websocket_presigner *presigner = refresh->presigner;
+
+    aws_signable_destroy(refresh->signable);
+    if (refresh->request != NULL) {
+        aws_http_message_release(refresh->request);
+    }
+    aws_mem_release(presigner->allocator, refresh);
+
+    aws_websocket_presigner_release(presigner);
+}
+
+/*
+ * Finishes a signing pass: installs the new signed path (on success), clears the in-progress flag and notifies
+ * everyone who was waiting on it.  Takes ownership of signed_path.
+ */
+static void s_websocket_presigner_finish_refresh(
+    struct aws_websocket_presigner *presigner,
+    struct aws_string *signed_path,
+    uint64_t sign_time,
+    int error_code) {
+
+    struct aws_linked_list pending_requests;
+    aws_linked_list_init(&pending_requests);
+
+    struct aws_string *old_signed_path = NULL;
+    uint64_t expiration_time = 0;
+
+    aws_mutex_lock(&presigner->lock);
+
+    aws_linked_list_swap_contents(&pending_requests, &presigner->pending_requests);
+    presigner->refresh_in_progress = false;
+
+    if (signed_path != NULL) {
+        uint64_t expiration_in_ns =
+            aws_timestamp_convert(presigner->expiration_in_seconds, AWS_TIMESTAMP_SECS, AWS_TIMESTAMP_NANOS, NULL);
+
+        old_signed_path = presigner->signed_path;
+        presigner->signed_path = signed_path;
+        presigner->expiration_time = sign_time + expiration_in_ns;
+        presigner->refresh_time = presigner->expiration_time - presigner->refresh_ahead_in_ns;
+        expiration_time = presigner->expiration_time;
+    }
+
+    aws_mutex_unlock(&presigner->lock);
+
+    aws_string_destroy(old_signed_path);
+
+    if (signed_path == NULL) {
+        AWS_LOGF_ERROR(
+            AWS_LS_AUTH_SIGNING,
+            "(id=%p) Websocket presigner failed to sign handshake with error %d(%s)",
+            (void *)presigner,
+            error_code,
+            aws_error_str(error_code));
+
+        s_presign_request_list_notify_and_clean_up(&pending_requests, presigner->allocator, NULL, error_code);
+        return;
+    }
+
+    AWS_LOGF_DEBUG(
+        AWS_LS_AUTH_SIGNING,
+        "(id=%p) Websocket presigner refreshed signed path, valid until %" PRIu64,
+        (void *)presigner,
+        expiration_time);
+
+    if (aws_linked_list_empty(&pending_requests)) {
+        return;
+    }
+
+    /*
+     * A later refresh may replace (and destroy) signed_path as soon as we unlock, so notify from our own copy.
+     */
+    struct aws_string *notify_path = aws_string_new_from_string(presigner->allocator, signed_path);
+    if (notify_path == NULL) {
+        s_presign_request_list_notify_and_clean_up(&pending_requests, presigner->allocator, NULL, aws_last_error());
+        return;
+    }
+
+    struct aws_byte_cursor notify_cursor = aws_byte_cursor_from_string(notify_path);
+    s_presign_request_list_notify_and_clean_up(
+        &pending_requests, presigner->allocator, &notify_cursor, AWS_ERROR_SUCCESS);
+
+    aws_string_destroy(notify_path);
+}
+
+static void s_on_presign_signing_complete(struct aws_signing_result *result, int error_code, void *userdata) {
+    struct aws_websocket_presign_refresh *refresh = userdata;
+    struct aws_websocket_presigner *presigner = refresh->presigner;
+
+    struct aws_string *signed_path = NULL;
+
+    if (result == NULL) {
+        if (error_code == AWS_ERROR_SUCCESS) {
+            error_code = AWS_ERROR_UNKNOWN;
+        }
+        goto done;
+    }
+
+    if (aws_apply_signing_result_to_http_request(refresh->request, presigner->allocator, result)) {
+        error_code = aws_last_error();
+        goto done;
+    }
+
+    struct aws_byte_cursor path_cursor;
+    AWS_ZERO_STRUCT(path_cursor);
+    if (aws_http_message_get_request_path(refresh->request, &path_cursor)) {
+        error_code = aws_last_error();
+        goto done;
+    }
+
+    signed_path = aws_string_new_from_array(presigner->allocator, path_cursor.ptr, path_cursor.len);
+    if (signed_path == NULL) {
+        error_code = aws_last_error();
+    }
+
+done:
+
+    s_websocket_presigner_finish_refresh(presigner, signed_path, refresh->sign_time, error_code);
+    s_websocket_presign_refresh_destroy(refresh);
+}
+
+AWS_STATIC_STRING_FROM_LITERAL(s_get_method, "GET");
+AWS_STATIC_STRING_FROM_LITERAL(s_host_header_name, "host");
+
+static struct aws_http_message *s_build_handshake_request(struct aws_websocket_presigner *presigner) {
+    struct aws_http_message *request = aws_http_message_new_request(presigner->allocator);
+    if (request == NULL) {
+        return NULL;
+    }
+
+    struct aws_http_header host_header = {
+        .name = aws_byte_cursor_from_string(s_host_header_name),
+        .value = aws_byte_cursor_from_string(presigner->host),
+    };
+
+    if (aws_http_message_set_request_method(request, aws_byte_cursor_from_string(s_get_method)) ||
+        aws_http_message_set_request_path(request, aws_byte_cursor_from_string(presigner->path)) ||
+        aws_http_message_add_header(request, host_header)) {
+        aws_http_message_release(request);
+        return NULL;
+    }
+
+    return request;
+}
+
+/*
+ * Starts an async signing pass.  Completion (success or failure) always runs through
+ * s_websocket_presigner_finish_refresh, even when setup fails synchronously.
+ */
+static void s_websocket_presigner_begin_refresh(struct aws_websocket_presigner *presigner, uint64_t now) {
+
+    struct aws_websocket_presign_refresh *refresh =
+        aws_mem_calloc(presigner->allocator, 1, sizeof(struct aws_websocket_presign_refresh));
+    if (refresh == NULL) {
+        s_websocket_presigner_finish_refresh(presigner, NULL, now, aws_last_error());
+        return;
+    }
+
+    aws_websocket_presigner_acquire(presigner);
+    refresh->presigner = presigner;
+    refresh->sign_time = now;
+
+    refresh->request = s_build_handshake_request(presigner);
+    if (refresh->request == NULL) {
+        goto on_error;
+    }
+
+    refresh->signable = aws_signable_new_http_request(presigner->allocator, refresh->request);
+    if (refresh->signable == NULL) {
+        goto on_error;
+    }
+
+    struct aws_signing_config_aws config;
+    AWS_ZERO_STRUCT(config);
+
+    config.config_type = AWS_SIGNING_CONFIG_AWS;
+    config.algorithm = AWS_SIGNING_ALGORITHM_SIG_V4_QUERY_PARAM;
+    config.credentials_provider = presigner->credentials_provider;
+    config.region = aws_byte_cursor_from_string(presigner->region);
+    config.service = aws_byte_cursor_from_string(presigner->service);
+    config.use_double_uri_encode = true;
+    config.should_normalize_uri_path = true;
+    config.body_signing_type = AWS_BODY_SIGNING_OFF;
+    config.expiration_in_seconds = presigner->expiration_in_seconds;
+
+    aws_date_time_init_epoch_millis(
+        &config.date, aws_timestamp_convert(now, AWS_TIMESTAMP_NANOS, AWS_TIMESTAMP_MILLIS, NULL));
+
+    if (aws_sign_request_aws(
+            presigner->allocator,
+            refresh->signable,
+            (struct aws_signing_config_base *)&config,
+            s_on_presign_signing_complete,
+            refresh)) {
+        goto on_error;
+    }
+
+    return;
+
+on_error:
+
+    s_websocket_presigner_finish_refresh(presigner, NULL, now, aws_last_error());
+    s_websocket_presign_refresh_destroy(refresh);
+}
+
+int aws_websocket_presigner_get_signed_path(
+    struct aws_websocket_presigner *presigner,
+    aws_websocket_presign_complete_fn *callback,
+    void *user_data) {
+
+    uint64_t now = 0;
+    if (presigner->clock_fn(&now)) {
+        return AWS_OP_ERR;
+    }
+
+    struct aws_string *cached_path = NULL;
+    bool should_refresh = false;
+    bool perform_callback = false;
+
+    aws_mutex_lock(&presigner->lock);
+
+    if (presigner->signed_path != NULL && now < presigner->expiration_time) {
+        perform_callback = true;
+        cached_path = aws_string_new_from_string(presigner->allocator, presigner->signed_path);
+
+        if (now >= presigner->refresh_time && !presigner->refresh_in_progress) {
+            presigner->refresh_in_progress = true;
+            should_refresh = true;
+        }
+    } else {
+        struct aws_websocket_presign_request *request =
+            aws_mem_acquire(presigner->allocator, sizeof(struct aws_websocket_presign_request));
+        if (request != NULL) {
+            AWS_ZERO_STRUCT(*request);
+            request->callback = callback;
+            request->user_data = user_data;
+            aws_linked_list_push_back(&presigner->pending_requests, &request->node);
+
+            if (!presigner->refresh_in_progress) {
+                presigner->refresh_in_progress = true;
+                should_refresh = true;
+            }
+        } else {
+            perform_callback = true;
+        }
+    }
+
+    aws_mutex_unlock(&presigner->lock);
+
+    if (should_refresh) {
+        AWS_LOGF_DEBUG(
+            AWS_LS_AUTH_SIGNING,
+            "(id=%p) Websocket presigner %s, re-signing handshake",
+            (void *)presigner,
+            perform_callback ? "entered refresh-ahead window" : "has no valid signed path");
+
+        s_websocket_presigner_begin_refresh(presigner, now);
+    }
+
+    if (perform_callback) {
+        if (cached_path != NULL) {
+            struct aws_byte_cursor cached_cursor = aws_byte_cursor_from_string(cached_path);
+            callback(&cached_cursor, AWS_ERROR_SUCCESS, user_data);
+            aws_string_destroy(cached_path);
+        } else {
+            callback(NULL, aws_last_error(), user_data);
+        }
+    }
+
+    return AWS_OP_SUCCESS;
+}
+
+struct aws_websocket_presigner *aws_websocket_presigner_new(
+    struct aws_allocator *allocator,
+    const struct aws_websocket_presigner_options *options) {
+
+    if (options->credentials_provider == NULL || options->region.len == 0 || options->service.len == 0 ||
+        options->host.len == 0 || options->path.len == 0) {
+        AWS_LOGF_ERROR(AWS_LS_AUTH_SIGNING, "Websocket presigner options are missing a required field");
+        aws_raise_error(AWS_AUTH_SIGNING_INVALID_CONFIGURATION);
+        return NULL;
+    }
+
+    struct aws_websocket_presigner *presigner = aws_mem_calloc(allocator, 1, sizeof(struct aws_websocket_presigner));
+    if (presigner == NULL) {
+        return NULL;
+    }
+
+    presigner->allocator = allocator;
+    aws_atomic_init_int(&presigner->ref_count, 1);
+    aws_linked_list_init(&presigner->pending_requests);
+
+    if (aws_mutex_init(&presigner->lock)) {
+        aws_mem_release(allocator, presigner);
+        return NULL;
+    }
+
+    presigner->credentials_provider = options->credentials_provider;
+    aws_credentials_provider_acquire(presigner->credentials_provider);
+
+    presigner->region = aws_string_new_from_array(allocator, options->region.ptr, options->region.len);
+    presigner->service = aws_string_new_from_array(allocator, options->service.ptr, options->service.len);
+    presigner->host = aws_string_new_from_array(allocator, options->host.ptr, options->host.len);
+    presigner->path = aws_string_new_from_array(allocator, options->path.ptr, options->path.len);
+    if (presigner->region == NULL || presigner->service == NULL || presigner->host == NULL ||
+        presigner->path == NULL) {
+        goto on_error;
+    }
+
+    presigner->expiration_in_seconds = options->expiration_in_seconds;
+    if (presigner->expiration_in_seconds == 0) {
+        presigner->expiration_in_seconds = DEFAULT_PRESIGN_EXPIRATION_SECS;
+    }
+
+    uint64_t refresh_ahead_in_seconds = options->refresh_ahead_in_seconds;
+    if (refresh_ahead_in_seconds == 0) {
+        refresh_ahead_in_seconds = DEFAULT_PRESIGN_REFRESH_AHEAD_SECS;
+    }
+
+    if (refresh_ahead_in_seconds > presigner->expiration_in_seconds / 2) {
+        refresh_ahead_in_seconds = presigner->expiration_in_seconds / 2;
+    }
+
+    presigner->refresh_ahead_in_ns =
+        aws_timestamp_convert(refresh_ahead_in_seconds, AWS_TIMESTAMP_SECS, AWS_TIMESTAMP_NANOS, NULL);
+
+    if (options->clock_fn != NULL) {
+        presigner->clock_fn = options->clock_fn;
+    } else {
+        presigner->clock_fn = &aws_sys_clock_get_ticks;
+    }
+
+    return presigner;
+
+on_error:
+
+    s_websocket_presigner_destroy(presigner);
+
+    return NULL;
+}
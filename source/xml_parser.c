@@ -172,6 +172,16 @@ int aws_xml_parser_parse(
     return s_node_next_sibling(parser);
 }
 
+static bool s_cursor_has_prefix(const struct aws_byte_cursor *cursor, const struct aws_byte_cursor *prefix) {
+    return cursor->len >= prefix->len && memcmp(cursor->ptr, prefix->ptr, prefix->len) == 0;
+}
+
+static bool s_is_name_terminator(uint8_t value) {
+    return value == '>' || value == '/' || value == ' ' || value == '\t' || value == '\r' || value == '\n';
+}
+
+/* skips the parser past node's closing tag, in a single forward pass over the document: every tag is looked at once,
+ * and only tags with the node's own name change the nesting depth. */
 int s_advance_to_closing_tag(
     struct aws_xml_parser *parser,
     struct aws_xml_node *node,
@@ -211,34 +221,51 @@ int s_advance_to_closing_tag(
     size_t depth_count = 1;
     struct aws_byte_cursor to_find_open = aws_byte_cursor_from_buf(&open_cmp_buf);
     struct aws_byte_cursor to_find_close = aws_byte_cursor_from_buf(&closing_cmp_buf);
-    struct aws_byte_cursor close_find_result;
-    AWS_ZERO_STRUCT(close_find_result);
-    do {
-        if (aws_byte_cursor_find_exact(&parser->doc, &to_find_close, &close_find_result)) {
+    uint8_t *close_location = NULL;
+
+    while (depth_count > 0) {
+        uint8_t *tag_location = memchr(parser->doc.ptr, '<', parser->doc.len);
+        if (!tag_location) {
+            parser->skipped_len += parser->doc.len;
             return aws_raise_error(AWS_ERROR_MALFORMED_INPUT_STRING);
         }
 
-        /* if we find an opening node with the same name, before the closing tag keep going. */
-        struct aws_byte_cursor open_find_result;
-        AWS_ZERO_STRUCT(open_find_result);
-
-        while (parser->doc.len) {
-            if (!aws_byte_cursor_find_exact(&parser->doc, &to_find_open, &open_find_result)) {
-                if (open_find_result.ptr < close_find_result.ptr) {
-                    size_t skip_len = open_find_result.ptr - parser->doc.ptr;
-                    aws_byte_cursor_advance(&parser->doc, skip_len + 1);
-                    depth_count++;
-                    continue;
-                }
-            }
-            size_t skip_len = close_find_result.ptr - parser->doc.ptr;
-            aws_byte_cursor_advance(&parser->doc, skip_len + closing_cmp_buf.len);
+        parser->skipped_len += tag_location - parser->doc.ptr + 1;
+        aws_byte_cursor_advance(&parser->doc, tag_location - parser->doc.ptr);
+
+        /* the tag is compared against both names, neither read runs past the closing name's length */
+        parser->skipped_len += to_find_close.len;
+
+        if (s_cursor_has_prefix(&parser->doc, &to_find_close)) {
+            close_location = parser->doc.ptr;
+            aws_byte_cursor_advance(&parser->doc, to_find_close.len);
             depth_count--;
-            break;
+            continue;
         }
-    } while (depth_count > 0);
 
-    size_t len = close_find_result.ptr - node->doc_at_body.ptr;
+        /* a nested node with the same name, unless it closes itself */
+        if (s_cursor_has_prefix(&parser->doc, &to_find_open) && parser->doc.len > to_find_open.len &&
+            s_is_name_terminator(parser->doc.ptr[to_find_open.len])) {
+            uint8_t *tag_end = memchr(parser->doc.ptr, '>', parser->doc.len);
+            if (!tag_end) {
+                parser->skipped_len += parser->doc.len;
+                return aws_raise_error(AWS_ERROR_MALFORMED_INPUT_STRING);
+            }
+
+            parser->skipped_len += tag_end - parser->doc.ptr + 1;
+
+            if (*(tag_end - 1) != '/') {
+                depth_count++;
+            }
+
+            aws_byte_cursor_advance(&parser->doc, tag_end - parser->doc.ptr + 1);
+            continue;
+        }
+
+        aws_byte_cursor_advance(&parser->doc, 1);
+    }
+
+    size_t len = close_location - node->doc_at_body.ptr;
 
     if (out_body) {
         *out_body = aws_byte_cursor_from_array(node->doc_at_body.ptr, len);
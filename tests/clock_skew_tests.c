@@ -0,0 +1,96 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/testing/aws_test_harness.h>
+
+#include <aws/auth/clock_skew.h>
+#include <aws/auth/private/aws_signing.h>
+
+#include "credentials_provider_utils.h"
+
+/* 2015-08-30T12:36:00Z */
+#define SKEW_TEST_LOCAL_TIME_SECS 1440938160ULL
+#define SKEW_TEST_NANOS_PER_SEC 1000000000ULL
+
+static int s_clock_skew_tracker_date_header_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    mock_aws_set_time(SKEW_TEST_LOCAL_TIME_SECS * SKEW_TEST_NANOS_PER_SEC);
+
+    struct aws_clock_skew_tracker_options options = {
+        .clock_fn = mock_aws_get_time,
+    };
+    struct aws_clock_skew_tracker *tracker = aws_clock_skew_tracker_new(allocator, &options);
+    ASSERT_NOT_NULL(tracker);
+
+    struct aws_byte_cursor endpoint = aws_byte_cursor_from_c_str("sts.amazonaws.com");
+    struct aws_byte_cursor other_endpoint = aws_byte_cursor_from_c_str("s3.amazonaws.com");
+
+    /* the server is ten minutes ahead of us */
+    ASSERT_SUCCESS(aws_clock_skew_tracker_record_date_header(
+        tracker, endpoint, aws_byte_cursor_from_c_str("Sun, 30 Aug 2015 12:46:00 GMT")));
+    ASSERT_INT_EQUALS(600000, aws_clock_skew_tracker_get_offset_ms(tracker, endpoint));
+    ASSERT_INT_EQUALS(
+        600000, aws_clock_skew_tracker_get_offset_ms(tracker, aws_byte_cursor_from_c_str("STS.amazonaws.com")));
+    ASSERT_INT_EQUALS(0, aws_clock_skew_tracker_get_offset_ms(tracker, other_endpoint));
+
+    ASSERT_FAILS(aws_clock_skew_tracker_record_date_header(tracker, endpoint, aws_byte_cursor_from_c_str("bogus")));
+    ASSERT_INT_EQUALS(600000, aws_clock_skew_tracker_get_offset_ms(tracker, endpoint));
+
+    /* signing states pick up the corrected time instead of the configured date */
+    struct aws_signing_config_aws config = {
+        .config_type = AWS_SIGNING_CONFIG_AWS,
+        .algorithm = AWS_SIGNING_ALGORITHM_SIG_V4_HEADER,
+        .region = aws_byte_cursor_from_c_str("us-east-1"),
+        .service = aws_byte_cursor_from_c_str("sts"),
+        .clock_skew_tracker = tracker,
+        .clock_skew_endpoint = endpoint,
+    };
+    config.credentials_provider = aws_credentials_provider_new_mock(allocator, NULL, 0, NULL);
+    aws_date_time_init_epoch_secs(&config.date, 0);
+
+    struct aws_signing_state_aws *state = aws_signing_state_new(allocator, &config, NULL, NULL, NULL);
+    ASSERT_NOT_NULL(state);
+    ASSERT_UINT_EQUALS((SKEW_TEST_LOCAL_TIME_SECS + 600) * 1000, aws_date_time_as_millis(&state->config.date));
+    aws_signing_state_destroy(state);
+
+    /* a single slow response doesn't move the offset */
+    struct aws_date_time server_time;
+    aws_date_time_init_epoch_secs(&server_time, (double)(SKEW_TEST_LOCAL_TIME_SECS - 30));
+    ASSERT_SUCCESS(aws_clock_skew_tracker_record_server_time(tracker, endpoint, &server_time));
+    ASSERT_INT_EQUALS(600000, aws_clock_skew_tracker_get_offset_ms(tracker, endpoint));
+
+    /* but once the older observations have aged out, the offset follows the new ones */
+    for (size_t i = 1; i < AWS_CLOCK_SKEW_SAMPLE_COUNT; ++i) {
+        ASSERT_SUCCESS(aws_clock_skew_tracker_record_server_time(tracker, endpoint, &server_time));
+    }
+    ASSERT_INT_EQUALS(-30000, aws_clock_skew_tracker_get_offset_ms(tracker, endpoint));
+
+    /* skews within the Date header's resolution and ordinary latency aren't applied */
+    aws_date_time_init_epoch_secs(&server_time, (double)(SKEW_TEST_LOCAL_TIME_SECS + 1));
+    ASSERT_SUCCESS(aws_clock_skew_tracker_record_server_time(tracker, other_endpoint, &server_time));
+    ASSERT_INT_EQUALS(0, aws_clock_skew_tracker_get_offset_ms(tracker, other_endpoint));
+
+    aws_credentials_provider_release(config.credentials_provider);
+    aws_clock_skew_tracker_destroy(tracker);
+
+    aws_auth_library_clean_up();
+
+    return 0;
+}
+
+AWS_TEST_CASE(clock_skew_tracker_date_header_test, s_clock_skew_tracker_date_header_test);
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/testing/aws_test_harness.h>
+
+#include <aws/auth/private/credentials_hedging.h>
+#include <aws/common/clock.h>
+#include <aws/io/event_loop.h>
+
+static uint64_t s_ms_to_ns(uint64_t ms) {
+    return aws_timestamp_convert(ms, AWS_TIMESTAMP_MILLIS, AWS_TIMESTAMP_NANOS, NULL);
+}
+
+static int s_credentials_hedging_delay_and_budget_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    struct aws_event_loop_group el_group;
+    ASSERT_SUCCESS(aws_event_loop_group_default_init(&el_group, allocator, 1));
+
+    struct aws_credentials_hedging hedging;
+
+    /* disabled unless a percentile is given */
+    struct aws_credentials_provider_hedging_options options;
+    AWS_ZERO_STRUCT(options);
+    ASSERT_SUCCESS(aws_credentials_hedging_init(&hedging, allocator, &options, &el_group, NULL, NULL));
+    ASSERT_FALSE(aws_credentials_hedging_is_enabled(&hedging));
+
+    options.latency_percentile = 100;
+    ASSERT_FAILS(aws_credentials_hedging_init(&hedging, allocator, &options, &el_group, NULL, NULL));
+
+    options.latency_percentile = 90;
+    options.min_delay_ms = 5;
+    options.max_hedges_per_100_requests = 50;
+    ASSERT_SUCCESS(aws_credentials_hedging_init(&hedging, allocator, &options, &el_group, NULL, NULL));
+    ASSERT_TRUE(aws_credentials_hedging_is_enabled(&hedging));
+
+    /* conservative until there's enough history */
+    ASSERT_UINT_EQUALS(s_ms_to_ns(1000), aws_credentials_hedging_get_delay_ns(&hedging));
+
+    for (uint64_t i = 20; i > 0; --i) {
+        aws_credentials_hedging_record_latency(&hedging, s_ms_to_ns(i));
+    }
+    ASSERT_UINT_EQUALS(s_ms_to_ns(19), aws_credentials_hedging_get_delay_ns(&hedging));
+
+    /* the floor applies to fast histories */
+    for (size_t i = 0; i < AWS_CREDENTIALS_HEDGING_SAMPLE_COUNT; ++i) {
+        aws_credentials_hedging_record_latency(&hedging, s_ms_to_ns(1));
+    }
+    ASSERT_UINT_EQUALS(s_ms_to_ns(5), aws_credentials_hedging_get_delay_ns(&hedging));
+
+    /* one hedge banked up front, then one per two requests */
+    ASSERT_TRUE(aws_credentials_hedging_try_acquire_hedge(&hedging));
+    ASSERT_FALSE(aws_credentials_hedging_try_acquire_hedge(&hedging));
+    aws_credentials_hedging_on_request(&hedging);
+    ASSERT_FALSE(aws_credentials_hedging_try_acquire_hedge(&hedging));
+    aws_credentials_hedging_on_request(&hedging);
+    ASSERT_TRUE(aws_credentials_hedging_try_acquire_hedge(&hedging));
+
+    /* the budget never banks more than one hedge */
+    for (size_t i = 0; i < 10; ++i) {
+        aws_credentials_hedging_on_request(&hedging);
+    }
+    ASSERT_TRUE(aws_credentials_hedging_try_acquire_hedge(&hedging));
+    ASSERT_FALSE(aws_credentials_hedging_try_acquire_hedge(&hedging));
+
+    aws_credentials_hedging_clean_up(&hedging);
+    aws_event_loop_group_clean_up(&el_group);
+
+    aws_auth_library_clean_up();
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(credentials_hedging_delay_and_budget_test, s_credentials_hedging_delay_and_budget_test)
@@ -16,6 +16,7 @@
 #include <aws/testing/aws_test_harness.h>
 
 #include <aws/auth/credentials.h>
+#include <aws/auth/imds_client.h>
 #include <aws/auth/private/credentials_utils.h>
 #include <aws/common/clock.h>
 #include <aws/common/condition_variable.h>
@@ -38,6 +39,15 @@ struct aws_mock_imds_tester {
     bool is_first_request_successful;
     bool is_second_request_successful;
 
+    /* if set, connection acquisitions are held until the test completes them */
+    bool is_connection_acquire_deferred;
+    size_t connection_acquire_count;
+    aws_http_connection_manager_on_connection_setup_fn *deferred_acquire_callback;
+    void *deferred_acquire_user_data;
+
+    aws_http_connection_manager_shutdown_complete_fn *manager_shutdown_callback;
+    void *manager_shutdown_user_data;
+
     struct aws_mutex lock;
     struct aws_condition_variable signal;
 
@@ -75,7 +85,9 @@ static struct aws_http_connection_manager *s_aws_http_connection_manager_new_moc
     struct aws_http_connection_manager_options *options) {
 
     (void)allocator;
-    (void)options;
+
+    s_tester.manager_shutdown_callback = options->shutdown_complete_callback;
+    s_tester.manager_shutdown_user_data = options->shutdown_complete_user_data;
 
     return (struct aws_http_connection_manager *)1;
 }
@@ -83,7 +95,7 @@ static struct aws_http_connection_manager *s_aws_http_connection_manager_new_moc
 static void s_aws_http_connection_manager_release_mock(struct aws_http_connection_manager *manager) {
     (void)manager;
 
-    s_on_shutdown_complete(NULL);
+    s_tester.manager_shutdown_callback(s_tester.manager_shutdown_user_data);
 }
 
 static void s_aws_http_connection_manager_acquire_connection_mock(
@@ -95,6 +107,14 @@ static void s_aws_http_connection_manager_acquire_connection_mock(
     (void)callback;
     (void)user_data;
 
+    ++s_tester.connection_acquire_count;
+
+    if (s_tester.is_connection_acquire_deferred) {
+        s_tester.deferred_acquire_callback = callback;
+        s_tester.deferred_acquire_user_data = user_data;
+        return;
+    }
+
     if (s_tester.is_connection_acquire_successful) {
         callback((struct aws_http_connection *)1, AWS_OP_SUCCESS, user_data);
     } else {
@@ -224,6 +244,8 @@ static int s_aws_imds_tester_init(struct aws_allocator *allocator) {
     }
 
     s_tester.current_request = 0;
+    s_tester.is_connection_acquire_deferred = false;
+    s_tester.connection_acquire_count = 0;
 
     /* default to everything successful */
     s_tester.is_connection_acquire_successful = true;
@@ -288,9 +310,6 @@ static int s_credentials_provider_imds_new_destroy(struct aws_allocator *allocat
 
     s_aws_wait_for_provider_shutdown_callback();
 
-    /* Because we mock the http connection manager, we never get a callback back from it */
-    aws_mem_release(provider->allocator, provider);
-
     s_aws_imds_tester_cleanup();
 
     return 0;
@@ -327,9 +346,6 @@ static int s_credentials_provider_imds_connect_failure(struct aws_allocator *all
 
     s_aws_wait_for_provider_shutdown_callback();
 
-    /* Because we mock the http connection manager, we never get a callback back from it */
-    aws_mem_release(provider->allocator, provider);
-
     s_aws_imds_tester_cleanup();
 
     return 0;
@@ -375,9 +391,6 @@ static int s_credentials_provider_imds_first_request_failure(struct aws_allocato
 
     s_aws_wait_for_provider_shutdown_callback();
 
-    /* Because we mock the http connection manager, we never get a callback back from it */
-    aws_mem_release(provider->allocator, provider);
-
     s_aws_imds_tester_cleanup();
 
     return 0;
@@ -427,9 +440,6 @@ static int s_credentials_provider_imds_second_request_failure(struct aws_allocat
 
     s_aws_wait_for_provider_shutdown_callback();
 
-    /* Because we mock the http connection manager, we never get a callback back from it */
-    aws_mem_release(provider->allocator, provider);
-
     s_aws_imds_tester_cleanup();
 
     return 0;
@@ -483,9 +493,6 @@ static int s_credentials_provider_imds_bad_document_failure(struct aws_allocator
 
     s_aws_wait_for_provider_shutdown_callback();
 
-    /* Because we mock the http connection manager, we never get a callback back from it */
-    aws_mem_release(provider->allocator, provider);
-
     s_aws_imds_tester_cleanup();
 
     return 0;
@@ -560,9 +567,6 @@ static int s_credentials_provider_imds_basic_success(struct aws_allocator *alloc
 
     s_aws_wait_for_provider_shutdown_callback();
 
-    /* Because we mock the http connection manager, we never get a callback back from it */
-    aws_mem_release(provider->allocator, provider);
-
     s_aws_imds_tester_cleanup();
 
     return 0;
@@ -634,9 +638,6 @@ static int s_credentials_provider_imds_success_multi_part_role_name(struct aws_a
 
     s_aws_wait_for_provider_shutdown_callback();
 
-    /* Because we mock the http connection manager, we never get a callback back from it */
-    aws_mem_release(provider->allocator, provider);
-
     s_aws_imds_tester_cleanup();
 
     return 0;
@@ -713,9 +714,6 @@ static int s_credentials_provider_imds_success_multi_part_doc(struct aws_allocat
 
     s_aws_wait_for_provider_shutdown_callback();
 
-    /* Because we mock the http connection manager, we never get a callback back from it */
-    aws_mem_release(provider->allocator, provider);
-
     s_aws_imds_tester_cleanup();
 
     return 0;
@@ -723,6 +721,210 @@ static int s_credentials_provider_imds_success_multi_part_doc(struct aws_allocat
 
 AWS_TEST_CASE(credentials_provider_imds_success_multi_part_doc, s_credentials_provider_imds_success_multi_part_doc);
 
+static void s_count_credentials_callback(struct aws_credentials *credentials, void *user_data) {
+    size_t *success_count = user_data;
+
+    if (credentials != NULL) {
+        ++(*success_count);
+    }
+}
+
+static int s_credentials_provider_imds_shared_client_coalescing(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    s_aws_imds_tester_init(allocator);
+
+    struct aws_byte_cursor test_role_cursor = aws_byte_cursor_from_string(s_test_role_response);
+    aws_array_list_push_back(&s_tester.first_response_data_callbacks, &test_role_cursor);
+
+    struct aws_byte_cursor good_response_cursor = aws_byte_cursor_from_string(s_good_response);
+    aws_array_list_push_back(&s_tester.second_response_data_callbacks, &good_response_cursor);
+
+    struct aws_imds_client_options client_options = {
+        .bootstrap = NULL,
+        .function_table = &s_mock_function_table,
+    };
+
+    struct aws_imds_client *client = aws_imds_client_new(allocator, &client_options);
+    ASSERT_NOT_NULL(client);
+
+    struct aws_credentials_provider_imds_options options = {
+        .bootstrap = NULL,
+        .client = client,
+        .shutdown_options =
+            {
+                .shutdown_callback = s_on_shutdown_complete,
+                .shutdown_user_data = NULL,
+            },
+    };
+
+    struct aws_credentials_provider *provider1 = aws_credentials_provider_new_imds(allocator, &options);
+    struct aws_credentials_provider *provider2 = aws_credentials_provider_new_imds(allocator, &options);
+    ASSERT_NOT_NULL(provider1);
+    ASSERT_NOT_NULL(provider2);
+
+    /* the client reference is only needed to build the providers */
+    aws_imds_client_release(client, NULL, NULL);
+
+    /* hold the first connection so that the second provider's role name query finds the first one in flight */
+    s_tester.is_connection_acquire_deferred = true;
+
+    size_t success_count = 0;
+    ASSERT_SUCCESS(aws_credentials_provider_get_credentials(provider1, s_count_credentials_callback, &success_count));
+    ASSERT_SUCCESS(aws_credentials_provider_get_credentials(provider2, s_count_credentials_callback, &success_count));
+
+    ASSERT_UINT_EQUALS(1, s_tester.connection_acquire_count);
+
+    s_tester.is_connection_acquire_deferred = false;
+    s_tester.deferred_acquire_callback(
+        (struct aws_http_connection *)1, AWS_ERROR_SUCCESS, s_tester.deferred_acquire_user_data);
+
+    ASSERT_UINT_EQUALS(2, success_count);
+    ASSERT_BIN_ARRAYS_EQUALS(
+        s_tester.first_request_uri.buffer,
+        s_tester.first_request_uri.len,
+        s_expected_imds_base_uri->bytes,
+        s_expected_imds_base_uri->len);
+
+    aws_credentials_provider_release(provider1);
+    aws_credentials_provider_release(provider2);
+
+    s_aws_wait_for_provider_shutdown_callback();
+
+    s_aws_imds_tester_cleanup();
+
+    return 0;
+}
+
+AWS_TEST_CASE(credentials_provider_imds_shared_client_coalescing, s_credentials_provider_imds_shared_client_coalescing);
+
+AWS_STATIC_STRING_FROM_LITERAL(
+    s_identity_document,
+    "{\"accountId\" : \"123456789012\", \"availabilityZone\" : \"us-west-2b\", "
+    "\"instanceId\" : \"i-0123456789abcdef0\", \"region\" : \"us-west-2\"}");
+AWS_STATIC_STRING_FROM_LITERAL(s_expected_identity_uri, "/latest/dynamic/instance-identity/document");
+AWS_STATIC_STRING_FROM_LITERAL(s_expected_region, "us-west-2");
+
+static void s_on_get_region(struct aws_byte_cursor value, int error_code, void *user_data) {
+    struct aws_byte_buf *region = user_data;
+
+    if (error_code == AWS_ERROR_SUCCESS) {
+        aws_byte_buf_append_dynamic(region, &value);
+    }
+}
+
+static void s_on_get_instance_identity(
+    const struct aws_imds_instance_identity *identity,
+    int error_code,
+    void *user_data) {
+
+    const struct aws_imds_instance_identity **out_identity = user_data;
+
+    if (error_code == AWS_ERROR_SUCCESS) {
+        *out_identity = identity;
+    }
+}
+
+static int s_imds_client_instance_identity_cached(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    s_aws_imds_tester_init(allocator);
+
+    struct aws_byte_cursor identity_cursor = aws_byte_cursor_from_string(s_identity_document);
+    aws_array_list_push_back(&s_tester.first_response_data_callbacks, &identity_cursor);
+
+    struct aws_imds_client_options client_options = {
+        .bootstrap = NULL,
+        .function_table = &s_mock_function_table,
+    };
+
+    struct aws_imds_client *client = aws_imds_client_new(allocator, &client_options);
+    ASSERT_NOT_NULL(client);
+
+    struct aws_byte_buf region;
+    ASSERT_SUCCESS(aws_byte_buf_init(&region, allocator, 16));
+
+    ASSERT_SUCCESS(aws_imds_client_get_region(client, s_on_get_region, &region));
+    ASSERT_BIN_ARRAYS_EQUALS(region.buffer, region.len, s_expected_region->bytes, s_expected_region->len);
+    ASSERT_BIN_ARRAYS_EQUALS(
+        s_tester.first_request_uri.buffer,
+        s_tester.first_request_uri.len,
+        s_expected_identity_uri->bytes,
+        s_expected_identity_uri->len);
+
+    /* served from the cache: a second request would have been recorded as the second uri */
+    region.len = 0;
+    const struct aws_imds_instance_identity *identity = NULL;
+    ASSERT_SUCCESS(aws_imds_client_get_region(client, s_on_get_region, &region));
+    ASSERT_SUCCESS(aws_imds_client_get_instance_identity(client, s_on_get_instance_identity, &identity));
+    ASSERT_UINT_EQUALS(1, s_tester.connection_acquire_count);
+    ASSERT_UINT_EQUALS(0, s_tester.second_request_uri.len);
+
+    ASSERT_BIN_ARRAYS_EQUALS(region.buffer, region.len, s_expected_region->bytes, s_expected_region->len);
+    ASSERT_NOT_NULL(identity);
+    ASSERT_STR_EQUALS("i-0123456789abcdef0", aws_string_c_str(identity->instance_id));
+    ASSERT_STR_EQUALS("us-west-2b", aws_string_c_str(identity->availability_zone));
+    ASSERT_STR_EQUALS("123456789012", aws_string_c_str(identity->account_id));
+
+    aws_byte_buf_clean_up(&region);
+
+    aws_imds_client_release(client, s_on_shutdown_complete, NULL);
+
+    s_aws_wait_for_provider_shutdown_callback();
+
+    s_aws_imds_tester_cleanup();
+
+    return 0;
+}
+
+AWS_TEST_CASE(imds_client_instance_identity_cached, s_imds_client_instance_identity_cached);
+
+static int s_imds_client_shared_keyed_by_options(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    s_aws_imds_tester_init(allocator);
+
+    struct aws_imds_client_options client_options = {
+        .bootstrap = NULL,
+        .function_table = &s_mock_function_table,
+    };
+
+    struct aws_imds_client *client1 = aws_imds_client_acquire_shared(allocator, &client_options);
+    ASSERT_NOT_NULL(client1);
+
+    /* the mock only tracks the most recent manager, so remember the first client's shutdown hook */
+    aws_http_connection_manager_shutdown_complete_fn *client1_shutdown_callback = s_tester.manager_shutdown_callback;
+    void *client1_shutdown_user_data = s_tester.manager_shutdown_user_data;
+
+    /* the default pool size is the same as leaving it unset */
+    struct aws_imds_client_options same_options = client_options;
+    same_options.max_connections = 2;
+    struct aws_imds_client *client2 = aws_imds_client_acquire_shared(allocator, &same_options);
+    ASSERT_PTR_EQUALS(client1, client2);
+
+    struct aws_imds_client_options other_options = client_options;
+    other_options.max_connections = 4;
+    struct aws_imds_client *client3 = aws_imds_client_acquire_shared(allocator, &other_options);
+    ASSERT_NOT_NULL(client3);
+    ASSERT_TRUE(client3 != client1);
+
+    aws_imds_client_release(client3, NULL, NULL);
+
+    s_tester.manager_shutdown_callback = client1_shutdown_callback;
+    s_tester.manager_shutdown_user_data = client1_shutdown_user_data;
+
+    aws_imds_client_release(client2, NULL, NULL);
+    aws_imds_client_release(client1, s_on_shutdown_complete, NULL);
+
+    s_aws_wait_for_provider_shutdown_callback();
+
+    s_aws_imds_tester_cleanup();
+
+    return 0;
+}
+
+AWS_TEST_CASE(imds_client_shared_keyed_by_options, s_imds_client_shared_keyed_by_options);
+
 static int s_credentials_provider_imds_real_new_destroy(struct aws_allocator *allocator, void *ctx) {
     (void)ctx;
 
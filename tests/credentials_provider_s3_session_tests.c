@@ -0,0 +1,472 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/testing/aws_test_harness.h>
+
+#include <aws/auth/credentials.h>
+#include <aws/auth/private/credentials_utils.h>
+#include <aws/auth/s3_session_cache.h>
+#include <aws/common/string.h>
+#include <aws/http/connection.h>
+#include <aws/http/connection_manager.h>
+#include <aws/http/request_response.h>
+
+#include "credentials_provider_utils.h"
+
+/* 2019-11-30T12:00:00Z; the mock CreateSession endpoint issues sessions valid until 12:05:00 */
+#define S3_SESSION_TEST_TIME_SECS 1575115200ULL
+#define S3_SESSION_TEST_NANOS_PER_SEC 1000000000ULL
+
+static const char *s_create_session_doc = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                                          "<CreateSessionResult xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">\n"
+                                          "    <Credentials>\n"
+                                          "        <SessionToken>sessionTokenResp</SessionToken>\n"
+                                          "        <SecretAccessKey>secretKeyResp</SecretAccessKey>\n"
+                                          "        <AccessKeyId>accessKeyIdResp</AccessKeyId>\n"
+                                          "        <Expiration>2019-11-30T12:05:00Z</Expiration>\n"
+                                          "    </Credentials>\n"
+                                          "</CreateSessionResult>";
+
+static const char *s_bucket_one = "bucket-one--usw2-az1--x-s3";
+static const char *s_bucket_two = "bucket-two--usw2-az3--x-s3";
+
+/*
+ * Stands in for the CreateSession endpoint.  Connection acquisition can be held, so that queries arriving while a
+ * CreateSession call is in flight can be observed.
+ */
+struct aws_mock_s3_session_tester {
+    struct aws_allocator *allocator;
+
+    size_t request_count;
+    struct aws_byte_buf request_path;
+    struct aws_byte_buf host_header;
+    bool had_auth_header;
+
+    bool hold_connections;
+    aws_http_connection_manager_on_connection_setup_fn *held_callback;
+    void *held_user_data;
+
+    size_t callback_count;
+    size_t credentials_count;
+    struct aws_credentials *credentials;
+
+    size_t manager_count;
+    size_t manager_shutdown_count;
+    size_t managers_shut_down_at_provider_shutdown;
+    bool has_provider_shut_down;
+};
+
+/* one per bucket; the mock managers shut down as soon as they are released */
+struct mock_connection_manager {
+    aws_http_connection_manager_shutdown_complete_fn *shutdown_callback;
+    void *shutdown_user_data;
+};
+
+static struct aws_mock_s3_session_tester s_tester;
+
+static struct aws_http_connection_manager *s_aws_http_connection_manager_new_mock(
+    struct aws_allocator *allocator,
+    struct aws_http_connection_manager_options *options) {
+
+    struct mock_connection_manager *manager = aws_mem_calloc(allocator, 1, sizeof(struct mock_connection_manager));
+    if (manager == NULL) {
+        return NULL;
+    }
+
+    manager->shutdown_callback = options->shutdown_complete_callback;
+    manager->shutdown_user_data = options->shutdown_complete_user_data;
+    ++s_tester.manager_count;
+
+    return (struct aws_http_connection_manager *)manager;
+}
+
+static void s_aws_http_connection_manager_release_mock(struct aws_http_connection_manager *manager) {
+    struct mock_connection_manager *mock_manager = (struct mock_connection_manager *)manager;
+
+    aws_http_connection_manager_shutdown_complete_fn *shutdown_callback = mock_manager->shutdown_callback;
+    void *shutdown_user_data = mock_manager->shutdown_user_data;
+    aws_mem_release(s_tester.allocator, mock_manager);
+
+    ++s_tester.manager_shutdown_count;
+    if (shutdown_callback != NULL) {
+        shutdown_callback(shutdown_user_data);
+    }
+}
+
+static void s_aws_http_connection_manager_acquire_connection_mock(
+    struct aws_http_connection_manager *manager,
+    aws_http_connection_manager_on_connection_setup_fn *callback,
+    void *user_data) {
+
+    (void)manager;
+
+    if (s_tester.hold_connections) {
+        s_tester.held_callback = callback;
+        s_tester.held_user_data = user_data;
+        return;
+    }
+
+    callback((struct aws_http_connection *)1, AWS_ERROR_SUCCESS, user_data);
+}
+
+static int s_aws_http_connection_manager_release_connection_mock(
+    struct aws_http_connection_manager *manager,
+    struct aws_http_connection *connection) {
+
+    (void)manager;
+    (void)connection;
+
+    return AWS_OP_SUCCESS;
+}
+
+static struct aws_http_stream *s_aws_http_connection_make_request_mock(
+    struct aws_http_connection *client_connection,
+    const struct aws_http_make_request_options *options) {
+
+    (void)client_connection;
+
+    ++s_tester.request_count;
+
+    aws_byte_buf_clean_up(&s_tester.request_path);
+    aws_byte_buf_clean_up(&s_tester.host_header);
+    s_tester.had_auth_header = false;
+
+    struct aws_byte_cursor path;
+    AWS_ZERO_STRUCT(path);
+    aws_http_message_get_request_path(options->request, &path);
+    aws_byte_buf_init_copy_from_cursor(&s_tester.request_path, s_tester.allocator, path);
+
+    size_t header_count = aws_http_message_get_header_count(options->request);
+    for (size_t i = 0; i < header_count; ++i) {
+        struct aws_http_header header;
+        AWS_ZERO_STRUCT(header);
+        aws_http_message_get_header(options->request, &header, i);
+
+        if (aws_byte_cursor_eq_c_str_ignore_case(&header.name, "host")) {
+            aws_byte_buf_init_copy_from_cursor(&s_tester.host_header, s_tester.allocator, header.value);
+        }
+
+        if (aws_byte_cursor_eq_c_str_ignore_case(&header.name, "authorization")) {
+            s_tester.had_auth_header = true;
+        }
+    }
+
+    struct aws_byte_cursor body = aws_byte_cursor_from_c_str(s_create_session_doc);
+    options->on_response_body((struct aws_http_stream *)1, &body, options->user_data);
+    options->on_complete((struct aws_http_stream *)1, AWS_ERROR_SUCCESS, options->user_data);
+
+    return (struct aws_http_stream *)1;
+}
+
+static int s_aws_http_stream_get_incoming_response_status_mock(
+    const struct aws_http_stream *stream,
+    int *out_status_code) {
+
+    (void)stream;
+
+    *out_status_code = 200;
+
+    return AWS_OP_SUCCESS;
+}
+
+static void s_aws_http_stream_release_mock(struct aws_http_stream *stream) {
+    (void)stream;
+}
+
+static void s_aws_http_connection_close_mock(struct aws_http_connection *connection) {
+    (void)connection;
+}
+
+static struct aws_credentials_provider_system_vtable s_mock_function_table = {
+    .aws_http_connection_manager_new = s_aws_http_connection_manager_new_mock,
+    .aws_http_connection_manager_release = s_aws_http_connection_manager_release_mock,
+    .aws_http_connection_manager_acquire_connection = s_aws_http_connection_manager_acquire_connection_mock,
+    .aws_http_connection_manager_release_connection = s_aws_http_connection_manager_release_connection_mock,
+    .aws_http_connection_make_request = s_aws_http_connection_make_request_mock,
+    .aws_http_stream_get_incoming_response_status = s_aws_http_stream_get_incoming_response_status_mock,
+    .aws_http_stream_release = s_aws_http_stream_release_mock,
+    .aws_http_connection_close = s_aws_http_connection_close_mock};
+
+/* the mocks and the signer both run synchronously, so every callback has run by the time a query returns */
+static void s_get_credentials_callback(struct aws_credentials *credentials, void *user_data) {
+    (void)user_data;
+
+    ++s_tester.callback_count;
+    if (credentials != NULL) {
+        ++s_tester.credentials_count;
+        aws_credentials_destroy(s_tester.credentials);
+        s_tester.credentials = aws_credentials_new_copy(s_tester.allocator, credentials);
+    }
+}
+
+static void s_on_provider_shutdown(void *user_data) {
+    (void)user_data;
+
+    s_tester.has_provider_shut_down = true;
+    s_tester.managers_shut_down_at_provider_shutdown = s_tester.manager_shutdown_count;
+}
+
+static void s_aws_s3_session_tester_init(struct aws_allocator *allocator) {
+    AWS_ZERO_STRUCT(s_tester);
+    s_tester.allocator = allocator;
+}
+
+static void s_aws_s3_session_tester_clean_up(void) {
+    aws_credentials_destroy(s_tester.credentials);
+    aws_byte_buf_clean_up(&s_tester.request_path);
+    aws_byte_buf_clean_up(&s_tester.host_header);
+}
+
+static struct aws_byte_cursor s_access_key_cur = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("accessKey12345");
+static struct aws_byte_cursor s_secret_key_cur = AWS_BYTE_CUR_INIT_FROM_STRING_LITERAL("secretKey12345");
+
+static struct aws_s3_session_cache *s_new_session_cache(
+    struct aws_allocator *allocator,
+    size_t max_sessions,
+    struct aws_credentials_provider **out_base_provider) {
+
+    struct aws_credentials_provider_static_options static_options = {
+        .access_key_id = s_access_key_cur,
+        .secret_access_key = s_secret_key_cur,
+    };
+    *out_base_provider = aws_credentials_provider_new_static(allocator, &static_options);
+    if (*out_base_provider == NULL) {
+        return NULL;
+    }
+
+    struct aws_s3_session_cache_options options = {
+        .creds_provider = *out_base_provider,
+        .region = aws_byte_cursor_from_c_str("us-west-2"),
+        .max_sessions = max_sessions,
+        .clock_fn = mock_aws_get_time,
+        .function_table = &s_mock_function_table,
+    };
+
+    return aws_s3_session_cache_new(allocator, &options);
+}
+
+static int s_credentials_provider_s3_session_caches_per_bucket_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+    s_aws_s3_session_tester_init(allocator);
+    mock_aws_set_time(S3_SESSION_TEST_TIME_SECS * S3_SESSION_TEST_NANOS_PER_SEC);
+
+    struct aws_credentials_provider *base_provider = NULL;
+    struct aws_s3_session_cache *session_cache = s_new_session_cache(allocator, 0, &base_provider);
+    ASSERT_NOT_NULL(session_cache);
+
+    struct aws_credentials_provider_s3_session_options provider_options = {
+        .session_cache = session_cache,
+        .bucket = aws_byte_cursor_from_c_str(s_bucket_one),
+    };
+    struct aws_credentials_provider *provider = aws_credentials_provider_new_s3_session(allocator, &provider_options);
+    ASSERT_NOT_NULL(provider);
+
+    /* concurrent queries for a bucket without a session share one CreateSession call */
+    s_tester.hold_connections = true;
+    ASSERT_SUCCESS(aws_credentials_provider_get_credentials(provider, s_get_credentials_callback, NULL));
+    ASSERT_SUCCESS(aws_credentials_provider_get_credentials(provider, s_get_credentials_callback, NULL));
+    ASSERT_UINT_EQUALS(0, s_tester.callback_count);
+    ASSERT_NOT_NULL(s_tester.held_callback);
+
+    s_tester.hold_connections = false;
+    s_tester.held_callback((struct aws_http_connection *)1, AWS_ERROR_SUCCESS, s_tester.held_user_data);
+
+    ASSERT_UINT_EQUALS(1, s_tester.request_count);
+    ASSERT_UINT_EQUALS(2, s_tester.credentials_count);
+    ASSERT_STR_EQUALS("accessKeyIdResp", aws_string_c_str(s_tester.credentials->access_key_id));
+    ASSERT_STR_EQUALS("secretKeyResp", aws_string_c_str(s_tester.credentials->secret_access_key));
+    ASSERT_STR_EQUALS("sessionTokenResp", aws_string_c_str(s_tester.credentials->session_token));
+
+    const char *expected_path = "/?session";
+    ASSERT_BIN_ARRAYS_EQUALS(
+        expected_path, strlen(expected_path), s_tester.request_path.buffer, s_tester.request_path.len);
+
+    const char *expected_host = "bucket-one--usw2-az1--x-s3.s3express-usw2-az1.us-west-2.amazonaws.com";
+    ASSERT_BIN_ARRAYS_EQUALS(
+        expected_host, strlen(expected_host), s_tester.host_header.buffer, s_tester.host_header.len);
+    ASSERT_TRUE(s_tester.had_auth_header);
+
+    /* later queries are answered from the cache */
+    ASSERT_SUCCESS(aws_credentials_provider_get_credentials(provider, s_get_credentials_callback, NULL));
+    ASSERT_UINT_EQUALS(1, s_tester.request_count);
+    ASSERT_UINT_EQUALS(3, s_tester.credentials_count);
+
+    /* other buckets get their own sessions */
+    ASSERT_SUCCESS(aws_s3_session_cache_get_credentials(
+        session_cache, aws_byte_cursor_from_c_str(s_bucket_two), s_get_credentials_callback, NULL));
+    ASSERT_UINT_EQUALS(2, s_tester.request_count);
+    ASSERT_UINT_EQUALS(4, s_tester.credentials_count);
+
+    expected_host = "bucket-two--usw2-az3--x-s3.s3express-usw2-az3.us-west-2.amazonaws.com";
+    ASSERT_BIN_ARRAYS_EQUALS(
+        expected_host, strlen(expected_host), s_tester.host_header.buffer, s_tester.host_header.len);
+
+    /* without an endpoint suffix, bucket names must identify their zone */
+    ASSERT_SUCCESS(aws_s3_session_cache_get_credentials(
+        session_cache, aws_byte_cursor_from_c_str("plain-bucket"), s_get_credentials_callback, NULL));
+    ASSERT_UINT_EQUALS(2, s_tester.request_count);
+    ASSERT_UINT_EQUALS(5, s_tester.callback_count);
+    ASSERT_UINT_EQUALS(4, s_tester.credentials_count);
+
+    aws_credentials_provider_release(provider);
+    aws_s3_session_cache_release(session_cache);
+    aws_credentials_provider_release(base_provider);
+    s_aws_s3_session_tester_clean_up();
+
+    aws_auth_library_clean_up();
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(credentials_provider_s3_session_caches_per_bucket, s_credentials_provider_s3_session_caches_per_bucket_fn)
+
+static int s_credentials_provider_s3_session_refreshes_before_expiry_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+    s_aws_s3_session_tester_init(allocator);
+    mock_aws_set_time(S3_SESSION_TEST_TIME_SECS * S3_SESSION_TEST_NANOS_PER_SEC);
+
+    struct aws_credentials_provider *base_provider = NULL;
+    struct aws_s3_session_cache *session_cache = s_new_session_cache(allocator, 0, &base_provider);
+    ASSERT_NOT_NULL(session_cache);
+
+    struct aws_byte_cursor bucket = aws_byte_cursor_from_c_str(s_bucket_one);
+
+    ASSERT_SUCCESS(aws_s3_session_cache_get_credentials(session_cache, bucket, s_get_credentials_callback, NULL));
+    ASSERT_UINT_EQUALS(1, s_tester.request_count);
+    ASSERT_UINT_EQUALS(1, s_tester.credentials_count);
+
+    /* outside the refresh-ahead window: cached */
+    mock_aws_set_time((S3_SESSION_TEST_TIME_SECS + 200) * S3_SESSION_TEST_NANOS_PER_SEC);
+    ASSERT_SUCCESS(aws_s3_session_cache_get_credentials(session_cache, bucket, s_get_credentials_callback, NULL));
+    ASSERT_UINT_EQUALS(1, s_tester.request_count);
+    ASSERT_UINT_EQUALS(2, s_tester.credentials_count);
+
+    /* inside it: the cached session is handed out while a replacement is created in the background */
+    s_tester.hold_connections = true;
+    mock_aws_set_time((S3_SESSION_TEST_TIME_SECS + 250) * S3_SESSION_TEST_NANOS_PER_SEC);
+    ASSERT_SUCCESS(aws_s3_session_cache_get_credentials(session_cache, bucket, s_get_credentials_callback, NULL));
+    ASSERT_UINT_EQUALS(3, s_tester.credentials_count);
+    ASSERT_NOT_NULL(s_tester.held_callback);
+
+    /* only one refresh is started */
+    aws_http_connection_manager_on_connection_setup_fn *held_callback = s_tester.held_callback;
+    s_tester.held_callback = NULL;
+    ASSERT_SUCCESS(aws_s3_session_cache_get_credentials(session_cache, bucket, s_get_credentials_callback, NULL));
+    ASSERT_UINT_EQUALS(4, s_tester.credentials_count);
+    ASSERT_NULL(s_tester.held_callback);
+
+    s_tester.hold_connections = false;
+    held_callback((struct aws_http_connection *)1, AWS_ERROR_SUCCESS, s_tester.held_user_data);
+    ASSERT_UINT_EQUALS(2, s_tester.request_count);
+    ASSERT_UINT_EQUALS(4, s_tester.callback_count);
+
+    /* once expired, queries wait for a new session */
+    mock_aws_set_time((S3_SESSION_TEST_TIME_SECS + 301) * S3_SESSION_TEST_NANOS_PER_SEC);
+    ASSERT_SUCCESS(aws_s3_session_cache_get_credentials(session_cache, bucket, s_get_credentials_callback, NULL));
+    ASSERT_UINT_EQUALS(3, s_tester.request_count);
+    ASSERT_UINT_EQUALS(5, s_tester.credentials_count);
+
+    aws_s3_session_cache_release(session_cache);
+    aws_credentials_provider_release(base_provider);
+    s_aws_s3_session_tester_clean_up();
+
+    aws_auth_library_clean_up();
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(
+    credentials_provider_s3_session_refreshes_before_expiry,
+    s_credentials_provider_s3_session_refreshes_before_expiry_fn)
+
+static int s_credentials_provider_s3_session_evicts_least_recently_used_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+    s_aws_s3_session_tester_init(allocator);
+    mock_aws_set_time(S3_SESSION_TEST_TIME_SECS * S3_SESSION_TEST_NANOS_PER_SEC);
+
+    struct aws_credentials_provider *base_provider = NULL;
+    struct aws_s3_session_cache *session_cache = s_new_session_cache(allocator, 2, &base_provider);
+    ASSERT_NOT_NULL(session_cache);
+
+    struct aws_byte_cursor bucket_one = aws_byte_cursor_from_c_str(s_bucket_one);
+    struct aws_byte_cursor bucket_two = aws_byte_cursor_from_c_str(s_bucket_two);
+    struct aws_byte_cursor bucket_three = aws_byte_cursor_from_c_str("bucket-three--usw2-az1--x-s3");
+
+    ASSERT_SUCCESS(aws_s3_session_cache_get_credentials(session_cache, bucket_one, s_get_credentials_callback, NULL));
+    mock_aws_set_time((S3_SESSION_TEST_TIME_SECS + 1) * S3_SESSION_TEST_NANOS_PER_SEC);
+    ASSERT_SUCCESS(aws_s3_session_cache_get_credentials(session_cache, bucket_two, s_get_credentials_callback, NULL));
+    ASSERT_UINT_EQUALS(2, s_tester.request_count);
+
+    /* using bucket one again leaves bucket two as the least recently used */
+    mock_aws_set_time((S3_SESSION_TEST_TIME_SECS + 2) * S3_SESSION_TEST_NANOS_PER_SEC);
+    ASSERT_SUCCESS(aws_s3_session_cache_get_credentials(session_cache, bucket_one, s_get_credentials_callback, NULL));
+    ASSERT_UINT_EQUALS(2, s_tester.request_count);
+
+    /* a third bucket doesn't fit, so bucket two's session and connection manager go */
+    mock_aws_set_time((S3_SESSION_TEST_TIME_SECS + 3) * S3_SESSION_TEST_NANOS_PER_SEC);
+    ASSERT_SUCCESS(aws_s3_session_cache_get_credentials(session_cache, bucket_three, s_get_credentials_callback, NULL));
+    ASSERT_UINT_EQUALS(3, s_tester.request_count);
+    ASSERT_UINT_EQUALS(3, s_tester.manager_count);
+    ASSERT_UINT_EQUALS(1, s_tester.manager_shutdown_count);
+
+    mock_aws_set_time((S3_SESSION_TEST_TIME_SECS + 4) * S3_SESSION_TEST_NANOS_PER_SEC);
+    ASSERT_SUCCESS(aws_s3_session_cache_get_credentials(session_cache, bucket_one, s_get_credentials_callback, NULL));
+    ASSERT_UINT_EQUALS(3, s_tester.request_count);
+
+    /* bucket two needs a new session, which in turn evicts bucket three */
+    mock_aws_set_time((S3_SESSION_TEST_TIME_SECS + 5) * S3_SESSION_TEST_NANOS_PER_SEC);
+    ASSERT_SUCCESS(aws_s3_session_cache_get_credentials(session_cache, bucket_two, s_get_credentials_callback, NULL));
+    ASSERT_UINT_EQUALS(4, s_tester.request_count);
+    ASSERT_UINT_EQUALS(2, s_tester.manager_shutdown_count);
+    ASSERT_UINT_EQUALS(6, s_tester.credentials_count);
+
+    /* a provider holding the last reference finishes shutting down after the remaining connection managers */
+    struct aws_credentials_provider_s3_session_options provider_options = {
+        .shutdown_options =
+            {
+                .shutdown_callback = s_on_provider_shutdown,
+                .shutdown_user_data = NULL,
+            },
+        .session_cache = session_cache,
+        .bucket = bucket_one,
+    };
+    struct aws_credentials_provider *provider = aws_credentials_provider_new_s3_session(allocator, &provider_options);
+    ASSERT_NOT_NULL(provider);
+
+    aws_s3_session_cache_release(session_cache);
+    ASSERT_UINT_EQUALS(2, s_tester.manager_shutdown_count);
+
+    aws_credentials_provider_release(provider);
+    ASSERT_TRUE(s_tester.has_provider_shut_down);
+    ASSERT_UINT_EQUALS(4, s_tester.manager_shutdown_count);
+    ASSERT_UINT_EQUALS(4, s_tester.managers_shut_down_at_provider_shutdown);
+
+    aws_credentials_provider_release(base_provider);
+    s_aws_s3_session_tester_clean_up();
+
+    aws_auth_library_clean_up();
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(
+    credentials_provider_s3_session_evicts_least_recently_used,
+    s_credentials_provider_s3_session_evicts_least_recently_used_fn)
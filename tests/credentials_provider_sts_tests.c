@@ -28,6 +28,7 @@
 #include <aws/auth/private/credentials_utils.h>
 #include <aws/testing/aws_test_harness.h>
 
+#include "credentials_provider_utils.h"
 #include "shared_credentials_test_definitions.h"
 
 struct aws_mock_sts_tester {
@@ -41,6 +42,12 @@ struct aws_mock_sts_tester {
     int mock_response_code;
     struct aws_byte_buf mock_body;
 
+    /* requests to this host get a 503 instead of mock_response_code */
+    struct aws_byte_cursor failing_host;
+    int current_response_code;
+    size_t request_count;
+    size_t acquire_count;
+
     struct aws_mutex lock;
     struct aws_condition_variable signal;
 
@@ -75,6 +82,8 @@ static void s_aws_http_connection_manager_acquire_connection_mock(
     (void)callback;
     (void)user_data;
 
+    ++s_tester.acquire_count;
+
     if (!s_tester.fail_connection) {
         callback((struct aws_http_connection *)1, AWS_OP_SUCCESS, user_data);
     } else {
@@ -128,6 +137,13 @@ static struct aws_http_stream *s_aws_http_connection_make_request_mock(
     (void)client_connection;
     (void)options;
 
+    /* the provider may fail over and send more than one request */
+    aws_byte_buf_clean_up(&s_tester.request_path);
+    aws_byte_buf_clean_up(&s_tester.method);
+    aws_byte_buf_clean_up(&s_tester.host_header);
+    aws_byte_buf_clean_up(&s_tester.request_body);
+    ++s_tester.request_count;
+
     struct aws_byte_cursor path;
     AWS_ZERO_STRUCT(path);
     aws_http_message_get_request_path(options->request, &path);
@@ -162,7 +178,13 @@ static struct aws_http_stream *s_aws_http_connection_make_request_mock(
     aws_byte_buf_init(&s_tester.request_body, s_tester.allocator, (size_t)body_len);
     aws_input_stream_read(input_stream, &s_tester.request_body);
 
-    s_invoke_mock_request_callbacks(options, s_tester.mock_response_code == 200);
+    s_tester.current_response_code = s_tester.mock_response_code;
+    struct aws_byte_cursor host_header = aws_byte_cursor_from_buf(&s_tester.host_header);
+    if (s_tester.failing_host.len > 0 && aws_byte_cursor_eq(&host_header, &s_tester.failing_host)) {
+        s_tester.current_response_code = 503;
+    }
+
+    s_invoke_mock_request_callbacks(options, s_tester.current_response_code == 200);
 
     return (struct aws_http_stream *)1;
 }
@@ -172,7 +194,7 @@ static int s_aws_http_stream_get_incoming_response_status_mock(
     int *out_status_code) {
     (void)stream;
 
-    *out_status_code = s_tester.mock_response_code;
+    *out_status_code = s_tester.current_response_code;
 
     return AWS_OP_SUCCESS;
 }
@@ -560,6 +582,178 @@ AWS_TEST_CASE(
     credentials_provider_sts_direct_config_service_fails,
     s_credentials_provider_sts_direct_config_service_fails_fn)
 
+static int s_credentials_provider_sts_regional_failover_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+    s_aws_sts_tester_init(allocator);
+
+    struct aws_event_loop_group el_group;
+    aws_event_loop_group_default_init(&el_group, allocator, 0);
+
+    struct aws_host_resolver resolver;
+    aws_host_resolver_init_default(&resolver, allocator, 10, &el_group);
+
+    struct aws_client_bootstrap_options bootstrap_options = {
+        .event_loop_group = &el_group,
+        .host_resolver = &resolver,
+    };
+    struct aws_client_bootstrap *bootstrap = aws_client_bootstrap_new(allocator, &bootstrap_options);
+
+    struct aws_credentials_provider_static_options static_options = {
+        .access_key_id = s_access_key_cur,
+        .secret_access_key = s_secret_key_cur,
+        .session_token = s_session_token_cur,
+    };
+    struct aws_credentials_provider *static_provider = aws_credentials_provider_new_static(allocator, &static_options);
+
+    struct aws_credentials_provider_sts_endpoint endpoints[] = {
+        {.region = aws_byte_cursor_from_c_str("eu-west-1")},
+        {.region = aws_byte_cursor_from_c_str("ap-southeast-2")},
+    };
+
+    struct aws_credentials_provider_sts_options options = {
+        .creds_provider = static_provider,
+        .bootstrap = bootstrap,
+        .role_arn = s_role_arn_cur,
+        .session_name = s_session_name_cur,
+        .duration_seconds = 0,
+        .endpoints = endpoints,
+        .endpoint_count = AWS_ARRAY_SIZE(endpoints),
+        .function_table = &s_mock_function_table,
+    };
+
+    s_tester.mock_body = aws_byte_buf_from_c_str(success_creds_doc);
+    s_tester.mock_response_code = 200;
+    s_tester.failing_host = aws_byte_cursor_from_c_str("sts.eu-west-1.amazonaws.com");
+
+    /* not cached, so that the second fetch goes back to STS */
+    struct aws_credentials_provider *sts_provider = aws_credentials_provider_new_sts(allocator, &options);
+
+    aws_credentials_provider_get_credentials(sts_provider, s_get_credentials_callback, NULL);
+
+    s_aws_wait_for_credentials_result();
+
+    ASSERT_NOT_NULL(s_tester.credentials);
+    ASSERT_STR_EQUALS("accessKeyIdResp", aws_string_c_str(s_tester.credentials->access_key_id));
+    ASSERT_UINT_EQUALS(2, s_tester.request_count);
+
+    const char *expected_host_header = "sts.ap-southeast-2.amazonaws.com";
+    ASSERT_BIN_ARRAYS_EQUALS(
+        expected_host_header, strlen(expected_host_header), s_tester.host_header.buffer, s_tester.host_header.len);
+
+    /* the failed endpoint is now quarantined, so the next fetch goes straight to the healthy one */
+    aws_credentials_destroy(s_tester.credentials);
+    s_tester.credentials = NULL;
+    s_tester.has_received_credentials_callback = false;
+
+    aws_credentials_provider_get_credentials(sts_provider, s_get_credentials_callback, NULL);
+
+    s_aws_wait_for_credentials_result();
+
+    ASSERT_NOT_NULL(s_tester.credentials);
+    ASSERT_UINT_EQUALS(3, s_tester.request_count);
+    ASSERT_BIN_ARRAYS_EQUALS(
+        expected_host_header, strlen(expected_host_header), s_tester.host_header.buffer, s_tester.host_header.len);
+
+    aws_credentials_provider_release(sts_provider);
+    aws_credentials_provider_release(static_provider);
+    s_aws_sts_tester_cleanup();
+
+    aws_client_bootstrap_release(bootstrap);
+    aws_host_resolver_clean_up(&resolver);
+    aws_event_loop_group_clean_up(&el_group);
+
+    aws_auth_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(credentials_provider_sts_regional_failover, s_credentials_provider_sts_regional_failover_fn)
+
+static int s_credentials_provider_sts_signs_while_connecting_fn(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+    s_aws_sts_tester_init(allocator);
+
+    struct aws_event_loop_group el_group;
+    aws_event_loop_group_default_init(&el_group, allocator, 0);
+
+    struct aws_host_resolver resolver;
+    aws_host_resolver_init_default(&resolver, allocator, 10, &el_group);
+
+    struct aws_client_bootstrap_options bootstrap_options = {
+        .event_loop_group = &el_group,
+        .host_resolver = &resolver,
+    };
+    struct aws_client_bootstrap *bootstrap = aws_client_bootstrap_new(allocator, &bootstrap_options);
+
+    struct aws_credentials *source_credentials =
+        aws_credentials_new_from_cursors(allocator, &s_access_key_cur, &s_secret_key_cur, &s_session_token_cur);
+    ASSERT_NOT_NULL(source_credentials);
+
+    struct get_credentials_mock_result results[] = {
+        {.credentials = source_credentials},
+    };
+
+    /* the source credentials, and so signing, only complete when the controller says so */
+    struct aws_credentials_provider_mock_async_controller controller;
+    aws_credentials_provider_mock_async_controller_init(&controller);
+
+    struct aws_credentials_provider *source_provider =
+        aws_credentials_provider_new_mock_async(allocator, results, AWS_ARRAY_SIZE(results), &controller, NULL);
+    ASSERT_NOT_NULL(source_provider);
+
+    struct aws_credentials_provider_sts_options options = {
+        .creds_provider = source_provider,
+        .bootstrap = bootstrap,
+        .role_arn = s_role_arn_cur,
+        .session_name = s_session_name_cur,
+        .duration_seconds = 0,
+        .function_table = &s_mock_function_table,
+    };
+
+    s_tester.mock_body = aws_byte_buf_from_c_str(success_creds_doc);
+    s_tester.mock_response_code = 200;
+
+    struct aws_credentials_provider *sts_provider = aws_credentials_provider_new_sts(allocator, &options);
+    ASSERT_NOT_NULL(sts_provider);
+
+    aws_credentials_provider_get_credentials(sts_provider, s_get_credentials_callback, NULL);
+
+    /* the connection is acquired while signing is still waiting on the source credentials */
+    ASSERT_UINT_EQUALS(1, s_tester.acquire_count);
+    ASSERT_UINT_EQUALS(0, s_tester.request_count);
+
+    aws_mutex_lock(&controller.sync);
+    controller.should_fire_callback = true;
+    aws_condition_variable_notify_one(&controller.signal);
+    aws_mutex_unlock(&controller.sync);
+
+    s_aws_wait_for_credentials_result();
+
+    ASSERT_NOT_NULL(s_tester.credentials);
+    ASSERT_STR_EQUALS("accessKeyIdResp", aws_string_c_str(s_tester.credentials->access_key_id));
+    ASSERT_UINT_EQUALS(1, s_tester.acquire_count);
+    ASSERT_UINT_EQUALS(1, s_tester.request_count);
+    ASSERT_TRUE(s_tester.had_auth_header);
+
+    aws_credentials_provider_release(sts_provider);
+    aws_credentials_provider_release(source_provider);
+    aws_credentials_provider_mock_async_controller_clean_up(&controller);
+    aws_credentials_destroy(source_credentials);
+    s_aws_sts_tester_cleanup();
+
+    aws_client_bootstrap_release(bootstrap);
+    aws_host_resolver_clean_up(&resolver);
+    aws_event_loop_group_clean_up(&el_group);
+
+    aws_auth_library_clean_up();
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(credentials_provider_sts_signs_while_connecting, s_credentials_provider_sts_signs_while_connecting_fn)
+
 static const char *s_soure_profile_config_file = "[default]\n"
                                                  "aws_access_key_id=BLAHBLAH\n"
                                                  "aws_secret_access_key=BLAHBLAHBLAH\n"
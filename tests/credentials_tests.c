@@ -35,6 +35,7 @@
 AWS_STATIC_STRING_FROM_LITERAL(s_access_key_id_test_value, "My Access Key");
 AWS_STATIC_STRING_FROM_LITERAL(s_secret_access_key_test_value, "SekritKey");
 AWS_STATIC_STRING_FROM_LITERAL(s_session_token_test_value, "Some Session Token");
+AWS_STATIC_STRING_FROM_LITERAL(s_uri_encoded_session_token_test_value, "Some%20Session%20Token");
 
 static int s_credentials_create_destroy_test(struct aws_allocator *allocator, void *ctx) {
     (void)ctx;
@@ -45,6 +46,15 @@ static int s_credentials_create_destroy_test(struct aws_allocator *allocator, vo
     ASSERT_TRUE(aws_string_compare(credentials->access_key_id, s_access_key_id_test_value) == 0);
     ASSERT_TRUE(aws_string_compare(credentials->secret_access_key, s_secret_access_key_test_value) == 0);
     ASSERT_TRUE(aws_string_compare(credentials->session_token, s_session_token_test_value) == 0);
+    ASSERT_TRUE(
+        aws_string_compare(credentials->uri_encoded_session_token, s_uri_encoded_session_token_test_value) == 0);
+
+    aws_credentials_destroy(credentials);
+
+    /* no session token, nothing to encode */
+    credentials = aws_credentials_new(allocator, s_access_key_id_test_value, s_secret_access_key_test_value, NULL);
+    ASSERT_NULL(credentials->session_token);
+    ASSERT_NULL(credentials->uri_encoded_session_token);
 
     aws_credentials_destroy(credentials);
 
@@ -71,6 +81,10 @@ static int s_credentials_copy_test(struct aws_allocator *allocator, void *ctx) {
     ASSERT_TRUE(aws_string_compare(credentials->session_token, s_session_token_test_value) == 0);
     ASSERT_TRUE(credentials->session_token != source->session_token);
 
+    ASSERT_TRUE(
+        aws_string_compare(credentials->uri_encoded_session_token, s_uri_encoded_session_token_test_value) == 0);
+    ASSERT_TRUE(credentials->uri_encoded_session_token != source->uri_encoded_session_token);
+
     aws_credentials_destroy(credentials);
     aws_credentials_destroy(source);
 
@@ -771,6 +785,53 @@ static int s_profile_credentials_provider_nondefault_test(struct aws_allocator *
 
 AWS_TEST_CASE(profile_credentials_provider_nondefault_test, s_profile_credentials_provider_nondefault_test);
 
+static void s_release_provider_in_callback(struct aws_credentials *credentials, void *user_data) {
+    struct aws_credentials_provider *provider = user_data;
+
+    (void)credentials;
+
+    /* drops the last reference from the provider's own io thread */
+    aws_credentials_provider_release(provider);
+}
+
+static int s_profile_credentials_provider_release_in_callback_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    s_aws_credentials_shutdown_checker_init();
+
+    aws_unset_environment_value(s_default_profile_env_variable_name);
+    ASSERT_SUCCESS(aws_create_profile_file(s_config_file_name, s_config_contents));
+    ASSERT_SUCCESS(aws_create_profile_file(s_credentials_file_name, s_credentials_contents));
+
+    struct aws_credentials_provider_profile_options options = {
+        .config_file_name_override = aws_byte_cursor_from_string(s_config_file_name),
+        .credentials_file_name_override = aws_byte_cursor_from_string(s_credentials_file_name),
+        .shutdown_options =
+            {
+                .shutdown_callback = s_on_shutdown_complete,
+                .shutdown_user_data = NULL,
+            },
+    };
+
+    struct aws_credentials_provider *provider = aws_credentials_provider_new_profile(allocator, &options);
+    ASSERT_NOT_NULL(provider);
+
+    ASSERT_SUCCESS(aws_credentials_provider_get_credentials(provider, s_release_provider_in_callback, provider));
+
+    s_aws_wait_for_provider_shutdown_callback();
+
+    s_aws_credentials_shutdown_checker_clean_up();
+
+    remove(aws_string_c_str(s_config_file_name));
+    remove(aws_string_c_str(s_credentials_file_name));
+
+    return 0;
+}
+
+AWS_TEST_CASE(
+    profile_credentials_provider_release_in_callback_test,
+    s_profile_credentials_provider_release_in_callback_test);
+
 static int s_profile_credentials_provider_environment_test(struct aws_allocator *allocator, void *ctx) {
     (void)ctx;
 
@@ -947,6 +1008,63 @@ static int s_credentials_provider_null_chain_test(struct aws_allocator *allocato
 
 AWS_TEST_CASE(credentials_provider_null_chain_test, s_credentials_provider_null_chain_test);
 
+static int s_lazy_factory_call_count = 0;
+
+static struct aws_credentials_provider *s_new_lazy_static_provider(
+    struct aws_allocator *allocator,
+    void *factory_user_data) {
+
+    (void)factory_user_data;
+
+    ++s_lazy_factory_call_count;
+
+    struct aws_credentials_provider_static_options options = {
+        .access_key_id = aws_byte_cursor_from_string(s_access_key_id_value2),
+        .secret_access_key = aws_byte_cursor_from_string(s_secret_access_key_value2),
+        .session_token = aws_byte_cursor_from_string(s_session_token_value2),
+    };
+
+    return aws_credentials_provider_new_static(allocator, &options);
+}
+
+static int s_credentials_provider_lazy_in_chain_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    struct aws_credentials_provider_shutdown_options null_options;
+    AWS_ZERO_STRUCT(null_options);
+
+    struct aws_credentials_provider_lazy_options lazy_options = {
+        .factory = s_new_lazy_static_provider,
+    };
+
+    struct aws_credentials_provider_static_options options = {
+        .access_key_id = aws_byte_cursor_from_string(s_access_key_id_value1),
+        .secret_access_key = aws_byte_cursor_from_string(s_secret_access_key_value1),
+        .session_token = aws_byte_cursor_from_string(s_session_token_value1),
+    };
+
+    /* never reached, so never created */
+    s_lazy_factory_call_count = 0;
+    ASSERT_SUCCESS(s_do_provider_chain_test(
+        allocator,
+        aws_credentials_provider_new_static(allocator, &options),
+        aws_credentials_provider_new_lazy(allocator, &lazy_options),
+        s_verify_first_credentials_callback));
+    ASSERT_INT_EQUALS(0, s_lazy_factory_call_count);
+
+    /* created when the chain falls through to it */
+    ASSERT_SUCCESS(s_do_provider_chain_test(
+        allocator,
+        aws_credentials_provider_new_null(allocator, &null_options),
+        aws_credentials_provider_new_lazy(allocator, &lazy_options),
+        s_verify_second_credentials_callback));
+    ASSERT_INT_EQUALS(1, s_lazy_factory_call_count);
+
+    return 0;
+}
+
+AWS_TEST_CASE(credentials_provider_lazy_in_chain_test, s_credentials_provider_lazy_in_chain_test);
+
 static int s_credentials_provider_default_basic_test(struct aws_allocator *allocator, void *ctx) {
     (void)ctx;
 
@@ -0,0 +1,249 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/testing/aws_test_harness.h>
+
+#include <aws/auth/credentials.h>
+#include <aws/auth/multipart_upload_signer.h>
+#include <aws/auth/private/aws_signing.h>
+#include <aws/auth/signable.h>
+#include <aws/auth/signing_result.h>
+#include <aws/common/mutex.h>
+#include <aws/common/string.h>
+#include <aws/io/stream.h>
+
+#include "credentials_provider_utils.h"
+#include "test_signable.h"
+
+#define MULTIPART_TEST_TIME_SECS 1440938160ULL
+#define MULTIPART_TEST_NANOS_PER_SEC 1000000000ULL
+#define MULTIPART_TEST_PART_COUNT 6
+
+AWS_STATIC_STRING_FROM_LITERAL(s_multipart_access_key_id, "AKIDEXAMPLE");
+AWS_STATIC_STRING_FROM_LITERAL(s_multipart_secret_access_key, "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY");
+AWS_STATIC_STRING_FROM_LITERAL(
+    s_multipart_session_token,
+    "AQoDYXdzEPT//////////wEXAMPLEtc764bNrC9SAPBSM22wDOk4x4HIZ8j4FZTwdQW");
+
+AWS_STATIC_STRING_FROM_LITERAL(
+    s_multipart_part_one_path,
+    "/test.txt?partNumber=1&uploadId=VXBsb2FkIElEIGZvciA2aWWpbmcncyBteS1tb3ZpZS5tMnRzIHVwbG9hZA");
+
+static const char *s_multipart_host = "examplebucket.s3.amazonaws.com";
+
+/* sizes either side of the signer's read size, and an empty part */
+static const size_t s_part_sizes[MULTIPART_TEST_PART_COUNT] = {0, 1, 1000, 65536, 65537, 200000};
+
+struct multipart_test_results {
+    struct aws_allocator *allocator;
+    struct aws_mutex lock;
+    size_t signed_count;
+    int error_codes[MULTIPART_TEST_PART_COUNT];
+    struct aws_byte_buf authorizations[MULTIPART_TEST_PART_COUNT];
+};
+
+static struct aws_byte_cursor s_find_result_header(struct aws_signing_result *result, const struct aws_string *name) {
+    struct aws_byte_cursor value;
+    AWS_ZERO_STRUCT(value);
+
+    struct aws_array_list *headers = NULL;
+    if (aws_signing_result_get_property_list(result, g_aws_http_headers_property_list_name, &headers)) {
+        return value;
+    }
+
+    struct aws_byte_cursor name_cursor = aws_byte_cursor_from_string(name);
+    for (size_t i = 0; i < aws_array_list_length(headers); ++i) {
+        struct aws_signing_result_property pair;
+        aws_array_list_get_at(headers, &pair, i);
+
+        struct aws_byte_cursor pair_name = aws_byte_cursor_from_string(pair.name);
+        if (aws_byte_cursor_eq_ignore_case(&pair_name, &name_cursor)) {
+            value = aws_byte_cursor_from_string(pair.value);
+        }
+    }
+
+    return value;
+}
+
+static void s_on_part_signed(uint32_t part_number, struct aws_signing_result *result, int error_code, void *user_data) {
+    struct multipart_test_results *results = user_data;
+    size_t index = part_number - 1;
+
+    aws_mutex_lock(&results->lock);
+
+    results->error_codes[index] = error_code;
+    if (result != NULL) {
+        struct aws_byte_buf *authorization = &results->authorizations[index];
+        struct aws_byte_cursor value = s_find_result_header(result, g_aws_signing_authorization_header_name);
+        if (aws_byte_buf_init(authorization, results->allocator, value.len) == AWS_OP_SUCCESS) {
+            aws_byte_buf_append(authorization, &value);
+        }
+    }
+    ++results->signed_count;
+
+    aws_mutex_unlock(&results->lock);
+}
+
+/* signs the same UploadPart request the ordinary way */
+static int s_sign_part_with_full_signer(
+    struct aws_allocator *allocator,
+    struct aws_multipart_upload_signer *signer,
+    struct aws_credentials *credentials,
+    uint32_t part_number,
+    struct aws_byte_cursor body,
+    struct aws_byte_buf *authorization) {
+
+    struct aws_byte_buf uri;
+    ASSERT_SUCCESS(aws_byte_buf_init(&uri, allocator, 128));
+    struct aws_byte_cursor scheme_and_host = aws_byte_cursor_from_c_str("https://examplebucket.s3.amazonaws.com");
+    ASSERT_SUCCESS(aws_byte_buf_append_dynamic(&uri, &scheme_and_host));
+    ASSERT_SUCCESS(aws_multipart_upload_signer_append_part_path(signer, part_number, &uri));
+
+    struct aws_byte_cursor method = aws_byte_cursor_from_c_str("PUT");
+    struct aws_byte_cursor uri_cursor = aws_byte_cursor_from_buf(&uri);
+    struct aws_signable_property_list_pair headers[] = {
+        {.name = aws_byte_cursor_from_c_str("Host"), .value = aws_byte_cursor_from_c_str(s_multipart_host)},
+    };
+
+    struct aws_input_stream *body_stream = aws_input_stream_new_from_cursor(allocator, &body);
+    ASSERT_NOT_NULL(body_stream);
+
+    struct aws_signable *signable =
+        aws_signable_new_test(allocator, &method, &uri_cursor, headers, AWS_ARRAY_SIZE(headers), body_stream);
+    ASSERT_NOT_NULL(signable);
+
+    struct aws_signing_config_aws config = {
+        .config_type = AWS_SIGNING_CONFIG_AWS,
+        .algorithm = AWS_SIGNING_ALGORITHM_SIG_V4_HEADER,
+        .region = aws_byte_cursor_from_c_str("us-east-1"),
+        .service = aws_byte_cursor_from_c_str("s3"),
+        .body_signing_type = AWS_BODY_SIGNING_ON,
+    };
+    aws_date_time_init_epoch_secs(&config.date, (double)MULTIPART_TEST_TIME_SECS);
+
+    struct aws_signing_state_aws *signing_state = aws_signing_state_new(allocator, &config, signable, NULL, NULL);
+    ASSERT_NOT_NULL(signing_state);
+    signing_state->credentials = credentials;
+
+    ASSERT_SUCCESS(aws_signing_build_canonical_request(signing_state));
+    ASSERT_SUCCESS(aws_signing_build_string_to_sign(signing_state));
+    ASSERT_SUCCESS(aws_signing_build_authorization_value(signing_state));
+
+    struct aws_byte_cursor value =
+        s_find_result_header(&signing_state->result, g_aws_signing_authorization_header_name);
+    ASSERT_SUCCESS(aws_byte_buf_init(authorization, allocator, value.len));
+    ASSERT_SUCCESS(aws_byte_buf_append(authorization, &value));
+
+    aws_signing_state_destroy(signing_state);
+    aws_signable_destroy(signable);
+    aws_input_stream_destroy(body_stream);
+    aws_byte_buf_clean_up(&uri);
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_multipart_upload_signer_matches_full_signer_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    mock_aws_set_time(MULTIPART_TEST_TIME_SECS * MULTIPART_TEST_NANOS_PER_SEC);
+
+    struct aws_credentials *credentials = aws_credentials_new(
+        allocator, s_multipart_access_key_id, s_multipart_secret_access_key, s_multipart_session_token);
+    ASSERT_NOT_NULL(credentials);
+
+    struct aws_multipart_upload_signer_options options = {
+        .credentials = credentials,
+        .region = aws_byte_cursor_from_c_str("us-east-1"),
+        .host = aws_byte_cursor_from_c_str(s_multipart_host),
+        .path = aws_byte_cursor_from_c_str("/test.txt"),
+        .upload_id = aws_byte_cursor_from_c_str("VXBsb2FkIElEIGZvciA2aWWpbmcncyBteS1tb3ZpZS5tMnRzIHVwbG9hZA"),
+        .thread_count = 3,
+        .clock_fn = mock_aws_get_time,
+    };
+
+    struct aws_multipart_upload_signer *signer = aws_multipart_upload_signer_new(allocator, &options);
+    ASSERT_NOT_NULL(signer);
+
+    struct aws_byte_buf payload;
+    ASSERT_SUCCESS(aws_byte_buf_init(&payload, allocator, s_part_sizes[MULTIPART_TEST_PART_COUNT - 1]));
+    for (size_t i = 0; i < payload.capacity; ++i) {
+        payload.buffer[i] = (uint8_t)(i * 13 + 7);
+    }
+    payload.len = payload.capacity;
+
+    struct multipart_test_results results;
+    AWS_ZERO_STRUCT(results);
+    results.allocator = allocator;
+    ASSERT_SUCCESS(aws_mutex_init(&results.lock));
+
+    struct aws_input_stream *bodies[MULTIPART_TEST_PART_COUNT];
+    for (size_t i = 0; i < MULTIPART_TEST_PART_COUNT; ++i) {
+        struct aws_byte_cursor body = aws_byte_cursor_from_array(payload.buffer, s_part_sizes[i]);
+        bodies[i] = aws_input_stream_new_from_cursor(allocator, &body);
+        ASSERT_NOT_NULL(bodies[i]);
+
+        ASSERT_SUCCESS(
+            aws_multipart_upload_signer_sign_part(signer, (uint32_t)(i + 1), bodies[i], s_on_part_signed, &results));
+    }
+
+    /* part numbers are bounded */
+    ASSERT_FAILS(aws_multipart_upload_signer_sign_part(signer, 0, NULL, s_on_part_signed, &results));
+    ASSERT_FAILS(aws_multipart_upload_signer_sign_part(
+        signer, AWS_MULTIPART_UPLOAD_MAX_PART_NUMBER + 1, NULL, s_on_part_signed, &results));
+
+    struct aws_byte_buf path;
+    ASSERT_SUCCESS(aws_byte_buf_init(&path, allocator, 128));
+    ASSERT_SUCCESS(aws_multipart_upload_signer_append_part_path(signer, 1, &path));
+    struct aws_byte_cursor path_cursor = aws_byte_cursor_from_buf(&path);
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&path_cursor, aws_string_c_str(s_multipart_part_one_path)));
+    aws_byte_buf_clean_up(&path);
+
+    /* the ordinary signer, fed the same requests, produces the same authorization values */
+    struct aws_byte_buf expected[MULTIPART_TEST_PART_COUNT];
+    for (size_t i = 0; i < MULTIPART_TEST_PART_COUNT; ++i) {
+        struct aws_byte_cursor body = aws_byte_cursor_from_array(payload.buffer, s_part_sizes[i]);
+        ASSERT_SUCCESS(
+            s_sign_part_with_full_signer(allocator, signer, credentials, (uint32_t)(i + 1), body, &expected[i]));
+    }
+
+    /* waits for every queued part */
+    aws_multipart_upload_signer_destroy(signer);
+    ASSERT_UINT_EQUALS(MULTIPART_TEST_PART_COUNT, results.signed_count);
+
+    for (size_t i = 0; i < MULTIPART_TEST_PART_COUNT; ++i) {
+        ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, results.error_codes[i]);
+        ASSERT_BIN_ARRAYS_EQUALS(
+            expected[i].buffer, expected[i].len, results.authorizations[i].buffer, results.authorizations[i].len);
+
+        aws_byte_buf_clean_up(&expected[i]);
+    }
+
+    for (size_t i = 0; i < MULTIPART_TEST_PART_COUNT; ++i) {
+        aws_byte_buf_clean_up(&results.authorizations[i]);
+        aws_input_stream_destroy(bodies[i]);
+    }
+
+    aws_mutex_clean_up(&results.lock);
+    aws_byte_buf_clean_up(&payload);
+    aws_credentials_destroy(credentials);
+
+    aws_auth_library_clean_up();
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(multipart_upload_signer_matches_full_signer_test, s_multipart_upload_signer_matches_full_signer_test);
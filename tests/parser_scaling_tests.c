@@ -0,0 +1,230 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/testing/aws_test_harness.h>
+
+#include <aws/auth/private/aws_profile.h>
+#include <aws/auth/private/xml_parser.h>
+#include <aws/common/string.h>
+
+#include <stdio.h>
+
+/*
+ * Regression checks for the parsers on adversarial input shapes, each parsed at a small size and at
+ * SCALING_TEST_SIZE_FACTOR times that size.  Wall-clock time is too noisy for a unit test, so parser_bench reports
+ * it; the checks here count work instead: bytes allocated by the profile parser, and bytes read by the XML parser's
+ * skip path.  The profile parser used to copy a continued value once per line, and the XML parser used to search the
+ * rest of the document for each skipped node: linear parsing does about SCALING_TEST_SIZE_FACTOR times as much work
+ * for the big input, quadratic parsing SCALING_TEST_SIZE_FACTOR squared times as much.  The bound sits in between,
+ * with room for buffers growing by doubling.
+ */
+#define SCALING_TEST_SIZE_FACTOR 16
+#define SCALING_TEST_MAX_RATIO (SCALING_TEST_SIZE_FACTOR * 4)
+
+/*
+ * Counts the bytes acquired through it.  The release callback isn't told the size, so every block carries its size
+ * in a header.
+ */
+struct counting_block_header {
+    size_t size;
+    /* keeps the user pointer aligned for any type */
+    uint64_t alignment;
+};
+
+static size_t s_acquired_bytes = 0;
+
+static void *s_counting_acquire(struct aws_allocator *allocator, size_t size) {
+    (void)allocator;
+
+    struct counting_block_header *header =
+        aws_mem_acquire(aws_default_allocator(), sizeof(struct counting_block_header) + size);
+    if (header == NULL) {
+        return NULL;
+    }
+
+    header->size = size;
+    s_acquired_bytes += size;
+
+    return header + 1;
+}
+
+static void s_counting_release(struct aws_allocator *allocator, void *ptr) {
+    (void)allocator;
+
+    if (ptr == NULL) {
+        return;
+    }
+
+    aws_mem_release(aws_default_allocator(), (struct counting_block_header *)ptr - 1);
+}
+
+static struct aws_allocator s_counting_allocator = {
+    .mem_acquire = s_counting_acquire,
+    .mem_release = s_counting_release,
+};
+
+typedef int(scaling_input_fn)(struct aws_byte_buf *input, size_t size);
+
+/* parses input and sets out_work to whatever measure of work the parser is checked on */
+typedef int(scaling_parse_fn)(struct aws_allocator *allocator, const struct aws_byte_buf *input, size_t *out_work);
+
+static int s_measure_parse(
+    struct aws_allocator *allocator,
+    scaling_input_fn *make_input,
+    scaling_parse_fn *parse,
+    size_t size,
+    size_t *out_work) {
+
+    struct aws_byte_buf input;
+    ASSERT_SUCCESS(aws_byte_buf_init(&input, allocator, 1024));
+    ASSERT_SUCCESS(make_input(&input, size));
+
+    ASSERT_SUCCESS(parse(allocator, &input, out_work));
+
+    aws_byte_buf_clean_up(&input);
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_check_linear_scaling(
+    struct aws_allocator *allocator,
+    scaling_input_fn *make_input,
+    scaling_parse_fn *parse,
+    size_t small_size) {
+
+    size_t small_work = 0;
+    size_t large_work = 0;
+    ASSERT_SUCCESS(s_measure_parse(allocator, make_input, parse, small_size, &small_work));
+    ASSERT_SUCCESS(s_measure_parse(allocator, make_input, parse, small_size * SCALING_TEST_SIZE_FACTOR, &large_work));
+
+    ASSERT_TRUE(small_work > 0);
+    ASSERT_TRUE(
+        large_work <= small_work * SCALING_TEST_MAX_RATIO,
+        "parse work grew from %zu to %zu for a %dx larger input",
+        small_work,
+        large_work,
+        SCALING_TEST_SIZE_FACTOR);
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_append_c_str(struct aws_byte_buf *input, const char *text) {
+    struct aws_byte_cursor text_cursor = aws_byte_cursor_from_c_str(text);
+    return aws_byte_buf_append_dynamic(input, &text_cursor);
+}
+
+/* one property continued over many lines, like an embedded policy document */
+static int s_make_long_continuation_profile(struct aws_byte_buf *input, size_t line_count) {
+    ASSERT_SUCCESS(s_append_c_str(input, "[profile policy]\npolicy = {\n"));
+    for (size_t i = 0; i < line_count; ++i) {
+        ASSERT_SUCCESS(s_append_c_str(input, "  \"Action\": [\"s3:GetObject\", \"s3:PutObject\"],\n"));
+    }
+    ASSERT_SUCCESS(s_append_c_str(input, "  }\n"));
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_STATIC_STRING_FROM_LITERAL(s_policy_profile_name, "policy");
+AWS_STATIC_STRING_FROM_LITERAL(s_policy_property_name, "policy");
+
+/* the work is the bytes allocated while parsing */
+static int s_parse_profile(struct aws_allocator *allocator, const struct aws_byte_buf *input, size_t *out_work) {
+    (void)allocator;
+
+    s_acquired_bytes = 0;
+
+    struct aws_profile_collection *profiles =
+        aws_profile_collection_new_from_buffer(&s_counting_allocator, input, AWS_PST_CONFIG);
+    ASSERT_NOT_NULL(profiles);
+
+    *out_work = s_acquired_bytes;
+
+    struct aws_profile *profile = aws_profile_collection_get_profile(profiles, s_policy_profile_name);
+    ASSERT_NOT_NULL(profile);
+    struct aws_profile_property *property = aws_profile_get_property(profile, s_policy_property_name);
+    ASSERT_NOT_NULL(property);
+    ASSERT_TRUE(property->value->len > input->len / 2);
+
+    aws_profile_collection_destroy(profiles);
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_profile_long_continuation_scaling_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    return s_check_linear_scaling(allocator, s_make_long_continuation_profile, s_parse_profile, 2000);
+}
+
+AWS_TEST_CASE(profile_long_continuation_scaling_test, s_profile_long_continuation_scaling_test);
+
+/* many differently-named siblings that the caller skips over */
+static int s_make_wide_xml(struct aws_byte_buf *input, size_t child_count) {
+    ASSERT_SUCCESS(s_append_c_str(input, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<Root>\n"));
+    for (size_t i = 0; i < child_count; ++i) {
+        char child[64];
+        snprintf(child, sizeof(child), "  <Child%zu>value</Child%zu>\n", i, i);
+        ASSERT_SUCCESS(s_append_c_str(input, child));
+    }
+    ASSERT_SUCCESS(s_append_c_str(input, "</Root>"));
+
+    return AWS_OP_SUCCESS;
+}
+
+static bool s_skip_child(struct aws_xml_parser *parser, struct aws_xml_node *node, void *user_data) {
+    (void)parser;
+    (void)node;
+
+    size_t *child_count = user_data;
+    ++*child_count;
+
+    return true;
+}
+
+static bool s_traverse_root(struct aws_xml_parser *parser, struct aws_xml_node *node, void *user_data) {
+    return aws_xml_node_traverse(parser, node, s_skip_child, user_data) == AWS_OP_SUCCESS;
+}
+
+/* the work is the bytes read while skipping the children */
+static int s_parse_wide_xml(struct aws_allocator *allocator, const struct aws_byte_buf *input, size_t *out_work) {
+    struct aws_byte_cursor doc = aws_byte_cursor_from_buf(input);
+
+    struct aws_xml_parser parser;
+    ASSERT_SUCCESS(aws_xml_parser_init(&parser, allocator, &doc, 0));
+
+    size_t reached_count = 0;
+    ASSERT_SUCCESS(aws_xml_parser_parse(&parser, s_traverse_root, &reached_count));
+
+    /* every child is on its own line, after the preamble and <Root> lines */
+    size_t line_count = 0;
+    for (size_t i = 0; i < input->len; ++i) {
+        line_count += input->buffer[i] == '\n';
+    }
+    ASSERT_UINT_EQUALS(line_count - 2, reached_count);
+
+    *out_work = parser.skipped_len;
+
+    aws_xml_parser_clean_up(&parser);
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_xml_wide_document_scaling_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    return s_check_linear_scaling(allocator, s_make_wide_xml, s_parse_wide_xml, 2000);
+}
+
+AWS_TEST_CASE(xml_wide_document_scaling_test, s_xml_wide_document_scaling_test);
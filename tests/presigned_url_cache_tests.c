@@ -0,0 +1,305 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/testing/aws_test_harness.h>
+
+#include <aws/auth/credentials.h>
+#include <aws/auth/presigned_url_cache.h>
+#include <aws/common/string.h>
+
+#include "credentials_provider_utils.h"
+
+AWS_STATIC_STRING_FROM_LITERAL(s_access_key_id, "AKIDEXAMPLE");
+AWS_STATIC_STRING_FROM_LITERAL(s_rotated_access_key_id, "AKIDROTATED");
+AWS_STATIC_STRING_FROM_LITERAL(s_secret_access_key, "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY");
+
+/* 2015-08-30T12:36:00Z */
+#define URL_CACHE_TEST_START_TIME_SECS 1440938160ULL
+#define URL_CACHE_TEST_NANOS_PER_SEC 1000000000ULL
+
+struct url_cache_test_state {
+    struct aws_allocator *allocator;
+    struct aws_byte_buf presigned_path;
+    int error_code;
+    int callback_count;
+};
+
+static void s_on_url_complete(const struct aws_byte_cursor *presigned_path, int error_code, void *user_data) {
+    struct url_cache_test_state *state = user_data;
+
+    state->error_code = error_code;
+    ++state->callback_count;
+
+    aws_byte_buf_clean_up(&state->presigned_path);
+    if (presigned_path != NULL) {
+        aws_byte_buf_init_copy_from_cursor(&state->presigned_path, state->allocator, *presigned_path);
+    }
+}
+
+static bool s_presigned_path_contains(struct url_cache_test_state *state, const char *fragment) {
+    struct aws_byte_cursor path = aws_byte_cursor_from_buf(&state->presigned_path);
+    struct aws_byte_cursor fragment_cursor = aws_byte_cursor_from_c_str(fragment);
+    struct aws_byte_cursor found;
+
+    return aws_byte_cursor_find_exact(&path, &fragment_cursor, &found) == AWS_OP_SUCCESS;
+}
+
+static struct aws_presigned_url_cache_request s_object_request(const char *path) {
+    struct aws_presigned_url_cache_request request = {
+        .method = aws_byte_cursor_from_c_str("GET"),
+        .host = aws_byte_cursor_from_c_str("examplebucket.s3.amazonaws.com"),
+        .path = aws_byte_cursor_from_c_str(path),
+        .region = aws_byte_cursor_from_c_str("us-east-1"),
+        .service = aws_byte_cursor_from_c_str("s3"),
+    };
+
+    return request;
+}
+
+static struct aws_presigned_url_cache *s_new_test_url_cache(
+    struct aws_allocator *allocator,
+    struct aws_credentials_provider *provider,
+    size_t max_entries) {
+
+    struct aws_presigned_url_cache_options options = {
+        .credentials_provider = provider,
+        .expiration_in_seconds = 600,
+        .min_remaining_validity_in_seconds = 120,
+        .max_entries = max_entries,
+        .clock_fn = mock_aws_get_time,
+    };
+
+    struct aws_presigned_url_cache *url_cache = aws_presigned_url_cache_new(allocator, &options);
+
+    aws_credentials_provider_release(provider);
+
+    return url_cache;
+}
+
+static int s_presigned_url_cache_reuses_valid_url_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    mock_aws_set_time(URL_CACHE_TEST_START_TIME_SECS * URL_CACHE_TEST_NANOS_PER_SEC);
+
+    struct aws_credentials_provider_static_options static_options = {
+        .access_key_id = aws_byte_cursor_from_string(s_access_key_id),
+        .secret_access_key = aws_byte_cursor_from_string(s_secret_access_key),
+    };
+
+    struct aws_credentials_provider *provider = aws_credentials_provider_new_static(allocator, &static_options);
+    ASSERT_NOT_NULL(provider);
+
+    struct aws_presigned_url_cache *url_cache = s_new_test_url_cache(allocator, provider, 0);
+    ASSERT_NOT_NULL(url_cache);
+
+    struct url_cache_test_state state;
+    AWS_ZERO_STRUCT(state);
+    state.allocator = allocator;
+
+    struct aws_presigned_url_cache_request request = s_object_request("/hot/object.jpg");
+
+    ASSERT_SUCCESS(aws_presigned_url_cache_get(url_cache, &request, s_on_url_complete, &state));
+    ASSERT_INT_EQUALS(1, state.callback_count);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, state.error_code);
+    ASSERT_TRUE(s_presigned_path_contains(&state, "/hot/object.jpg?"));
+    ASSERT_TRUE(s_presigned_path_contains(&state, "X-Amz-Expires=600"));
+    ASSERT_TRUE(s_presigned_path_contains(&state, "X-Amz-Date=20150830T123600Z"));
+    ASSERT_TRUE(s_presigned_path_contains(&state, "X-Amz-Signature="));
+
+    struct aws_byte_buf first_path;
+    ASSERT_SUCCESS(aws_byte_buf_init_copy(&first_path, allocator, &state.presigned_path));
+
+    /* plenty of validity left: the cached url is handed out again */
+    mock_aws_set_time((URL_CACHE_TEST_START_TIME_SECS + 100) * URL_CACHE_TEST_NANOS_PER_SEC);
+    ASSERT_SUCCESS(aws_presigned_url_cache_get(url_cache, &request, s_on_url_complete, &state));
+    ASSERT_INT_EQUALS(2, state.callback_count);
+    ASSERT_BIN_ARRAYS_EQUALS(first_path.buffer, first_path.len, state.presigned_path.buffer, state.presigned_path.len);
+
+    /* a different object is a different entry */
+    struct aws_presigned_url_cache_request other_request = s_object_request("/hot/other.jpg");
+    ASSERT_SUCCESS(aws_presigned_url_cache_get(url_cache, &other_request, s_on_url_complete, &state));
+    ASSERT_INT_EQUALS(3, state.callback_count);
+    ASSERT_TRUE(s_presigned_path_contains(&state, "/hot/other.jpg?"));
+    ASSERT_TRUE(s_presigned_path_contains(&state, "X-Amz-Date=20150830T123740Z"));
+
+    /* less than the minimum validity left: re-signed */
+    mock_aws_set_time((URL_CACHE_TEST_START_TIME_SECS + 500) * URL_CACHE_TEST_NANOS_PER_SEC);
+    ASSERT_SUCCESS(aws_presigned_url_cache_get(url_cache, &request, s_on_url_complete, &state));
+    ASSERT_INT_EQUALS(4, state.callback_count);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, state.error_code);
+    ASSERT_TRUE(s_presigned_path_contains(&state, "/hot/object.jpg?"));
+    ASSERT_TRUE(s_presigned_path_contains(&state, "X-Amz-Date=20150830T124420Z"));
+
+    /* incomplete requests are rejected up front */
+    struct aws_presigned_url_cache_request bad_request = s_object_request("/hot/object.jpg");
+    AWS_ZERO_STRUCT(bad_request.region);
+    ASSERT_FAILS(aws_presigned_url_cache_get(url_cache, &bad_request, s_on_url_complete, &state));
+    ASSERT_INT_EQUALS(4, state.callback_count);
+
+    aws_byte_buf_clean_up(&first_path);
+    aws_byte_buf_clean_up(&state.presigned_path);
+    aws_presigned_url_cache_release(url_cache);
+
+    aws_auth_library_clean_up();
+
+    return 0;
+}
+
+AWS_TEST_CASE(presigned_url_cache_reuses_valid_url_test, s_presigned_url_cache_reuses_valid_url_test);
+
+static int s_presigned_url_cache_resigns_on_rotation_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    mock_aws_set_time(URL_CACHE_TEST_START_TIME_SECS * URL_CACHE_TEST_NANOS_PER_SEC);
+
+    struct aws_credentials *credentials = aws_credentials_new(allocator, s_access_key_id, s_secret_access_key, NULL);
+    ASSERT_NOT_NULL(credentials);
+    struct aws_credentials *rotated_credentials =
+        aws_credentials_new(allocator, s_rotated_access_key_id, s_secret_access_key, NULL);
+    ASSERT_NOT_NULL(rotated_credentials);
+
+    struct get_credentials_mock_result results[] = {
+        {.credentials = credentials},
+        {.credentials = credentials},
+        {.credentials = rotated_credentials},
+        {.credentials = credentials},
+    };
+
+    struct aws_credentials_provider *provider =
+        aws_credentials_provider_new_mock(allocator, results, AWS_ARRAY_SIZE(results), NULL);
+    ASSERT_NOT_NULL(provider);
+
+    struct aws_presigned_url_cache *url_cache = s_new_test_url_cache(allocator, provider, 0);
+    ASSERT_NOT_NULL(url_cache);
+
+    struct url_cache_test_state state;
+    AWS_ZERO_STRUCT(state);
+    state.allocator = allocator;
+
+    struct aws_presigned_url_cache_request request = s_object_request("/hot/object.jpg");
+
+    ASSERT_SUCCESS(aws_presigned_url_cache_get(url_cache, &request, s_on_url_complete, &state));
+    ASSERT_TRUE(s_presigned_path_contains(&state, "X-Amz-Credential=AKIDEXAMPLE%2F"));
+
+    struct aws_byte_buf first_path;
+    ASSERT_SUCCESS(aws_byte_buf_init_copy(&first_path, allocator, &state.presigned_path));
+
+    mock_aws_set_time((URL_CACHE_TEST_START_TIME_SECS + 10) * URL_CACHE_TEST_NANOS_PER_SEC);
+    ASSERT_SUCCESS(aws_presigned_url_cache_get(url_cache, &request, s_on_url_complete, &state));
+    ASSERT_BIN_ARRAYS_EQUALS(first_path.buffer, first_path.len, state.presigned_path.buffer, state.presigned_path.len);
+
+    /* the credentials rotated: the still-valid url signed with the old ones isn't handed out */
+    ASSERT_SUCCESS(aws_presigned_url_cache_get(url_cache, &request, s_on_url_complete, &state));
+    ASSERT_INT_EQUALS(3, state.callback_count);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, state.error_code);
+    ASSERT_TRUE(s_presigned_path_contains(&state, "X-Amz-Credential=AKIDROTATED%2F"));
+    ASSERT_TRUE(s_presigned_path_contains(&state, "X-Amz-Date=20150830T123610Z"));
+
+    /* the rotation dropped the urls signed with the old key, so going back to it re-signs */
+    mock_aws_set_time((URL_CACHE_TEST_START_TIME_SECS + 20) * URL_CACHE_TEST_NANOS_PER_SEC);
+    ASSERT_SUCCESS(aws_presigned_url_cache_get(url_cache, &request, s_on_url_complete, &state));
+    ASSERT_INT_EQUALS(4, state.callback_count);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, state.error_code);
+    ASSERT_TRUE(s_presigned_path_contains(&state, "X-Amz-Credential=AKIDEXAMPLE%2F"));
+    ASSERT_TRUE(s_presigned_path_contains(&state, "X-Amz-Date=20150830T123620Z"));
+
+    aws_byte_buf_clean_up(&first_path);
+    aws_byte_buf_clean_up(&state.presigned_path);
+    aws_presigned_url_cache_release(url_cache);
+
+    aws_credentials_destroy(rotated_credentials);
+    aws_credentials_destroy(credentials);
+
+    aws_auth_library_clean_up();
+
+    return 0;
+}
+
+AWS_TEST_CASE(presigned_url_cache_resigns_on_rotation_test, s_presigned_url_cache_resigns_on_rotation_test);
+
+/* gets a url for path at start time + offset_secs and checks which signing time it carries */
+static int s_get_url_signed_at(
+    struct aws_presigned_url_cache *url_cache,
+    struct url_cache_test_state *state,
+    const char *path,
+    uint64_t offset_secs,
+    const char *expected_date) {
+
+    int callback_count = state->callback_count;
+
+    mock_aws_set_time((URL_CACHE_TEST_START_TIME_SECS + offset_secs) * URL_CACHE_TEST_NANOS_PER_SEC);
+
+    struct aws_presigned_url_cache_request request = s_object_request(path);
+    ASSERT_SUCCESS(aws_presigned_url_cache_get(url_cache, &request, s_on_url_complete, state));
+    ASSERT_INT_EQUALS(callback_count + 1, state->callback_count);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, state->error_code);
+    ASSERT_TRUE(s_presigned_path_contains(state, path));
+    ASSERT_TRUE(s_presigned_path_contains(state, expected_date));
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_presigned_url_cache_evicts_least_recently_used_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    struct aws_credentials_provider_static_options static_options = {
+        .access_key_id = aws_byte_cursor_from_string(s_access_key_id),
+        .secret_access_key = aws_byte_cursor_from_string(s_secret_access_key),
+    };
+
+    struct aws_credentials_provider *provider = aws_credentials_provider_new_static(allocator, &static_options);
+    ASSERT_NOT_NULL(provider);
+
+    struct aws_presigned_url_cache *url_cache = s_new_test_url_cache(allocator, provider, 2);
+    ASSERT_NOT_NULL(url_cache);
+
+    struct url_cache_test_state state;
+    AWS_ZERO_STRUCT(state);
+    state.allocator = allocator;
+
+    /* fill the cache, then use a so that b is the least recently used */
+    ASSERT_SUCCESS(s_get_url_signed_at(url_cache, &state, "/a.jpg", 0, "X-Amz-Date=20150830T123600Z"));
+    ASSERT_SUCCESS(s_get_url_signed_at(url_cache, &state, "/b.jpg", 10, "X-Amz-Date=20150830T123610Z"));
+    ASSERT_SUCCESS(s_get_url_signed_at(url_cache, &state, "/a.jpg", 20, "X-Amz-Date=20150830T123600Z"));
+
+    /* one past max_entries: b is evicted to make room */
+    ASSERT_SUCCESS(s_get_url_signed_at(url_cache, &state, "/c.jpg", 30, "X-Amz-Date=20150830T123630Z"));
+
+    /* the recently used urls are still served from the cache */
+    ASSERT_SUCCESS(s_get_url_signed_at(url_cache, &state, "/a.jpg", 40, "X-Amz-Date=20150830T123600Z"));
+    ASSERT_SUCCESS(s_get_url_signed_at(url_cache, &state, "/c.jpg", 50, "X-Amz-Date=20150830T123630Z"));
+
+    /* b is re-signed, which in turn evicts a, now the least recently used */
+    ASSERT_SUCCESS(s_get_url_signed_at(url_cache, &state, "/b.jpg", 60, "X-Amz-Date=20150830T123700Z"));
+    ASSERT_SUCCESS(s_get_url_signed_at(url_cache, &state, "/c.jpg", 70, "X-Amz-Date=20150830T123630Z"));
+    ASSERT_SUCCESS(s_get_url_signed_at(url_cache, &state, "/a.jpg", 80, "X-Amz-Date=20150830T123720Z"));
+
+    aws_byte_buf_clean_up(&state.presigned_path);
+    aws_presigned_url_cache_release(url_cache);
+
+    aws_auth_library_clean_up();
+
+    return 0;
+}
+
+AWS_TEST_CASE(
+    presigned_url_cache_evicts_least_recently_used_test,
+    s_presigned_url_cache_evicts_least_recently_used_test);
@@ -0,0 +1,202 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/testing/aws_test_harness.h>
+
+#include <aws/auth/credentials.h>
+#include <aws/auth/s3_post_policy.h>
+#include <aws/common/string.h>
+
+AWS_STATIC_STRING_FROM_LITERAL(s_access_key_id, "AKIDEXAMPLE");
+AWS_STATIC_STRING_FROM_LITERAL(s_secret_access_key, "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY");
+
+AWS_STATIC_STRING_FROM_LITERAL(
+    s_raw_policy_document,
+    "{\"expiration\":\"2015-08-31T12:00:00Z\",\"conditions\":[{\"bucket\":\"examplebucket\"}]}");
+AWS_STATIC_STRING_FROM_LITERAL(
+    s_raw_policy_expected_policy,
+    "eyJleHBpcmF0aW9uIjoiMjAxNS0wOC0zMVQxMjowMDowMFoiLCJjb25kaXRpb25zIjpbeyJidWNrZXQiOiJleGFtcGxlYnVja2V0In1dfQ==");
+AWS_STATIC_STRING_FROM_LITERAL(
+    s_raw_policy_expected_signature,
+    "ce43d4ec178c4bc27180838d1f790b76c5e07a21c31558a872653b069cd9f4ee");
+
+AWS_STATIC_STRING_FROM_LITERAL(
+    s_conditions_expected_policy,
+    "eyJleHBpcmF0aW9uIjoiMjAxNS0wOC0zMVQxMjowMDowMFoiLCJjb25kaXRpb25zIjpbeyJidWNrZXQiOiJleGFtcGxlYnVja2V0In0sWyJzdG"
+    "FydHMtd2l0aCIsIiRrZXkiLCJ1c2VyL1wicXVvdGVkXCIvIl0sWyJjb250ZW50LWxlbmd0aC1yYW5nZSIsMCwxMDQ4NTc2XSx7IngtYW16LWFs"
+    "Z29yaXRobSI6IkFXUzQtSE1BQy1TSEEyNTYifSx7IngtYW16LWNyZWRlbnRpYWwiOiJBS0lERVhBTVBMRS8yMDE1MDgzMC91cy1lYXN0LTEvcz"
+    "MvYXdzNF9yZXF1ZXN0In0seyJ4LWFtei1kYXRlIjoiMjAxNTA4MzBUMTIzNjAwWiJ9XX0=");
+AWS_STATIC_STRING_FROM_LITERAL(
+    s_conditions_expected_signature,
+    "a59325fd7f56f03cd2db9daac1f9f5b948994362023d8acbb796ddae24d22024");
+
+/* 2015-08-30T12:36:00Z */
+#define POST_POLICY_TEST_SIGNING_TIME_SECS 1440938160
+/* 2015-08-31T12:00:00Z */
+#define POST_POLICY_TEST_EXPIRATION_TIME_SECS 1441022400
+
+static void s_init_signing_options(
+    struct aws_s3_post_policy_signing_options *options,
+    const struct aws_credentials *credentials) {
+
+    AWS_ZERO_STRUCT(*options);
+    options->credentials = credentials;
+    options->region = aws_byte_cursor_from_c_str("us-east-1");
+    aws_date_time_init_epoch_secs(&options->date, POST_POLICY_TEST_SIGNING_TIME_SECS);
+}
+
+static void s_init_conditions(struct aws_s3_post_policy_conditions *conditions) {
+    AWS_ZERO_STRUCT(*conditions);
+    aws_date_time_init_epoch_secs(&conditions->expiration, POST_POLICY_TEST_EXPIRATION_TIME_SECS);
+    conditions->bucket = aws_byte_cursor_from_c_str("examplebucket");
+    conditions->key_prefix = aws_byte_cursor_from_c_str("user/\"quoted\"/");
+    conditions->has_content_length_range = true;
+    conditions->content_length_min = 0;
+    conditions->content_length_max = 1048576;
+}
+
+static int s_s3_post_policy_sign_document_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    struct aws_credentials *credentials = aws_credentials_new(allocator, s_access_key_id, s_secret_access_key, NULL);
+    ASSERT_NOT_NULL(credentials);
+
+    struct aws_s3_post_policy_signing_options options;
+    s_init_signing_options(&options, credentials);
+
+    struct aws_byte_buf output;
+    ASSERT_SUCCESS(aws_byte_buf_init(&output, allocator, 16));
+
+    struct aws_s3_post_policy_form_fields fields;
+    AWS_ZERO_STRUCT(fields);
+
+    struct aws_byte_cursor document = aws_byte_cursor_from_string(s_raw_policy_document);
+    ASSERT_SUCCESS(aws_s3_post_policy_sign(allocator, &options, &document, &output, &fields));
+
+    ASSERT_BIN_ARRAYS_EQUALS(
+        s_raw_policy_expected_policy->bytes, s_raw_policy_expected_policy->len, fields.policy.ptr, fields.policy.len);
+    ASSERT_BIN_ARRAYS_EQUALS(
+        s_raw_policy_expected_signature->bytes,
+        s_raw_policy_expected_signature->len,
+        fields.signature.ptr,
+        fields.signature.len);
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&fields.algorithm, "AWS4-HMAC-SHA256"));
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&fields.credential, "AKIDEXAMPLE/20150830/us-east-1/s3/aws4_request"));
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&fields.date, "20150830T123600Z"));
+    ASSERT_UINT_EQUALS(0, fields.security_token.len);
+
+    aws_byte_buf_clean_up(&output);
+    aws_credentials_destroy(credentials);
+
+    aws_auth_library_clean_up();
+
+    return 0;
+}
+
+AWS_TEST_CASE(s3_post_policy_sign_document_test, s_s3_post_policy_sign_document_test);
+
+static int s_s3_post_policy_sign_conditions_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    struct aws_credentials *credentials = aws_credentials_new(allocator, s_access_key_id, s_secret_access_key, NULL);
+    ASSERT_NOT_NULL(credentials);
+
+    struct aws_s3_post_policy_signing_options options;
+    s_init_signing_options(&options, credentials);
+
+    struct aws_s3_post_policy_conditions conditions;
+    s_init_conditions(&conditions);
+
+    struct aws_byte_buf output;
+    ASSERT_SUCCESS(aws_byte_buf_init(&output, allocator, 16));
+
+    struct aws_s3_post_policy_form_fields fields;
+    AWS_ZERO_STRUCT(fields);
+
+    ASSERT_SUCCESS(aws_s3_post_policy_sign_conditions(allocator, &options, &conditions, &output, &fields));
+
+    ASSERT_BIN_ARRAYS_EQUALS(
+        s_conditions_expected_policy->bytes, s_conditions_expected_policy->len, fields.policy.ptr, fields.policy.len);
+    ASSERT_BIN_ARRAYS_EQUALS(
+        s_conditions_expected_signature->bytes,
+        s_conditions_expected_signature->len,
+        fields.signature.ptr,
+        fields.signature.len);
+
+    aws_byte_buf_clean_up(&output);
+    aws_credentials_destroy(credentials);
+
+    aws_auth_library_clean_up();
+
+    return 0;
+}
+
+AWS_TEST_CASE(s3_post_policy_sign_conditions_test, s_s3_post_policy_sign_conditions_test);
+
+#define BULK_POLICY_COUNT 3
+
+static int s_s3_post_policy_sign_conditions_bulk_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    struct aws_credentials *credentials = aws_credentials_new(allocator, s_access_key_id, s_secret_access_key, NULL);
+    ASSERT_NOT_NULL(credentials);
+
+    struct aws_s3_post_policy_signing_options options;
+    s_init_signing_options(&options, credentials);
+
+    struct aws_s3_post_policy_conditions conditions[BULK_POLICY_COUNT];
+    for (size_t i = 0; i < BULK_POLICY_COUNT; ++i) {
+        s_init_conditions(&conditions[i]);
+    }
+    conditions[1].key_prefix = aws_byte_cursor_from_c_str("other/");
+
+    /* start small so the output buffer has to grow (and move) mid-batch */
+    struct aws_byte_buf output;
+    ASSERT_SUCCESS(aws_byte_buf_init(&output, allocator, 16));
+
+    struct aws_s3_post_policy_form_fields fields[BULK_POLICY_COUNT];
+    AWS_ZERO_ARRAY(fields);
+
+    ASSERT_SUCCESS(aws_s3_post_policy_sign_conditions_bulk(
+        allocator, &options, conditions, BULK_POLICY_COUNT, &output, fields));
+
+    ASSERT_BIN_ARRAYS_EQUALS(
+        s_conditions_expected_signature->bytes,
+        s_conditions_expected_signature->len,
+        fields[0].signature.ptr,
+        fields[0].signature.len);
+    ASSERT_BIN_ARRAYS_EQUALS(
+        s_conditions_expected_signature->bytes,
+        s_conditions_expected_signature->len,
+        fields[2].signature.ptr,
+        fields[2].signature.len);
+    ASSERT_FALSE(aws_byte_cursor_eq(&fields[0].signature, &fields[1].signature));
+    ASSERT_TRUE(aws_byte_cursor_eq(&fields[0].credential, &fields[1].credential));
+
+    aws_byte_buf_clean_up(&output);
+    aws_credentials_destroy(credentials);
+
+    aws_auth_library_clean_up();
+
+    return 0;
+}
+
+AWS_TEST_CASE(s3_post_policy_sign_conditions_bulk_test, s_s3_post_policy_sign_conditions_bulk_test);
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/testing/aws_test_harness.h>
+
+#include <aws/auth/private/aws_signing.h>
+#include <aws/auth/signing_key_cache.h>
+#include <aws/cal/hash.h>
+#include <aws/common/string.h>
+
+#include "credentials_provider_utils.h"
+
+/* 2015-08-30T23:57:00Z, three minutes before the day rolls over */
+#define KEY_CACHE_TEST_LOCAL_TIME_SECS 1440979020ULL
+#define KEY_CACHE_TEST_SECS_PER_DAY 86400ULL
+#define KEY_CACHE_TEST_NANOS_PER_SEC 1000000000ULL
+
+AWS_STATIC_STRING_FROM_LITERAL(s_key_cache_access_key_id, "AKIDEXAMPLE");
+AWS_STATIC_STRING_FROM_LITERAL(s_key_cache_secret_access_key, "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY");
+
+static int s_check_cached_key(
+    struct aws_allocator *allocator,
+    struct aws_signing_key_cache *cache,
+    uint64_t epoch_secs,
+    struct aws_byte_cursor region,
+    struct aws_byte_cursor service) {
+
+    struct aws_date_time date;
+    aws_date_time_init_epoch_secs(&date, (double)epoch_secs);
+
+    uint8_t expected[AWS_SHA256_LEN];
+    struct aws_byte_buf expected_buf = aws_byte_buf_from_empty_array(expected, sizeof(expected));
+    ASSERT_SUCCESS(aws_signing_derive_sigv4_signing_key(
+        allocator, s_key_cache_secret_access_key, &date, &region, &service, &expected_buf));
+
+    uint8_t cached[AWS_SHA256_LEN];
+    struct aws_byte_buf cached_buf = aws_byte_buf_from_empty_array(cached, sizeof(cached));
+    ASSERT_SUCCESS(aws_signing_key_cache_get_sigv4_key(
+        cache, s_key_cache_access_key_id, s_key_cache_secret_access_key, &date, &region, &service, &cached_buf));
+
+    ASSERT_BIN_ARRAYS_EQUALS(expected, sizeof(expected), cached_buf.buffer, cached_buf.len);
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_signing_key_cache_day_rollover_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    mock_aws_set_time(KEY_CACHE_TEST_LOCAL_TIME_SECS * KEY_CACHE_TEST_NANOS_PER_SEC);
+
+    struct aws_signing_key_cache_options options = {
+        .clock_fn = mock_aws_get_time,
+        .manual_prederive = true,
+    };
+    struct aws_signing_key_cache *cache = aws_signing_key_cache_new(allocator, &options);
+    ASSERT_NOT_NULL(cache);
+
+    struct aws_byte_cursor region = aws_byte_cursor_from_c_str("us-east-1");
+    struct aws_byte_cursor service = aws_byte_cursor_from_c_str("s3");
+    struct aws_byte_cursor other_service = aws_byte_cursor_from_c_str("sts");
+
+    struct aws_signing_key_cache_stats stats;
+
+    /* the second request for a scope comes from the cache */
+    ASSERT_SUCCESS(s_check_cached_key(allocator, cache, KEY_CACHE_TEST_LOCAL_TIME_SECS, region, service));
+    aws_signing_key_cache_get_stats(cache, &stats);
+    ASSERT_UINT_EQUALS(1, stats.derive_count);
+    ASSERT_UINT_EQUALS(0, stats.hit_count);
+
+    ASSERT_SUCCESS(s_check_cached_key(allocator, cache, KEY_CACHE_TEST_LOCAL_TIME_SECS, region, service));
+    aws_signing_key_cache_get_stats(cache, &stats);
+    ASSERT_UINT_EQUALS(1, stats.derive_count);
+    ASSERT_UINT_EQUALS(1, stats.hit_count);
+
+    ASSERT_SUCCESS(s_check_cached_key(allocator, cache, KEY_CACHE_TEST_LOCAL_TIME_SECS, region, other_service));
+    aws_signing_key_cache_get_stats(cache, &stats);
+    ASSERT_UINT_EQUALS(2, stats.derive_count);
+
+    /* both active scopes get tomorrow's key, once */
+    size_t derived_count = 0;
+    ASSERT_SUCCESS(aws_signing_key_cache_prederive(cache, &derived_count));
+    ASSERT_UINT_EQUALS(2, derived_count);
+    ASSERT_SUCCESS(aws_signing_key_cache_prederive(cache, &derived_count));
+    ASSERT_UINT_EQUALS(0, derived_count);
+
+    /* requests dated on both sides of midnight get the right key */
+    uint64_t tomorrow_secs = KEY_CACHE_TEST_LOCAL_TIME_SECS + 3 * 60 + 1;
+    ASSERT_SUCCESS(s_check_cached_key(allocator, cache, tomorrow_secs, region, service));
+    ASSERT_SUCCESS(s_check_cached_key(allocator, cache, KEY_CACHE_TEST_LOCAL_TIME_SECS, region, service));
+
+    /* without deriving either day's key again */
+    aws_signing_key_cache_get_stats(cache, &stats);
+    ASSERT_UINT_EQUALS(2, stats.derive_count);
+    ASSERT_UINT_EQUALS(3, stats.hit_count);
+
+    /* two days on, only the scope used yesterday is still worth pre-deriving */
+    mock_aws_set_time((tomorrow_secs + KEY_CACHE_TEST_SECS_PER_DAY) * KEY_CACHE_TEST_NANOS_PER_SEC);
+    ASSERT_SUCCESS(aws_signing_key_cache_prederive(cache, &derived_count));
+    ASSERT_UINT_EQUALS(1, derived_count);
+
+    aws_signing_key_cache_destroy(cache);
+
+    aws_auth_library_clean_up();
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(signing_key_cache_day_rollover_test, s_signing_key_cache_day_rollover_test);
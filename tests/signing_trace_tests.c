@@ -0,0 +1,110 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/testing/aws_test_harness.h>
+
+#include <aws/auth/signable.h>
+#include <aws/auth/signing_trace.h>
+#include <aws/io/stream.h>
+
+#include "test_signable.h"
+
+static int s_signing_trace_round_trip_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    struct aws_byte_cursor method = aws_byte_cursor_from_c_str("PUT");
+    struct aws_byte_cursor uri = aws_byte_cursor_from_c_str("https://example.amazonaws.com/a/secret/path?k1=v1&k2=v2");
+    struct aws_signable_property_list_pair headers[] = {
+        {.name = aws_byte_cursor_from_c_str("Host"), .value = aws_byte_cursor_from_c_str("example.amazonaws.com")},
+        {.name = aws_byte_cursor_from_c_str("x-custom"), .value = aws_byte_cursor_from_c_str("do-not-record")},
+    };
+
+    struct aws_byte_cursor payload = aws_byte_cursor_from_c_str("payload");
+    struct aws_input_stream *payload_stream = aws_input_stream_new_from_cursor(allocator, &payload);
+    ASSERT_NOT_NULL(payload_stream);
+
+    struct aws_signable *signable =
+        aws_signable_new_test(allocator, &method, &uri, headers, AWS_ARRAY_SIZE(headers), payload_stream);
+    ASSERT_NOT_NULL(signable);
+
+    struct aws_signing_config_aws config = {
+        .config_type = AWS_SIGNING_CONFIG_AWS,
+        .algorithm = AWS_SIGNING_ALGORITHM_SIG_V4_QUERY_PARAM,
+        .body_signing_type = AWS_BODY_SIGNING_ON,
+        .use_double_uri_encode = true,
+    };
+
+    struct aws_signing_trace_record record;
+    ASSERT_SUCCESS(aws_signing_trace_record_init(&record, allocator));
+    ASSERT_SUCCESS(aws_signing_trace_record_capture(&record, signable, &config));
+
+    struct aws_byte_buf trace;
+    ASSERT_SUCCESS(aws_byte_buf_init(&trace, allocator, 16));
+    ASSERT_SUCCESS(aws_signing_trace_encode_header(&trace));
+    ASSERT_SUCCESS(aws_signing_trace_record_encode(&record, &trace));
+    ASSERT_SUCCESS(aws_signing_trace_record_encode(&record, &trace));
+
+    /* only shapes are recorded, never values */
+    struct aws_byte_cursor trace_cursor = aws_byte_cursor_from_buf(&trace);
+    struct aws_byte_cursor value_cursor = aws_byte_cursor_from_c_str("do-not-record");
+    struct aws_byte_cursor found;
+    ASSERT_FAILS(aws_byte_cursor_find_exact(&trace_cursor, &value_cursor, &found));
+    struct aws_byte_cursor path_cursor = aws_byte_cursor_from_c_str("secret");
+    ASSERT_FAILS(aws_byte_cursor_find_exact(&trace_cursor, &path_cursor, &found));
+
+    struct aws_signing_trace_record decoded;
+    ASSERT_SUCCESS(aws_signing_trace_record_init(&decoded, allocator));
+
+    ASSERT_SUCCESS(aws_signing_trace_decode_header(&trace_cursor));
+    for (size_t i = 0; i < 2; ++i) {
+        ASSERT_SUCCESS(aws_signing_trace_record_decode(&decoded, &trace_cursor));
+
+        ASSERT_INT_EQUALS(AWS_SIGNING_ALGORITHM_SIG_V4_QUERY_PARAM, decoded.algorithm);
+        ASSERT_INT_EQUALS(AWS_BODY_SIGNING_ON, decoded.body_signing_type);
+        ASSERT_TRUE(decoded.use_double_uri_encode);
+        ASSERT_FALSE(decoded.should_normalize_uri_path);
+        ASSERT_UINT_EQUALS(sizeof("/a/secret/path") - 1, decoded.path_length);
+        ASSERT_UINT_EQUALS(2, decoded.query_param_count);
+        ASSERT_UINT_EQUALS(payload.len, decoded.payload_size);
+        ASSERT_UINT_EQUALS(2, aws_array_list_length(&decoded.headers));
+
+        struct aws_signing_trace_header_shape shape;
+        ASSERT_SUCCESS(aws_array_list_get_at(&decoded.headers, &shape, 1));
+        ASSERT_TRUE(aws_byte_cursor_eq_c_str(&shape.name, "x-custom"));
+        ASSERT_UINT_EQUALS(sizeof("do-not-record") - 1, shape.value_length);
+    }
+    ASSERT_UINT_EQUALS(0, trace_cursor.len);
+
+    /* truncated records are rejected */
+    struct aws_byte_cursor truncated = aws_byte_cursor_from_buf(&trace);
+    truncated.len -= 1;
+    ASSERT_SUCCESS(aws_signing_trace_decode_header(&truncated));
+    ASSERT_SUCCESS(aws_signing_trace_record_decode(&decoded, &truncated));
+    ASSERT_FAILS(aws_signing_trace_record_decode(&decoded, &truncated));
+
+    aws_signing_trace_record_clean_up(&decoded);
+    aws_signing_trace_record_clean_up(&record);
+    aws_byte_buf_clean_up(&trace);
+    aws_signable_destroy(signable);
+    aws_input_stream_destroy(payload_stream);
+
+    aws_auth_library_clean_up();
+
+    return 0;
+}
+
+AWS_TEST_CASE(signing_trace_round_trip_test, s_signing_trace_round_trip_test);
@@ -17,16 +17,21 @@
 
 #include <aws/auth/credentials.h>
 #include <aws/auth/private/aws_signing.h>
+#include <aws/auth/private/payload_digests.h>
+#include <aws/auth/private/signing_ring.h>
 #include <aws/auth/signable.h>
 #include <aws/auth/signing.h>
 #include <aws/common/condition_variable.h>
 #include <aws/common/string.h>
+#include <aws/common/thread.h>
 #include <aws/http/request_response.h>
 #include <aws/io/file_utils.h>
 #include <aws/io/stream.h>
 #include <aws/io/uri.h>
 
 #include <ctype.h>
+#include <stdio.h>
+#include <string.h>
 
 #include "credentials_provider_utils.h"
 #include "test_signable.h"
@@ -811,10 +816,11 @@ static int s_sigv4_skip_custom_header_test(struct aws_allocator *allocator, void
 }
 AWS_TEST_CASE(sigv4_skip_custom_header_test, s_sigv4_skip_custom_header_test);
 
-static int s_do_forbidden_header_param_test(
+static int s_do_canonical_request_validation_test(
     struct aws_allocator *allocator,
     const struct aws_string *request_contents,
-    enum aws_auth_errors expected_error) {
+    uint64_t expiration_in_seconds,
+    int expected_error) {
 
     aws_auth_library_init(allocator);
 
@@ -842,14 +848,22 @@ static int s_do_forbidden_header_param_test(
     };
 
     config.credentials_provider = aws_credentials_provider_new_static(allocator, &static_options);
+    config.expiration_in_seconds = expiration_in_seconds;
+    if (expiration_in_seconds > 0) {
+        config.algorithm = AWS_SIGNING_ALGORITHM_SIG_V4_QUERY_PARAM;
+    }
 
     struct aws_signing_state_aws *signing_state = aws_signing_state_new(allocator, &config, signable, NULL, NULL);
     ASSERT_NOT_NULL(signing_state);
 
     signing_state->credentials = credentials;
 
-    ASSERT_FAILS(aws_signing_build_canonical_request(signing_state));
-    ASSERT_TRUE(aws_last_error() == expected_error);
+    if (expected_error == AWS_ERROR_SUCCESS) {
+        ASSERT_SUCCESS(aws_signing_build_canonical_request(signing_state));
+    } else {
+        ASSERT_FAILS(aws_signing_build_canonical_request(signing_state));
+        ASSERT_TRUE(aws_last_error() == expected_error);
+    }
 
     aws_signing_state_destroy(signing_state);
     aws_credentials_provider_release(config.credentials_provider);
@@ -862,6 +876,14 @@ static int s_do_forbidden_header_param_test(
     return AWS_OP_SUCCESS;
 }
 
+static int s_do_forbidden_header_param_test(
+    struct aws_allocator *allocator,
+    const struct aws_string *request_contents,
+    enum aws_auth_errors expected_error) {
+
+    return s_do_canonical_request_validation_test(allocator, request_contents, 0, expected_error);
+}
+
 AWS_STATIC_STRING_FROM_LITERAL(
     s_amz_date_header_request,
     "GET / HTTP/1.1\n"
@@ -961,6 +983,58 @@ static int s_sigv4_fail_signed_headers_param_test(struct aws_allocator *allocato
 }
 AWS_TEST_CASE(sigv4_fail_signed_headers_param_test, s_sigv4_fail_signed_headers_param_test);
 
+AWS_STATIC_STRING_FROM_LITERAL(
+    s_amz_expires_param_request,
+    "GET /?X-Amz-Expires=300 HTTP/1.1\n"
+    "Host:example.amazonaws.com\n");
+
+/* a caller-supplied X-Amz-Expires is only illegal when the signer adds its own */
+static int s_sigv4_expires_param_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    ASSERT_SUCCESS(
+        s_do_canonical_request_validation_test(allocator, s_amz_expires_param_request, 0, AWS_ERROR_SUCCESS));
+    ASSERT_SUCCESS(s_do_canonical_request_validation_test(
+        allocator, s_amz_expires_param_request, 600, AWS_AUTH_SIGNING_ILLEGAL_REQUEST_QUERY_PARAM));
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(sigv4_expires_param_test, s_sigv4_expires_param_test);
+
+static int s_sigv4_fail_expiration_too_long_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    struct aws_credentials_provider_static_options static_options = {
+        .access_key_id = aws_byte_cursor_from_string(s_test_suite_access_key_id),
+        .secret_access_key = aws_byte_cursor_from_string(s_test_suite_secret_access_key),
+    };
+
+    struct aws_signing_config_aws config;
+    AWS_ZERO_STRUCT(config);
+    config.config_type = AWS_SIGNING_CONFIG_AWS;
+    config.algorithm = AWS_SIGNING_ALGORITHM_SIG_V4_QUERY_PARAM;
+    config.region = aws_byte_cursor_from_c_str("us-east-1");
+    config.service = aws_byte_cursor_from_c_str("s3");
+    config.credentials_provider = aws_credentials_provider_new_static(allocator, &static_options);
+    ASSERT_NOT_NULL(config.credentials_provider);
+
+    config.expiration_in_seconds = AWS_SIGV4_MAX_EXPIRATION_IN_SECONDS;
+    ASSERT_SUCCESS(aws_validate_aws_signing_config_aws(&config));
+
+    config.expiration_in_seconds = AWS_SIGV4_MAX_EXPIRATION_IN_SECONDS + 1;
+    ASSERT_FAILS(aws_validate_aws_signing_config_aws(&config));
+    ASSERT_INT_EQUALS(AWS_AUTH_SIGNING_INVALID_CONFIGURATION, aws_last_error());
+
+    aws_credentials_provider_release(config.credentials_provider);
+
+    aws_auth_library_clean_up();
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(sigv4_fail_expiration_too_long_test, s_sigv4_fail_expiration_too_long_test);
+
 struct null_credentials_state {
     struct aws_signing_result *result;
     int error_code;
@@ -1013,3 +1087,339 @@ static int s_signer_null_credentials_test(struct aws_allocator *allocator, void
     return AWS_OP_SUCCESS;
 }
 AWS_TEST_CASE(signer_null_credentials_test, s_signer_null_credentials_test);
+
+AWS_STATIC_STRING_FROM_LITERAL(
+    s_raw_vanilla_canonical_request,
+    "GET\n/\n\nhost:example.amazonaws.com\nx-amz-date:20150830T123600Z\n\nhost;x-amz-date\n"
+    "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+AWS_STATIC_STRING_FROM_LITERAL(
+    s_raw_vanilla_canonical_request_hash,
+    "bb579772317eb040ac9ed261061d46c1f17a8133879d6129b6e1c25292927e63");
+AWS_STATIC_STRING_FROM_LITERAL(
+    s_raw_vanilla_string_to_sign,
+    "AWS4-HMAC-SHA256\n20150830T123600Z\n20150830/us-east-1/service/aws4_request\n"
+    "bb579772317eb040ac9ed261061d46c1f17a8133879d6129b6e1c25292927e63");
+AWS_STATIC_STRING_FROM_LITERAL(
+    s_raw_vanilla_signature,
+    "5fa00fa31553b73ebf1942676e86291e8372ff2a2260956d9b8aae1d763fbf31");
+
+/* 2015-08-30T12:36:00Z */
+#define RAW_SIGNING_TEST_TIME_SECS 1440938160
+
+static int s_sigv4_raw_signing_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    struct aws_credentials *credentials =
+        aws_credentials_new(allocator, s_test_suite_access_key_id, s_test_suite_secret_access_key, NULL);
+    ASSERT_NOT_NULL(credentials);
+
+    struct aws_sigv4_raw_signing_options options = {
+        .credentials = credentials,
+        .region = aws_byte_cursor_from_c_str("us-east-1"),
+        .service = aws_byte_cursor_from_c_str("service"),
+    };
+    aws_date_time_init_epoch_secs(&options.date, RAW_SIGNING_TEST_TIME_SECS);
+
+    struct aws_byte_buf signature;
+    ASSERT_SUCCESS(aws_byte_buf_init(&signature, allocator, 16));
+
+    struct aws_byte_cursor canonical_request = aws_byte_cursor_from_string(s_raw_vanilla_canonical_request);
+    ASSERT_SUCCESS(aws_sigv4_sign_canonical_request(allocator, &options, &canonical_request, &signature));
+    ASSERT_BIN_ARRAYS_EQUALS(
+        s_raw_vanilla_signature->bytes, s_raw_vanilla_signature->len, signature.buffer, signature.len);
+
+    signature.len = 0;
+    struct aws_byte_cursor hash = aws_byte_cursor_from_string(s_raw_vanilla_canonical_request_hash);
+    ASSERT_SUCCESS(aws_sigv4_sign_canonical_request_hash(allocator, &options, &hash, &signature));
+    ASSERT_BIN_ARRAYS_EQUALS(
+        s_raw_vanilla_signature->bytes, s_raw_vanilla_signature->len, signature.buffer, signature.len);
+
+    signature.len = 0;
+    struct aws_byte_cursor string_to_sign = aws_byte_cursor_from_string(s_raw_vanilla_string_to_sign);
+    ASSERT_SUCCESS(aws_sigv4_sign_string_to_sign(allocator, &options, &string_to_sign, &signature));
+    ASSERT_BIN_ARRAYS_EQUALS(
+        s_raw_vanilla_signature->bytes, s_raw_vanilla_signature->len, signature.buffer, signature.len);
+
+    /* a truncated hash is rejected rather than silently signed */
+    signature.len = 0;
+    struct aws_byte_cursor bad_hash = aws_byte_cursor_advance(&hash, 10);
+    ASSERT_FAILS(aws_sigv4_sign_canonical_request_hash(allocator, &options, &bad_hash, &signature));
+    ASSERT_UINT_EQUALS(0, signature.len);
+
+    aws_byte_buf_clean_up(&signature);
+    aws_credentials_destroy(credentials);
+
+    aws_auth_library_clean_up();
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(sigv4_raw_signing_test, s_sigv4_raw_signing_test);
+
+static int s_sigv4_payload_digests_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    struct aws_byte_cursor method = aws_byte_cursor_from_c_str("PUT");
+    struct aws_byte_cursor uri = aws_byte_cursor_from_c_str("https://example.amazonaws.com/vault/archives");
+    struct aws_signable_property_list_pair headers[] = {
+        {.name = aws_byte_cursor_from_c_str("Host"), .value = aws_byte_cursor_from_c_str("example.amazonaws.com")},
+    };
+
+    struct aws_byte_cursor payload = aws_byte_cursor_from_c_str("payload");
+    struct aws_input_stream *payload_stream = aws_input_stream_new_from_cursor(allocator, &payload);
+    ASSERT_NOT_NULL(payload_stream);
+
+    struct aws_signable *signable =
+        aws_signable_new_test(allocator, &method, &uri, headers, AWS_ARRAY_SIZE(headers), payload_stream);
+    ASSERT_NOT_NULL(signable);
+
+    struct aws_credentials *credentials =
+        aws_credentials_new(allocator, s_test_suite_access_key_id, s_test_suite_secret_access_key, NULL);
+    ASSERT_NOT_NULL(credentials);
+
+    struct aws_signing_config_aws config = {
+        .config_type = AWS_SIGNING_CONFIG_AWS,
+        .algorithm = AWS_SIGNING_ALGORITHM_SIG_V4_HEADER,
+        .region = aws_byte_cursor_from_c_str("us-east-1"),
+        .service = aws_byte_cursor_from_c_str("glacier"),
+        .body_signing_type = AWS_BODY_SIGNING_ON,
+        .add_tree_hash_header = true,
+        .extra_payload_digests = AWS_SIGNING_PAYLOAD_DIGEST_MD5 | AWS_SIGNING_PAYLOAD_DIGEST_CRC32C,
+    };
+    aws_date_time_init_epoch_secs(&config.date, RAW_SIGNING_TEST_TIME_SECS);
+
+    struct aws_signing_state_aws *signing_state = aws_signing_state_new(allocator, &config, signable, NULL, NULL);
+    ASSERT_NOT_NULL(signing_state);
+    signing_state->credentials = credentials;
+
+    ASSERT_SUCCESS(aws_signing_build_canonical_request(signing_state));
+
+    /* the tree hash is signed; a one-chunk payload's tree hash is its linear hash */
+    struct aws_byte_cursor signed_headers = aws_byte_cursor_from_buf(&signing_state->signed_headers);
+    struct aws_byte_cursor tree_hash_header_name = aws_byte_cursor_from_string(g_aws_signing_tree_hash_header_name);
+    struct aws_byte_cursor found;
+    ASSERT_SUCCESS(aws_byte_cursor_find_exact(&signed_headers, &tree_hash_header_name, &found));
+    ASSERT_BIN_ARRAYS_EQUALS(
+        signing_state->payload_hash.buffer,
+        signing_state->payload_hash.len,
+        signing_state->tree_hash.buffer,
+        signing_state->tree_hash.len);
+
+    /* the extra digests come from the same read and are signed (SignedHeaders is lowercase) */
+    struct aws_byte_cursor md5_header_name = aws_byte_cursor_from_string(g_aws_signing_content_md5_header_name);
+    struct aws_byte_cursor signed_md5_name = aws_byte_cursor_from_c_str("content-md5");
+    ASSERT_SUCCESS(aws_byte_cursor_find_exact(&signed_headers, &signed_md5_name, &found));
+    struct aws_byte_cursor signed_crc32c_name = aws_byte_cursor_from_string(g_aws_signing_checksum_crc32c_header_name);
+    ASSERT_SUCCESS(aws_byte_cursor_find_exact(&signed_headers, &signed_crc32c_name, &found));
+
+    struct aws_array_list *result_headers = NULL;
+    ASSERT_SUCCESS(aws_signing_result_get_property_list(
+        &signing_state->result, g_aws_http_headers_property_list_name, &result_headers));
+
+    struct aws_byte_cursor md5_value = s_get_value_from_result(result_headers, &md5_header_name);
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&md5_value, "Mhw89IbtUJFk7eweGYH+yA=="));
+
+    struct aws_byte_cursor crc32c_header_name = aws_byte_cursor_from_string(g_aws_signing_checksum_crc32c_header_name);
+    struct aws_byte_cursor crc32c_value = s_get_value_from_result(result_headers, &crc32c_header_name);
+    ASSERT_TRUE(aws_byte_cursor_eq_c_str(&crc32c_value, "9ONpcA=="));
+
+    /* the standard check value */
+    struct aws_byte_cursor check_input = aws_byte_cursor_from_c_str("123456789");
+    ASSERT_UINT_EQUALS(0xE3069283, aws_crc32c_compute(&check_input, 0));
+
+    aws_signing_state_destroy(signing_state);
+    aws_credentials_destroy(credentials);
+    aws_signable_destroy(signable);
+    aws_input_stream_destroy(payload_stream);
+
+    aws_auth_library_clean_up();
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(sigv4_payload_digests_test, s_sigv4_payload_digests_test);
+
+static int s_sigv4_fail_tree_hash_header_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    struct aws_byte_cursor method = aws_byte_cursor_from_c_str("PUT");
+    struct aws_byte_cursor uri = aws_byte_cursor_from_c_str("https://example.amazonaws.com/vault/archives");
+    struct aws_signable_property_list_pair headers[] = {
+        {.name = aws_byte_cursor_from_c_str("Host"), .value = aws_byte_cursor_from_c_str("example.amazonaws.com")},
+        {.name = aws_byte_cursor_from_c_str("X-Amz-SHA256-Tree-Hash"), .value = aws_byte_cursor_from_c_str("lies")},
+    };
+
+    struct aws_byte_cursor payload = aws_byte_cursor_from_c_str("payload");
+    struct aws_input_stream *payload_stream = aws_input_stream_new_from_cursor(allocator, &payload);
+    ASSERT_NOT_NULL(payload_stream);
+
+    struct aws_signable *signable =
+        aws_signable_new_test(allocator, &method, &uri, headers, AWS_ARRAY_SIZE(headers), payload_stream);
+    ASSERT_NOT_NULL(signable);
+
+    struct aws_credentials *credentials =
+        aws_credentials_new(allocator, s_test_suite_access_key_id, s_test_suite_secret_access_key, NULL);
+    ASSERT_NOT_NULL(credentials);
+
+    struct aws_signing_config_aws config = {
+        .config_type = AWS_SIGNING_CONFIG_AWS,
+        .algorithm = AWS_SIGNING_ALGORITHM_SIG_V4_HEADER,
+        .region = aws_byte_cursor_from_c_str("us-east-1"),
+        .service = aws_byte_cursor_from_c_str("glacier"),
+        .body_signing_type = AWS_BODY_SIGNING_ON,
+        .add_tree_hash_header = true,
+    };
+    aws_date_time_init_epoch_secs(&config.date, RAW_SIGNING_TEST_TIME_SECS);
+
+    /* the signer adds the tree hash itself, so a caller-supplied one is refused */
+    struct aws_signing_state_aws *signing_state = aws_signing_state_new(allocator, &config, signable, NULL, NULL);
+    ASSERT_NOT_NULL(signing_state);
+    signing_state->credentials = credentials;
+
+    ASSERT_FAILS(aws_signing_build_canonical_request(signing_state));
+    ASSERT_INT_EQUALS(AWS_AUTH_SIGNING_ILLEGAL_REQUEST_HEADER, aws_last_error());
+
+    aws_signing_state_destroy(signing_state);
+
+    /* otherwise it is signed like any other header */
+    config.add_tree_hash_header = false;
+    signing_state = aws_signing_state_new(allocator, &config, signable, NULL, NULL);
+    ASSERT_NOT_NULL(signing_state);
+    signing_state->credentials = credentials;
+
+    ASSERT_SUCCESS(aws_input_stream_seek(payload_stream, 0, AWS_SSB_BEGIN));
+    ASSERT_SUCCESS(aws_signing_build_canonical_request(signing_state));
+
+    aws_signing_state_destroy(signing_state);
+    aws_credentials_destroy(credentials);
+    aws_signable_destroy(signable);
+    aws_input_stream_destroy(payload_stream);
+
+    aws_auth_library_clean_up();
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(sigv4_fail_tree_hash_header_test, s_sigv4_fail_tree_hash_header_test);
+
+struct recent_request_visit_state {
+    size_t count;
+    bool saw_truncated;
+};
+
+static void s_count_recent_requests(const struct aws_signing_recent_request *request, void *user_data) {
+    struct recent_request_visit_state *state = user_data;
+
+    ++state->count;
+    if (request->canonical_request_truncated) {
+        state->saw_truncated = true;
+    }
+}
+
+static int s_sigv4_recent_request_ring_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    struct aws_byte_cursor canonical_request = aws_byte_cursor_from_string(s_raw_vanilla_canonical_request);
+    struct aws_byte_cursor string_to_sign = aws_byte_cursor_from_string(s_raw_vanilla_string_to_sign);
+
+    /* overflow the ring by two so the first two entries get overwritten */
+    char signatures[AWS_SIGNING_RING_SLOT_COUNT + 2][8];
+    for (size_t i = 0; i < AWS_SIGNING_RING_SLOT_COUNT + 2; ++i) {
+        snprintf(signatures[i], sizeof(signatures[i]), "sig%zu", i);
+        struct aws_byte_cursor signature = aws_byte_cursor_from_c_str(signatures[i]);
+        aws_signing_ring_record(&canonical_request, &string_to_sign, &signature);
+    }
+
+    struct recent_request_visit_state state;
+    AWS_ZERO_STRUCT(state);
+    aws_signing_visit_recent_requests(s_count_recent_requests, &state);
+    ASSERT_UINT_EQUALS(AWS_SIGNING_RING_SLOT_COUNT, state.count);
+    ASSERT_FALSE(state.saw_truncated);
+
+    struct aws_byte_cursor oldest = aws_byte_cursor_from_c_str(signatures[0]);
+    ASSERT_FALSE(aws_signing_report_signature_failure(&oldest));
+    struct aws_byte_cursor newest = aws_byte_cursor_from_c_str(signatures[AWS_SIGNING_RING_SLOT_COUNT + 1]);
+    ASSERT_TRUE(aws_signing_report_signature_failure(&newest));
+
+    /* canonical requests that don't fit in a slot are kept, but truncated */
+    struct aws_byte_buf huge_request;
+    ASSERT_SUCCESS(aws_byte_buf_init(&huge_request, allocator, AWS_SIGNING_RING_SLOT_DATA_SIZE));
+    memset(huge_request.buffer, 'a', huge_request.capacity);
+    huge_request.len = huge_request.capacity;
+
+    struct aws_byte_cursor huge_cursor = aws_byte_cursor_from_buf(&huge_request);
+    struct aws_byte_cursor huge_signature = aws_byte_cursor_from_c_str("huge");
+    aws_signing_ring_record(&huge_cursor, &string_to_sign, &huge_signature);
+
+    AWS_ZERO_STRUCT(state);
+    aws_signing_visit_recent_requests(s_count_recent_requests, &state);
+    ASSERT_TRUE(state.saw_truncated);
+    ASSERT_TRUE(aws_signing_report_signature_failure(&huge_signature));
+
+    aws_byte_buf_clean_up(&huge_request);
+
+    aws_auth_library_clean_up();
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(sigv4_recent_request_ring_test, s_sigv4_recent_request_ring_test);
+
+struct ring_recording_thread_args {
+    struct aws_byte_cursor canonical_request;
+    struct aws_byte_cursor string_to_sign;
+    struct aws_byte_cursor signature;
+};
+
+static void s_record_signature_thread_fn(void *arg) {
+    struct ring_recording_thread_args *args = arg;
+
+    aws_signing_ring_record(&args->canonical_request, &args->string_to_sign, &args->signature);
+}
+
+static int s_sigv4_recent_request_ring_reuse_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    /*
+     * Each thread records once and exits before the next one starts.  Exiting threads hand their ring back, so
+     * every thread writes to the same ring and only the last AWS_SIGNING_RING_SLOT_COUNT entries survive.
+     */
+    char signatures[AWS_SIGNING_RING_SLOT_COUNT + 2][8];
+    for (size_t i = 0; i < AWS_SIGNING_RING_SLOT_COUNT + 2; ++i) {
+        snprintf(signatures[i], sizeof(signatures[i]), "sig%zu", i);
+
+        struct ring_recording_thread_args args = {
+            .canonical_request = aws_byte_cursor_from_string(s_raw_vanilla_canonical_request),
+            .string_to_sign = aws_byte_cursor_from_string(s_raw_vanilla_string_to_sign),
+            .signature = aws_byte_cursor_from_c_str(signatures[i]),
+        };
+
+        struct aws_thread_options thread_options;
+        AWS_ZERO_STRUCT(thread_options);
+
+        struct aws_thread thread;
+        ASSERT_SUCCESS(aws_thread_init(&thread, allocator));
+        ASSERT_SUCCESS(aws_thread_launch(&thread, s_record_signature_thread_fn, &args, &thread_options));
+        ASSERT_SUCCESS(aws_thread_join(&thread));
+        aws_thread_clean_up(&thread);
+    }
+
+    struct recent_request_visit_state state;
+    AWS_ZERO_STRUCT(state);
+    aws_signing_visit_recent_requests(s_count_recent_requests, &state);
+    ASSERT_UINT_EQUALS(AWS_SIGNING_RING_SLOT_COUNT, state.count);
+
+    struct aws_byte_cursor oldest = aws_byte_cursor_from_c_str(signatures[0]);
+    ASSERT_FALSE(aws_signing_report_signature_failure(&oldest));
+
+    aws_auth_library_clean_up();
+
+    return AWS_OP_SUCCESS;
+}
+AWS_TEST_CASE(sigv4_recent_request_ring_reuse_test, s_sigv4_recent_request_ring_reuse_test);
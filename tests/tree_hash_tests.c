@@ -0,0 +1,220 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/testing/aws_test_harness.h>
+
+#include <aws/auth/auth.h>
+#include <aws/auth/private/tree_hash.h>
+#include <aws/cal/hash.h>
+#include <aws/io/stream.h>
+
+/* four full leaves and a half leaf, so the tree has an odd digest to carry up */
+#define TREE_HASH_TEST_PAYLOAD_SIZE (4 * AWS_TREE_HASH_CHUNK_SIZE + AWS_TREE_HASH_CHUNK_SIZE / 2)
+#define TREE_HASH_TEST_LEAF_COUNT 5
+
+static int s_update_linear_hash(const struct aws_byte_cursor *chunk, void *user_data) {
+    return aws_hash_update(user_data, chunk);
+}
+
+static int s_compute_tree_hash(
+    struct aws_allocator *allocator,
+    struct aws_byte_cursor payload,
+    size_t thread_count,
+    struct aws_byte_buf *tree_digest,
+    struct aws_byte_buf *linear_digest) {
+
+    struct aws_input_stream *stream = aws_input_stream_new_from_cursor(allocator, &payload);
+    ASSERT_NOT_NULL(stream);
+
+    struct aws_hash *linear_hash = aws_sha256_new(allocator);
+    ASSERT_NOT_NULL(linear_hash);
+
+    ASSERT_SUCCESS(aws_sha256_tree_hash_compute(
+        allocator, stream, thread_count, s_update_linear_hash, linear_hash, tree_digest));
+    ASSERT_SUCCESS(aws_hash_finalize(linear_hash, linear_digest, 0));
+
+    aws_hash_destroy(linear_hash);
+    aws_input_stream_destroy(stream);
+
+    return AWS_OP_SUCCESS;
+}
+
+static int s_sha256_pair(struct aws_allocator *allocator, const uint8_t *left, const uint8_t *right, uint8_t *out) {
+    uint8_t pair[AWS_SHA256_LEN * 2];
+    memcpy(pair, left, AWS_SHA256_LEN);
+    memcpy(pair + AWS_SHA256_LEN, right, AWS_SHA256_LEN);
+
+    struct aws_byte_cursor pair_cursor = aws_byte_cursor_from_array(pair, sizeof(pair));
+    struct aws_byte_buf out_buf = aws_byte_buf_from_empty_array(out, AWS_SHA256_LEN);
+
+    return aws_sha256_compute(allocator, &pair_cursor, &out_buf, 0);
+}
+
+static int s_sha256_tree_hash_multi_chunk_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    struct aws_byte_buf payload;
+    ASSERT_SUCCESS(aws_byte_buf_init(&payload, allocator, TREE_HASH_TEST_PAYLOAD_SIZE));
+    for (size_t i = 0; i < TREE_HASH_TEST_PAYLOAD_SIZE; ++i) {
+        payload.buffer[i] = (uint8_t)(i * 31 + (i >> 13));
+    }
+    payload.len = TREE_HASH_TEST_PAYLOAD_SIZE;
+    struct aws_byte_cursor payload_cursor = aws_byte_cursor_from_buf(&payload);
+
+    /* expected: ((h0 h1) (h2 h3)) h4, built by hand */
+    uint8_t leaves[TREE_HASH_TEST_LEAF_COUNT][AWS_SHA256_LEN];
+    for (size_t i = 0; i < TREE_HASH_TEST_LEAF_COUNT; ++i) {
+        struct aws_byte_cursor leaf = payload_cursor;
+        aws_byte_cursor_advance(&leaf, i * AWS_TREE_HASH_CHUNK_SIZE);
+        if (leaf.len > AWS_TREE_HASH_CHUNK_SIZE) {
+            leaf.len = AWS_TREE_HASH_CHUNK_SIZE;
+        }
+
+        struct aws_byte_buf leaf_digest = aws_byte_buf_from_empty_array(leaves[i], AWS_SHA256_LEN);
+        ASSERT_SUCCESS(aws_sha256_compute(allocator, &leaf, &leaf_digest, 0));
+    }
+
+    uint8_t left[AWS_SHA256_LEN];
+    uint8_t right[AWS_SHA256_LEN];
+    uint8_t both[AWS_SHA256_LEN];
+    uint8_t expected_root[AWS_SHA256_LEN];
+    ASSERT_SUCCESS(s_sha256_pair(allocator, leaves[0], leaves[1], left));
+    ASSERT_SUCCESS(s_sha256_pair(allocator, leaves[2], leaves[3], right));
+    ASSERT_SUCCESS(s_sha256_pair(allocator, left, right, both));
+    ASSERT_SUCCESS(s_sha256_pair(allocator, both, leaves[4], expected_root));
+
+    uint8_t expected_linear[AWS_SHA256_LEN];
+    struct aws_byte_buf expected_linear_buf = aws_byte_buf_from_empty_array(expected_linear, AWS_SHA256_LEN);
+    ASSERT_SUCCESS(aws_sha256_compute(allocator, &payload_cursor, &expected_linear_buf, 0));
+
+    /* the same tree regardless of how many threads hash the leaves */
+    size_t thread_counts[] = {1, 4, 0};
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(thread_counts); ++i) {
+        struct aws_byte_buf tree_digest;
+        ASSERT_SUCCESS(aws_byte_buf_init(&tree_digest, allocator, AWS_SHA256_LEN));
+        struct aws_byte_buf linear_digest;
+        ASSERT_SUCCESS(aws_byte_buf_init(&linear_digest, allocator, AWS_SHA256_LEN));
+
+        ASSERT_SUCCESS(s_compute_tree_hash(allocator, payload_cursor, thread_counts[i], &tree_digest, &linear_digest));
+
+        ASSERT_BIN_ARRAYS_EQUALS(expected_root, AWS_SHA256_LEN, tree_digest.buffer, tree_digest.len);
+        ASSERT_BIN_ARRAYS_EQUALS(expected_linear, AWS_SHA256_LEN, linear_digest.buffer, linear_digest.len);
+
+        aws_byte_buf_clean_up(&linear_digest);
+        aws_byte_buf_clean_up(&tree_digest);
+    }
+
+    aws_byte_buf_clean_up(&payload);
+
+    aws_auth_library_clean_up();
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(sha256_tree_hash_multi_chunk_test, s_sha256_tree_hash_multi_chunk_test);
+
+static int s_sha256_tree_hash_single_chunk_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    /* a single leaf is its own root, so the tree hash matches the linear hash */
+    struct aws_byte_cursor payload = aws_byte_cursor_from_c_str("{\"Action\":\"UploadArchive\"}");
+
+    struct aws_byte_buf tree_digest;
+    ASSERT_SUCCESS(aws_byte_buf_init(&tree_digest, allocator, AWS_SHA256_LEN));
+    struct aws_byte_buf linear_digest;
+    ASSERT_SUCCESS(aws_byte_buf_init(&linear_digest, allocator, AWS_SHA256_LEN));
+
+    ASSERT_SUCCESS(s_compute_tree_hash(allocator, payload, 4, &tree_digest, &linear_digest));
+    ASSERT_BIN_ARRAYS_EQUALS(linear_digest.buffer, linear_digest.len, tree_digest.buffer, tree_digest.len);
+
+    /* an empty payload is the hash of the empty string */
+    struct aws_byte_buf empty_digest;
+    ASSERT_SUCCESS(aws_byte_buf_init(&empty_digest, allocator, AWS_SHA256_LEN));
+    ASSERT_SUCCESS(aws_sha256_tree_hash_compute(allocator, NULL, 0, NULL, NULL, &empty_digest));
+
+    uint8_t expected_empty[AWS_SHA256_LEN] = {
+        0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14, 0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+        0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c, 0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55,
+    };
+    ASSERT_BIN_ARRAYS_EQUALS(expected_empty, AWS_SHA256_LEN, empty_digest.buffer, empty_digest.len);
+
+    aws_byte_buf_clean_up(&empty_digest);
+    aws_byte_buf_clean_up(&linear_digest);
+    aws_byte_buf_clean_up(&tree_digest);
+
+    aws_auth_library_clean_up();
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(sha256_tree_hash_single_chunk_test, s_sha256_tree_hash_single_chunk_test);
+
+/* large enough that the leaves are spread over threads, with an odd leaf out */
+#define TREE_HASH_PARALLEL_TEST_PAYLOAD_SIZE                                                                           \
+    ((AWS_TREE_HASH_PARALLEL_MIN_CHUNK_COUNT * 2 + 1) * AWS_TREE_HASH_CHUNK_SIZE + 7)
+
+static int s_sha256_tree_hash_parallel_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    struct aws_byte_buf payload;
+    ASSERT_SUCCESS(aws_byte_buf_init(&payload, allocator, TREE_HASH_PARALLEL_TEST_PAYLOAD_SIZE));
+    for (size_t i = 0; i < TREE_HASH_PARALLEL_TEST_PAYLOAD_SIZE; ++i) {
+        payload.buffer[i] = (uint8_t)(i * 17 + (i >> 11));
+    }
+    payload.len = TREE_HASH_PARALLEL_TEST_PAYLOAD_SIZE;
+    struct aws_byte_cursor payload_cursor = aws_byte_cursor_from_buf(&payload);
+
+    /* the serial computation is the reference */
+    struct aws_byte_buf serial_tree_digest;
+    ASSERT_SUCCESS(aws_byte_buf_init(&serial_tree_digest, allocator, AWS_SHA256_LEN));
+    struct aws_byte_buf serial_linear_digest;
+    ASSERT_SUCCESS(aws_byte_buf_init(&serial_linear_digest, allocator, AWS_SHA256_LEN));
+    ASSERT_SUCCESS(s_compute_tree_hash(allocator, payload_cursor, 1, &serial_tree_digest, &serial_linear_digest));
+
+    /* more threads than the pool has are clamped rather than refused, and the pool's threads are reused */
+    size_t thread_counts[] = {2, 4, AWS_TREE_HASH_MAX_POOL_THREAD_COUNT * 2, 0, 0};
+    for (size_t i = 0; i < AWS_ARRAY_SIZE(thread_counts); ++i) {
+        struct aws_byte_buf tree_digest;
+        ASSERT_SUCCESS(aws_byte_buf_init(&tree_digest, allocator, AWS_SHA256_LEN));
+        struct aws_byte_buf linear_digest;
+        ASSERT_SUCCESS(aws_byte_buf_init(&linear_digest, allocator, AWS_SHA256_LEN));
+
+        ASSERT_SUCCESS(s_compute_tree_hash(allocator, payload_cursor, thread_counts[i], &tree_digest, &linear_digest));
+
+        ASSERT_BIN_ARRAYS_EQUALS(
+            serial_tree_digest.buffer, serial_tree_digest.len, tree_digest.buffer, tree_digest.len);
+        ASSERT_BIN_ARRAYS_EQUALS(
+            serial_linear_digest.buffer, serial_linear_digest.len, linear_digest.buffer, linear_digest.len);
+
+        aws_byte_buf_clean_up(&linear_digest);
+        aws_byte_buf_clean_up(&tree_digest);
+    }
+
+    aws_byte_buf_clean_up(&serial_linear_digest);
+    aws_byte_buf_clean_up(&serial_tree_digest);
+    aws_byte_buf_clean_up(&payload);
+
+    aws_auth_library_clean_up();
+
+    return AWS_OP_SUCCESS;
+}
+
+AWS_TEST_CASE(sha256_tree_hash_parallel_test, s_sha256_tree_hash_parallel_test);
@@ -0,0 +1,174 @@
+/*
+ * Copyright 2010-2019 Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * A copy of the License is located at
+ *
+ *  http://aws.amazon.com/apache2.0
+ *
+ * or in the "license" file accompanying this file. This file is distributed
+ * on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either
+ * express or implied. See the License for the specific language governing
+ * permissions and limitations under the License.
+ */
+
+#include <aws/testing/aws_test_harness.h>
+
+#include <aws/auth/credentials.h>
+#include <aws/auth/websocket_presigner.h>
+#include <aws/common/string.h>
+
+#include "credentials_provider_utils.h"
+
+#include <string.h>
+
+AWS_STATIC_STRING_FROM_LITERAL(s_access_key_id, "AKIDEXAMPLE");
+AWS_STATIC_STRING_FROM_LITERAL(s_secret_access_key, "wJalrXUtnFEMI/K7MDENG+bPxRfiCYEXAMPLEKEY");
+
+/* 2015-08-30T12:36:00Z */
+#define PRESIGN_TEST_START_TIME_SECS 1440938160ULL
+#define PRESIGN_TEST_NANOS_PER_SEC 1000000000ULL
+
+struct presign_test_state {
+    struct aws_allocator *allocator;
+    struct aws_byte_buf signed_path;
+    int error_code;
+    int callback_count;
+};
+
+static void s_on_presign_complete(const struct aws_byte_cursor *signed_path, int error_code, void *user_data) {
+    struct presign_test_state *state = user_data;
+
+    state->error_code = error_code;
+    ++state->callback_count;
+
+    aws_byte_buf_clean_up(&state->signed_path);
+    if (signed_path != NULL) {
+        aws_byte_buf_init_copy_from_cursor(&state->signed_path, state->allocator, *signed_path);
+    }
+}
+
+static bool s_signed_path_contains(struct presign_test_state *state, const char *fragment) {
+    struct aws_byte_cursor path = aws_byte_cursor_from_buf(&state->signed_path);
+    struct aws_byte_cursor fragment_cursor = aws_byte_cursor_from_c_str(fragment);
+    struct aws_byte_cursor found;
+
+    return aws_byte_cursor_find_exact(&path, &fragment_cursor, &found) == AWS_OP_SUCCESS;
+}
+
+static struct aws_websocket_presigner *s_new_test_presigner(struct aws_allocator *allocator) {
+    struct aws_credentials_provider_static_options static_options = {
+        .access_key_id = aws_byte_cursor_from_string(s_access_key_id),
+        .secret_access_key = aws_byte_cursor_from_string(s_secret_access_key),
+    };
+
+    struct aws_credentials_provider *provider = aws_credentials_provider_new_static(allocator, &static_options);
+    if (provider == NULL) {
+        return NULL;
+    }
+
+    struct aws_websocket_presigner_options options = {
+        .credentials_provider = provider,
+        .region = aws_byte_cursor_from_c_str("us-east-1"),
+        .service = aws_byte_cursor_from_c_str("iotdevicegateway"),
+        .host = aws_byte_cursor_from_c_str("example-ats.iot.us-east-1.amazonaws.com"),
+        .path = aws_byte_cursor_from_c_str("/mqtt"),
+        .expiration_in_seconds = 300,
+        .refresh_ahead_in_seconds = 60,
+        .clock_fn = mock_aws_get_time,
+    };
+
+    struct aws_websocket_presigner *presigner = aws_websocket_presigner_new(allocator, &options);
+
+    aws_credentials_provider_release(provider);
+
+    return presigner;
+}
+
+static int s_websocket_presigner_cached_path_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    mock_aws_set_time(PRESIGN_TEST_START_TIME_SECS * PRESIGN_TEST_NANOS_PER_SEC);
+
+    struct aws_websocket_presigner *presigner = s_new_test_presigner(allocator);
+    ASSERT_NOT_NULL(presigner);
+
+    struct presign_test_state state;
+    AWS_ZERO_STRUCT(state);
+    state.allocator = allocator;
+
+    ASSERT_SUCCESS(aws_websocket_presigner_get_signed_path(presigner, s_on_presign_complete, &state));
+    ASSERT_INT_EQUALS(1, state.callback_count);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, state.error_code);
+    ASSERT_TRUE(s_signed_path_contains(&state, "/mqtt?"));
+    ASSERT_TRUE(s_signed_path_contains(&state, "X-Amz-Expires=300"));
+    ASSERT_TRUE(s_signed_path_contains(&state, "X-Amz-Date=20150830T123600Z"));
+    ASSERT_TRUE(s_signed_path_contains(&state, "X-Amz-Signature="));
+
+    struct aws_byte_buf first_path;
+    ASSERT_SUCCESS(aws_byte_buf_init_copy(&first_path, allocator, &state.signed_path));
+
+    /* inside the validity window and before the refresh-ahead window: the cached path is reused */
+    mock_aws_set_time((PRESIGN_TEST_START_TIME_SECS + 100) * PRESIGN_TEST_NANOS_PER_SEC);
+    ASSERT_SUCCESS(aws_websocket_presigner_get_signed_path(presigner, s_on_presign_complete, &state));
+    ASSERT_INT_EQUALS(2, state.callback_count);
+    ASSERT_BIN_ARRAYS_EQUALS(first_path.buffer, first_path.len, state.signed_path.buffer, state.signed_path.len);
+
+    /* inside the refresh-ahead window: still handed the cached path, but a re-sign happens in the background */
+    mock_aws_set_time((PRESIGN_TEST_START_TIME_SECS + 250) * PRESIGN_TEST_NANOS_PER_SEC);
+    ASSERT_SUCCESS(aws_websocket_presigner_get_signed_path(presigner, s_on_presign_complete, &state));
+    ASSERT_INT_EQUALS(3, state.callback_count);
+    ASSERT_BIN_ARRAYS_EQUALS(first_path.buffer, first_path.len, state.signed_path.buffer, state.signed_path.len);
+
+    /* the static provider completes synchronously, so the refreshed path is already in place */
+    ASSERT_SUCCESS(aws_websocket_presigner_get_signed_path(presigner, s_on_presign_complete, &state));
+    ASSERT_INT_EQUALS(4, state.callback_count);
+    ASSERT_TRUE(s_signed_path_contains(&state, "X-Amz-Date=20150830T124010Z"));
+
+    aws_byte_buf_clean_up(&first_path);
+    aws_byte_buf_clean_up(&state.signed_path);
+    aws_websocket_presigner_release(presigner);
+
+    aws_auth_library_clean_up();
+
+    return 0;
+}
+
+AWS_TEST_CASE(websocket_presigner_cached_path_test, s_websocket_presigner_cached_path_test);
+
+static int s_websocket_presigner_expired_path_test(struct aws_allocator *allocator, void *ctx) {
+    (void)ctx;
+
+    aws_auth_library_init(allocator);
+
+    mock_aws_set_time(PRESIGN_TEST_START_TIME_SECS * PRESIGN_TEST_NANOS_PER_SEC);
+
+    struct aws_websocket_presigner *presigner = s_new_test_presigner(allocator);
+    ASSERT_NOT_NULL(presigner);
+
+    struct presign_test_state state;
+    AWS_ZERO_STRUCT(state);
+    state.allocator = allocator;
+
+    ASSERT_SUCCESS(aws_websocket_presigner_get_signed_path(presigner, s_on_presign_complete, &state));
+    ASSERT_TRUE(s_signed_path_contains(&state, "X-Amz-Date=20150830T123600Z"));
+
+    /* past expiration: the caller waits on a fresh signing pass rather than getting the stale path */
+    mock_aws_set_time((PRESIGN_TEST_START_TIME_SECS + 301) * PRESIGN_TEST_NANOS_PER_SEC);
+    ASSERT_SUCCESS(aws_websocket_presigner_get_signed_path(presigner, s_on_presign_complete, &state));
+    ASSERT_INT_EQUALS(2, state.callback_count);
+    ASSERT_INT_EQUALS(AWS_ERROR_SUCCESS, state.error_code);
+    ASSERT_TRUE(s_signed_path_contains(&state, "X-Amz-Date=20150830T124101Z"));
+
+    aws_byte_buf_clean_up(&state.signed_path);
+    aws_websocket_presigner_release(presigner);
+
+    aws_auth_library_clean_up();
+
+    return 0;
+}
+
+AWS_TEST_CASE(websocket_presigner_expired_path_test, s_websocket_presigner_expired_path_test);